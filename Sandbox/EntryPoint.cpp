@@ -63,18 +63,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		maxTPSCvar->value = 60.0;
 
 		Physics::create();
+		Jobs::create();
 		Window::create(1600, 900, "Sandbox");
 		Input::Keyboard::create(Window::getHandle());
 		Input::Mouse::create(Window::getHandle());
+		auto startupStart = std::chrono::high_resolution_clock::now();
 		Renderer::create(1600, 900, 2048);
 		Debug::create();
 		Data::LightRenderer::create();
 		Data::SkyRenderer::create();
 		Data::DebugRenderer::create();
 		Data::ParticleRenderer::create();
+		Data::TextureCompressor::create();
 		Components::StaticModel::create();
+		Components::LevelOfDetail::create();
 		Components::AnimatedModel::create();
+		Components::ModelCache::create();
+		//Pipelines were built on worker threads since Renderer::create, the world binds them
+		Renderer::PipelineCache::wait();
+		//Cold against warm shader and pipeline cache startup
+		Logger::gInfo("Renderer startup took " + std::to_string(std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startupStart).count()) + " ms");
+		Command::execute("eg::Renderer::PrintShaderCacheStats");
 		World::create();
+		//Players stay resident, the controlled one must never be evicted with its cell
+		World::Streaming::registerStreamableType("MapPhysicsObject");
 
 		{
 
@@ -126,7 +139,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 					World::render(cmd, alpha, Renderer::RenderStage::SUBPASS1_POINTLIGHT);
 				});
 
-			World::load("world.json", jsonDispatcher);
+			//Streamed objects are parked on stream out and reused on stream in
+			World::ObjectPool<sndbx::MapPhysicsObject> mapPhysicsObjectPool("MapPhysicsObject");
+
+			World::Streaming::load("world.json", jsonDispatcher);
 
 			using Clock = std::chrono::high_resolution_clock;
 			using TimePoint = std::chrono::time_point<Clock>;
@@ -156,6 +172,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 				float alpha = static_cast<float>(accumulator / tickInterval);
 				eg::Debug::checkForKeyboardInput();
 				World::update(deltaTime, alpha);
+				World::Streaming::update(Renderer::getMainCamera().mPosition);
 				Input::Keyboard::update();
 				Input::Mouse::update();
 
@@ -190,6 +207,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	}
 
 	World::destroy();
+	Components::ModelCache::destroy();
 	Components::AnimatedModel::destroy();
 	Components::StaticModel::destroy();
 	Data::DebugRenderer::destroy();
@@ -198,6 +216,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	Data::LightRenderer::destroy();
 	Debug::destroy();
 	Renderer::destory();
+	Jobs::destroy();
 	Window::destroy();
 	Physics::destroy();
 
@@ -8,25 +8,43 @@
 
 namespace sndbx
 {
-	void MapObject::render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage)
+	MapObject::~MapObject()
 	{
+		eg::World::getTransformHierarchy().destroy(mNode);
+	}
+
+	void MapObject::updateTransform(float alpha)
+	{
+		//Static body, only written when the object is added
 		JPH::BodyInterface* bodyInterface = eg::Physics::getBodyInterface();
 		JPH::Mat44 matrix = bodyInterface->GetCenterOfMassTransform(mBody.mBodyID);
 		glm::mat4x4 glmMatrix;
 		std::memcpy(&glmMatrix[0][0], &matrix, sizeof(glmMatrix));
 
+		eg::World::TransformHierarchy& hierarchy = eg::World::getTransformHierarchy();
+		if (mNode == eg::World::TransformHierarchy::INVALID_HANDLE)
+			mNode = hierarchy.create();
+		hierarchy.setLocal(mNode, glmMatrix);
+	}
+
+	void MapObject::render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage)
+	{
+		if (mNode == eg::World::TransformHierarchy::INVALID_HANDLE)
+			return;
+		const glm::mat4x4& glmMatrix = eg::World::getTransformHierarchy().getWorld(mNode);
+
 		switch (stage)
 		{
 		case eg::Renderer::RenderStage::SHADOW:
 			if (mModel)
 			{
-				mModel->renderShadow(cmd, glmMatrix);
+				mModel->renderShadow(cmd, glmMatrix, mLod.select(stage, glmMatrix, *mModel));
 			}
 			break;
 		case eg::Renderer::RenderStage::SUBPASS0_GBUFFER:
 			if (mModel)
 			{
-				mModel->render(cmd, glmMatrix);
+				mModel->render(cmd, glmMatrix, mLod.select(stage, glmMatrix, *mModel));
 			}
 
 			break;
@@ -36,6 +54,14 @@ namespace sndbx
 	}
 
 	void MapObject::fromJson(const nlohmann::json& json)
+	{
+		eg::World::LoadContext context;
+		prepareLoad(json, context);
+		context.flush();
+		finishLoad();
+	}
+
+	bool MapObject::prepareLoad(const nlohmann::json& json, eg::World::LoadContext& context)
 	{
 		std::string modelPath(json["model"]["model_path"].get<std::string>());
 		glm::vec3 position = { json["body"]["position"].at(0).get<float>(),
@@ -47,7 +73,9 @@ namespace sndbx
 		rotation.z = json["body"]["rotation"].at(2).get<float>();
 		rotation.w = json["body"]["rotation"].at(3).get<float>();
 
-		tinygltf::Model model;
+		//Image decoding and block compression happen here, the upload waits for finishLoad
+		mPendingModel = std::make_unique<tinygltf::Model>();
+		tinygltf::Model& model = *mPendingModel;
 		tinygltf::TinyGLTF loader;
 		loader.SetImageLoader(eg::Data::LoadImageData, nullptr);
 		std::string err;
@@ -65,8 +93,7 @@ namespace sndbx
 			throw std::runtime_error("Failed to load map object: " + modelPath);
 		}
 
-		//We will not be caching this model
-		mModel = std::make_shared<eg::Components::StaticModel>(modelPath, model);
+		mModelPath = modelPath;
 
 		//Create rigid body
 		{
@@ -162,10 +189,22 @@ namespace sndbx
 			bodySetting.mAllowSleeping = false;
 			bodySetting.mMotionQuality = JPH::EMotionQuality::Discrete;
 
-			mBody.mBodyID = eg::Physics::getBodyInterface()->CreateAndAddBody(bodySetting, JPH::EActivation::DontActivate);
+			JPH::Body* body = eg::Physics::getBodyInterface()->CreateBody(bodySetting);
+			if (!body)
+				throw std::runtime_error("Failed to create map object body, out of bodies: " + modelPath);
+			mBody.mBodyID = body->GetID();
+			context.addBody(mBody.mBodyID, JPH::EActivation::DontActivate);
 			mBody.mMass = 0.0f;
 			mBody.mFriction = 0.8f;
 			mBody.mRestitution = 1.0f;
 		}
+		return true;
+	}
+
+	void MapObject::finishLoad()
+	{
+		//We will not be caching this model
+		mModel = std::make_shared<eg::Components::StaticModel>(mModelPath, *mPendingModel);
+		mPendingModel.reset();
 	}
 }
\ No newline at end of file
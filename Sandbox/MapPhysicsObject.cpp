@@ -14,18 +14,20 @@ namespace sndbx
 
 	MapPhysicsObject::~MapPhysicsObject()
 	{
-		const JPH::BodyLockInterface& lockInterface = eg::Physics::getPhysicsSystem().GetBodyLockInterface();
-		JPH::BodyLockRead lockRead(lockInterface, mBody.mBodyID);
-		bool valid = lockRead.Succeeded();
-		lockRead.ReleaseLock();
-		if (!valid) return; // Body already removed or invalid
-		eg::Physics::getBodyInterface()->RemoveBody(mBody.mBodyID);
-		eg::Physics::getBodyInterface()->DestroyBody(mBody.mBodyID);
-		
+		eg::World::getTransformHierarchy().destroy(mNode);
+		mBody.destroy();
 	}
 	void MapPhysicsObject::fromJson(const nlohmann::json& json)
 	{
-		std::string modelPath = json["model"]["model_path"].get<std::string>();
+		eg::World::LoadContext context;
+		prepareLoad(json, context);
+		context.flush();
+		finishLoad();
+	}
+
+	bool MapPhysicsObject::prepareLoad(const nlohmann::json& json, eg::World::LoadContext& context)
+	{
+		mModelPath = json["model"]["model_path"].get<std::string>();
 		glm::vec3 position = { json["rigidBody"]["position"].at(0).get<float>(),
 			json["rigidBody"]["position"].at(1).get<float>(),
 			json["rigidBody"]["position"].at(2).get<float>() };
@@ -35,10 +37,6 @@ namespace sndbx
 		rotation.z = json["rigidBody"]["rotation"].at(2).get<float>();
 		rotation.w = json["rigidBody"]["rotation"].at(3).get<float>();
 
-		mCuller = std::make_unique<eg::Components::CameraFrustumCuller>(eg::Renderer::getMainCamera());
-
-		mModel = eg::Components::ModelCache::loadStaticModel(modelPath);
-
 		//Create rigid body
 		{
 
@@ -53,16 +51,46 @@ namespace sndbx
 			bodySetting.mMassPropertiesOverride.mMass = 10.0f;
 			bodySetting.mLinearDamping = 1.001f;
 			bodySetting.mAngularDamping = 0.0f;
-			bodySetting.mAllowSleeping = false;
+			bodySetting.mAllowSleeping = true;
 			bodySetting.mMotionQuality = JPH::EMotionQuality::Discrete;
 			bodySetting.mRestitution = 0.9f;
 
-			mBody.mBodyID = eg::Physics::getBodyInterface()->CreateAndAddBody(bodySetting, JPH::EActivation::Activate);
+			JPH::Body* body = eg::Physics::getBodyInterface()->CreateBody(bodySetting);
+			if (!body)
+				throw std::runtime_error("Failed to create map physics object body, out of bodies");
+			mBody.mBodyID = body->GetID();
+			context.addBody(mBody.mBodyID, JPH::EActivation::Activate);
 			mBody.mMass = 10.0f;
 			mBody.mFriction = 0.2f;
 			mBody.mRestitution = 0.0f;
 
 		}
+		return true;
+	}
+
+	void MapPhysicsObject::finishLoad()
+	{
+		//Camera is main thread only, the model loads in the background
+		mCuller = std::make_unique<eg::Components::CameraFrustumCuller>(eg::Renderer::getMainCamera());
+		mModel = eg::Components::ModelCache::loadStaticModelAsync(mModelPath);
+	}
+
+	bool MapPhysicsObject::onPoolAcquire(const nlohmann::json& json)
+	{
+		glm::vec3 position = { json["rigidBody"]["position"].at(0).get<float>(),
+			json["rigidBody"]["position"].at(1).get<float>(),
+			json["rigidBody"]["position"].at(2).get<float>() };
+		glm::quat rotation;
+		rotation.x = json["rigidBody"]["rotation"].at(0).get<float>();
+		rotation.y = json["rigidBody"]["rotation"].at(1).get<float>();
+		rotation.z = json["rigidBody"]["rotation"].at(2).get<float>();
+		rotation.w = json["rigidBody"]["rotation"].at(3).get<float>();
+
+		//Culler and body are kept, the model comes from the cache
+		mModel = eg::Components::ModelCache::loadStaticModelAsync(json["model"]["model_path"].get<std::string>());
+		mBody.unpark(position, rotation);
+		mLod = eg::Components::LevelOfDetail();
+		return true;
 	}
 
 	void MapPhysicsObject::prePhysicsUpdate(float delta)
@@ -74,6 +102,13 @@ namespace sndbx
 	{
 		
 		
+	}
+	void MapPhysicsObject::updateTransform(float alpha)
+	{
+		eg::World::TransformHierarchy& hierarchy = eg::World::getTransformHierarchy();
+		if (mNode == eg::World::TransformHierarchy::INVALID_HANDLE)
+			mNode = hierarchy.create();
+		hierarchy.setLocal(mNode, mBody.getBodyMatrix(alpha));
 	}
 	void MapPhysicsObject::fixedUpdate(float delta)
 	{
@@ -82,25 +117,34 @@ namespace sndbx
 
 	void MapPhysicsObject::render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage)
 	{
-		glm::mat4x4 mat = mBody.getBodyMatrix(alpha);
-		eg::Command::Var* widthCVar = eg::Command::findVar("eg::Renderer::ScreenWidth");
-		eg::Command::Var* heightCVar = eg::Command::findVar("eg::Renderer::ScreenHeight");
+		if (mNode == eg::World::TransformHierarchy::INVALID_HANDLE)
+			return;
+		const glm::mat4x4& mat = eg::World::getTransformHierarchy().getWorld(mNode);
+		static eg::Command::Var* widthCVar = eg::Command::findVar("eg::Renderer::ScreenWidth");
+		static eg::Command::Var* heightCVar = eg::Command::findVar("eg::Renderer::ScreenHeight");
 
 		mCuller->updateFrustumPlanes(vk::Extent2D( static_cast<uint32_t>(widthCVar->value), 
 			static_cast<uint32_t>(heightCVar->value)));
 
+		//Placeholder until the model has finished loading
+		eg::Components::StaticModel* model = mModel.get().get();
+		if (!model)
+			model = eg::Components::ModelCache::getPlaceholder().get();
+		if (!model)
+			return;
+
 		switch (stage)
 		{
 		case eg::Renderer::RenderStage::SHADOW:
 		{
-			mModel->renderShadow(cmd, mat);
+			model->renderShadow(cmd, mat, mLod.select(stage, mat, *model));
 			break;
 		}
 		case eg::Renderer::RenderStage::SUBPASS0_GBUFFER:
 		{
 			if (mCuller->isSphereInFrustum(mat[3], 2.0f))
 			{
-				mModel->render(cmd, mat);
+				model->render(cmd, mat, mLod.select(stage, mat, *model));
 			}
 			
 			break;
@@ -22,13 +22,10 @@ namespace sndbx
 
 	Player::~Player()
 	{
-		const JPH::BodyLockInterface& lockInterface = eg::Physics::getPhysicsSystem().GetBodyLockInterface();
-		JPH::BodyLockRead lockRead(lockInterface, mBody.mBodyID);
-		bool valid = lockRead.Succeeded();
-		lockRead.ReleaseLock();
-		if (!valid) return; // Body already removed or invalid
-		eg::Physics::getBodyInterface()->RemoveBody(mBody.mBodyID);
-		eg::Physics::getBodyInterface()->DestroyBody(mBody.mBodyID);
+		eg::World::TransformHierarchy& hierarchy = eg::World::getTransformHierarchy();
+		hierarchy.destroy(mModelNode);
+		hierarchy.destroy(mNode);
+		mBody.destroy();
 	}
 
 	void Player::prePhysicsUpdate(float delta)
@@ -41,6 +38,17 @@ namespace sndbx
 		mAnimator->update(delta);
 	}
 
+	void Player::updateTransform(float alpha)
+	{
+		eg::World::TransformHierarchy& hierarchy = eg::World::getTransformHierarchy();
+		if (mNode == eg::World::TransformHierarchy::INVALID_HANDLE)
+		{
+			mNode = hierarchy.create();
+			mModelNode = hierarchy.create(mNode, mModelOffsetMatrix);
+		}
+		hierarchy.setLocal(mNode, mBody.getBodyMatrix(alpha));
+	}
+
 	void Player::fixedUpdate(float delta)
 	{
 		const JPH::BodyLockInterface& lockInterface = eg::Physics::getPhysicsSystem().GetBodyLockInterface();
@@ -127,25 +135,24 @@ namespace sndbx
 
 	void Player::render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage)
 	{
-		if (!mModel)
+		if (!mModel || mModelNode == eg::World::TransformHierarchy::INVALID_HANDLE)
 			return;
 
-		glm::mat4x4 glmMatrix = mBody.getBodyMatrix(alpha);
-		glmMatrix *= mModelOffsetMatrix;
+		const glm::mat4x4& glmMatrix = eg::World::getTransformHierarchy().getWorld(mModelNode);
 
 		switch (stage)
 		{
 
 		case eg::Renderer::RenderStage::SHADOW:
 		{
-			mModel->renderShadow(cmd, *mAnimator, glmMatrix);
+			mModel->renderShadow(cmd, *mAnimator, glmMatrix, mLod.select(stage, glmMatrix, *mModel));
 			break;
 		}
 		case eg::Renderer::RenderStage::SUBPASS0_GBUFFER:
 		{
 			if (mVisible)
 			{
-				mModel->render(cmd, *mAnimator, glmMatrix);
+				mModel->render(cmd, *mAnimator, glmMatrix, mLod.select(stage, glmMatrix, *mModel));
 			}
 			break;
 		}
@@ -178,6 +185,47 @@ namespace sndbx
 		};
 	}
 
+	bool Player::onPoolAcquire(const nlohmann::json& json)
+	{
+		//Capsule shape and animator are tied to the size and the model, only reuse when they match
+		if (json["height"].get<float>() != mHeight || json["radius"].get<float>() != mRadius
+			|| eg::Components::ModelCache::loadAnimatedModelFromJson(json["model"]) != mModel)
+			return false;
+
+		mMass = json["mass"];
+		mGroundAccel = json["groundAccel"];
+		mAirAccel = json["airAccel"];
+		mJumpStrength = json["jumpStrength"];
+		mGroundMaxSpeed = json["groundMaxSpeed"];
+		mAirMaxSpeed = json["airMaxSpeed"];
+		mGroundDamping = json["groundDamping"];
+		mAirDamping = json["airDamping"];
+		mYaw = json["yaw"];
+		mPitchClamp = json["pitchClamp"];
+		mPitch = json["pitch"];
+		mCameraDistance = json["cameraDistance"];
+		mPlayerSpeed = json["playerSpeed"];
+		mMouseSensitivity = json["mouseSensitivity"];
+
+		mDirection = { 0, 0, 0 };
+		mVelocity = { 0, 0, 0 };
+		mJumpRequested = false;
+		mGrabOject = false;
+		mAnimator->setState(glm::vec2(0.0f));
+
+		glm::vec3 position = { json["body"]["position"].at(0).get<float>(),
+			json["body"]["position"].at(1).get<float>(),
+			json["body"]["position"].at(2).get<float>() };
+		glm::quat rotation;
+		rotation.x = json["body"]["rotation"].at(0).get<float>();
+		rotation.y = json["body"]["rotation"].at(1).get<float>();
+		rotation.z = json["body"]["rotation"].at(2).get<float>();
+		rotation.w = json["body"]["rotation"].at(3).get<float>();
+		mBody.unpark(position, rotation);
+		mLod = eg::Components::LevelOfDetail();
+		return true;
+	}
+
 	void Player::fromJson(const nlohmann::json& json)
 	{
 		mModel = eg::Components::ModelCache::loadAnimatedModelFromJson(json["model"]);
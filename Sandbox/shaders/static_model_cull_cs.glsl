@@ -0,0 +1,85 @@
+#version 450
+
+layout(local_size_x = 64) in;
+
+struct CullInstance
+{
+    mat4 transform;
+    vec4 sphere; //Model space center and radius, a negative radius is never culled
+    uint firstCommand;
+    uint commandCount;
+    uint pad0;
+    uint pad1;
+};
+
+struct CullCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint batch;
+    uint outputOffset;
+    uint pad;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances { CullInstance instances[]; };
+layout(std430, set = 0, binding = 1) buffer Commands { CullCommand commands[]; };
+layout(std430, set = 0, binding = 2) writeonly buffer Visible { mat4 visible[]; };
+layout(std430, set = 0, binding = 3) writeonly buffer Compacted { CullCommand compacted[]; };
+layout(std430, set = 0, binding = 4) buffer Counts { uint counts[]; };
+
+layout(push_constant) uniform PushConstant
+{
+    vec4 planes[6];
+    uint instanceCount;
+    uint commandCount;
+    uint cullEnabled;
+    uint phase; //0 culls instances, 1 compacts the commands they reached
+} pc;
+
+bool isVisible(CullInstance instance)
+{
+    if (pc.cullEnabled == 0 || instance.sphere.w < 0.0)
+        return true;
+    vec3 center = (instance.transform * vec4(instance.sphere.xyz, 1.0)).xyz;
+    float scale = max(length(instance.transform[0].xyz), max(length(instance.transform[1].xyz), length(instance.transform[2].xyz)));
+    float radius = instance.sphere.w * scale;
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(pc.planes[i].xyz, center) + pc.planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (pc.phase == 0)
+    {
+        if (index >= pc.instanceCount)
+            return;
+        CullInstance instance = instances[index];
+        //A run without a mesh at its lod owns no command, firstCommand already belongs to the next run
+        if (instance.commandCount == 0 || !isVisible(instance))
+            return;
+        //The first command of the run hands out the slot, the other meshes of the run count along
+        uint slot = atomicAdd(commands[instance.firstCommand].instanceCount, 1);
+        visible[commands[instance.firstCommand].firstInstance + slot] = instance.transform;
+        for (uint i = 1; i < instance.commandCount; i++)
+        {
+            atomicAdd(commands[instance.firstCommand + i].instanceCount, 1);
+        }
+    }
+    else
+    {
+        if (index >= pc.commandCount)
+            return;
+        CullCommand command = commands[index];
+        if (command.instanceCount == 0)
+            return;
+        uint slot = atomicAdd(counts[command.batch], 1);
+        compacted[command.outputOffset + slot] = command;
+    }
+}
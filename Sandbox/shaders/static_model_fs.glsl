@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 
 layout(location = 0) in vec3 fsNormal;
@@ -9,33 +10,44 @@ layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec3 outAlbeo;
 layout(location = 2) out vec3 outMr;
 
-layout(set = 1, binding = 0) uniform UniformBuffer
+struct Material
 {
     vec3 albedoColor;
-    uint has_albedo;
-    uint has_normal;
-    uint has_mr;
-} ubo;
-layout(set = 1, binding = 1) uniform sampler2D uAlbedo;
-layout(set = 1, binding = 2) uniform sampler2D uNormal;
-layout(set = 1, binding = 3) uniform sampler2D uMr;
+    uint albedo; //Texture indices, INVALID_INDEX when unset
+    uint normal;
+    uint mr;
+    uint pad0;
+    uint pad1;
+};
+
+const uint INVALID_INDEX = 0xFFFFFFFFu;
+
+//Every model's textures and materials
+layout(set = 1, binding = 0) uniform sampler2D uTextures[];
+layout(std430, set = 1, binding = 1) readonly buffer Materials { Material materials[]; };
+
+layout(push_constant) uniform PushConstant
+{
+    uint materialIndex;
+} pc;
 
 
 
 void main() {
-    vec3 albedo = ubo.albedoColor;
+    Material material = materials[pc.materialIndex];
+    vec3 albedo = material.albedoColor;
     vec3 mr = vec3(1.0, 0.0, 1.0);
     vec3 normal = normalize(fsNormal);
 
-    if(ubo.has_normal == 1)
+    if(material.normal != INVALID_INDEX)
     {
-        vec3 normalMap = texture(uNormal, fsUv).rgb * 2.0 - 1.0;
+        vec3 normalMap = texture(uTextures[material.normal], fsUv).rgb * 2.0 - 1.0;
         normal = normalize(fsTBN * normalMap);
     }
 
-    if(ubo.has_albedo == 1)
+    if(material.albedo != INVALID_INDEX)
     {
-        vec4 sampledAlbedo =  texture(uAlbedo, fsUv);
+        vec4 sampledAlbedo =  texture(uTextures[material.albedo], fsUv);
         albedo = sampledAlbedo.rgb;
         if(sampledAlbedo.a < 0.1)
         {
@@ -43,12 +55,12 @@ void main() {
         }
     }
 
-    if(ubo.has_mr == 1)
+    if(material.mr != INVALID_INDEX)
     {
-        mr = texture(uMr, fsUv).rgb;
+        mr = texture(uTextures[material.mr], fsUv).rgb;
     }
 
-    outAlbeo = ubo.albedoColor * albedo;
+    outAlbeo = material.albedoColor * albedo;
     outNormal = normal;
     outMr = mr;
 }
\ No newline at end of file
@@ -6,15 +6,12 @@ layout(triangle_strip, max_vertices = 3) out;
 
 layout(location = 0) in vec2 gsUv[];
 layout(location = 1) in vec3 gsNormal[];
+layout(location = 2) in mat3 gsModel[];
 
 layout(location = 0) out vec3 fsNormal;
 layout(location = 1) out vec2 fsUv;
 layout(location = 2) out mat3 fsTBN;
 
-layout(push_constant) uniform PushConstant
-{
-    mat4 model;
-} ps;
 
 
 
@@ -30,8 +27,8 @@ void main()
 	float r = 1.0 / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
 	vec3 tangent = vec3((edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r);
 	vec3 bitangent = vec3((edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r);
-	vec3 T = normalize(vec3(ps.model * vec4(tangent, 0.0f)));
-	vec3 B = normalize(vec3(ps.model * vec4(bitangent, 0.0f)));
+	vec3 T = normalize(gsModel[0] * tangent);
+	vec3 B = normalize(gsModel[0] * bitangent);
 
 
 	for(int i = 0; i < 3; i++)
@@ -2,15 +2,11 @@
 
 #include "shaders/gubo.glsl"
 
-layout(push_constant) uniform PushConstant
-{
-    mat4 model;
-} ps;
-
-
 layout(location = 0) in vec3 inPos;
+//Per instance
+layout(location = 3) in mat4 inModel;
 
 
 void main() {
-    gl_Position = ps.model * vec4(inPos, 1.0);
+    gl_Position = inModel * vec4(inPos, 1.0);
 }
\ No newline at end of file
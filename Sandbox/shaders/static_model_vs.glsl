@@ -2,22 +2,20 @@
 
 #include "shaders/gubo.glsl"
 
-layout(push_constant) uniform PushConstant
-{
-    mat4 model;
-} ps;
-
-
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUv;
+//Per instance
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec2 gsUv;
 layout(location = 1) out vec3 gsNormal;
+layout(location = 2) out mat3 gsModel;
 
 void main() {
-    vec4 v = ps.model * vec4(inPos, 1.0);
+    vec4 v = inModel * vec4(inPos, 1.0);
     gl_Position = gUBO.projection * gUBO.view * v;
-    gsNormal = vec3(ps.model * vec4(inNormal, 0.0f));
+    gsNormal = vec3(inModel * vec4(inNormal, 0.0f));
     gsUv = inUv;
+    gsModel = mat3(inModel);
 }
\ No newline at end of file
@@ -10,8 +10,15 @@ namespace sndbx
 	private:
 		std::shared_ptr<eg::Components::StaticModel> mModel = nullptr;
 		eg::Components::RigidBody mBody;
+		eg::Components::LevelOfDetail mLod;
+		eg::World::TransformHierarchy::Handle mNode = eg::World::TransformHierarchy::INVALID_HANDLE;
+
+		//Parsed on a loader thread, uploaded by finishLoad
+		std::string mModelPath;
+		std::unique_ptr<tinygltf::Model> mPendingModel;
 	public:
 		MapObject() = default;
+		~MapObject();
 
 		void update(float delta, float alpha) override {}
 		void prePhysicsUpdate(float delta) override {}
@@ -19,6 +26,9 @@ namespace sndbx
 		void render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage) override;
 		void onInspector() override {};
 		const char* getType() const override { return "MapObject"; }
+		uint32_t getUpdatePhases() const override { return PHASE_NONE; }
+		void onRetire() override { mBody.destroy(); }
+		void updateTransform(float alpha) override;
 
 		nlohmann::json toJson() const override
 		{
@@ -30,5 +40,7 @@ namespace sndbx
 		}
 
 		void fromJson(const nlohmann::json& json) override;
+		bool prepareLoad(const nlohmann::json& json, eg::World::LoadContext& context) override;
+		void finishLoad() override;
 	};
 }
\ No newline at end of file
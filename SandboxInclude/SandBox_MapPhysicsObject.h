@@ -10,7 +10,10 @@ namespace sndbx
 	private:
 		eg::Components::RigidBody mBody;
 		std::unique_ptr<eg::Components::CameraFrustumCuller> mCuller;
-		std::shared_ptr<eg::Components::StaticModel> mModel = nullptr;
+		eg::Components::AssetHandle<eg::Components::StaticModel> mModel;
+		eg::Components::LevelOfDetail mLod;
+		eg::World::TransformHierarchy::Handle mNode = eg::World::TransformHierarchy::INVALID_HANDLE;
+		std::string mModelPath;
 	public:
 		MapPhysicsObject() = default;
 		~MapPhysicsObject();
@@ -21,16 +24,24 @@ namespace sndbx
 		void render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage) override;
 		void onInspector() override {};
 		const char* getType() const override { return "MapPhysicsObject"; }
+		void onPoolRelease() override { mBody.park(); }
+		void onRetire() override { mBody.destroy(); }
+		bool onPoolAcquire(const nlohmann::json& json) override;
+		void updateTransform(float alpha) override;
+		uint32_t getUpdatePhases() const override { return PHASE_PRE_PHYSICS; }
+		JPH::BodyID getSleepBody() const override { return mBody.mBodyID; }
 
 		nlohmann::json toJson() const override
 		{
 			return {
 				{"type", getType()},
-				{"model", mModel->toJson()},
+				{"model", { {"model_path", mModel.getPath()} }},
 				{"rigidBody", mBody.toJson()},
 				{"particleEmitter",{}}
 			};
 		}
 		void fromJson(const nlohmann::json& json) override;
+		bool prepareLoad(const nlohmann::json& json, eg::World::LoadContext& context) override;
+		void finishLoad() override;
 	};
 }
\ No newline at end of file
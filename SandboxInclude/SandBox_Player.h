@@ -12,6 +12,7 @@ namespace sndbx
 		std::shared_ptr<eg::Components::AnimatedModel> mModel = nullptr;
 		std::unique_ptr<eg::Components::Animator2DBlend> mAnimator;
 		eg::Components::RigidBody mBody;
+		eg::Components::LevelOfDetail mLod;
 
 		bool mVisible;
 		float mHeight = 1.8f;
@@ -37,6 +38,9 @@ namespace sndbx
 		float mMouseSensitivity = 0.2f;
 
 		glm::mat4x4 mModelOffsetMatrix;
+		//The model hangs off the body node by mModelOffsetMatrix
+		eg::World::TransformHierarchy::Handle mNode = eg::World::TransformHierarchy::INVALID_HANDLE;
+		eg::World::TransformHierarchy::Handle mModelNode = eg::World::TransformHierarchy::INVALID_HANDLE;
 	public:
 		Player(bool visible = true);
 		~Player();
@@ -47,6 +51,11 @@ namespace sndbx
 		void render(vk::CommandBuffer cmd, float alpha, eg::Renderer::RenderStage stage) override;
 		void onInspector() override {};
 		const char* getType() const override { return "Player"; }
+		void onPoolRelease() override { mBody.park(); }
+		void onRetire() override { mBody.destroy(); }
+		bool onPoolAcquire(const nlohmann::json& json) override;
+		void updateTransform(float alpha) override;
+		JPH::BodyID getSleepBody() const override { return mBody.mBodyID; }
 
 		nlohmann::json toJson() const override;
 
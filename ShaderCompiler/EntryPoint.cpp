@@ -0,0 +1,29 @@
+#include <Renderer.h>
+#include <Logger.h>
+
+#include <memory>
+#include <string>
+
+//Compiles every shader variant of a manifest into the shader cache of the working directory.
+//Run from the Sandbox directory by the precompile_shaders target
+int main(int argc, char* argv[])
+{
+	using namespace eg;
+
+	Logger::create(std::make_unique<ConsoleLogger>());
+	int result = 0;
+	try
+	{
+		Renderer::ShaderCache::create();
+		std::string manifestPath = argc > 1 ? argv[1] : "shaders/variants.json";
+		if (!Renderer::ShaderCache::precompile(manifestPath))
+			result = 1;
+	}
+	catch (const std::exception& e)
+	{
+		Logger::gError(e.what());
+		result = 1;
+	}
+	Logger::destroy();
+	return result;
+}
@@ -1,6 +1,8 @@
 #include <Components.h>
 #include <Data.h>
 #include <string>
+#include <algorithm>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <shaderc/shaderc.hpp>
@@ -9,8 +11,8 @@ namespace eg::Components
 {
 	vk::Pipeline AnimatedModel::sPipeline;
 	vk::PipelineLayout AnimatedModel::sPipelineLayout;
-	vk::DescriptorSetLayout AnimatedModel::sMaterialLayout;
 	vk::DescriptorSetLayout AnimatedModel::sBoneLayout;
+	vk::DescriptorSet AnimatedModel::sBoneSets[Renderer::MAX_FRAMES_IN_FLIGHT];
 	vk::Pipeline AnimatedModel::sShadowPipeline;
 	vk::PipelineLayout AnimatedModel::sShadowPipelineLayout;
 	Command::Var* AnimatedModel::sRenderScaleCVar;
@@ -25,52 +27,79 @@ namespace eg::Components
 
 		Command::registerFn("eg::Renderer::ReloadAllPipelines", [](size_t, char* []) {
 			destroy();
-			createPipeline();
-			createShadowPipeline();
+			Renderer::PipelineCache::build([]() { createPipeline(); createShadowPipeline(); });
 			});
 
-		createPipeline();
-		createShadowPipeline();
+		//One pipeline to the reloader, the shadow pipeline is laid out against the bone set layout
+		Renderer::HotReload::registerPipeline("AnimatedModel", []() { createPipeline(); createShadowPipeline(); }, []() {
+			std::vector<vk::DescriptorSet> boneSets(std::begin(sBoneSets), std::end(sBoneSets));
+			return Renderer::HotReload::Build([pipeline = sPipeline, layout = sPipelineLayout, boneLayout = sBoneLayout, boneSets,
+				shadowPipeline = sShadowPipeline, shadowLayout = sShadowPipelineLayout]() {
+				vk::Device dv = Renderer::getDevice();
+				dv.destroyPipeline(pipeline);
+				dv.destroyPipelineLayout(layout);
+				dv.destroyDescriptorSetLayout(boneLayout);
+				{
+					auto poolLock = Renderer::lockDescriptorPool();
+					dv.freeDescriptorSets(Renderer::getDescriptorPool(), boneSets);
+				}
+				dv.destroyPipeline(shadowPipeline);
+				dv.destroyPipelineLayout(shadowLayout);
+				});
+			});
 	}
 	void AnimatedModel::destroy()
 	{
 		vk::Device dv = Renderer::getDevice();
 		dv.destroyPipeline(sPipeline);
 		dv.destroyPipelineLayout(sPipelineLayout);
-		dv.destroyDescriptorSetLayout(sMaterialLayout);
 		dv.destroyDescriptorSetLayout(sBoneLayout);
+		{
+			auto poolLock = Renderer::lockDescriptorPool();
+			dv.freeDescriptorSets(Renderer::getDescriptorPool(), sBoneSets);
+		}
 		dv.destroyPipeline(sShadowPipeline);
 		dv.destroyPipelineLayout(sShadowPipelineLayout);
 	}
 	void AnimatedModel::createPipeline()
 	{
+		vk::DescriptorSetLayout boneLayout;
+		vk::DescriptorSet boneSets[Renderer::MAX_FRAMES_IN_FLIGHT];
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		Logger::gTrace("Creating animated model renderer !");
-		//Define shader layout
+		//Create bone layout
 		{
-
 			vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 			{
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment, {}), //uniform buffer
-				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}), //albedo
-				vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}), //normal
-				vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}) //mr
+				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, {}), //bone matrices in the frame ring
 			};
 			vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 			descLayoutCI.setBindings(descLayoutBindings);
 
-			sMaterialLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
-		}
+			boneLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
-		//Create bone layout
-		{
-			vk::DescriptorSetLayoutBinding descLayoutBindings[] =
+			vk::DescriptorSetLayout setLayouts[Renderer::MAX_FRAMES_IN_FLIGHT];
+			std::fill(std::begin(setLayouts), std::end(setLayouts), boneLayout);
+			vk::DescriptorSetAllocateInfo ai{};
+			ai.setDescriptorPool(Renderer::getDescriptorPool())
+				.setSetLayouts(setLayouts);
 			{
-				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, {}), //uniform buffer
-			};
-			vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
-			descLayoutCI.setBindings(descLayoutBindings);
-
-			sBoneLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+				auto poolLock = Renderer::lockDescriptorPool();
+				auto sets = Renderer::getDevice().allocateDescriptorSets(ai);
+				std::copy(sets.begin(), sets.end(), boneSets);
+			}
+			for (uint32_t i = 0; i < Renderer::MAX_FRAMES_IN_FLIGHT; i++)
+			{
+				vk::DescriptorBufferInfo bufferInfo{};
+				bufferInfo.setBuffer(Renderer::FrameAllocator::getGPUBuffer(i))
+					.setOffset(0)
+					.setRange(sizeof(glm::mat4x4) * MAX_BONE_COUNT);
+				Renderer::getDevice().updateDescriptorSets({
+					vk::WriteDescriptorSet(boneSets[i], 0, 0, 1, vk::DescriptorType::eUniformBufferDynamic, nullptr, &bufferInfo, nullptr, nullptr),
+					}, {});
+			}
 		}
 
 
@@ -100,19 +129,21 @@ namespace eg::Components
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			Renderer::getGlobalDescriptorSet(), // Slot0
-			sMaterialLayout, //Slot 1
-			sBoneLayout, //Slot 2
+			Renderer::Bindless::getLayout(), //Slot 1
+			boneLayout, //Slot 2
 		};
 		vk::PushConstantRange pushConstantRanges[] =
 		{
-			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, 0, sizeof(VertexPushConstant))
+			//The material index follows the model matrix, one range so packets push both at once
+			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry | vk::ShaderStageFlagBits::eFragment,
+				0, sizeof(VertexPushConstant) + sizeof(MaterialPushConstant))
 		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRanges);
 
-		sPipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -271,7 +302,7 @@ namespace eg::Components
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(sPipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::DefaultRenderPass::getRenderPass())
 			.setSubpass(0)
 			.setBasePipelineHandle(nullptr)
@@ -288,12 +319,12 @@ namespace eg::Components
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create AnimatedModel pipeline !");
 		}
-		sPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
@@ -301,9 +332,17 @@ namespace eg::Components
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(geometryShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		sBoneLayout = boneLayout;
+		std::copy(std::begin(boneSets), std::end(boneSets), std::begin(sBoneSets));
+		sPipelineLayout = layout;
+		sPipeline = pipeline;
 	}
 	void AnimatedModel::createShadowPipeline()
 	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		Logger::gTrace("Creating depth only animated model renderer !");
 
 		//Load shaders
@@ -346,7 +385,7 @@ namespace eg::Components
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRanges);
 
-		sShadowPipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -449,7 +488,7 @@ namespace eg::Components
 		dynamicStateCI.setDynamicStates(dynamicStates);
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(sShadowPipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::Atmosphere::getRenderPass())
 			.setSubpass(0)
 			.setBasePipelineHandle(nullptr)
@@ -466,12 +505,12 @@ namespace eg::Components
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create depth only AnimatedModel pipeline !");
 		}
-		sShadowPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
@@ -479,6 +518,9 @@ namespace eg::Components
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(geometryShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		sShadowPipelineLayout = layout;
+		sShadowPipeline = pipeline;
 	}
 
 	AnimatedModel::AnimatedModel(const std::string& filePath) :
@@ -517,33 +559,77 @@ namespace eg::Components
 		Logger::gInfo("Animated model: " + filePath + " loaded !");
 	}
 
+	AnimatedModel::AnimatedModel(const std::string& filePath, const tinygltf::Model& model) :
+		StaticModel()
+	{
+		setFilePath(filePath);
+		try
+		{
+			this->extractNodes(model);
+			this->extractMaterials(model);
+			this->extractedAnimatedRawMeshes(model);
+			this->extractSkins(model);
+		}
+		catch (...)
+		{
+			throw std::runtime_error("StaticModel, Error loading model !");
+		}
+	}
+
 	AnimatedModel::~AnimatedModel()
 	{
 
 	}
 
-	void AnimatedModel::render(vk::CommandBuffer cmd,
-		const Animator& animator,
-		glm::mat4x4 worldTransform)
+	size_t AnimatedModel::getGpuMemorySize() const
 	{
-		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, sPipeline);
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			sPipelineLayout,
-			0,
-			Renderer::getCurrentFrameGUBODescSet(),
-			{}
-		);
-
-		float scaledWidth = static_cast<float>(sWidthCVar->value * sRenderScaleCVar->value);
-		float scaledHeight = static_cast<float>(sHeightCVar->value * sRenderScaleCVar->value);
+		size_t size = StaticModel::getGpuMemorySize();
+		for (const auto& rawMesh : mAnimatedRawMeshes)
+		{
+			size += rawMesh.positionBuffer.getAllocationSize() + rawMesh.normalBuffer.getAllocationSize()
+				+ rawMesh.uvBuffer.getAllocationSize() + rawMesh.boneIdsBuffer.getAllocationSize()
+				+ rawMesh.boneWeightsBuffer.getAllocationSize() + rawMesh.indexBuffer.getAllocationSize();
+		}
+		return size;
+	}
 
-		cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f, scaledWidth, scaledHeight,
-			0.0f, 1.0f } });
-		cmd.setScissor(0, vk::Rect2D({ 0, 0 }, { static_cast<uint32_t>(scaledWidth), static_cast<uint32_t>(scaledHeight) }));
+	size_t AnimatedModel::getCpuMemorySize() const
+	{
+		size_t size = StaticModel::getCpuMemorySize() - sizeof(StaticModel) + sizeof(*this)
+			+ mAnimatedRawMeshes.capacity() * sizeof(AnimatedRawMesh);
+		for (const auto& chain : mLodChains)
+		{
+			size += sizeof(chain) + chain.capacity() * sizeof(int32_t);
+		}
+		for (const auto& node : mNodes)
+		{
+			size += sizeof(Node) + node.name.capacity() + node.children.capacity() * sizeof(int32_t);
+		}
+		for (const auto& skin : mSkins)
+		{
+			size += sizeof(Skin) + skin.name.capacity() + skin.joints.capacity() * sizeof(int32_t)
+				+ skin.inverseBindMatrices.capacity() * sizeof(glm::mat4x4);
+		}
+		return size;
+	}
 
+	void AnimatedModel::render(vk::CommandBuffer cmd,
+		const Animator& animator,
+		glm::mat4x4 worldTransform, uint32_t lod)
+	{
+		glm::vec3 cameraPosition = Renderer::getMainCamera().mPosition;
 		using Node = Components::Animator::AnimationNode;
 		using NodeVec = std::vector<std::shared_ptr<Node>>;
 
+		//Both stages take their own copy, the matrices don't change while a frame is extracted
+		auto boneOffset = animator.snapshotBones();
+		if (!boneOffset)
+			return;
+		vk::DescriptorSet boneSet = sBoneSets[Renderer::getCurrentFrameIndex()];
+
+		lod = std::min(lod, mLodCount - 1);
+		uint32_t drawCalls = 0, triangles = 0;
+
 
 		//Build current node worlds transform using lambdas
 		std::function<void(const NodeVec& nodes,
@@ -559,26 +645,42 @@ namespace eg::Components
 				localTransform = glm::scale(localTransform, currentNode->scale);
 				accumulatedTransform *= localTransform;
 
-				if (currentNode->meshIndex >= 0)
+				//Coarser LOD meshes are only reached through the chain of their finest level
+				if (currentNode->meshIndex >= 0 && !mLodChains.at(currentNode->meshIndex).empty())
 				{
 					//Build model matrix	
 					VertexPushConstant ps{};
 					ps.model = accumulatedTransform;
-					cmd.pushConstants(sPipelineLayout,
-						vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, 0, sizeof(ps), &ps);
-					const auto& rawMesh = mAnimatedRawMeshes.at(currentNode->meshIndex);
-					cmd.bindVertexBuffers(0, {
-						rawMesh.positionBuffer.getBuffer(),
-						rawMesh.normalBuffer.getBuffer(),
-						rawMesh.uvBuffer.getBuffer(),
-						rawMesh.boneIdsBuffer.getBuffer(),
-						rawMesh.boneWeightsBuffer.getBuffer()
-						}, { 0, 0, 0, 0, 0 });
-					cmd.bindIndexBuffer(rawMesh.indexBuffer.getBuffer(), 0, vk::IndexType::eUint32);
-					cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-						sPipelineLayout,
-						1, { mMaterials.at(rawMesh.materialIndex).mSet, animator.getDescriptorSet() }, {});
-					cmd.drawIndexed(rawMesh.vertexCount, 1, 0, 0, 0);
+					const auto& chain = mLodChains.at(currentNode->meshIndex);
+					const auto& rawMesh = mAnimatedRawMeshes.at(chain.at(std::min<size_t>(lod, chain.size() - 1)));
+
+					Renderer::RenderQueue::Packet packet{};
+					packet.pipeline = sPipeline;
+					packet.layout = sPipelineLayout;
+					packet.sets[0] = Renderer::getCurrentFrameGUBODescSet();
+					packet.sets[1] = Renderer::Bindless::getSet();
+					packet.sets[2] = boneSet;
+					packet.setCount = 3;
+					packet.dynamicOffsets[0] = *boneOffset;
+					packet.dynamicOffsetCount = 1;
+					packet.vertexBuffers[0] = rawMesh.positionBuffer.getBuffer();
+					packet.vertexBuffers[1] = rawMesh.normalBuffer.getBuffer();
+					packet.vertexBuffers[2] = rawMesh.uvBuffer.getBuffer();
+					packet.vertexBuffers[3] = rawMesh.boneIdsBuffer.getBuffer();
+					packet.vertexBuffers[4] = rawMesh.boneWeightsBuffer.getBuffer();
+					packet.vertexBufferCount = 5;
+					packet.indexBuffer = rawMesh.indexBuffer.getBuffer();
+					MaterialPushConstant material{ mMaterials.at(rawMesh.materialIndex).mIndex };
+					packet.pushConstantStages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry | vk::ShaderStageFlagBits::eFragment;
+					packet.pushConstantSize = sizeof(ps) + sizeof(material);
+					std::memcpy(packet.pushConstants, &ps, sizeof(ps));
+					std::memcpy(packet.pushConstants + sizeof(ps), &material, sizeof(material));
+					packet.indexCount = rawMesh.vertexCount;
+					packet.key = Renderer::RenderQueue::makeKey(packet.pipeline, material.materialIndex, packet.vertexBuffers[0],
+						glm::distance(cameraPosition, glm::vec3(accumulatedTransform[3])));
+					Renderer::RenderQueue::submit(Renderer::RenderStage::SUBPASS0_GBUFFER, packet);
+					drawCalls++;
+					triangles += rawMesh.vertexCount / 3;
 				}
 
 
@@ -591,28 +693,24 @@ namespace eg::Components
 			animator.getAnimationNodes(),
 			animator.getAnimationNodes().at(mRootNodeIndex),
 			worldTransform);
+		LevelOfDetail::recordSubmit(Renderer::RenderStage::SUBPASS0_GBUFFER, lod, drawCalls, triangles);
 	}
 	void AnimatedModel::renderShadow(vk::CommandBuffer cmd,
 		const Animator& animator,
-		glm::mat4x4 worldTransform)
+		glm::mat4x4 worldTransform, uint32_t lod)
 	{
-		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, sShadowPipeline);
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			sShadowPipelineLayout,
-			0,
-			{ Renderer::getCurrentFrameGUBODescSet(), Renderer::Atmosphere::getDirectionalSet() },
-			{}
-		);
-		cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f,
-			static_cast<float>(Renderer::Atmosphere::getShadowMapSize()),
-			static_cast<float>(Renderer::Atmosphere::getShadowMapSize()),
-			0.0f, 1.0f } });
-		cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0),
-			vk::Extent2D(Renderer::Atmosphere::getShadowMapSize(), Renderer::Atmosphere::getShadowMapSize())));
-
 		using Node = Components::Animator::AnimationNode;
 		using NodeVec = std::vector<std::shared_ptr<Node>>;
 
+		//Both stages take their own copy, the matrices don't change while a frame is extracted
+		auto boneOffset = animator.snapshotBones();
+		if (!boneOffset)
+			return;
+		vk::DescriptorSet boneSet = sBoneSets[Renderer::getCurrentFrameIndex()];
+
+		lod = std::min(lod, mLodCount - 1);
+		uint32_t drawCalls = 0, triangles = 0;
+
 		//Build current node worlds transform using lambdas
 		std::function<void( const NodeVec& nodes,
 			const std::shared_ptr<Node>& currentNode,
@@ -627,24 +725,37 @@ namespace eg::Components
 				localTransform = glm::scale(localTransform, currentNode->scale);
 				accumulatedTransform *= localTransform;
 
-				if (currentNode->meshIndex >= 0)
+				//Coarser LOD meshes are only reached through the chain of their finest level
+				if (currentNode->meshIndex >= 0 && !mLodChains.at(currentNode->meshIndex).empty())
 				{
 					//Build model matrix	
 					VertexPushConstant ps{};
 					ps.model = accumulatedTransform;
-					cmd.pushConstants(sShadowPipelineLayout,
-						vk::ShaderStageFlagBits::eVertex, 0, sizeof(ps), &ps);
-					const auto& rawMesh = mAnimatedRawMeshes.at(currentNode->meshIndex);
-					cmd.bindVertexBuffers(0, {
-						rawMesh.positionBuffer.getBuffer(),
-						rawMesh.boneIdsBuffer.getBuffer(),
-						rawMesh.boneWeightsBuffer.getBuffer()
-						}, { 0, 0, 0 });
-					cmd.bindIndexBuffer(rawMesh.indexBuffer.getBuffer(), 0, vk::IndexType::eUint32);
-					cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-						sShadowPipelineLayout,
-						2, { animator.getDescriptorSet() }, {});
-					cmd.drawIndexed(rawMesh.vertexCount, 1, 0, 0, 0);
+					const auto& chain = mLodChains.at(currentNode->meshIndex);
+					const auto& rawMesh = mAnimatedRawMeshes.at(chain.at(std::min<size_t>(lod, chain.size() - 1)));
+
+					Renderer::RenderQueue::Packet packet{};
+					packet.pipeline = sShadowPipeline;
+					packet.layout = sShadowPipelineLayout;
+					packet.sets[0] = Renderer::getCurrentFrameGUBODescSet();
+					packet.sets[1] = Renderer::Atmosphere::getDirectionalSet();
+					packet.sets[2] = boneSet;
+					packet.setCount = 3;
+					packet.dynamicOffsets[0] = *boneOffset;
+					packet.dynamicOffsetCount = 1;
+					packet.vertexBuffers[0] = rawMesh.positionBuffer.getBuffer();
+					packet.vertexBuffers[1] = rawMesh.boneIdsBuffer.getBuffer();
+					packet.vertexBuffers[2] = rawMesh.boneWeightsBuffer.getBuffer();
+					packet.vertexBufferCount = 3;
+					packet.indexBuffer = rawMesh.indexBuffer.getBuffer();
+					packet.pushConstantStages = vk::ShaderStageFlagBits::eVertex;
+					packet.pushConstantSize = sizeof(ps);
+					std::memcpy(packet.pushConstants, &ps, sizeof(ps));
+					packet.indexCount = rawMesh.vertexCount;
+					packet.key = Renderer::RenderQueue::makeKey(packet.pipeline, 0, packet.vertexBuffers[0], 0.0f);
+					Renderer::RenderQueue::submit(Renderer::RenderStage::SHADOW, packet);
+					drawCalls++;
+					triangles += rawMesh.vertexCount / 3;
 				}
 
 
@@ -656,6 +767,7 @@ namespace eg::Components
 		renderScreneGraph(animator.getAnimationNodes(),
 			animator.getAnimationNodes().at(mRootNodeIndex),
 			worldTransform);
+		LevelOfDetail::recordSubmit(Renderer::RenderStage::SHADOW, lod, drawCalls, triangles);
 	}
 
 
@@ -754,9 +866,16 @@ namespace eg::Components
 		std::vector<glm::ivec4> boneIds;
 		std::vector<glm::vec4> boneWeights;
 
+		mLodChains = extractLodChains(model);
+		for (const auto& chain : mLodChains)
+		{
+			mLodCount = std::max(mLodCount, static_cast<uint32_t>(chain.size()));
+		}
+
 		mAnimatedRawMeshes.reserve(model.meshes.size());
-		for (const auto& mesh : model.meshes)
+		for (size_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
 		{
+			const auto& mesh = model.meshes[meshIndex];
 			for (const auto& primitive : mesh.primitives)
 			{
 				if (primitive.material < 0)
@@ -928,6 +1047,8 @@ namespace eg::Components
 					static_cast<uint32_t>(indices.size()),
 				};
 
+				if (!mLodChains[meshIndex].empty())
+					expandBounds(positions);
 				mAnimatedRawMeshes.push_back(std::move(rawMesh));
 			}
 		}
@@ -209,4 +209,14 @@ namespace eg::Components
 
 		Logger::gInfo("Animation loaded: " + animPath);
 	}
+
+	size_t Animation::getMemorySize() const
+	{
+		size_t size = sizeof(*this) + mName.capacity() + mChannels.capacity() * sizeof(Channel);
+		for (const auto& channel : mChannels)
+		{
+			size += channel.keyTimes.capacity() * sizeof(float) + channel.data.capacity() * sizeof(Channel::Data);
+		}
+		return size;
+	}
 }
\ No newline at end of file
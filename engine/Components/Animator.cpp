@@ -2,12 +2,13 @@
 
 #include <Data.h>
 
+#include <cstring>
+
 namespace eg::Components
 {
 	Animator::Animator(const std::vector<std::shared_ptr<Animation>>& animations,
 		const AnimatedModel& model) :
 		mModel(model),
-		mUniformBuffer(nullptr, sizeof(mBoneMatrices), vk::BufferUsageFlagBits::eUniformBuffer),
 		mCurrentAnimation(nullptr)
 	{
 		//Init animation map
@@ -34,29 +35,8 @@ namespace eg::Components
 			mAnimationNodes.push_back(animNode);
 		}
 
-		//Allocate uniform buffer 
+		//Bind pose until the first update
 		mBoneMatrices.fill(glm::mat4x4(1.0f));
-
-		//Allocate descriptor set
-		vk::DescriptorSetLayout setLayouts[] =
-		{
-			AnimatedModel::getBoneLayout()
-		};
-		vk::DescriptorSetAllocateInfo ai{};
-		ai.setDescriptorPool(Renderer::getDescriptorPool())
-			.setDescriptorSetCount(1)
-			.setSetLayouts(setLayouts);
-		mDescriptorSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
-
-		vk::DescriptorBufferInfo bufferInfo{};
-		bufferInfo
-			.setOffset(0)
-			.setRange(sizeof(mBoneMatrices))
-			.setBuffer(mUniformBuffer.getBuffer());
-
-		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mDescriptorSet, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo, nullptr, nullptr),
-			}, {});
 	}
 
 	void Animator::setAnimation(const std::string& animationName)
@@ -168,15 +148,15 @@ namespace eg::Components
 		}
 
 		buildNodeModelLocalTransform(mAnimationNodes, mAnimationNodes.at(mModel.getRootNodeIndex()), glm::mat4x4(1.0f), false);
-
-		//Update bone matrices
-		mUniformBuffer.write(mBoneMatrices.data(), sizeof(mBoneMatrices));
 	}
 
-	Animator::~Animator()
+	std::optional<uint32_t> Animator::snapshotBones() const
 	{
-		//Free descriptor set
-		Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), mDescriptorSet);
+		auto allocation = Renderer::FrameAllocator::allocateGPU(sizeof(mBoneMatrices));
+		if (!allocation)
+			return std::nullopt;
+		std::memcpy(allocation.data, mBoneMatrices.data(), sizeof(mBoneMatrices));
+		return static_cast<uint32_t>(allocation.offset);
 	}
 
 	std::shared_ptr<Animator::AnimationNode> Animator::getAnimationNodeByName(const std::string& name)
@@ -12,8 +12,9 @@ namespace eg::Components
 			glm::quat rotation = { 1, 0, 0, 0 };
 			glm::vec3 scale = { 1, 1, 1 };
 		};
-		std::vector<BlendedNode> blendedNodes;
-		blendedNodes.resize(mAnimationNodes.size());
+		//Frame scratch, the nodes only live through this call
+		size_t nodeCount = mAnimationNodes.size();
+		BlendedNode* blendedNodes = Renderer::FrameAllocator::allocateArray<BlendedNode>(nodeCount);
 
 		//Process each channel
 		float length2 = mState.x * mState.x + mState.y * mState.y;
@@ -56,7 +57,9 @@ namespace eg::Components
 
 			for (const auto& channel : animation.animation->getChannels())
 			{
-				auto& blendedNode = blendedNodes.at(channel.targetJoint);
+				if (channel.targetJoint < 0 || static_cast<size_t>(channel.targetJoint) >= nodeCount)
+					throw std::runtime_error("Animation channel targets a missing joint");
+				auto& blendedNode = blendedNodes[channel.targetJoint];
 				blendedNode.targetJoint = channel.targetJoint;
 				//Find the keyframe for the current time
 				size_t keyframeIndex = 0;
@@ -97,8 +100,9 @@ namespace eg::Components
 			i++;
 		}
 
-		for(const auto& blendedNode : blendedNodes)
+		for (size_t j = 0; j < nodeCount; j++)
 		{
+			const auto& blendedNode = blendedNodes[j];
 			if (blendedNode.targetJoint != -1)
 			{
 				auto& currentNode = mAnimationNodes.at(blendedNode.targetJoint);
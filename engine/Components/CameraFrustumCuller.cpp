@@ -13,7 +13,18 @@ namespace eg::Components
 
 	bool CameraFrustumCuller::isBoundingBoxInFrustum(const glm::vec3& min, const glm::vec3& max, const glm::vec3* offset) const
 	{
-		return false;
+		glm::vec3 boxMin = offset ? min + *offset : min;
+		glm::vec3 boxMax = offset ? max + *offset : max;
+		for (const auto& plane : mFrustumPlanes) {
+			// Corner furthest along the plane normal, the box is outside when even that one is behind the plane
+			glm::vec3 positive(
+				plane.normal.x >= 0.0f ? boxMax.x : boxMin.x,
+				plane.normal.y >= 0.0f ? boxMax.y : boxMin.y,
+				plane.normal.z >= 0.0f ? boxMax.z : boxMin.z);
+			if (glm::dot(plane.normal, positive) + plane.d < 0.0f)
+				return false;
+		}
+		return true;
 	}
 
 	bool CameraFrustumCuller::isSphereInFrustum(const glm::vec3& center, float radius) const
@@ -0,0 +1,132 @@
+#include <Components.h>
+#include <Logger.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace eg::Components
+{
+	//Static field
+	Command::Var* LevelOfDetail::sScreenSizeCVar;
+	Command::Var* LevelOfDetail::sHysteresisCVar;
+	Command::Var* LevelOfDetail::sShadowBiasCVar;
+	Command::Var* LevelOfDetail::sForceLodCVar;
+
+	std::atomic<uint32_t> LevelOfDetail::sObjects[2][MAX_LOD_COUNT];
+	std::atomic<uint32_t> LevelOfDetail::sDrawCalls[2][MAX_LOD_COUNT];
+	std::atomic<uint32_t> LevelOfDetail::sTriangles[2][MAX_LOD_COUNT];
+	LevelOfDetail::Stats LevelOfDetail::sLastStats[2];
+
+	//Shadow stage keeps separate state, every other stage shares the main view state
+	static uint32_t stageIndex(Renderer::RenderStage stage)
+	{
+		return stage == Renderer::RenderStage::SHADOW ? 0 : 1;
+	}
+
+	void LevelOfDetail::create()
+	{
+		//Projected sphere diameter / screen height below which LOD1 is used, halved for each following level
+		sScreenSizeCVar = Command::registerVar("eg::Renderer::LodScreenSize", "None", 0.25);
+		sHysteresisCVar = Command::registerVar("eg::Renderer::LodHysteresis", "None", 0.15);
+		//Screen size multiplier for the shadow stage, lower picks coarser levels
+		sShadowBiasCVar = Command::registerVar("eg::Renderer::LodShadowBias", "None", 0.5);
+		sForceLodCVar = Command::registerVar("eg::Renderer::LodForce", "None", -1.0);
+
+		Command::registerFn("eg::Renderer::PrintLodStats", [](size_t, char* []) {
+			const char* stageNames[] = { "shadow", "gbuffer" };
+			for (uint32_t stage = 0; stage < 2; stage++)
+			{
+				for (uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++)
+				{
+					const Stats& stats = sLastStats[stage];
+					if (stats.objects[lod] == 0)
+						continue;
+					Logger::gInfo(std::string("LOD") + std::to_string(lod) + " [" + stageNames[stage] + "]: "
+						+ std::to_string(stats.objects[lod]) + " objects, "
+						+ std::to_string(stats.drawCalls[lod]) + " draw calls, "
+						+ std::to_string(stats.triangles[lod]) + " triangles");
+				}
+			}
+			});
+	}
+
+	void LevelOfDetail::endFrame()
+	{
+		for (uint32_t stage = 0; stage < 2; stage++)
+		{
+			for (uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++)
+			{
+				sLastStats[stage].objects[lod] = sObjects[stage][lod].exchange(0, std::memory_order_relaxed);
+				sLastStats[stage].drawCalls[lod] = sDrawCalls[stage][lod].exchange(0, std::memory_order_relaxed);
+				sLastStats[stage].triangles[lod] = sTriangles[stage][lod].exchange(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void LevelOfDetail::recordSubmit(Renderer::RenderStage stage, uint32_t lod, uint32_t drawCalls, uint32_t triangles, uint32_t objects)
+	{
+		uint32_t index = stageIndex(stage);
+		lod = std::min(lod, MAX_LOD_COUNT - 1);
+		sObjects[index][lod].fetch_add(objects, std::memory_order_relaxed);
+		sDrawCalls[index][lod].fetch_add(drawCalls, std::memory_order_relaxed);
+		sTriangles[index][lod].fetch_add(triangles, std::memory_order_relaxed);
+	}
+
+	const LevelOfDetail::Stats& LevelOfDetail::getStats(Renderer::RenderStage stage)
+	{
+		return sLastStats[stageIndex(stage)];
+	}
+
+	//Per instance field
+	uint32_t LevelOfDetail::select(Renderer::RenderStage stage, const glm::mat4x4& worldTransform, const StaticModel& model)
+	{
+		uint32_t& current = mLods[stageIndex(stage)];
+		uint32_t lodCount = std::min(model.getLodCount(), MAX_LOD_COUNT);
+		if (lodCount <= 1)
+		{
+			current = 0;
+			return current;
+		}
+
+		if (sForceLodCVar->value >= 0.0)
+		{
+			current = std::min(static_cast<uint32_t>(sForceLodCVar->value), lodCount - 1);
+			return current;
+		}
+
+		//Bounding sphere in world space, scale taken from the largest basis vector
+		const Camera& camera = Renderer::getMainCamera();
+		glm::vec3 center = glm::vec3(worldTransform * glm::vec4(model.getBoundingCenter(), 1.0f));
+		float scale = std::max({ glm::length(glm::vec3(worldTransform[0])),
+			glm::length(glm::vec3(worldTransform[1])),
+			glm::length(glm::vec3(worldTransform[2])) });
+		float radius = model.getBoundingRadius() * scale;
+		float distance = glm::length(center - camera.mPosition);
+
+		float screenSize = std::numeric_limits<float>::max();
+		if (distance > radius)
+			screenSize = radius / (distance * std::tan(glm::radians(camera.mFov) * 0.5f));
+		if (stage == Renderer::RenderStage::SHADOW)
+			screenSize *= static_cast<float>(sShadowBiasCVar->value);
+
+		//Level n is used below threshold(n), hysteresis keeps objects near a boundary from flickering
+		float baseSize = static_cast<float>(sScreenSizeCVar->value);
+		float hysteresis = static_cast<float>(sHysteresisCVar->value);
+		auto threshold = [baseSize](uint32_t lod) {
+			return baseSize / static_cast<float>(1u << (lod - 1));
+			};
+
+		current = std::min(current, lodCount - 1);
+		while (current + 1 < lodCount && screenSize < threshold(current + 1) * (1.0f - hysteresis))
+			current++;
+		while (current > 0 && screenSize > threshold(current) * (1.0f + hysteresis))
+			current--;
+		return current;
+	}
+
+	uint32_t LevelOfDetail::getLod(Renderer::RenderStage stage) const
+	{
+		return mLods[stageIndex(stage)];
+	}
+}
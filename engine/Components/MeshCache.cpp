@@ -0,0 +1,626 @@
+#include <Components.h>
+#include <Data.h>
+#include <Logger.h>
+
+#include <tiny_gltf.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+namespace eg::Components
+{
+	//On disk layout, little endian:
+	//FileHeader | MeshEntry[meshCount] | MaterialEntry[materialCount] | ImageEntry[imageCount] | data
+	//Data offsets inside entries are relative to dataOffset
+	static constexpr char MAGIC[4] = { 'E', 'G', 'M', 'C' };
+	static constexpr uint64_t ALIGNMENT = 16;
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t imageCount;
+		uint32_t lodCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		uint64_t meshesOffset;
+		uint64_t materialsOffset;
+		uint64_t imagesOffset;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+	static_assert(sizeof(FileHeader) == 96);
+
+	struct MeshEntry
+	{
+		uint64_t positionOffset;
+		uint64_t normalOffset;
+		uint64_t uvOffset;
+		uint64_t indexOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexSize;
+		uint32_t materialIndex;
+		uint32_t lod;
+		uint32_t lodCount;
+	};
+	static_assert(sizeof(MeshEntry) == 56);
+
+	struct MaterialEntry
+	{
+		float albedoColor[3];
+		int32_t albedoImage; //-1 when the material has no texture
+		int32_t normalImage;
+		int32_t mrImage;
+	};
+	static_assert(sizeof(MaterialEntry) == 24);
+
+	struct ImageEntry
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		uint32_t format;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+	static_assert(sizeof(ImageEntry) == 32);
+
+	static uint64_t alignUp(uint64_t value)
+	{
+		return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	//FNV-1a over 64 bit words, folded so the high bits of every word reach the low bits of the result.
+	//The format version is mixed in so a format change renames every cooked file
+	static uint64_t hashSource(const uint8_t* data, size_t size)
+	{
+		constexpr uint64_t PRIME = 1099511628211ull;
+		uint64_t hash = 14695981039346656037ull;
+		size_t wordCount = size / sizeof(uint64_t);
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(word));
+			hash = (hash ^ word) * PRIME;
+			hash ^= hash >> 32;
+		}
+		for (size_t i = wordCount * sizeof(uint64_t); i < size; i++)
+		{
+			hash = (hash ^ data[i]) * PRIME;
+		}
+		hash = (hash ^ size) * PRIME;
+		hash = (hash ^ MeshCache::VERSION) * PRIME;
+		return hash ^ (hash >> 29);
+	}
+
+	//Cooker
+
+	//Keeps images as raw RGBA8, they are filtered and compressed per mip level afterwards
+	static bool loadRawImageData(tinygltf::Image* image, const int imageIndex, std::string* err,
+		std::string*, int, int, const unsigned char* bytes, int size, void*)
+	{
+		int w = 0, h = 0, comp = 0;
+		stbi_uc* data = stbi_load_from_memory(bytes, size, &w, &h, &comp, STBI_rgb_alpha);
+		if (!data || w < 1 || h < 1)
+		{
+			if (data)
+				stbi_image_free(data);
+			if (err)
+				(*err) += "Can't decode image[" + std::to_string(imageIndex) + "] name = \"" + image->name + "\"\n";
+			return false;
+		}
+		image->width = w;
+		image->height = h;
+		image->component = 4;
+		image->bits = 8;
+		image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		image->as_is = false;
+		image->image.assign(data, data + static_cast<size_t>(w) * h * 4);
+		stbi_image_free(data);
+		return true;
+	}
+
+	template<typename T>
+	static void readAccessor(const tinygltf::Model& model, int accessorIndex, std::vector<T>& out)
+	{
+		const auto& accessor = model.accessors.at(accessorIndex);
+		const auto& bufferView = model.bufferViews.at(accessor.bufferView);
+		const auto& buffer = model.buffers.at(bufferView.buffer);
+		size_t stride = bufferView.byteStride != 0 ? bufferView.byteStride : sizeof(T);
+		size_t offset = bufferView.byteOffset + accessor.byteOffset;
+		if (accessor.count > 0 && offset + stride * (accessor.count - 1) + sizeof(T) > buffer.data.size())
+			throw std::runtime_error("Accessor " + std::to_string(accessorIndex) + " is out of its buffer");
+
+		out.resize(accessor.count);
+		for (size_t i = 0; i < accessor.count; i++)
+		{
+			std::memcpy(&out[i], buffer.data.data() + offset + i * stride, sizeof(T));
+		}
+	}
+
+	static void readIndices(const tinygltf::Model& model, int accessorIndex, std::vector<uint32_t>& out)
+	{
+		switch (model.accessors.at(accessorIndex).componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		{
+			std::vector<uint8_t> indices;
+			readAccessor(model, accessorIndex, indices);
+			out.assign(indices.begin(), indices.end());
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		{
+			std::vector<uint16_t> indices;
+			readAccessor(model, accessorIndex, indices);
+			out.assign(indices.begin(), indices.end());
+			break;
+		}
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			readAccessor(model, accessorIndex, out);
+			break;
+		default:
+			throw std::runtime_error("Unsupported index type in accessor " + std::to_string(accessorIndex));
+		}
+	}
+
+	static void cookSource(const Data::MappedFile& source, uint64_t sourceHash,
+		const std::string& sourcePath, const std::string& cookedPath)
+	{
+		tinygltf::Model model;
+		tinygltf::TinyGLTF loader;
+		loader.SetImageLoader(loadRawImageData, nullptr);
+		std::string err;
+		std::string warn;
+		bool ret = loader.LoadBinaryFromMemory(&model, &err, &warn,
+			source.getData(), static_cast<unsigned int>(source.getSize()),
+			std::filesystem::path(sourcePath).parent_path().string());
+		if (!warn.empty())
+			Logger::gWarn(warn);
+		if (!ret)
+			throw std::runtime_error("Failed to load model: " + sourcePath + " " + err);
+
+		std::vector<MeshEntry> meshes;
+		std::vector<MaterialEntry> materials;
+		std::vector<ImageEntry> images;
+		std::vector<uint8_t> data;
+		auto append = [&data](const void* bytes, size_t size) -> uint64_t {
+			uint64_t offset = alignUp(data.size());
+			data.resize(offset + size);
+			if (size > 0)
+				std::memcpy(data.data() + offset, bytes, size);
+			return offset;
+			};
+
+		FileHeader header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = MeshCache::VERSION;
+		header.sourceHash = sourceHash;
+		header.lodCount = 1;
+
+		std::vector<std::pair<uint32_t, uint32_t>> meshLods(model.meshes.size(), { 0, 1 });
+		for (const auto& chain : StaticModel::extractLodChains(model))
+		{
+			for (size_t level = 0; level < chain.size(); level++)
+			{
+				meshLods[chain[level]] = { static_cast<uint32_t>(level), static_cast<uint32_t>(chain.size()) };
+			}
+			header.lodCount = std::max(header.lodCount, static_cast<uint32_t>(chain.size()));
+		}
+
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		std::vector<uint32_t> indices;
+		std::vector<glm::vec3> positions, normals;
+		std::vector<glm::vec2> uvs;
+		for (size_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
+		{
+			for (const auto& primitive : model.meshes[meshIndex].primitives)
+			{
+				if (primitive.material < 0)
+					throw std::runtime_error("Mesh must have a material !");
+				readIndices(model, primitive.indices, indices);
+				readAccessor(model, primitive.attributes.at("POSITION"), positions);
+				readAccessor(model, primitive.attributes.at("NORMAL"), normals);
+				readAccessor(model, primitive.attributes.at("TEXCOORD_0"), uvs);
+
+				MeshEntry entry{};
+				entry.vertexCount = static_cast<uint32_t>(positions.size());
+				entry.indexCount = static_cast<uint32_t>(indices.size());
+				entry.materialIndex = static_cast<uint32_t>(primitive.material);
+				entry.lod = meshLods[meshIndex].first;
+				entry.lodCount = meshLods[meshIndex].second;
+				entry.positionOffset = append(positions.data(), positions.size() * sizeof(glm::vec3));
+				entry.normalOffset = append(normals.data(), normals.size() * sizeof(glm::vec3));
+				entry.uvOffset = append(uvs.data(), uvs.size() * sizeof(glm::vec2));
+
+				uint32_t maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+				if (maxIndex <= std::numeric_limits<uint16_t>::max())
+				{
+					std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+					entry.indexSize = sizeof(uint16_t);
+					entry.indexOffset = append(shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+				}
+				else
+				{
+					entry.indexSize = sizeof(uint32_t);
+					entry.indexOffset = append(indices.data(), indices.size() * sizeof(uint32_t));
+				}
+
+				if (entry.lod == 0)
+				{
+					for (const auto& position : positions)
+					{
+						boundsMin = glm::min(boundsMin, position);
+						boundsMax = glm::max(boundsMax, position);
+					}
+				}
+				meshes.push_back(entry);
+			}
+		}
+
+		for (const auto& image : model.images)
+		{
+			//Cooking runs once per source, it always takes the best quality
+			Data::TextureCompressor::CompressedImage compressed = Data::TextureCompressor::compress(image.image.data(),
+				static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), Data::TextureCompressor::Quality::High);
+			ImageEntry entry{};
+			entry.width = compressed.width;
+			entry.height = compressed.height;
+			entry.mipLevels = compressed.mipLevels;
+			entry.format = static_cast<uint32_t>(compressed.format);
+			entry.dataSize = compressed.data.size();
+			entry.dataOffset = append(compressed.data.data(), compressed.data.size());
+			images.push_back(entry);
+		}
+
+		auto imageOf = [&model](int textureIndex) -> int32_t {
+			if (textureIndex < 0)
+				return -1;
+			return model.textures.at(textureIndex).source;
+			};
+		for (const auto& material : model.materials)
+		{
+			MaterialEntry entry{};
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				entry.albedoColor[i] = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[i]);
+			}
+			entry.albedoImage = imageOf(material.pbrMetallicRoughness.baseColorTexture.index);
+			entry.normalImage = imageOf(material.normalTexture.index);
+			entry.mrImage = imageOf(material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+			materials.push_back(entry);
+		}
+
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.imageCount = static_cast<uint32_t>(images.size());
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			header.boundsMin[i] = boundsMin[i];
+			header.boundsMax[i] = boundsMax[i];
+		}
+		header.meshesOffset = alignUp(sizeof(FileHeader));
+		header.materialsOffset = alignUp(header.meshesOffset + meshes.size() * sizeof(MeshEntry));
+		header.imagesOffset = alignUp(header.materialsOffset + materials.size() * sizeof(MaterialEntry));
+		header.dataOffset = alignUp(header.imagesOffset + images.size() * sizeof(ImageEntry));
+		header.dataSize = data.size();
+
+		//Written next to the target and renamed over it, concurrent cooks of one source never see a partial file
+		std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path());
+		std::ostringstream tempPath;
+		tempPath << cookedPath << ".tmp" << std::hash<std::thread::id>{}(std::this_thread::get_id());
+		{
+			std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+			if (!file)
+				throw std::runtime_error("Can't write cooked model: " + tempPath.str());
+			auto writeAt = [&file](uint64_t offset, const void* bytes, size_t size) {
+				static const char padding[ALIGNMENT] = {};
+				uint64_t position = static_cast<uint64_t>(file.tellp());
+				file.write(padding, static_cast<std::streamsize>(offset - position));
+				file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+				};
+			writeAt(0, &header, sizeof(header));
+			writeAt(header.meshesOffset, meshes.data(), meshes.size() * sizeof(MeshEntry));
+			writeAt(header.materialsOffset, materials.data(), materials.size() * sizeof(MaterialEntry));
+			writeAt(header.imagesOffset, images.data(), images.size() * sizeof(ImageEntry));
+			writeAt(header.dataOffset, data.data(), data.size());
+			if (!file)
+				throw std::runtime_error("Can't write cooked model: " + tempPath.str());
+		}
+		std::filesystem::rename(tempPath.str(), cookedPath);
+	}
+
+	//Loader
+	void StaticModel::loadCooked(const std::string& cookedPath)
+	{
+		Data::MappedFile file(cookedPath);
+		const uint8_t* base = file.getData();
+		const uint64_t fileSize = file.getSize();
+		auto inBounds = [](uint64_t offset, uint64_t size, uint64_t limit) {
+			return offset <= limit && size <= limit - offset;
+			};
+
+		if (!inBounds(0, sizeof(FileHeader), fileSize))
+			throw std::runtime_error("Cooked model is too small: " + cookedPath);
+		FileHeader header;
+		std::memcpy(&header, base, sizeof(header));
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error("Not a cooked model: " + cookedPath);
+		if (header.version != MeshCache::VERSION)
+			throw std::runtime_error("Unsupported cooked model version " + std::to_string(header.version) + ": " + cookedPath);
+		if (!inBounds(header.meshesOffset, static_cast<uint64_t>(header.meshCount) * sizeof(MeshEntry), fileSize)
+			|| !inBounds(header.materialsOffset, static_cast<uint64_t>(header.materialCount) * sizeof(MaterialEntry), fileSize)
+			|| !inBounds(header.imagesOffset, static_cast<uint64_t>(header.imageCount) * sizeof(ImageEntry), fileSize)
+			|| !inBounds(header.dataOffset, header.dataSize, fileSize)
+			|| header.lodCount == 0)
+			throw std::runtime_error("Corrupted cooked model: " + cookedPath);
+
+		std::vector<MeshEntry> meshes(header.meshCount);
+		std::vector<MaterialEntry> materials(header.materialCount);
+		std::vector<ImageEntry> images(header.imageCount);
+		std::memcpy(meshes.data(), base + header.meshesOffset, meshes.size() * sizeof(MeshEntry));
+		std::memcpy(materials.data(), base + header.materialsOffset, materials.size() * sizeof(MaterialEntry));
+		std::memcpy(images.data(), base + header.imagesOffset, images.size() * sizeof(ImageEntry));
+		const uint8_t* data = base + header.dataOffset;
+
+		//Everything is validated before the first GPU allocation
+		for (const auto& mesh : meshes)
+		{
+			if ((mesh.indexSize != sizeof(uint16_t) && mesh.indexSize != sizeof(uint32_t))
+				|| mesh.materialIndex >= header.materialCount
+				|| mesh.lodCount == 0 || mesh.lod >= mesh.lodCount
+				|| !inBounds(mesh.positionOffset, static_cast<uint64_t>(mesh.vertexCount) * sizeof(glm::vec3), header.dataSize)
+				|| !inBounds(mesh.normalOffset, static_cast<uint64_t>(mesh.vertexCount) * sizeof(glm::vec3), header.dataSize)
+				|| !inBounds(mesh.uvOffset, static_cast<uint64_t>(mesh.vertexCount) * sizeof(glm::vec2), header.dataSize)
+				|| !inBounds(mesh.indexOffset, static_cast<uint64_t>(mesh.indexCount) * mesh.indexSize, header.dataSize))
+				throw std::runtime_error("Corrupted cooked mesh: " + cookedPath);
+		}
+		for (const auto& material : materials)
+		{
+			for (int32_t image : { material.albedoImage, material.normalImage, material.mrImage })
+			{
+				if (image < -1 || image >= static_cast<int32_t>(header.imageCount))
+					throw std::runtime_error("Corrupted cooked material: " + cookedPath);
+			}
+		}
+		for (const auto& image : images)
+		{
+			if (image.width == 0 || image.height == 0 || image.mipLevels == 0
+				|| (image.format != static_cast<uint32_t>(vk::Format::eBc3UnormBlock)
+					&& image.format != static_cast<uint32_t>(vk::Format::eBc1RgbUnormBlock))
+				|| !inBounds(image.dataOffset, image.dataSize, header.dataSize))
+				throw std::runtime_error("Corrupted cooked image: " + cookedPath);
+		}
+
+		try
+		{
+			mImages.reserve(images.size());
+			for (const auto& image : images)
+			{
+				mImages.push_back(std::make_shared<Renderer::CombinedImageSampler2D>(
+					image.width, image.height,
+					static_cast<vk::Format>(image.format),
+					vk::ImageUsageFlagBits::eSampled,
+					vk::ImageAspectFlagBits::eColor,
+					image.mipLevels, data + image.dataOffset, static_cast<size_t>(image.dataSize)));
+			}
+
+			for (const auto& material : materials)
+			{
+				Material newMaterial{};
+				if (material.albedoImage >= 0)
+					newMaterial.mAlbedo = mImages.at(material.albedoImage);
+				if (material.normalImage >= 0)
+					newMaterial.mNormal = mImages.at(material.normalImage);
+				if (material.mrImage >= 0)
+					newMaterial.mMr = mImages.at(material.mrImage);
+				createMaterial(newMaterial, glm::vec3(material.albedoColor[0], material.albedoColor[1], material.albedoColor[2]));
+			}
+
+			//Streams are interleaved into the geometry pool's staging, the mapped file is only read
+			mRawMeshes.reserve(meshes.size());
+			for (const auto& mesh : meshes)
+			{
+				RawMesh rawMesh{
+					Renderer::MeshBuffer(reinterpret_cast<const glm::vec3*>(data + mesh.positionOffset),
+					reinterpret_cast<const glm::vec3*>(data + mesh.normalOffset),
+					reinterpret_cast<const glm::vec2*>(data + mesh.uvOffset),
+					mesh.vertexCount,
+					data + mesh.indexOffset, mesh.indexCount,
+					mesh.indexSize == sizeof(uint16_t) ? vk::IndexType::eUint16 : vk::IndexType::eUint32),
+
+					mesh.materialIndex,
+					mesh.lod,
+					mesh.lodCount
+				};
+				mRawMeshes.push_back(std::move(rawMesh));
+			}
+		}
+		catch (...)
+		{
+			//Leave the model empty so the caller can fall back to glTF
+			releaseMaterials();
+			mRawMeshes.clear();
+			mImages.clear();
+			throw;
+		}
+
+		mLodCount = header.lodCount;
+		mBoundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		mBoundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	}
+}
+
+namespace eg::Components::MeshCache
+{
+	static Command::Var* sEnabledCVar = nullptr;
+
+	void create()
+	{
+		sEnabledCVar = Command::registerVar("eg::Components::MeshCacheEnabled", "None", 1.0);
+		Command::registerFn("eg::Components::CookModels", [](size_t argc, char* argv[]) {
+			cookDirectory(argc > 1 ? argv[1] : "models");
+			});
+		Command::registerFn("eg::Components::BenchmarkMeshCache", [](size_t argc, char* argv[]) {
+			uint32_t iterations = 5;
+			if (argc > 2)
+			{
+				try
+				{
+					iterations = std::max(static_cast<uint32_t>(std::stoul(argv[2])), 1u);
+				}
+				catch (...)
+				{
+					Logger::gError("Invalid iteration count for eg::Components::BenchmarkMeshCache");
+					return;
+				}
+			}
+			benchmark(argc > 1 ? argv[1] : "models", iterations);
+			});
+	}
+
+	bool isEnabled()
+	{
+		return sEnabledCVar != nullptr && sEnabledCVar->value != 0.0;
+	}
+
+	std::string getCookedPath(const std::string& sourcePath)
+	{
+		try
+		{
+			Data::MappedFile source(sourcePath);
+			uint64_t hash = hashSource(source.getData(), source.getSize());
+
+			char hashString[17];
+			std::snprintf(hashString, sizeof(hashString), "%016llx", static_cast<unsigned long long>(hash));
+			std::string cookedPath = (std::filesystem::path(DIRECTORY)
+				/ (std::filesystem::path(sourcePath).stem().string() + "-" + hashString + EXTENSION)).string();
+			if (std::filesystem::exists(cookedPath))
+				return cookedPath;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			cookSource(source, hash, sourcePath, cookedPath);
+			auto end = std::chrono::high_resolution_clock::now();
+			Logger::gInfo("Cooked " + sourcePath + " into " + cookedPath + " in "
+				+ std::to_string(std::chrono::duration<double, std::milli>(end - start).count()) + " ms");
+			return cookedPath;
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gWarn("Can't cook " + sourcePath + ": " + e.what());
+			return std::string();
+		}
+	}
+
+	void cook(const std::string& sourcePath, const std::string& cookedPath)
+	{
+		Data::MappedFile source(sourcePath);
+		cookSource(source, hashSource(source.getData(), source.getSize()), sourcePath, cookedPath);
+	}
+
+	static std::vector<std::string> findSources(const std::string& directory)
+	{
+		std::vector<std::string> sources;
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, ec))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".glb")
+				sources.push_back(entry.path().string());
+		}
+		if (ec)
+			Logger::gWarn("Can't list " + directory + ": " + ec.message());
+		std::sort(sources.begin(), sources.end());
+		return sources;
+	}
+
+	void cookDirectory(const std::string& directory)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		uint32_t cooked = 0;
+		std::vector<std::string> sources = findSources(directory);
+		for (const auto& source : sources)
+		{
+			if (!getCookedPath(source).empty())
+				cooked++;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		Logger::gInfo("MeshCache: " + std::to_string(cooked) + "/" + std::to_string(sources.size())
+			+ " models up to date in " + std::to_string(std::chrono::duration<double, std::milli>(end - start).count()) + " ms");
+	}
+
+	void benchmark(const std::string& directory, uint32_t iterations)
+	{
+		if (!isEnabled())
+		{
+			Logger::gWarn("MeshCache is disabled, set eg::Components::MeshCacheEnabled to benchmark it");
+			return;
+		}
+
+		using Clock = std::chrono::high_resolution_clock;
+		auto toMs = [](Clock::duration duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+			};
+		double totalGltf = 0.0, totalCooked = 0.0, totalCook = 0.0;
+		for (const auto& source : findSources(directory))
+		{
+			try
+			{
+				//First call cooks a missing or stale file, later calls only hash the source
+				auto cookStart = Clock::now();
+				if (getCookedPath(source).empty())
+					continue;
+				double cookTime = toMs(Clock::now() - cookStart);
+
+				double gltfTime = 0.0, cookedTime = 0.0;
+				for (uint32_t i = 0; i < iterations; i++)
+				{
+					auto start = Clock::now();
+					{
+						tinygltf::Model gltf;
+						tinygltf::TinyGLTF loader;
+						loader.SetImageLoader(Data::LoadImageData, nullptr);
+						std::string err, warn;
+						if (!loader.LoadBinaryFromFile(&gltf, &err, &warn, source))
+							throw std::runtime_error("Failed to load model: " + source + " " + err);
+						StaticModel model(source, gltf);
+					}
+					auto middle = Clock::now();
+					{
+						StaticModel model(source);
+					}
+					auto end = Clock::now();
+					gltfTime += toMs(middle - start);
+					cookedTime += toMs(end - middle);
+				}
+				gltfTime /= iterations;
+				cookedTime /= iterations;
+				totalGltf += gltfTime;
+				totalCooked += cookedTime;
+				totalCook += cookTime;
+				Logger::gInfo("MeshCache " + source + ": glTF " + std::to_string(gltfTime) + " ms, cooked "
+					+ std::to_string(cookedTime) + " ms, x" + std::to_string(gltfTime / std::max(cookedTime, 1e-6))
+					+ ", first lookup " + std::to_string(cookTime) + " ms");
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError(e.what());
+			}
+		}
+		Logger::gInfo("MeshCache total: glTF " + std::to_string(totalGltf) + " ms, cooked " + std::to_string(totalCooked)
+			+ " ms, x" + std::to_string(totalGltf / std::max(totalCooked, 1e-6))
+			+ ", cooking " + std::to_string(totalCook) + " ms");
+	}
+}
@@ -1,34 +1,517 @@
 #include <Components.h>
+#include <Data.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <tiny_gltf.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace eg::Components::ModelCache
 {
-	static std::unordered_map<std::string, std::shared_ptr<StaticModel>> sCache;
-	static std::unordered_map<std::string, std::shared_ptr<AnimatedModel>> sAnimatedCache;
-	static std::unordered_map<std::string, std::shared_ptr<Animation>> sAnimationCache;
+	template<typename T>
+	struct Entry
+	{
+		std::shared_ptr<T> asset;
+		size_t gpuBytes = 0;
+		size_t cpuBytes = 0;
+		uint64_t lastUse = 0; //Last frame the asset was requested or referenced outside the cache
+	};
 
+	template<typename T>
+	struct Store
+	{
+		std::unordered_map<std::string, Entry<T>> loaded;
+		std::unordered_map<std::string, std::shared_future<std::shared_ptr<T>>> loading;
+	};
 
-	std::shared_ptr<Animation> loadAnimation(const std::string& filePath)
+	//Evicted assets are kept until every frame that could still draw them has completed
+	struct RetiredAsset
 	{
-		auto it = sAnimationCache.find(filePath);
-		if (it != sAnimationCache.end())
+		std::shared_ptr<void> asset;
+		size_t framesLeft;
+	};
+
+	//Decoding runs on the shared job threads and returns the step that creates the GPU resources on the transfer thread
+	template<typename T>
+	using Finalize = std::function<std::shared_ptr<T>()>;
+	template<typename T>
+	using Decode = std::function<Finalize<T>()>;
+
+	class JobQueue
+	{
+	private:
+		std::mutex mMutex;
+		std::condition_variable mCV;
+		std::deque<std::function<void()>> mJobs;
+		std::vector<std::thread> mThreads;
+		bool mRunning = false;
+
+		void run()
 		{
-			return it->second;
+			while (true)
+			{
+				std::function<void()> job;
+				{
+					std::unique_lock lock(mMutex);
+					mCV.wait(lock, [this]() { return !mRunning || !mJobs.empty(); });
+					if (!mRunning)
+						return;
+					job = std::move(mJobs.front());
+					mJobs.pop_front();
+				}
+				job();
+			}
 		}
-		auto animation = std::make_shared<Animation>(filePath);
-		sAnimationCache[filePath] = animation;
-		return animation;
+	public:
+		void start(uint32_t threadCount)
+		{
+			mRunning = true;
+			for (uint32_t i = 0; i < threadCount; i++)
+			{
+				mThreads.emplace_back(&JobQueue::run, this);
+			}
+		}
+
+		//Queued jobs are dropped, handles to their loads stay null
+		void stop()
+		{
+			{
+				std::lock_guard lock(mMutex);
+				mRunning = false;
+			}
+			mCV.notify_all();
+			for (auto& thread : mThreads)
+			{
+				thread.join();
+			}
+			mThreads.clear();
+			mJobs.clear();
+		}
+
+		bool push(std::function<void()> job)
+		{
+			{
+				std::lock_guard lock(mMutex);
+				if (!mRunning)
+					return false;
+				mJobs.push_back(std::move(job));
+			}
+			mCV.notify_one();
+			return true;
+		}
+	};
+
+	static std::mutex sMutex; //Guards the stores, loads finish on the transfer thread
+	static Store<StaticModel> sStaticModels;
+	static Store<AnimatedModel> sAnimatedModels;
+	static Store<Animation> sAnimations;
+	static JobQueue sTransfer;
+	//Decode jobs pushed to eg::Jobs and not finished, destroy waits for them before stopping the transfer thread
+	static std::condition_variable sDecodeCV;
+	static uint32_t sDecoding = 0;
+	static bool sAccepting = false;
+	static std::shared_ptr<StaticModel> sPlaceholder;
+
+	static Command::Var* sBudgetCVar = nullptr;
+	static std::vector<RetiredAsset> sRetiredAssets;
+	static uint64_t sFrame = 0;
+	static Stats sStats;
+
+	static std::pair<size_t, size_t> measure(const StaticModel& model)
+	{
+		return { model.getGpuMemorySize(), model.getCpuMemorySize() };
 	}
 
-	std::shared_ptr<StaticModel> loadStaticModel(const std::string& filePath)
+	static std::pair<size_t, size_t> measure(const Animation& animation)
+	{
+		return { 0, animation.getMemorySize() };
+	}
+
+	template<typename T>
+	static void insert(Store<T>& store, const std::string& filePath, const std::shared_ptr<T>& asset)
+	{
+		auto [gpuBytes, cpuBytes] = measure(*asset);
+		store.loaded[filePath] = Entry<T>{ asset, gpuBytes, cpuBytes, sFrame };
+		sStats.gpuBytes += gpuBytes;
+		sStats.cpuBytes += cpuBytes;
+		sStats.residentCount++;
+	}
+
+	template<typename T>
+	static void remove(Store<T>& store, typename std::unordered_map<std::string, Entry<T>>::iterator it, bool deferred)
+	{
+		sStats.gpuBytes -= it->second.gpuBytes;
+		sStats.cpuBytes -= it->second.cpuBytes;
+		sStats.residentCount--;
+		if (deferred)
+			sRetiredAssets.push_back({ std::move(it->second.asset), Renderer::RETIRE_FRAME_COUNT });
+		store.loaded.erase(it);
+	}
+
+	//Assets only the cache references, least recently used first, until the budget is met
+	static void evict(bool deferred)
+	{
+		const size_t budget = static_cast<size_t>(std::max(sBudgetCVar ? sBudgetCVar->value : 0.0, 0.0) * 1024.0 * 1024.0);
+		std::lock_guard lock(sMutex);
+		if (sStats.gpuBytes + sStats.cpuBytes <= budget)
+			return;
+
+		struct Candidate
+		{
+			uint64_t lastUse;
+			uint32_t store;
+			std::string path;
+		};
+		std::vector<Candidate> candidates;
+		auto collect = [&candidates](auto& store, uint32_t storeIndex) {
+			for (auto& [path, entry] : store.loaded)
+			{
+				if (entry.asset.use_count() == 1)
+					candidates.push_back({ entry.lastUse, storeIndex, path });
+			}
+			};
+		collect(sStaticModels, 0);
+		collect(sAnimatedModels, 1);
+		collect(sAnimations, 2);
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+			return a.lastUse < b.lastUse;
+			});
+
+		for (const auto& candidate : candidates)
+		{
+			if (sStats.gpuBytes + sStats.cpuBytes <= budget)
+				break;
+			switch (candidate.store)
+			{
+			case 0: remove(sStaticModels, sStaticModels.loaded.find(candidate.path), deferred); break;
+			case 1: remove(sAnimatedModels, sAnimatedModels.loaded.find(candidate.path), deferred); break;
+			default: remove(sAnimations, sAnimations.loaded.find(candidate.path), deferred); break;
+			}
+			sStats.evictions++;
+		}
+	}
+
+	//Failed loads resolve to null so handles polled every frame never throw, the error is logged once here
+	template<typename T>
+	static void fail(Store<T>& store, const std::string& filePath,
+		std::promise<std::shared_ptr<T>>& promise, std::exception_ptr error)
+	{
+		{
+			std::lock_guard lock(sMutex);
+			store.loading.erase(filePath);
+		}
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("ModelCache: failed to load " + filePath + ": " + e.what());
+		}
+		catch (...)
+		{
+			Logger::gError("ModelCache: failed to load " + filePath);
+		}
+		promise.set_value(nullptr);
+	}
+
+	template<typename T>
+	static void finish(Store<T>& store, const std::string& filePath,
+		std::promise<std::shared_ptr<T>>& promise, const Finalize<T>& finalize)
+	{
+		std::shared_ptr<T> asset;
+		try
+		{
+			asset = finalize();
+		}
+		catch (...)
+		{
+			fail(store, filePath, promise, std::current_exception());
+			return;
+		}
+		{
+			std::lock_guard lock(sMutex);
+			store.loading.erase(filePath);
+			insert(store, filePath, asset);
+		}
+		Logger::gInfo("ModelCache: " + filePath + " loaded !");
+		promise.set_value(std::move(asset));
+	}
+
+	template<typename T>
+	static std::shared_future<std::shared_ptr<T>> load(Store<T>& store, const std::string& filePath, Decode<T> decode, bool async)
+	{
+		auto promise = std::make_shared<std::promise<std::shared_ptr<T>>>();
+		std::shared_future<std::shared_ptr<T>> future;
+		{
+			std::lock_guard lock(sMutex);
+			auto loadedIt = store.loaded.find(filePath);
+			if (loadedIt != store.loaded.end())
+			{
+				sStats.hits++;
+				loadedIt->second.lastUse = sFrame;
+				promise->set_value(loadedIt->second.asset);
+				return promise->get_future().share();
+			}
+			auto loadingIt = store.loading.find(filePath);
+			if (loadingIt != store.loading.end())
+			{
+				sStats.hits++;
+				return loadingIt->second;
+			}
+			sStats.misses++;
+			future = promise->get_future().share();
+			store.loading.emplace(filePath, future);
+		}
+
+		bool pushed = false;
+		if (async)
+		{
+			std::lock_guard lock(sMutex);
+			if (sAccepting)
+			{
+				sDecoding++;
+				pushed = true;
+			}
+		}
+		if (pushed)
+		{
+			Jobs::push([&store, filePath, promise, decode]() {
+				try
+				{
+					{
+						std::lock_guard lock(sMutex);
+						if (!sAccepting)
+							throw std::runtime_error("ModelCache is shut down");
+					}
+					Finalize<T> finalize = decode();
+					if (!sTransfer.push([&store, filePath, promise, finalize]() { finish(store, filePath, *promise, finalize); }))
+						throw std::runtime_error("ModelCache is shut down");
+				}
+				catch (...)
+				{
+					fail(store, filePath, *promise, std::current_exception());
+				}
+				std::lock_guard lock(sMutex);
+				if (--sDecoding == 0)
+					sDecodeCV.notify_all();
+				});
+		}
+		else
+		{
+			//Synchronous load, or no worker pool: everything runs on the calling thread
+			try
+			{
+				finish(store, filePath, *promise, decode());
+			}
+			catch (...)
+			{
+				fail(store, filePath, *promise, std::current_exception());
+			}
+		}
+		return future;
+	}
+
+	template<typename T>
+	static std::shared_ptr<T> wait(const std::shared_future<std::shared_ptr<T>>& future, const std::string& filePath)
+	{
+		std::shared_ptr<T> asset = future.get();
+		if (!asset)
+			throw std::runtime_error("Failed to load model: " + filePath);
+		return asset;
+	}
+
+	static void parseModel(const std::string& filePath, tinygltf::Model& model)
+	{
+		tinygltf::TinyGLTF loader;
+		loader.SetImageLoader(Data::LoadImageData, nullptr);
+		std::string err;
+		std::string warn;
+		bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, filePath);
+		if (!warn.empty())
+			Logger::gWarn(warn);
+		if (!ret)
+			throw std::runtime_error("Failed to load model: " + filePath + " " + err);
+	}
+
+	static Decode<StaticModel> decodeStaticModel(const std::string& filePath)
+	{
+		return [filePath]() -> Finalize<StaticModel> {
+			//Hashing and cooking stay on the worker, the transfer thread only uploads
+			std::string cookedPath = MeshCache::isEnabled() ? MeshCache::getCookedPath(filePath) : std::string();
+			if (!cookedPath.empty())
+			{
+				return [filePath, cookedPath]() {
+					try
+					{
+						return std::make_shared<StaticModel>(filePath, cookedPath);
+					}
+					catch (const std::exception& e)
+					{
+						Logger::gWarn("Model: " + filePath + ", falling back to glTF: " + e.what());
+					}
+					tinygltf::Model model;
+					parseModel(filePath, model);
+					return std::make_shared<StaticModel>(filePath, model);
+					};
+			}
+
+			auto model = std::make_shared<tinygltf::Model>();
+			parseModel(filePath, *model);
+			return [filePath, model]() { return std::make_shared<StaticModel>(filePath, *model); };
+			};
+	}
+
+	static Decode<AnimatedModel> decodeAnimatedModel(const std::string& filePath)
+	{
+		return [filePath]() -> Finalize<AnimatedModel> {
+			auto model = std::make_shared<tinygltf::Model>();
+			parseModel(filePath, *model);
+			return [filePath, model]() { return std::make_shared<AnimatedModel>(filePath, *model); };
+			};
+	}
+
+	static Decode<Animation> decodeAnimation(const std::string& filePath)
+	{
+		return [filePath]() -> Finalize<Animation> {
+			//Keyframes only, nothing left for the transfer thread
+			auto animation = std::make_shared<Animation>(filePath);
+			return [animation]() { return animation; };
+			};
+	}
+
+	void create()
+	{
+		//Decoding shares the job threads, GPU resources are created on a single transfer thread
+		sTransfer.start(1);
+		{
+			std::lock_guard lock(sMutex);
+			sAccepting = true;
+		}
+
+		sBudgetCVar = Command::registerVar("eg::Components::ModelCacheBudgetMB", "None", 512.0);
+		Command::registerFn("eg::Components::PrintModelCacheStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("ModelCache: " + std::to_string(stats.residentCount) + " assets, "
+				+ std::to_string(stats.gpuBytes / (1024 * 1024)) + " MB GPU, "
+				+ std::to_string(stats.cpuBytes / (1024 * 1024)) + " MB CPU, "
+				+ std::to_string(stats.hits) + " hits, " + std::to_string(stats.misses) + " misses, "
+				+ std::to_string(stats.evictions) + " evictions, " + std::to_string(getLoadingCount()) + " loading");
+			});
+		Command::registerFn("eg::Components::ClearModelCache", [](size_t, char* []) {
+			Renderer::waitIdle();
+			clearCache();
+			});
+
+		try
+		{
+			sPlaceholder = loadStaticModel(PLACEHOLDER_PATH);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gWarn(std::string("ModelCache: no placeholder model, loading models are not drawn: ") + e.what());
+		}
+	}
+
+	void destroy()
+	{
+		//Decode jobs feed the transfer thread, those still queued fail their load once they run
+		{
+			std::unique_lock lock(sMutex);
+			sAccepting = false;
+			sDecodeCV.wait(lock, []() { return sDecoding == 0; });
+		}
+		sTransfer.stop();
+		std::lock_guard lock(sMutex);
+		sStaticModels = {};
+		sAnimatedModels = {};
+		sAnimations = {};
+		sRetiredAssets.clear();
+		sStats = {};
+		sPlaceholder.reset();
+	}
+
+	void update()
 	{
-		auto it = sCache.find(filePath);
-		if (it != sCache.end())
 		{
-			return it->second;
+			std::lock_guard lock(sMutex);
+			sFrame++;
+			for (auto it = sRetiredAssets.begin(); it != sRetiredAssets.end();)
+			{
+				if (--it->framesLeft == 0)
+					it = sRetiredAssets.erase(it);
+				else
+					++it;
+			}
+
+			//Assets still referenced outside the cache count as used this frame
+			auto touch = [](auto& store) {
+				for (auto& [path, entry] : store.loaded)
+				{
+					if (entry.asset.use_count() > 1)
+						entry.lastUse = sFrame;
+				}
+				};
+			touch(sStaticModels);
+			touch(sAnimatedModels);
+			touch(sAnimations);
 		}
-		auto model = std::make_shared<StaticModel>(filePath);
-		sCache[filePath] = model;
-		return model;
+		evict(true);
+	}
+
+	void trim()
+	{
+		{
+			std::lock_guard lock(sMutex);
+			sRetiredAssets.clear();
+		}
+		evict(false);
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lock(sMutex);
+		return sStats;
+	}
+
+	AssetHandle<StaticModel> loadStaticModelAsync(const std::string& filePath)
+	{
+		return AssetHandle<StaticModel>(filePath, load(sStaticModels, filePath, decodeStaticModel(filePath), true));
+	}
+
+	AssetHandle<AnimatedModel> loadAnimatedModelAsync(const std::string& filePath)
+	{
+		return AssetHandle<AnimatedModel>(filePath, load(sAnimatedModels, filePath, decodeAnimatedModel(filePath), true));
+	}
+
+	AssetHandle<Animation> loadAnimationAsync(const std::string& animPath)
+	{
+		return AssetHandle<Animation>(animPath, load(sAnimations, animPath, decodeAnimation(animPath), true));
+	}
+
+	const std::shared_ptr<StaticModel>& getPlaceholder()
+	{
+		return sPlaceholder;
+	}
+
+	uint32_t getLoadingCount()
+	{
+		std::lock_guard lock(sMutex);
+		return static_cast<uint32_t>(sStaticModels.loading.size() + sAnimatedModels.loading.size() + sAnimations.loading.size());
+	}
+
+	std::shared_ptr<Animation> loadAnimation(const std::string& filePath)
+	{
+		return wait(load(sAnimations, filePath, decodeAnimation(filePath), false), filePath);
+	}
+
+	std::shared_ptr<StaticModel> loadStaticModel(const std::string& filePath)
+	{
+		return wait(load(sStaticModels, filePath, decodeStaticModel(filePath), false), filePath);
 	}
 	std::shared_ptr<StaticModel> loadStaticModelFromJson(const nlohmann::json& json)
 	{
@@ -42,14 +525,7 @@ namespace eg::Components::ModelCache
 	}
 	std::shared_ptr<AnimatedModel> loadAnimatedModel(const std::string& filePath)
 	{
-		auto it = sAnimatedCache.find(filePath);
-		if (it != sAnimatedCache.end())
-		{
-			return it->second;
-		}
-		auto model = std::make_shared<AnimatedModel>(filePath);
-		sAnimatedCache[filePath] = model;
-		return model;
+		return wait(load(sAnimatedModels, filePath, decodeAnimatedModel(filePath), false), filePath);
 	}
 	std::shared_ptr<AnimatedModel> loadAnimatedModelFromJson(const nlohmann::json& json)
 	{
@@ -63,8 +539,15 @@ namespace eg::Components::ModelCache
 	}
 	void clearCache()
 	{
-		sCache.clear();
-		sAnimatedCache.clear();
+		//Loads in flight still land in the cache, requests for them keep being shared
+		std::lock_guard lock(sMutex);
+		sStaticModels.loaded.clear();
+		sAnimatedModels.loaded.clear();
+		sAnimations.loaded.clear();
+		sRetiredAssets.clear();
+		sStats.gpuBytes = 0;
+		sStats.cpuBytes = 0;
+		sStats.residentCount = 0;
 		Logger::gInfo("Model cache cleared.");
 	}
-}
\ No newline at end of file
+}
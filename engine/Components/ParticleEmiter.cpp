@@ -46,7 +46,10 @@ namespace eg::Components
 				.setSetLayouts(layouts);
 
 			//Allocate descriptor set
-			atlas->set = Renderer::getDevice().allocateDescriptorSets(descSetAllocInfo)[0];
+			{
+				auto poolLock = Renderer::lockDescriptorPool();
+				atlas->set = Renderer::getDevice().allocateDescriptorSets(descSetAllocInfo)[0];
+			}
 			//Update descriptor set
 			vk::DescriptorImageInfo imageInfo{};
 			imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
@@ -69,6 +72,7 @@ namespace eg::Components
 
 	void ParticleEmitter::clearAtlasTextures()
 	{
+		auto poolLock = Renderer::lockDescriptorPool();
 		for (const auto& [atlasName, texture] : mAtlasTextures)
 		{
 			//Free descriptor set
@@ -15,7 +15,10 @@ namespace eg::Components
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
 			.setSetLayouts(setLayouts);
-		this->mSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		{
+			auto poolLock = Renderer::lockDescriptorPool();
+			this->mSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 		vk::DescriptorBufferInfo buffer(mBuffer.getBuffer(), 0, sizeof(UniformBuffer));
 
@@ -32,6 +35,7 @@ namespace eg::Components
 
 	PointLight::~PointLight()
 	{
+		auto poolLock = Renderer::lockDescriptorPool();
 		Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), mSet);
 	}
 
@@ -2,6 +2,7 @@
 
 #include <Physics.h>
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
+#include <Jolt/Physics/Body/BodyLock.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
 #include <Jolt/Physics/Collision/RayCast.h>
 #include <Jolt/Physics/Collision/CastResult.h>
@@ -14,6 +15,49 @@ namespace eg::Components
 	{
 		mPreviousMatrix = mCurrentMatrix;
 	}
+	void RigidBody::park()
+	{
+		static const JPH::RVec3 PARK_POSITION(0.0f, -10000.0f, 0.0f);
+
+		JPH::BodyInterface* bodyInterface = eg::Physics::getBodyInterface();
+		bodyInterface->DeactivateBody(mBodyID);
+		bodyInterface->SetLinearAndAngularVelocity(mBodyID, JPH::Vec3::sZero(), JPH::Vec3::sZero());
+		bodyInterface->SetPositionAndRotation(mBodyID, PARK_POSITION, JPH::Quat::sIdentity(), JPH::EActivation::DontActivate);
+	}
+
+	void RigidBody::unpark(const glm::vec3& position, const glm::quat& rotation)
+	{
+		JPH::BodyInterface* bodyInterface = eg::Physics::getBodyInterface();
+		bodyInterface->SetPositionRotationAndVelocity(mBodyID,
+			JPH::RVec3(position.x, position.y, position.z),
+			JPH::Quat(rotation.x, rotation.y, rotation.z, rotation.w),
+			JPH::Vec3::sZero(), JPH::Vec3::sZero());
+		bodyInterface->ActivateBody(mBodyID);
+
+		//No interpolation from the parking spot
+		mCurrentMatrix = glm::translate(glm::mat4x4(1.0f), position) * glm::mat4_cast(rotation);
+		mPreviousMatrix = mCurrentMatrix;
+	}
+
+	void RigidBody::destroy()
+	{
+		if (mBodyID.IsInvalid())
+			return;
+		bool valid;
+		{
+			JPH::BodyLockRead lockRead(eg::Physics::getPhysicsSystem().GetBodyLockInterface(), mBodyID);
+			valid = lockRead.Succeeded();
+		}
+		if (valid)
+		{
+			JPH::BodyInterface* bodyInterface = eg::Physics::getBodyInterface();
+			if (bodyInterface->IsAdded(mBodyID))
+				bodyInterface->RemoveBody(mBodyID);
+			bodyInterface->DestroyBody(mBodyID);
+		}
+		mBodyID = JPH::BodyID();
+	}
+
 	glm::mat4x4 RigidBody::getBodyMatrix(float alpha) const
 	{
 		// Fast decompose lambda function
@@ -5,61 +5,551 @@
 #include <tiny_gltf.h>
 #include <shaderc/shaderc.hpp>
 #include <vector>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <tuple>
 
 namespace eg::Components
 {
 	//Static field
 	vk::Pipeline StaticModel::sPipeline;
 	vk::PipelineLayout StaticModel::sPipelineLayout;
-	vk::DescriptorSetLayout StaticModel::sDescriptorLayout;
 
 	vk::Pipeline StaticModel::sShadowPipeline;
 	vk::PipelineLayout StaticModel::sShadowPipelineLayout;
 
+	vk::Pipeline StaticModel::sCullPipeline;
+	vk::PipelineLayout StaticModel::sCullPipelineLayout;
+	vk::DescriptorSetLayout StaticModel::sCullDescriptorLayout;
+
 	Command::Var* StaticModel::sRenderScaleCVar;
 	Command::Var* StaticModel::sWidthCVar;
 	Command::Var* StaticModel::sHeightCVar;
+	Command::Var* StaticModel::sInstancingCVar;
+	Command::Var* StaticModel::sGpuCullingCVar;
+
+	//Instances queued by render and renderShadow, one queue per render stage, each filled by that stage's gather job
+	struct QueuedInstance
+	{
+		StaticModel* model;
+		uint32_t lod;
+		glm::mat4x4 transform;
+	};
+
+	//GPU culling input, one record per queued instance and one indirect command per mesh of its run
+	struct CullInstance
+	{
+		glm::mat4x4 transform;
+		glm::vec4 sphere; //Model space center and radius, a negative radius is never culled
+		uint32_t firstCommand;
+		uint32_t commandCount;
+		uint32_t pad[2];
+	};
+	static_assert(sizeof(CullInstance) == 96, "CullInstance must match static_model_cull_cs.glsl");
+
+	struct CullCommand
+	{
+		vk::DrawIndexedIndirectCommand draw;
+		uint32_t batch; //Draws sharing vertex, index buffer and material
+		uint32_t outputOffset; //First slot of the batch in the compacted buffer
+		uint32_t pad;
+	};
+	static_assert(sizeof(CullCommand) == 32, "CullCommand must match static_model_cull_cs.glsl");
+
+	struct CullPushConstant
+	{
+		glm::vec4 planes[6];
+		uint32_t instanceCount;
+		uint32_t commandCount;
+		uint32_t cullEnabled;
+		uint32_t phase;
+	};
+
+	//Buffers of one stage for one frame in flight, grown when outgrown
+	struct CullFrame
+	{
+		std::unique_ptr<Renderer::CPUBuffer> instances;
+		std::unique_ptr<Renderer::CPUBuffer> commands;
+		std::unique_ptr<Renderer::GPUBuffer> visible; //Transforms of the instances that passed, read as instance data
+		std::unique_ptr<Renderer::GPUBuffer> compacted; //Commands with at least one instance, grouped by batch
+		std::unique_ptr<Renderer::GPUBuffer> counts; //Draw count of every batch
+		uint32_t instanceCapacity = 0;
+		uint32_t commandCapacity = 0;
+		uint32_t batchCapacity = 0;
+		vk::DescriptorSet set;
+		//Work recorded this frame, dispatched by cullInstances
+		uint32_t instanceCount = 0;
+		uint32_t commandCount = 0;
+		uint32_t batchCount = 0;
+	};
+
+	//Draws sharing vertex, index buffer and material, one indirect count draw each
+	struct IndirectBatch
+	{
+		vk::Buffer vertexBuffer;
+		vk::Buffer indexBuffer;
+		uint32_t material;
+		uint32_t commandCount;
+		uint32_t outputOffset;
+	};
+	using BatchKey = std::tuple<VkBuffer, VkBuffer, uint32_t>;
+
+	struct InstanceQueue
+	{
+		std::vector<QueuedInstance> instances;
+		//Scratch of drawInstancesIndirect, cleared every frame but kept at its high water mark
+		std::vector<IndirectBatch> batches;
+		std::vector<std::pair<BatchKey, uint32_t>> batchIndices; //Sorted by key
+		std::vector<CullInstance> cullInstances;
+		std::vector<CullCommand> cullCommands;
+		//Transforms are written in place, a buffer outgrown mid frame is kept until the frame comes around again
+		std::unique_ptr<Renderer::CPUBuffer> buffers[Renderer::MAX_FRAMES_IN_FLIGHT];
+		std::vector<std::unique_ptr<Renderer::CPUBuffer>> retired[Renderer::MAX_FRAMES_IN_FLIGHT];
+		uint32_t used = 0; //Instances written this frame
+		CullFrame cull[Renderer::MAX_FRAMES_IN_FLIGHT];
+		StaticModel::InstanceStats stats;
+		StaticModel::InstanceStats lastStats;
+	};
+	static InstanceQueue sInstanceQueues[2];
+
+	//Shadow stage has its own queue, the G-buffer stage takes the other
+	static uint32_t stageIndex(Renderer::RenderStage stage)
+	{
+		return stage == Renderer::RenderStage::SHADOW ? 0 : 1;
+	}
 
 	void StaticModel::create()
 	{
 		sRenderScaleCVar = Command::findVar("eg::Renderer::ScreenRenderScale");
 		sWidthCVar = Command::findVar("eg::Renderer::ScreenWidth");
 		sHeightCVar = Command::findVar("eg::Renderer::ScreenHeight");
+		//0 draws every object on its own as soon as it is rendered
+		sInstancingCVar = Command::registerVar("eg::Renderer::InstanceStaticModels", "None", 1.0);
+		//0 keeps the CPU instanced path, GPU culling also needs drawIndirectCount support
+		sGpuCullingCVar = Command::registerVar("eg::Renderer::GpuCulling", "None", 1.0);
 		Command::registerFn("eg::Renderer::ReloadAllPipelines", [](size_t, char* []) {
-			destroy();
-			createStaticModelPipeline();
-			createStaticModelShadowPipeline();
+			destroyPipelines();
+			Renderer::PipelineCache::build(createStaticModelPipeline);
+			Renderer::PipelineCache::build(createStaticModelShadowPipeline);
+			Renderer::PipelineCache::build(createCullPipeline);
+			});
+		Command::registerFn("eg::Renderer::PrintInstanceStats", [](size_t, char* []) {
+			InstanceStats shadow = getInstanceStats(Renderer::RenderStage::SHADOW);
+			InstanceStats gbuffer = getInstanceStats(Renderer::RenderStage::SUBPASS0_GBUFFER);
+			Logger::gInfo(std::string("Instancing ") + (sInstancingCVar->value != 0.0 ? "on" : "off")
+				+ ", GPU culling " + (sGpuCullingCVar->value != 0.0 && Renderer::isDrawIndirectCountSupported() ? "on" : "off"));
+			Logger::gInfo("Shadow: " + std::to_string(shadow.instances) + " instances, " + std::to_string(shadow.drawCalls)
+				+ " draw calls, recorded in " + std::to_string(Renderer::getShadowRecordTimeMs()) + " ms");
+			Logger::gInfo("GBuffer: " + std::to_string(gbuffer.instances) + " instances, " + std::to_string(gbuffer.drawCalls)
+				+ " draw calls, recorded in " + std::to_string(Renderer::getGBufferRecordTimeMs()) + " ms");
+			});
+		Renderer::HotReload::registerPipeline("StaticModel", createStaticModelPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = sPipeline, layout = sPipelineLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				});
+			});
+		Renderer::HotReload::registerPipeline("StaticModel shadow", createStaticModelShadowPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = sShadowPipeline, layout = sShadowPipelineLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				});
 			});
-		createStaticModelPipeline();
-		createStaticModelShadowPipeline();
+		//The descriptor layout is kept, the per frame sets stay valid
+		Renderer::HotReload::registerPipeline("StaticModel cull", createCullPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = sCullPipeline, layout = sCullPipelineLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				});
+			});
+		MeshCache::create();
 	}
 	void StaticModel::destroy()
+	{
+		{
+			auto poolLock = Renderer::lockDescriptorPool();
+			for (auto& queue : sInstanceQueues)
+			{
+				for (const auto& cull : queue.cull)
+				{
+					if (cull.set)
+						Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), cull.set);
+				}
+			}
+		}
+		destroyPipelines();
+		Renderer::getDevice().destroyDescriptorSetLayout(sCullDescriptorLayout);
+		for (auto& queue : sInstanceQueues)
+		{
+			queue = {};
+		}
+	}
+	void StaticModel::destroyPipelines()
 	{
 		vk::Device dv = Renderer::getDevice();
 		dv.destroyPipeline(sPipeline);
 		dv.destroyPipelineLayout(sPipelineLayout);
-		dv.destroyDescriptorSetLayout(sDescriptorLayout);
 		dv.destroyPipeline(sShadowPipeline);
 		dv.destroyPipelineLayout(sShadowPipelineLayout);
+		dv.destroyPipeline(sCullPipeline);
+		dv.destroyPipelineLayout(sCullPipelineLayout);
 	}
 
+	void StaticModel::flushInstances(Renderer::RenderStage stage)
+	{
+		uint32_t index = stageIndex(stage);
+		//The culling pass runs once per frame, so only a stage drawn in one go can take it
+		if (sGpuCullingCVar->value != 0.0 && sInstancingCVar->value != 0.0
+			&& Renderer::isDrawIndirectCountSupported() && sInstanceQueues[index].used == 0)
+			drawInstancesIndirect(index);
+		else
+			drawInstances(index);
+
+		InstanceQueue& queue = sInstanceQueues[index];
+		queue.lastStats = queue.stats;
+		queue.stats = {};
+		queue.used = 0;
+	}
 
-	void StaticModel::createStaticModelPipeline()
+	StaticModel::InstanceStats StaticModel::getInstanceStats(Renderer::RenderStage stage)
 	{
-		Logger::gTrace("Creating static model renderer !");
-		//Define shader layout
-		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
+		return sInstanceQueues[stageIndex(stage)].lastStats;
+	}
+
+	Renderer::RenderQueue::Packet StaticModel::stagePacket(uint32_t stageIndex)
+	{
+		Renderer::RenderQueue::Packet packet{};
+		packet.sets[0] = Renderer::getCurrentFrameGUBODescSet();
+		packet.setCount = 2;
+		if (stageIndex == 0)
 		{
-			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment, {}), //uniform buffer
-			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}), //albedo
-			vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}), //normal
-			vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, {}) //mr
-		};
-		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
-		descLayoutCI.setBindings(descLayoutBindings);
+			packet.pipeline = sShadowPipeline;
+			packet.layout = sShadowPipelineLayout;
+			packet.sets[1] = Renderer::Atmosphere::getDirectionalSet();
+		}
+		else
+		{
+			//The material index is pushed per mesh
+			packet.pipeline = sPipeline;
+			packet.layout = sPipelineLayout;
+			packet.sets[1] = Renderer::Bindless::getSet();
+			packet.pushConstantStages = vk::ShaderStageFlagBits::eFragment;
+			packet.pushConstantSize = sizeof(MaterialPushConstant);
+		}
+		packet.vertexBufferCount = 2;
+		return packet;
+	}
+
+	void StaticModel::drawInstances(uint32_t stageIndex)
+	{
+		InstanceQueue& queue = sInstanceQueues[stageIndex];
+		if (queue.instances.empty())
+			return;
+
+		//The fence of this frame index was waited on before recording began
+		uint32_t frame = Renderer::getCurrentFrameIndex();
+		if (queue.used == 0)
+			queue.retired[frame].clear();
+
+		uint32_t needed = queue.used + static_cast<uint32_t>(queue.instances.size());
+		auto& buffer = queue.buffers[frame];
+		if (!buffer || buffer->getAllocationSize() < needed * sizeof(glm::mat4x4))
+		{
+			if (buffer)
+				queue.retired[frame].push_back(std::move(buffer));
+			//Earlier draws of this frame still read the old buffer, so the new one starts where they ended
+			buffer = std::make_unique<Renderer::CPUBuffer>(nullptr,
+				std::max<size_t>(needed * 2, 256) * sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eVertexBuffer);
+		}
+
+		//Objects sharing a model and level end up next to each other
+		std::sort(queue.instances.begin(), queue.instances.end(), [](const QueuedInstance& a, const QueuedInstance& b)
+			{
+				return a.model != b.model ? a.model < b.model : a.lod < b.lod;
+			});
+
+		glm::mat4x4* transforms = static_cast<glm::mat4x4*>(buffer->getInfo().pMappedData);
+		glm::vec3 cameraPosition = Renderer::getMainCamera().mPosition;
+		size_t runStart = 0;
+		while (runStart < queue.instances.size())
+		{
+			const QueuedInstance& first = queue.instances[runStart];
+			size_t runEnd = runStart;
+			//A run sorts by its nearest instance, shadow draws have no camera depth
+			float depth = stageIndex == 0 ? 0.0f : std::numeric_limits<float>::max();
+			while (runEnd < queue.instances.size() && queue.instances[runEnd].model == first.model && queue.instances[runEnd].lod == first.lod)
+			{
+				transforms[queue.used + runEnd] = queue.instances[runEnd].transform;
+				if (stageIndex != 0)
+					depth = std::min(depth, glm::distance(cameraPosition, glm::vec3(queue.instances[runEnd].transform[3])));
+				runEnd++;
+			}
+			first.model->drawMeshes(stageIndex, first.lod, queue.used + static_cast<uint32_t>(runStart),
+				static_cast<uint32_t>(runEnd - runStart), buffer->getBuffer(), depth);
+			runStart = runEnd;
+		}
+
+		queue.stats.instances += static_cast<uint32_t>(queue.instances.size());
+		queue.used = needed;
+		queue.instances.clear();
+	}
+
+	void StaticModel::drawInstancesIndirect(uint32_t stageIndex)
+	{
+		InstanceQueue& queue = sInstanceQueues[stageIndex];
+		if (queue.instances.empty())
+			return;
+
+		uint32_t frame = Renderer::getCurrentFrameIndex();
+		queue.retired[frame].clear();
+		CullFrame& cull = queue.cull[frame];
+
+		std::sort(queue.instances.begin(), queue.instances.end(), [](const QueuedInstance& a, const QueuedInstance& b)
+			{
+				return a.model != b.model ? a.model < b.model : a.lod < b.lod;
+			});
+
+		//One command per mesh of every run, every instance of a run owns a slot in the visible buffer
+		auto& batches = queue.batches;
+		auto& batchIndices = queue.batchIndices;
+		auto& instances = queue.cullInstances;
+		auto& commands = queue.cullCommands;
+		batches.clear();
+		batchIndices.clear();
+		commands.clear();
+		instances.resize(queue.instances.size());
+		size_t runStart = 0;
+		while (runStart < queue.instances.size())
+		{
+			const QueuedInstance& first = queue.instances[runStart];
+			const StaticModel& model = *first.model;
+			uint32_t firstCommand = static_cast<uint32_t>(commands.size());
+			uint32_t triangles = 0;
+			for (const auto& rawMesh : model.mRawMeshes)
+			{
+				if (rawMesh.lod != std::min(first.lod, rawMesh.lodCount - 1))
+					continue;
+				const auto& geometry = rawMesh.geometry;
+				uint32_t material = stageIndex != 0 ? model.mMaterials.at(rawMesh.materialIndex).mIndex : 0;
+				BatchKey key = std::make_tuple(static_cast<VkBuffer>(geometry.getVertexBuffer()),
+					static_cast<VkBuffer>(geometry.getIndexBuffer()), material);
+				auto it = std::lower_bound(batchIndices.begin(), batchIndices.end(), key,
+					[](const std::pair<BatchKey, uint32_t>& entry, const BatchKey& key) { return entry.first < key; });
+				if (it == batchIndices.end() || it->first != key)
+				{
+					it = batchIndices.insert(it, { key, static_cast<uint32_t>(batches.size()) });
+					batches.push_back({ geometry.getVertexBuffer(), geometry.getIndexBuffer(), material, 0, 0 });
+				}
+				batches[it->second].commandCount++;
+
+				CullCommand command{};
+				command.draw = vk::DrawIndexedIndirectCommand(geometry.getIndexCount(), 0, geometry.getFirstIndex(),
+					static_cast<int32_t>(geometry.getFirstVertex()), static_cast<uint32_t>(runStart));
+				command.batch = it->second;
+				commands.push_back(command);
+				triangles += geometry.getIndexCount() / 3;
+			}
+
+			size_t runEnd = runStart;
+			glm::vec4 sphere(model.getBoundingCenter(), model.mBoundsMin.x > model.mBoundsMax.x ? -1.0f : model.getBoundingRadius());
+			while (runEnd < queue.instances.size() && queue.instances[runEnd].model == first.model && queue.instances[runEnd].lod == first.lod)
+			{
+				instances[runEnd] = { queue.instances[runEnd].transform, sphere, firstCommand,
+					static_cast<uint32_t>(commands.size()) - firstCommand, { 0, 0 } };
+				runEnd++;
+			}
+			uint32_t runLength = static_cast<uint32_t>(runEnd - runStart);
+			//Counted as submitted, the GPU decides how many of them are drawn
+			LevelOfDetail::recordSubmit(stageIndex == 0 ? Renderer::RenderStage::SHADOW : Renderer::RenderStage::SUBPASS0_GBUFFER,
+				first.lod, static_cast<uint32_t>(commands.size()) - firstCommand, triangles * runLength, runLength);
+			runStart = runEnd;
+		}
+
+		uint32_t offset = 0;
+		for (auto& batch : batches)
+		{
+			batch.outputOffset = offset;
+			offset += batch.commandCount;
+		}
+		for (auto& command : commands)
+		{
+			command.outputOffset = batches[command.batch].outputOffset;
+		}
+
+		//The fence of this frame index was waited on, the old buffers are no longer read
+		bool rebind = !cull.set;
+		if (cull.instanceCapacity < instances.size())
+		{
+			cull.instanceCapacity = std::max<uint32_t>(static_cast<uint32_t>(instances.size()) * 2, 256);
+			cull.instances = std::make_unique<Renderer::CPUBuffer>(nullptr,
+				cull.instanceCapacity * sizeof(CullInstance), vk::BufferUsageFlagBits::eStorageBuffer);
+			cull.visible = std::make_unique<Renderer::GPUBuffer>(nullptr,
+				cull.instanceCapacity * sizeof(glm::mat4x4), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+			rebind = true;
+		}
+		if (cull.commandCapacity < commands.size())
+		{
+			cull.commandCapacity = std::max<uint32_t>(static_cast<uint32_t>(commands.size()) * 2, 256);
+			cull.commands = std::make_unique<Renderer::CPUBuffer>(nullptr,
+				cull.commandCapacity * sizeof(CullCommand), vk::BufferUsageFlagBits::eStorageBuffer);
+			cull.compacted = std::make_unique<Renderer::GPUBuffer>(nullptr,
+				cull.commandCapacity * sizeof(CullCommand), vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+			rebind = true;
+		}
+		if (cull.batchCapacity < batches.size())
+		{
+			cull.batchCapacity = std::max<uint32_t>(static_cast<uint32_t>(batches.size()) * 2, 64);
+			cull.counts = std::make_unique<Renderer::GPUBuffer>(nullptr,
+				cull.batchCapacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+			rebind = true;
+		}
+		if (rebind)
+		{
+			if (!cull.set)
+			{
+				vk::DescriptorSetAllocateInfo ai{};
+				ai.setDescriptorPool(Renderer::getDescriptorPool())
+					.setDescriptorSetCount(1)
+					.setSetLayouts(sCullDescriptorLayout);
+				auto poolLock = Renderer::lockDescriptorPool();
+				cull.set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			}
+			vk::DescriptorBufferInfo bufferInfos[] =
+			{
+				vk::DescriptorBufferInfo(cull.instances->getBuffer(), 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(cull.commands->getBuffer(), 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(cull.visible->getBuffer(), 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(cull.compacted->getBuffer(), 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(cull.counts->getBuffer(), 0, VK_WHOLE_SIZE)
+			};
+			vk::WriteDescriptorSet writes[5];
+			for (uint32_t i = 0; i < 5; i++)
+			{
+				writes[i] = vk::WriteDescriptorSet(cull.set, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i], nullptr, nullptr);
+			}
+			Renderer::getDevice().updateDescriptorSets(writes, {});
+		}
+		cull.instances->write(instances.data(), instances.size() * sizeof(CullInstance));
+		cull.commands->write(commands.data(), commands.size() * sizeof(CullCommand));
+		cull.instanceCount = static_cast<uint32_t>(instances.size());
+		cull.commandCount = static_cast<uint32_t>(commands.size());
+		cull.batchCount = static_cast<uint32_t>(batches.size());
+
+		//Filled by cullInstances before the pass executes these commands
+		Renderer::RenderStage stage = stageIndex == 0 ? Renderer::RenderStage::SHADOW : Renderer::RenderStage::SUBPASS0_GBUFFER;
+		for (uint32_t i = 0; i < batches.size(); i++)
+		{
+			const IndirectBatch& batch = batches[i];
+			Renderer::RenderQueue::Packet packet = stagePacket(stageIndex);
+			if (stageIndex != 0)
+			{
+				MaterialPushConstant pushConstant{ batch.material };
+				std::memcpy(packet.pushConstants, &pushConstant, sizeof(pushConstant));
+			}
+			packet.vertexBuffers[0] = batch.vertexBuffer;
+			packet.vertexBuffers[1] = cull.visible->getBuffer();
+			packet.indexBuffer = batch.indexBuffer;
+			packet.indirectBuffer = cull.compacted->getBuffer();
+			packet.indirectOffset = batch.outputOffset * sizeof(CullCommand);
+			packet.countBuffer = cull.counts->getBuffer();
+			packet.countOffset = i * sizeof(uint32_t);
+			packet.maxDrawCount = batch.commandCount;
+			packet.stride = sizeof(CullCommand);
+			packet.key = Renderer::RenderQueue::makeKey(packet.pipeline, batch.material, batch.vertexBuffer, 0.0f);
+			Renderer::RenderQueue::submit(stage, packet);
+		}
+
+		queue.stats.instances += cull.instanceCount;
+		queue.stats.drawCalls += cull.batchCount;
+		queue.used = cull.instanceCount;
+		queue.instances.clear();
+	}
+
+	void StaticModel::cullInstances(vk::CommandBuffer cmd)
+	{
+		uint32_t frame = Renderer::getCurrentFrameIndex();
+		bool hasWork = false;
+		for (const auto& queue : sInstanceQueues)
+		{
+			hasWork |= queue.cull[frame].commandCount > 0;
+		}
+		if (!hasWork)
+			return;
+
+		//Draw counts start from zero every frame
+		for (const auto& queue : sInstanceQueues)
+		{
+			const CullFrame& cull = queue.cull[frame];
+			if (cull.commandCount > 0)
+				cmd.fillBuffer(cull.counts->getBuffer(), 0, cull.batchCount * sizeof(uint32_t), 0);
+		}
+		vk::MemoryBarrier barrier{};
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+			vk::DependencyFlags{}, { barrier }, {}, {});
+
+		//Only the camera pass is frustum culled, casters outside the view still throw shadows into it
+		CameraFrustumCuller culler(Renderer::getMainCamera());
+		culler.updateFrustumPlanes(vk::Extent2D(static_cast<uint32_t>(sWidthCVar->value), static_cast<uint32_t>(sHeightCVar->value)));
+
+		cmd.bindPipeline(vk::PipelineBindPoint::eCompute, sCullPipeline);
+		for (uint32_t phase = 0; phase < 2; phase++)
+		{
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				const CullFrame& cull = sInstanceQueues[i].cull[frame];
+				if (cull.commandCount == 0)
+					continue;
+				CullPushConstant pushConstant{};
+				for (size_t plane = 0; plane < 6; plane++)
+				{
+					pushConstant.planes[plane] = culler.getPlane(plane);
+				}
+				pushConstant.instanceCount = cull.instanceCount;
+				pushConstant.commandCount = cull.commandCount;
+				pushConstant.cullEnabled = i == 0 ? 0 : 1;
+				pushConstant.phase = phase;
+				cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, sCullPipelineLayout, 0, { cull.set }, {});
+				cmd.pushConstants(sCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstant), &pushConstant);
+				uint32_t count = phase == 0 ? cull.instanceCount : cull.commandCount;
+				cmd.dispatch((count + 63) / 64, 1, 1);
+			}
+
+			//Compaction reads the instance counts the cull phase accumulated
+			if (phase == 0)
+			{
+				barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+					.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+				cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags{}, { barrier }, {}, {});
+			}
+		}
+
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+			vk::DependencyFlags{}, { barrier }, {}, {});
+
+		for (auto& queue : sInstanceQueues)
+		{
+			CullFrame& cull = queue.cull[frame];
+			cull.instanceCount = 0;
+			cull.commandCount = 0;
+			cull.batchCount = 0;
+		}
+	}
+
 
-		sDescriptorLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+	void StaticModel::createStaticModelPipeline()
+	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
 
+		Logger::gTrace("Creating static model renderer !");
 		//Load shaders
 		auto vertexBinary = Renderer::compileShaderFromFile("shaders/static_model_vs.glsl", shaderc_glsl_vertex_shader);
 		auto geometryBinary = Renderer::compileShaderFromFile("shaders/static_model_gs.glsl", shaderc_glsl_geometry_shader);
@@ -85,18 +575,15 @@ namespace eg::Components
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			Renderer::getGlobalDescriptorSet(), // Slot0
-			sDescriptorLayout, //Slot 1
-		};
-		vk::PushConstantRange pushConstantRanges[] =
-		{
-			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, 0, sizeof(VertexPushConstant))
+			Renderer::Bindless::getLayout(), //Slot 1
 		};
+		vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(MaterialPushConstant));
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
-			.setPushConstantRanges(pushConstantRanges);
+			.setPushConstantRanges(pushConstantRange);
 
-		sPipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -125,16 +612,19 @@ namespace eg::Components
 			}
 		};
 
-		//Create vertex layout
+		//Create vertex layout, interleaved as stored in the geometry pool, then one model matrix per instance
 		vk::VertexInputBindingDescription vertexBindingDescriptions[] = {
-			vk::VertexInputBindingDescription(0, sizeof(float) * 3, vk::VertexInputRate::eVertex),
-			vk::VertexInputBindingDescription(1, sizeof(float) * 3, vk::VertexInputRate::eVertex),
-			vk::VertexInputBindingDescription(2, sizeof(float) * 2, vk::VertexInputRate::eVertex)
+			vk::VertexInputBindingDescription(0, sizeof(Renderer::GeometryPool::Vertex), vk::VertexInputRate::eVertex),
+			vk::VertexInputBindingDescription(1, sizeof(glm::mat4x4), vk::VertexInputRate::eInstance)
 		};
 		vk::VertexInputAttributeDescription vertexAttributeDescriptions[] = {
-			vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, 0),
-			vk::VertexInputAttributeDescription(1, 1, vk::Format::eR32G32B32Sfloat, 0),
-			vk::VertexInputAttributeDescription(2, 2, vk::Format::eR32G32Sfloat, 0)
+			vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Renderer::GeometryPool::Vertex, position)),
+			vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Renderer::GeometryPool::Vertex, normal)),
+			vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32Sfloat, offsetof(Renderer::GeometryPool::Vertex, uv)),
+			vk::VertexInputAttributeDescription(3, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 0),
+			vk::VertexInputAttributeDescription(4, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 1),
+			vk::VertexInputAttributeDescription(5, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 2),
+			vk::VertexInputAttributeDescription(6, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 3)
 		};
 
 		vk::PipelineVertexInputStateCreateInfo vertexInputStateCI{};
@@ -253,7 +743,7 @@ namespace eg::Components
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(sPipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::DefaultRenderPass::getRenderPass())
 			.setSubpass(0)
 			.setBasePipelineHandle(nullptr)
@@ -270,12 +760,12 @@ namespace eg::Components
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create StaticModel pipeline !");
 		}
-		sPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
@@ -283,9 +773,15 @@ namespace eg::Components
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(geometryShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		sPipelineLayout = layout;
+		sPipeline = pipeline;
 	}
 	void StaticModel::createStaticModelShadowPipeline()
 	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		Logger::gTrace("Creating depth only static model renderer !");
 
 		//Load shaders
@@ -316,16 +812,11 @@ namespace eg::Components
 			Renderer::getGlobalDescriptorSet(), // Slot0,
 			Renderer::Atmosphere::getDirectionalDescLayout() // Slot 1
 		};
-		vk::PushConstantRange pushConstantRanges[] =
-		{
-			vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexPushConstant))
-		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
-			.setSetLayouts(setLayouts)
-			.setPushConstantRanges(pushConstantRanges);
+			.setSetLayouts(setLayouts);
 
-		sShadowPipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -355,12 +846,17 @@ namespace eg::Components
 			}
 		};
 
-		//Create vertex layout
+		//Create vertex layout, only the position of the interleaved vertex is read, then one model matrix per instance
 		vk::VertexInputBindingDescription vertexBindingDescriptions[] = {
-			vk::VertexInputBindingDescription(0, sizeof(float) * 3, vk::VertexInputRate::eVertex),
+			vk::VertexInputBindingDescription(0, sizeof(Renderer::GeometryPool::Vertex), vk::VertexInputRate::eVertex),
+			vk::VertexInputBindingDescription(1, sizeof(glm::mat4x4), vk::VertexInputRate::eInstance)
 		};
 		vk::VertexInputAttributeDescription vertexAttributeDescriptions[] = {
-			vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, 0),
+			vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Renderer::GeometryPool::Vertex, position)),
+			vk::VertexInputAttributeDescription(3, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 0),
+			vk::VertexInputAttributeDescription(4, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 1),
+			vk::VertexInputAttributeDescription(5, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 2),
+			vk::VertexInputAttributeDescription(6, 1, vk::Format::eR32G32B32A32Sfloat, sizeof(glm::vec4) * 3)
 		};
 
 		vk::PipelineVertexInputStateCreateInfo vertexInputStateCI{};
@@ -424,7 +920,7 @@ namespace eg::Components
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(sShadowPipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::Atmosphere::getRenderPass())
 			.setSubpass(0)
 			.setBasePipelineHandle(nullptr)
@@ -441,12 +937,12 @@ namespace eg::Components
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create depth only StaticModel pipeline !");
 		}
-		sShadowPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
@@ -454,6 +950,68 @@ namespace eg::Components
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(geometryShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		sShadowPipelineLayout = layout;
+		sShadowPipeline = pipeline;
+	}
+
+
+	void StaticModel::createCullPipeline()
+	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
+		Logger::gTrace("Creating static model culling pipeline !");
+		//Kept across pipeline reloads, the per frame sets were allocated with it
+		if (!sCullDescriptorLayout)
+		{
+			vk::DescriptorSetLayoutBinding descLayoutBindings[] =
+			{
+				vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, {}), //instances
+				vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, {}), //commands
+				vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, {}), //visible
+				vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, {}), //compacted
+				vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, {}) //counts
+			};
+			vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
+			descLayoutCI.setBindings(descLayoutBindings);
+			sCullDescriptorLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		}
+
+		auto computeBinary = Renderer::compileShaderFromFile("shaders/static_model_cull_cs.glsl", shaderc_glsl_compute_shader);
+		vk::ShaderModuleCreateInfo computeShaderModuleCI{};
+		computeShaderModuleCI.setCodeSize(computeBinary.size() * sizeof(uint32_t));
+		computeShaderModuleCI.setPCode(computeBinary.data());
+		auto computeShaderModule = Renderer::getDevice().createShaderModule(computeShaderModuleCI);
+
+		vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstant));
+		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
+		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
+			.setSetLayouts(sCullDescriptorLayout)
+			.setPushConstantRanges(pushConstantRange);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+
+		vk::ComputePipelineCreateInfo pipelineCI{};
+		pipelineCI.setLayout(layout)
+			.setStage(vk::PipelineShaderStageCreateInfo
+				{
+					vk::PipelineShaderStageCreateFlags{},
+					vk::ShaderStageFlagBits::eCompute,
+					computeShaderModule,
+					"main"
+				});
+
+		auto pipeLineResult = Renderer::getDevice().createComputePipeline(Renderer::PipelineCache::get(), pipelineCI);
+		if (pipeLineResult.result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("Failed to create StaticModel culling pipeline !");
+		}
+		pipeline = pipeLineResult.value;
+
+		Renderer::getDevice().destroyShaderModule(computeShaderModule);
+
+		sCullPipelineLayout = layout;
+		sCullPipeline = pipeline;
 	}
 
 
@@ -461,6 +1019,22 @@ namespace eg::Components
 	StaticModel::StaticModel(const std::string& filePath) :
 		mFilePath(filePath)
 	{
+		//Cooked models skip glTF parsing and texture compression entirely
+		std::string cookedPath = MeshCache::isEnabled() ? MeshCache::getCookedPath(filePath) : std::string();
+		if (!cookedPath.empty())
+		{
+			try
+			{
+				loadCooked(cookedPath);
+				Logger::gInfo("Model: " + filePath + " loaded from " + cookedPath + " !");
+				return;
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gWarn("Model: " + filePath + ", falling back to glTF: " + e.what());
+			}
+		}
+
 		tinygltf::Model model;
 		tinygltf::TinyGLTF loader;
 		loader.SetImageLoader(Data::LoadImageData, nullptr);
@@ -506,66 +1080,172 @@ namespace eg::Components
 		}
 	}
 
+	StaticModel::StaticModel(const std::string& filePath, const std::string& cookedPath) :
+		mFilePath(filePath)
+	{
+		loadCooked(cookedPath);
+	}
+
 	void StaticModel::render(vk::CommandBuffer cmd,
-		glm::mat4x4 worldTransform)
-	{
-		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, sPipeline);
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			sPipelineLayout,
-			0,
-			Renderer::getCurrentFrameGUBODescSet(),
-			{}
-		);
-		float scaledWidth = static_cast<float>(sWidthCVar->value * sRenderScaleCVar->value);
-		float scaledHeight = static_cast<float>(sHeightCVar->value * sRenderScaleCVar->value);
-
-		cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f, scaledWidth, scaledHeight,
-			0.0f, 1.0f } });
-		cmd.setScissor(0, vk::Rect2D({ 0, 0 }, { static_cast<uint32_t>(scaledWidth), static_cast<uint32_t>(scaledHeight) }));
-
-		//Build model matrix
-		VertexPushConstant ps{};
-		ps.model = worldTransform;
-		cmd.pushConstants(sPipelineLayout,
-			vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eGeometry, 0, sizeof(ps), &ps);
+		glm::mat4x4 worldTransform, uint32_t lod)
+	{
+		sInstanceQueues[1].instances.push_back({ this, std::min(lod, mLodCount - 1), worldTransform });
+		if (sInstancingCVar->value == 0.0)
+			drawInstances(1);
+	}
+	void StaticModel::renderShadow(vk::CommandBuffer cmd,
+		glm::mat4x4 worldTransform, uint32_t lod)
+	{
+		sInstanceQueues[0].instances.push_back({ this, std::min(lod, mLodCount - 1), worldTransform });
+		if (sInstancingCVar->value == 0.0)
+			drawInstances(0);
+	}
+
+	void StaticModel::drawMeshes(uint32_t stageIndex, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount,
+		vk::Buffer instanceBuffer, float depth) const
+	{
+		Renderer::RenderStage stage = stageIndex == 0 ? Renderer::RenderStage::SHADOW : Renderer::RenderStage::SUBPASS0_GBUFFER;
+		uint32_t drawCalls = 0, triangles = 0;
 		for (const auto& rawMesh : mRawMeshes)
 		{
-			cmd.bindVertexBuffers(0, { rawMesh.positionBuffer.getBuffer(), rawMesh.normalBuffer.getBuffer(), rawMesh.uvBuffer.getBuffer() }, { 0, 0, 0 });
-			cmd.bindIndexBuffer(rawMesh.indexBuffer.getBuffer(), 0, vk::IndexType::eUint32);
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-				sPipelineLayout,
-				1, { mMaterials.at(rawMesh.materialIndex).mSet }, {});
-			cmd.drawIndexed(rawMesh.vertexCount, 1, 0, 0, 0);
+			//Meshes with a shorter LOD chain keep drawing their coarsest level
+			if (rawMesh.lod != std::min(lod, rawMesh.lodCount - 1))
+				continue;
+			const auto& geometry = rawMesh.geometry;
+			Renderer::RenderQueue::Packet packet = stagePacket(stageIndex);
+			uint32_t material = 0;
+			if (stageIndex != 0)
+			{
+				material = mMaterials.at(rawMesh.materialIndex).mIndex;
+				MaterialPushConstant pushConstant{ material };
+				std::memcpy(packet.pushConstants, &pushConstant, sizeof(pushConstant));
+			}
+			packet.vertexBuffers[0] = geometry.getVertexBuffer();
+			packet.vertexBuffers[1] = instanceBuffer;
+			packet.indexBuffer = geometry.getIndexBuffer();
+			packet.indexCount = geometry.getIndexCount();
+			packet.instanceCount = instanceCount;
+			packet.firstIndex = geometry.getFirstIndex();
+			packet.vertexOffset = static_cast<int32_t>(geometry.getFirstVertex());
+			packet.firstInstance = firstInstance;
+			//Meshes sharing a pool block sort next to each other and share the bindings
+			packet.key = Renderer::RenderQueue::makeKey(packet.pipeline, material, geometry.getVertexBuffer(), depth);
+			Renderer::RenderQueue::submit(stage, packet);
+			drawCalls++;
+			triangles += geometry.getIndexCount() / 3 * instanceCount;
 		}
+		sInstanceQueues[stageIndex].stats.drawCalls += drawCalls;
+		LevelOfDetail::recordSubmit(stage, lod, drawCalls, triangles, instanceCount);
 	}
-	void StaticModel::renderShadow(vk::CommandBuffer cmd,
-		glm::mat4x4 worldTransform)
-	{
-		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, sShadowPipeline);
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-			sShadowPipelineLayout,
-			0,
-			{ Renderer::getCurrentFrameGUBODescSet(), Renderer::Atmosphere::getDirectionalSet() },
-			{}
-		);
-		cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f,
-			static_cast<float>(Renderer::Atmosphere::getShadowMapSize()),
-			static_cast<float>(Renderer::Atmosphere::getShadowMapSize()),
-			0.0f, 1.0f } });
-		cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0),
-			vk::Extent2D(Renderer::Atmosphere::getShadowMapSize(), Renderer::Atmosphere::getShadowMapSize())));
-
-		//Build model matrix
-		VertexPushConstant ps{};
-		ps.model = worldTransform;
-		cmd.pushConstants(sShadowPipelineLayout,
-			vk::ShaderStageFlagBits::eVertex, 0, sizeof(ps), &ps);
+
+	std::vector<std::vector<int32_t>> StaticModel::extractLodChains(const tinygltf::Model& model)
+	{
+		const int32_t meshCount = static_cast<int32_t>(model.meshes.size());
+		std::vector<std::vector<int32_t>> chains(meshCount);
+		for (int32_t i = 0; i < meshCount; i++)
+		{
+			chains[i] = { i };
+		}
+
+		//MSFT_lod, the finest node lists the nodes of its coarser levels
+		for (const auto& node : model.nodes)
+		{
+			auto it = node.extensions.find("MSFT_lod");
+			if (node.mesh < 0 || it == node.extensions.end() || !it->second.Has("ids"))
+				continue;
+			const auto& ids = it->second.Get("ids");
+			for (size_t i = 0; i < ids.ArrayLen(); i++)
+			{
+				int32_t nodeIndex = ids.Get(static_cast<int>(i)).GetNumberAsInt();
+				if (nodeIndex < 0 || nodeIndex >= static_cast<int32_t>(model.nodes.size()))
+					continue;
+				int32_t lodMesh = model.nodes.at(nodeIndex).mesh;
+				if (lodMesh < 0 || lodMesh == node.mesh || chains[lodMesh].size() != 1 || chains[node.mesh].empty())
+					continue;
+				chains[node.mesh].push_back(lodMesh);
+				chains[lodMesh].clear();
+			}
+		}
+
+		//"<name>_LOD<n>" naming, as written by most DCC exporters
+		auto splitLodName = [](const std::string& name, std::string& stem) -> int32_t
+			{
+				size_t pos = name.rfind("_LOD");
+				if (pos == std::string::npos)
+					pos = name.rfind("_lod");
+				if (pos == std::string::npos || pos + 4 >= name.size()
+					|| name.find_first_not_of("0123456789", pos + 4) != std::string::npos)
+				{
+					stem = name;
+					return 0;
+				}
+				stem = name.substr(0, pos);
+				return std::stoi(name.substr(pos + 4));
+			};
+
+		std::unordered_map<std::string, int32_t> baseMeshes;
+		std::vector<std::pair<int32_t, int32_t>> coarserMeshes; //level, mesh
+		std::vector<std::string> stems(meshCount);
+		for (int32_t i = 0; i < meshCount; i++)
+		{
+			if (chains[i].size() != 1)
+				continue;
+			int32_t level = splitLodName(model.meshes[i].name, stems[i]);
+			if (level == 0)
+				baseMeshes.emplace(stems[i], i);
+			else
+				coarserMeshes.emplace_back(level, i);
+		}
+		std::sort(coarserMeshes.begin(), coarserMeshes.end());
+		for (const auto& [level, mesh] : coarserMeshes)
+		{
+			auto it = baseMeshes.find(stems[mesh]);
+			if (it == baseMeshes.end())
+				continue;
+			chains[it->second].push_back(mesh);
+			chains[mesh].clear();
+		}
+
+		return chains;
+	}
+
+	void StaticModel::expandBounds(const std::vector<glm::vec3>& positions)
+	{
+		for (const auto& position : positions)
+		{
+			mBoundsMin = glm::min(mBoundsMin, position);
+			mBoundsMax = glm::max(mBoundsMax, position);
+		}
+	}
+
+	float StaticModel::getBoundingRadius() const
+	{
+		if (mBoundsMin.x > mBoundsMax.x)
+			return 0.0f;
+		return glm::length(mBoundsMax - mBoundsMin) * 0.5f;
+	}
+
+	size_t StaticModel::getGpuMemorySize() const
+	{
+		size_t size = 0;
 		for (const auto& rawMesh : mRawMeshes)
 		{
-			cmd.bindVertexBuffers(0, { rawMesh.positionBuffer.getBuffer() }, { 0, });
-			cmd.bindIndexBuffer(rawMesh.indexBuffer.getBuffer(), 0, vk::IndexType::eUint32);
-			cmd.drawIndexed(rawMesh.vertexCount, 1, 0, 0, 0);
+			size += rawMesh.geometry.getAllocationSize();
 		}
+		//Materials share images, every image is listed once in mImages
+		for (const auto& image : mImages)
+		{
+			size += image->getImage().getAllocationSize();
+		}
+		return size;
+	}
+
+	size_t StaticModel::getCpuMemorySize() const
+	{
+		return sizeof(*this) + mFilePath.capacity()
+			+ mRawMeshes.capacity() * sizeof(RawMesh)
+			+ mImages.capacity() * sizeof(mImages[0])
+			+ mMaterials.capacity() * sizeof(Material);
 	}
 
 	void StaticModel::extractRawMeshes(const tinygltf::Model& model)
@@ -574,9 +1254,21 @@ namespace eg::Components
 		std::vector<glm::vec3> positions, normals;
 		std::vector<glm::vec2> uvs;
 
+		//LOD level and chain length of every glTF mesh
+		std::vector<std::pair<uint32_t, uint32_t>> meshLods(model.meshes.size(), { 0, 1 });
+		for (const auto& chain : extractLodChains(model))
+		{
+			for (size_t level = 0; level < chain.size(); level++)
+			{
+				meshLods[chain[level]] = { static_cast<uint32_t>(level), static_cast<uint32_t>(chain.size()) };
+			}
+			mLodCount = std::max(mLodCount, static_cast<uint32_t>(chain.size()));
+		}
+
 		mRawMeshes.reserve(model.meshes.size());
-		for (const auto& mesh : model.meshes)
+		for (size_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
 		{
+			const auto& mesh = model.meshes[meshIndex];
 			for (const auto& primitive : mesh.primitives)
 			{
 				if (primitive.material < 0)
@@ -663,26 +1355,21 @@ namespace eg::Components
 
 
 
-				RawMesh rawMesh{
-					Renderer::GPUBuffer(positions.data(),
-					positions.size() * sizeof(glm::vec3),
-					vk::BufferUsageFlagBits::eVertexBuffer),
+				if (normals.size() != positions.size() || uvs.size() != positions.size())
+					throw std::runtime_error("Mesh attributes must have the same count !");
 
-					Renderer::GPUBuffer(normals.data(),
-					normals.size() * sizeof(glm::vec3),
-					vk::BufferUsageFlagBits::eVertexBuffer),
-
-					Renderer::GPUBuffer(uvs.data(),
-					uvs.size() * sizeof(glm::vec2),
-					vk::BufferUsageFlagBits::eVertexBuffer),
-
-					Renderer::GPUBuffer(indices.data(), indices.size() * sizeof(uint32_t),
-					vk::BufferUsageFlagBits::eIndexBuffer),
+				RawMesh rawMesh{
+					Renderer::MeshBuffer(positions.data(), normals.data(), uvs.data(),
+					static_cast<uint32_t>(positions.size()),
+					indices.data(), static_cast<uint32_t>(indices.size()), vk::IndexType::eUint32),
 
 					static_cast<uint32_t>(primitive.material),
-					static_cast<uint32_t>(indices.size()),
+					meshLods[meshIndex].first,
+					meshLods[meshIndex].second,
 				};
 
+				if (rawMesh.lod == 0)
+					expandBounds(positions);
 				mRawMeshes.push_back(std::move(rawMesh));
 			}
 
@@ -712,10 +1399,10 @@ namespace eg::Components
 
 					auto newImage = std::make_shared<Renderer::CombinedImageSampler2D>(
 						image.width, image.height,
-						vk::Format::eBc3UnormBlock,
+						Data::TextureCompressor::getImageFormat(image),
 						vk::ImageUsageFlagBits::eSampled,
 						vk::ImageAspectFlagBits::eColor,
-						(void*)image.image.data(), image.image.size());
+						Data::TextureCompressor::getImageMipLevels(image), image.image.data(), image.image.size());
 
 					this->mImages.push_back(newImage);
 					newMaterial.mAlbedo = newImage;
@@ -742,10 +1429,10 @@ namespace eg::Components
 
 					auto newImage = std::make_shared<Renderer::CombinedImageSampler2D>(
 						image.width, image.height,
-						vk::Format::eBc3UnormBlock,
+						Data::TextureCompressor::getImageFormat(image),
 						vk::ImageUsageFlagBits::eSampled,
 						vk::ImageAspectFlagBits::eColor,
-						(void*)image.image.data(), image.image.size());
+						Data::TextureCompressor::getImageMipLevels(image), image.image.data(), image.image.size());
 
 					this->mImages.push_back(newImage);
 					newMaterial.mNormal = newImage;
@@ -772,10 +1459,10 @@ namespace eg::Components
 
 					auto newImage = std::make_shared<Renderer::CombinedImageSampler2D>(
 						image.width, image.height,
-						vk::Format::eBc3UnormBlock,
+						Data::TextureCompressor::getImageFormat(image),
 						vk::ImageUsageFlagBits::eSampled,
 						vk::ImageAspectFlagBits::eColor,
-						(void*)image.image.data(), image.image.size());
+						Data::TextureCompressor::getImageMipLevels(image), image.image.data(), image.image.size());
 
 					this->mImages.push_back(newImage);
 					newMaterial.mMr = newImage;
@@ -788,66 +1475,50 @@ namespace eg::Components
 			}
 
 
-			vk::DescriptorImageInfo baseColorInfo{};
-			baseColorInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-				.setImageView(newMaterial.mAlbedo ? newMaterial.mAlbedo->getImage().getImageView() : Renderer::getDefaultCheckerboardImage().getImage().getImageView())
-				.setSampler(newMaterial.mAlbedo ? newMaterial.mAlbedo->getSampler() : Renderer::getDefaultCheckerboardImage().getSampler());
-
-			vk::DescriptorImageInfo normalInfo{};
-			normalInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-				.setImageView(newMaterial.mNormal ? newMaterial.mNormal->getImage().getImageView() : Renderer::getDefaultCheckerboardImage().getImage().getImageView())
-				.setSampler(newMaterial.mNormal ? newMaterial.mNormal->getSampler() : Renderer::getDefaultCheckerboardImage().getSampler());
-
-			vk::DescriptorImageInfo metallicRoughnessInfo{};
-			metallicRoughnessInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-				.setImageView(newMaterial.mMr ? newMaterial.mMr->getImage().getImageView() : Renderer::getDefaultCheckerboardImage().getImage().getImageView())
-				.setSampler(newMaterial.mMr ? newMaterial.mMr->getSampler() : Renderer::getDefaultCheckerboardImage().getSampler());
-
-			//Load buffer
-			Material::UniformBuffer uniformBuffer;
-			uniformBuffer.has_albedo = newMaterial.mAlbedo ? 1 : 0;
-			uniformBuffer.has_normal = newMaterial.mNormal ? 1 : 0;
-			uniformBuffer.has_mr = newMaterial.mMr ? 1 : 0;
-			uniformBuffer.albedoColor[0] = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[0]);
-			uniformBuffer.albedoColor[1] = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[1]);
-			uniformBuffer.albedoColor[2] = static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[2]);
-
-			newMaterial.mUniformBuffer
-				= std::make_shared<Renderer::CPUBuffer>(&uniformBuffer, sizeof(Material::UniformBuffer), vk::BufferUsageFlagBits::eUniformBuffer);
-			vk::DescriptorBufferInfo bufferInfo{};
-			bufferInfo
-				.setOffset(0)
-				.setRange(sizeof(Material::UniformBuffer))
-				.setBuffer(newMaterial.mUniformBuffer->getBuffer());
-
-			//Allocate descriptor set
-			vk::DescriptorSetLayout setLayouts[] =
-			{
-				sDescriptorLayout
-			};
-			vk::DescriptorSetAllocateInfo ai{};
-			ai.setDescriptorPool(Renderer::getDescriptorPool())
-				.setDescriptorSetCount(1)
-				.setSetLayouts(setLayouts);
-			newMaterial.mSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
-
-			Renderer::getDevice().updateDescriptorSets({
-				vk::WriteDescriptorSet(newMaterial.mSet, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo, nullptr, nullptr),
-				vk::WriteDescriptorSet(newMaterial.mSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &baseColorInfo, nullptr, nullptr, nullptr),
-				vk::WriteDescriptorSet(newMaterial.mSet, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &normalInfo, nullptr, nullptr, nullptr),
-				vk::WriteDescriptorSet(newMaterial.mSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &metallicRoughnessInfo, nullptr, nullptr, nullptr)
-				}, {});
-
-			this->mMaterials.push_back(newMaterial);
+			createMaterial(newMaterial, glm::vec3(
+				static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[0]),
+				static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[1]),
+				static_cast<float>(material.pbrMetallicRoughness.baseColorFactor[2])));
 		}
 	}
 
+	void StaticModel::createMaterial(Material& newMaterial, const glm::vec3& albedoColor)
+	{
+		const std::shared_ptr<Renderer::CombinedImageSampler2D>* images[] = { &newMaterial.mAlbedo, &newMaterial.mNormal, &newMaterial.mMr };
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			if (*images[i])
+				newMaterial.mTextures[i] = Renderer::Bindless::addTexture((*images[i])->getImage().getImageView(), (*images[i])->getSampler());
+		}
 
-	StaticModel::~StaticModel()
+		Renderer::Bindless::Material material;
+		material.albedoColor[0] = albedoColor.r;
+		material.albedoColor[1] = albedoColor.g;
+		material.albedoColor[2] = albedoColor.b;
+		material.albedo = newMaterial.mTextures[0];
+		material.normal = newMaterial.mTextures[1];
+		material.mr = newMaterial.mTextures[2];
+		newMaterial.mIndex = Renderer::Bindless::addMaterial(material);
+
+		this->mMaterials.push_back(newMaterial);
+	}
+
+	void StaticModel::releaseMaterials()
 	{
 		for (const auto& material : mMaterials)
 		{
-			Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), material.mSet);
+			Renderer::Bindless::removeMaterial(material.mIndex);
+			for (uint32_t texture : material.mTextures)
+			{
+				Renderer::Bindless::removeTexture(texture);
+			}
 		}
+		mMaterials.clear();
+	}
+
+
+	StaticModel::~StaticModel()
+	{
+		releaseMaterials();
 	}
-}
\ No newline at end of file
+}
@@ -64,42 +64,16 @@ namespace eg::Data
 
 
 
-		// Store the decoded image data
-		//Compress image using stb_dxt
-		std::vector<uint8_t> compressed;
-
-		const int blocksX = (w + 3) / 4;
-		const int blocksY = (h + 3) / 4;
-		compressed.resize(blocksX * blocksY * 16); // BC1 = 8 bytes per 4x4 block
-
-
-
-		uint8_t block[64]; // 4x4 block of RGBA
-		for (int by = 0; by < blocksY; ++by) {
-			for (int bx = 0; bx < blocksX; ++bx) {
-				std::memset(block, 0, sizeof(block));
-				for (int y = 0; y < 4; ++y) {
-					for (int x = 0; x < 4; ++x) {
-						int imgX = bx * 4 + x;
-						int imgY = by * 4 + y;
-						if (imgX < w && imgY < h) {
-							int srcIndex = (imgY * w + imgX) * 4;
-							int dstIndex = (y * 4 + x) * 4;
-							std::memcpy(&block[dstIndex], &data[srcIndex], 4);
-						}
-					}
-				}
-				int blockIndex = by * blocksX + bx;
-				stb_compress_dxt_block(&compressed[blockIndex * 16], block, 1, STB_DXT_NORMAL);
-			}
-		}
+		//Whole mip chain, compressed on every idle core
+		TextureCompressor::CompressedImage compressed = TextureCompressor::compress(data,
+			static_cast<uint32_t>(w), static_cast<uint32_t>(h), TextureCompressor::getQuality());
 		image->width = w;
 		image->height = h;
-		image->component = 4;
+		image->component = compressed.format == vk::Format::eBc1RgbUnormBlock ? 3 : 4; //Read back by TextureCompressor::getImageFormat
 		image->bits = 8;
 		image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
 		image->as_is = false;
-		image->image = std::move(compressed);
+		image->image = std::move(compressed.data);
 
 
 		stbi_image_free(data);
@@ -3,13 +3,15 @@
 
 #include <shaderc/shaderc.hpp>
 #include <Renderer.h>
+#include <cstring>
 
 namespace eg::Data::DebugRenderer
 {
 	constexpr size_t MAX_LINE_COUNT = 65536 * 8;
 	std::vector<VertexFormat> gLineVertices;
-	std::optional<Renderer::GPUBuffer> gLineVertexBuffer;
-	std::optional<Renderer::CPUBuffer> gLineStagingVertexBuffer;
+	//Lines copied into the frame ring by the last update, new lines can be added while the frame records
+	Renderer::FrameAllocator::GPUAllocation gLineAllocation;
+	uint32_t gDrawnLineVertexCount = 0;
 	
 	vk::PipelineLayout gLinePipelineLayout;
 	vk::Pipeline gLinePipeline;
@@ -29,10 +31,15 @@ namespace eg::Data::DebugRenderer
 			vk::Device dv = Renderer::getDevice();
 			dv.destroyPipeline(gLinePipeline);
 			dv.destroyPipelineLayout(gLinePipelineLayout);
-			createPipeline();
+			Renderer::PipelineCache::build(createPipeline);
 		});
 
-		createPipeline();
+		Renderer::HotReload::registerPipeline("DebugRenderer", createPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = gLinePipeline, layout = gLinePipelineLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				});
+			});
 	}
 
 	void destroy()
@@ -40,12 +47,13 @@ namespace eg::Data::DebugRenderer
 		vk::Device dv = Renderer::getDevice();
 		dv.destroyPipeline(gLinePipeline);
 		dv.destroyPipelineLayout(gLinePipelineLayout);
-		gLineVertexBuffer.reset();
-		gLineStagingVertexBuffer.reset();
 	}
 
 	void createPipeline()
 	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		Logger::gTrace("Creating debug renderer !");
 
 		//Load shaders
@@ -74,7 +82,7 @@ namespace eg::Data::DebugRenderer
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts);
 
-		gLinePipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -184,7 +192,7 @@ namespace eg::Data::DebugRenderer
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(gLinePipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::Postprocessing::getRenderPass())
 			.setSubpass(3)
 			.setBasePipelineHandle(nullptr)
@@ -201,12 +209,12 @@ namespace eg::Data::DebugRenderer
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create StaticModel pipeline !");
 		}
-		gLinePipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
@@ -214,10 +222,8 @@ namespace eg::Data::DebugRenderer
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
 
-
-		//Allocate vertex buffer
-		gLineVertexBuffer.emplace(nullptr, sizeof(VertexFormat) * MAX_LINE_COUNT, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst);
-		gLineStagingVertexBuffer.emplace(nullptr, sizeof(VertexFormat) * MAX_LINE_COUNT, vk::BufferUsageFlagBits::eTransferSrc);
+		gLinePipelineLayout = layout;
+		gLinePipeline = pipeline;
 	}
 
 	void recordLine(const glm::vec3& start, const glm::vec3& end, const glm::vec3& color)
@@ -232,28 +238,29 @@ namespace eg::Data::DebugRenderer
 
 	void updateVertexBuffers()
 	{
+		gDrawnLineVertexCount = 0;
 		if (gLineVertices.size() > 0)
 		{
-			Renderer::immediateSubmit([&](vk::CommandBuffer cmd)
-				{
-					gLineStagingVertexBuffer->write(gLineVertices.data(), sizeof(VertexFormat) * gLineVertices.size());
-
-					vk::BufferCopy copyRegion{};
-					copyRegion.setSize(sizeof(VertexFormat) * gLineVertices.size());
-					cmd.copyBuffer(gLineStagingVertexBuffer->getBuffer(), gLineVertexBuffer->getBuffer(), copyRegion);
-				});
+			//Lines that don't fit the ring are dropped for the frame
+			gLineAllocation = Renderer::FrameAllocator::allocateGPU(sizeof(VertexFormat) * gLineVertices.size());
+			if (gLineAllocation)
+			{
+				std::memcpy(gLineAllocation.data, gLineVertices.data(), sizeof(VertexFormat) * gLineVertices.size());
+				gDrawnLineVertexCount = static_cast<uint32_t>(gLineVertices.size());
+			}
 		}
+		gLineVertices.clear();
 	}
 	void render(vk::CommandBuffer cmd)
 	{
-		if (gLineVertices.size() > 0)
+		if (gDrawnLineVertexCount > 0)
 		{
 			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
 				gLinePipelineLayout,
 				0,
 				{ Renderer::getCurrentFrameGUBODescSet() },
 			{});
-			cmd.bindVertexBuffers(0, { gLineVertexBuffer->getBuffer() }, { 0 });
+			cmd.bindVertexBuffers(0, { gLineAllocation.buffer }, { gLineAllocation.offset });
 
 			cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, gLinePipeline);
 
@@ -264,8 +271,7 @@ namespace eg::Data::DebugRenderer
 				0.0f, 1.0f } });
 			cmd.setScissor(0, vk::Rect2D({ 0, 0 }, { static_cast<uint32_t>(scaledWidth), static_cast<uint32_t>(scaledHeight) }));
 			
-			cmd.draw(static_cast<uint32_t>(gLineVertices.size()), 1, 0, 0);
+			cmd.draw(gDrawnLineVertexCount, 1, 0, 0);
 		}
-		gLineVertices.clear();
 	}
 }
\ No newline at end of file
@@ -26,10 +26,20 @@ namespace eg::Data::LightRenderer
 
 		Command::registerFn("eg::Renderer::ReloadAllPipelines", [](size_t, char* []) {
 			destroy();
-			createPointPipeline(Renderer::getGlobalDescriptorSet());
+			Renderer::PipelineCache::build([]() { createPointPipeline(Renderer::getGlobalDescriptorSet()); });
 		});
 
-		createPointPipeline(Renderer::getGlobalDescriptorSet());
+		Renderer::HotReload::registerPipeline("LightRenderer point", []() { createPointPipeline(Renderer::getGlobalDescriptorSet()); }, []() {
+			return Renderer::HotReload::Build([pipeline = mPointPipeline, layout = mPointLayout, descLayout = mPointDescLayout,
+				perDescLayout = mPointPerDescLayout, set = mPointSet]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				Renderer::getDevice().destroyDescriptorSetLayout(descLayout);
+				Renderer::getDevice().destroyDescriptorSetLayout(perDescLayout);
+				auto poolLock = Renderer::lockDescriptorPool();
+				Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), set);
+				});
+			});
 	}
 	void destroy()
 	{
@@ -37,6 +47,7 @@ namespace eg::Data::LightRenderer
 		Renderer::getDevice().destroyPipelineLayout(mPointLayout);
 		Renderer::getDevice().destroyDescriptorSetLayout(mPointDescLayout);
 		Renderer::getDevice().destroyDescriptorSetLayout(mPointPerDescLayout);
+		auto poolLock = Renderer::lockDescriptorPool();
 		Renderer::getDevice().freeDescriptorSets(Renderer::getDescriptorPool(), mPointSet);
 	}
 
@@ -80,6 +91,12 @@ namespace eg::Data::LightRenderer
 
 	void createPointPipeline(vk::DescriptorSetLayout globalSetLayout)
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet set;
+		vk::DescriptorSetLayout perDescLayout;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -92,15 +109,18 @@ namespace eg::Data::LightRenderer
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mPointDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 
 		vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(mPointDescLayout);
-		mPointSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		{
+			auto poolLock = Renderer::lockDescriptorPool();
+			set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 		vk::DescriptorImageInfo imageInfos[] = {
 			vk::DescriptorImageInfo(nullptr, Renderer::DefaultRenderPass::getNormal().getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal),
@@ -111,19 +131,19 @@ namespace eg::Data::LightRenderer
 
 
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mPointSet, 0, 0,
+			vk::WriteDescriptorSet(set, 0, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[0]),
-			vk::WriteDescriptorSet(mPointSet, 1, 0,
+			vk::WriteDescriptorSet(set, 1, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[1]),
-			vk::WriteDescriptorSet(mPointSet, 2, 0,
+			vk::WriteDescriptorSet(set, 2, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[2]),
-			vk::WriteDescriptorSet(mPointSet, 3, 0,
+			vk::WriteDescriptorSet(set, 3, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[3])
@@ -136,7 +156,7 @@ namespace eg::Data::LightRenderer
 
 		descLayoutCI.setBindings(perLightDescLayoutBindings);
 
-		mPointPerDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		perDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Load shaders
 		auto vertexBinary = Renderer::compileShaderFromFile("shaders/fullscreen_quad.glsl", shaderc_glsl_vertex_shader);
@@ -156,15 +176,15 @@ namespace eg::Data::LightRenderer
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			globalSetLayout, // Slot0
-			mPointDescLayout, //Slot 1
-			mPointPerDescLayout //Slot 2
+			descLayout, //Slot 1
+			perDescLayout //Slot 2
 		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRangeCount(0)
 			.setPPushConstantRanges(nullptr);
-		mPointLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -272,7 +292,7 @@ namespace eg::Data::LightRenderer
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mPointLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::DefaultRenderPass::getRenderPass())
 			.setSubpass(1)
 			.setBasePipelineHandle(nullptr)
@@ -289,18 +309,24 @@ namespace eg::Data::LightRenderer
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create PointLight pipeline !");
 		}
-		mPointPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mPointDescLayout = descLayout;
+		mPointSet = set;
+		mPointPerDescLayout = perDescLayout;
+		mPointLayout = layout;
+		mPointPipeline = pipeline;
 	}
 	
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include <Data.h>
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eg::Data
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& filePath)
+	{
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open file for mapping: " + filePath);
+		mFileHandle = file;
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		mSize = static_cast<size_t>(size.QuadPart);
+		if (mSize == 0)
+			return;
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to create file mapping: " + filePath);
+		}
+		mMappingHandle = mapping;
+
+		mData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!mData)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file: " + filePath);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData)
+			UnmapViewOfFile(mData);
+		if (mMappingHandle)
+			CloseHandle(mMappingHandle);
+		if (mFileHandle)
+			CloseHandle(mFileHandle);
+	}
+#else
+	MappedFile::MappedFile(const std::string& filePath)
+	{
+		mFileDescriptor = open(filePath.c_str(), O_RDONLY);
+		if (mFileDescriptor < 0)
+			throw std::runtime_error("Failed to open file for mapping: " + filePath);
+
+		struct stat st {};
+		fstat(mFileDescriptor, &st);
+		mSize = static_cast<size_t>(st.st_size);
+		if (mSize == 0)
+			return;
+
+		void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+		if (data == MAP_FAILED)
+		{
+			close(mFileDescriptor);
+			throw std::runtime_error("Failed to map file: " + filePath);
+		}
+		mData = static_cast<const uint8_t*>(data);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData)
+			munmap(const_cast<uint8_t*>(mData), mSize);
+		if (mFileDescriptor >= 0)
+			close(mFileDescriptor);
+	}
+#endif
+}
@@ -6,6 +6,8 @@
 #include <Data.h>
 
 #include <shaderc/shaderc.hpp>
+#include <cstring>
+#include <algorithm>
 
 namespace eg::Data::ParticleRenderer
 {
@@ -25,8 +27,10 @@ namespace eg::Data::ParticleRenderer
 	struct ParticleAtlas
 	{
 		glm::uvec2 size; // Size of the atlas
-		std::vector<Components::ParticleInstance> instances;
-		std::optional<Renderer::GPUBuffer> buffer;
+		std::vector<Components::ParticleInstance> instances; //Cleared every frame, the capacity is kept
+		//Instances copied into the frame ring by the last update
+		Renderer::FrameAllocator::GPUAllocation allocation;
+		uint32_t drawnCount = 0;
 	};
 
 
@@ -36,7 +40,6 @@ namespace eg::Data::ParticleRenderer
 	vk::PipelineLayout gPipelineLayout;
 	vk::DescriptorSetLayout gDescLayout;
 	std::optional<Renderer::GPUBuffer> gVertexBuffer;
-	std::optional<Renderer::CPUBuffer> gInstanceBufferCPU;
 
 	Command::Var* mRenderScaleCVar;
 	Command::Var* mWidthCVar;
@@ -55,12 +58,17 @@ namespace eg::Data::ParticleRenderer
 			Renderer::getDevice().destroyPipeline(gPipeline);
 			Renderer::getDevice().destroyPipelineLayout(gPipelineLayout);
 			Renderer::getDevice().destroyDescriptorSetLayout(gDescLayout);
-			createPipeline();
+			Renderer::PipelineCache::build(createPipeline);
 		});
 
 		gVertexBuffer.emplace(particleVertices.data(), particleVertices.size() * sizeof(ParticleVertex), vk::BufferUsageFlagBits::eVertexBuffer);
-		gInstanceBufferCPU.emplace(nullptr, sizeof(Components::ParticleInstance) * MAX_PARTICLES, vk::BufferUsageFlagBits::eTransferSrc);
-		createPipeline();
+		Renderer::HotReload::registerPipeline("ParticleRenderer", createPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = gPipeline, layout = gPipelineLayout, descLayout = gDescLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				Renderer::getDevice().destroyDescriptorSetLayout(descLayout);
+				});
+			});
 	}
 
 
@@ -80,33 +88,15 @@ namespace eg::Data::ParticleRenderer
 	{
 		for (auto& [set, atlas] : gParticleMap)
 		{
-			if (!atlas.buffer.has_value())
+			atlas.drawnCount = static_cast<uint32_t>(std::min<size_t>(atlas.instances.size(), MAX_PARTICLES));
+			atlas.allocation = {};
+			if (atlas.drawnCount > 0)
 			{
-				atlas.buffer.emplace(nullptr,
-					sizeof(Components::ParticleInstance) * MAX_PARTICLES,
-					vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer);
-			}
-
-			//Update buffer
-			if (atlas.instances.size() == 0)
-			{
-				continue;
-			}
-			if (atlas.instances.size() > MAX_PARTICLES)
-			{
-				atlas.instances.resize(MAX_PARTICLES);
-			}
-			if (atlas.instances.size() > 0)
-			{
-				Renderer::immediateSubmit([&](vk::CommandBuffer cmd)
-					{
-						gInstanceBufferCPU->write(atlas.instances.data(), atlas.instances.size() * sizeof(Components::ParticleInstance));
-
-						vk::BufferCopy copyRegion{};
-						copyRegion.setSize(sizeof(Components::ParticleInstance) * atlas.instances.size());
-						cmd.copyBuffer(gInstanceBufferCPU->getBuffer(), atlas.buffer->getBuffer(), copyRegion);
-					});
+				atlas.allocation = Renderer::FrameAllocator::allocateGPU(sizeof(Components::ParticleInstance) * atlas.drawnCount);
+				if (atlas.allocation)
+					std::memcpy(atlas.allocation.data, atlas.instances.data(), sizeof(Components::ParticleInstance) * atlas.drawnCount);
 			}
+			atlas.instances.clear();
 		}	
 	}
 	void render(vk::CommandBuffer cmd)
@@ -139,14 +129,12 @@ namespace eg::Data::ParticleRenderer
 				{}
 			);
 
-			cmd.bindVertexBuffers(0, { gVertexBuffer->getBuffer(), atlas.buffer->getBuffer() }, { 0, 0 });
-			cmd.draw(4, static_cast<uint32_t>(atlas.instances.size()), 0, 0);
-		}
-
-
-		for (auto& [set, atlas] : gParticleMap)
-		{
-			atlas.instances.clear();
+			if (atlas.drawnCount == 0 || !atlas.allocation)
+			{
+				continue;
+			}
+			cmd.bindVertexBuffers(0, { gVertexBuffer->getBuffer(), atlas.allocation.buffer }, { 0, atlas.allocation.offset });
+			cmd.draw(4, atlas.drawnCount, 0, 0);
 		}
 	}
 	
@@ -156,13 +144,16 @@ namespace eg::Data::ParticleRenderer
 		Renderer::getDevice().destroyPipelineLayout(gPipelineLayout);
 		Renderer::getDevice().destroyDescriptorSetLayout(gDescLayout);
 		gVertexBuffer.reset();
-		gInstanceBufferCPU.reset();
 		gParticleMap.clear();
 	}
 
 
 	void createPipeline()
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -171,7 +162,7 @@ namespace eg::Data::ParticleRenderer
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		gDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 
 		//Load shaders
@@ -192,7 +183,7 @@ namespace eg::Data::ParticleRenderer
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			Renderer::getGlobalDescriptorSet(), // Slot0
-			gDescLayout, // Slot 1
+			descLayout, // Slot 1
 		};
 
 		//Push constant
@@ -205,7 +196,7 @@ namespace eg::Data::ParticleRenderer
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRange);
 
-		gPipelineLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -317,7 +308,7 @@ namespace eg::Data::ParticleRenderer
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(gPipelineLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::DefaultRenderPass::getRenderPass())
 			.setSubpass(1)
 			.setBasePipelineHandle(nullptr)
@@ -334,17 +325,21 @@ namespace eg::Data::ParticleRenderer
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create AmbientLight pipeline !");
 		}
-		gPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		gDescLayout = descLayout;
+		gPipelineLayout = layout;
+		gPipeline = pipeline;
 	}
 }
\ No newline at end of file
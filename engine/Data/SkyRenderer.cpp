@@ -28,10 +28,16 @@ namespace eg::Data::SkyRenderer
 			Renderer::getDevice().destroyPipeline(gPipeline);
 			Renderer::getDevice().destroyPipelineLayout(gLayout);
 			Renderer::getDevice().destroyDescriptorSetLayout(gSetLayout);
-			createPipeline();
+			Renderer::PipelineCache::build(createPipeline);
 		});
 
-		createPipeline();
+		Renderer::HotReload::registerPipeline("SkyRenderer", createPipeline, []() {
+			return Renderer::HotReload::Build([pipeline = gPipeline, layout = gLayout, setLayout = gSetLayout]() {
+				Renderer::getDevice().destroyPipeline(pipeline);
+				Renderer::getDevice().destroyPipelineLayout(layout);
+				Renderer::getDevice().destroyDescriptorSetLayout(setLayout);
+				});
+			});
 		
 	}
 	void destroy()
@@ -67,6 +73,11 @@ namespace eg::Data::SkyRenderer
 
 	void createPipeline()
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet set;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		//vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		//{
@@ -75,21 +86,21 @@ namespace eg::Data::SkyRenderer
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		//descLayoutCI.setBindings(descLayoutBindings);
 
-		gSetLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 		/*vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(gSetLayout);
-		gSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
 
 		vk::DescriptorImageInfo imageInfos[] = {
 			vk::DescriptorImageInfo(nullptr, Renderer::DefaultRenderPass::getDepth().getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal),
 		};
 
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(gSet, 0, 0,
+			vk::WriteDescriptorSet(set, 0, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[0])
@@ -114,14 +125,14 @@ namespace eg::Data::SkyRenderer
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			Renderer::getGlobalDescriptorSet(), // Set0
-			//gSetLayout //Set1
+			//descLayout //Set1
 		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRangeCount(0)
 			.setPPushConstantRanges(nullptr);
-		gLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -230,7 +241,7 @@ namespace eg::Data::SkyRenderer
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(gLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(Renderer::DefaultRenderPass::getRenderPass())
 			.setSubpass(1)
 			.setBasePipelineHandle(nullptr)
@@ -247,18 +258,23 @@ namespace eg::Data::SkyRenderer
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create AmbientLight pipeline !");
 		}
-		gPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		gSetLayout = descLayout;
+		gSet = set;
+		gLayout = layout;
+		gPipeline = pipeline;
 	}
 
 	vk::DescriptorSetLayout getDescLayout()
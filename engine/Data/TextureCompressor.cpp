@@ -0,0 +1,506 @@
+#include <Data.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <stb_dxt.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EG_TEXTURE_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace eg::Data::TextureCompressor
+{
+	static constexpr uint32_t ROWS_PER_TILE = 8; //Block rows a thread takes at once
+	static constexpr size_t MIN_BLOCKS_PER_THREAD = 512; //Below this a helper thread costs more than it saves
+
+	static Command::Var* sQualityCVar = nullptr;
+
+	struct Level
+	{
+		const uint8_t* pixels;
+		uint32_t width;
+		uint32_t height;
+		size_t offset; //Into the compressed chain
+	};
+
+	struct Tile
+	{
+		uint32_t level;
+		uint32_t firstRow;
+		uint32_t rowCount;
+	};
+
+	//Mips
+
+	static uint8_t average(uint8_t a, uint8_t b)
+	{
+		return static_cast<uint8_t>((a + b + 1) >> 1); //Same rounding as _mm_avg_epu8
+	}
+
+	static void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+			uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+			uint32_t x = 0;
+#ifdef EG_TEXTURE_COMPRESSOR_SSE2
+			//4 destination texels from 8x2 source texels
+			for (; x * 2 + 8 <= width; x += 4)
+			{
+				__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+				__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+				__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+				__m128 v0 = _mm_castsi128_ps(_mm_avg_epu8(a0, b0));
+				__m128 v1 = _mm_castsi128_ps(_mm_avg_epu8(a1, b1));
+				__m128i even = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+				__m128i odd = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_avg_epu8(even, odd));
+			}
+#endif
+			for (; x < dstWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, width - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					out[x * 4 + c] = average(average(row0[x0 + c], row1[x0 + c]), average(row0[x1 + c], row1[x1 + c]));
+				}
+			}
+		}
+	}
+
+	static bool isOpaque(const uint8_t* rgba, size_t pixelCount)
+	{
+		size_t i = 0;
+#ifdef EG_TEXTURE_COMPRESSOR_SSE2
+		const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+		for (; i + 4 <= pixelCount; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask)) != 0xFFFF)
+				return false;
+		}
+#endif
+		for (; i < pixelCount; i++)
+		{
+			if (rgba[i * 4 + 3] != 255)
+				return false;
+		}
+		return true;
+	}
+
+	//Blocks
+
+	//Edge texels are repeated into partial blocks so they don't bleed black
+	static void loadBlock(const Level& level, uint32_t bx, uint32_t by, uint8_t block[64])
+	{
+		uint32_t x = bx * 4;
+		uint32_t y = by * 4;
+		if (x + 4 <= level.width && y + 4 <= level.height)
+		{
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				std::memcpy(block + row * 16, level.pixels + (static_cast<size_t>(y + row) * level.width + x) * 4, 16);
+			}
+			return;
+		}
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				uint32_t srcX = std::min(x + column, level.width - 1);
+				uint32_t srcY = std::min(y + row, level.height - 1);
+				std::memcpy(&block[(row * 4 + column) * 4], level.pixels + (static_cast<size_t>(srcY) * level.width + srcX) * 4, 4);
+			}
+		}
+	}
+
+	static uint16_t to565(const uint8_t* color)
+	{
+		uint32_t r = (color[0] * 31 + 127) / 255;
+		uint32_t g = (color[1] * 63 + 127) / 255;
+		uint32_t b = (color[2] * 31 + 127) / 255;
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	static void from565(uint16_t color, uint8_t* out)
+	{
+		uint32_t r = (color >> 11) & 31;
+		uint32_t g = (color >> 5) & 63;
+		uint32_t b = color & 31;
+		out[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+		out[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+		out[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+		out[3] = 0;
+	}
+
+	//Range fit: endpoints are the inset corners of the color bounding box, every texel takes the closest of the 4 palette colors
+	static void encodeColorFast(const uint8_t block[64], uint8_t* out)
+	{
+		uint8_t minColor[4];
+		uint8_t maxColor[4];
+#ifdef EG_TEXTURE_COMPRESSOR_SSE2
+		__m128i pixels[4];
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			pixels[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+		}
+		__m128i low = _mm_min_epu8(_mm_min_epu8(pixels[0], pixels[1]), _mm_min_epu8(pixels[2], pixels[3]));
+		__m128i high = _mm_max_epu8(_mm_max_epu8(pixels[0], pixels[1]), _mm_max_epu8(pixels[2], pixels[3]));
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+		int32_t packedMin = _mm_cvtsi128_si32(low);
+		int32_t packedMax = _mm_cvtsi128_si32(high);
+		std::memcpy(minColor, &packedMin, 4);
+		std::memcpy(maxColor, &packedMax, 4);
+#else
+		std::memcpy(minColor, block, 4);
+		std::memcpy(maxColor, block, 4);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+				maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+			}
+		}
+#endif
+		//The box corners are rarely texels, pulling them in by 1/16 of the range lowers the error
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint8_t inset = static_cast<uint8_t>((maxColor[c] - minColor[c]) >> 4);
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		//Every channel of the maximum is at least the minimum's, so color0 >= color1 selects the 4 color mode
+		uint16_t color0 = to565(maxColor);
+		uint16_t color1 = to565(minColor);
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			uint8_t palette[4][4];
+			from565(color0, palette[0]);
+			from565(color1, palette[1]);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+#ifdef EG_TEXTURE_COMPRESSOR_SSE2
+			//4 texels per step, sum of absolute differences to every palette color
+			const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+			const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+			const __m128i lowWords = _mm_set1_epi32(0x0000FFFF);
+			__m128i colors[4];
+			for (uint32_t k = 0; k < 4; k++)
+			{
+				int32_t packed;
+				std::memcpy(&packed, palette[k], 4);
+				colors[k] = _mm_set1_epi32(packed);
+			}
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				__m128i texels = _mm_and_si128(pixels[i], rgbMask);
+				__m128i best = _mm_set1_epi32(INT32_MAX);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					__m128i diff = _mm_or_si128(_mm_subs_epu8(texels, colors[k]), _mm_subs_epu8(colors[k], texels));
+					__m128i sum = _mm_add_epi16(_mm_and_si128(diff, lowBytes), _mm_srli_epi16(diff, 8));
+					__m128i distance = _mm_add_epi32(_mm_and_si128(sum, lowWords), _mm_srli_epi32(sum, 16));
+					__m128i closer = _mm_cmplt_epi32(distance, best);
+					best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+					bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int32_t>(k))), _mm_andnot_si128(closer, bestIndex));
+				}
+				alignas(16) uint32_t lanes[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					indices |= lanes[lane] << ((i * 4 + lane) * 2);
+				}
+			}
+#else
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best = UINT32_MAX;
+				uint32_t bestIndex = 0;
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					uint32_t distance = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						distance += static_cast<uint32_t>(std::abs(block[i * 4 + c] - palette[k][c]));
+					}
+					if (distance < best)
+					{
+						best = distance;
+						bestIndex = k;
+					}
+				}
+				indices |= bestIndex << (i * 2);
+			}
+#endif
+		}
+
+		out[0] = static_cast<uint8_t>(color0);
+		out[1] = static_cast<uint8_t>(color0 >> 8);
+		out[2] = static_cast<uint8_t>(color1);
+		out[3] = static_cast<uint8_t>(color1 >> 8);
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+	}
+
+	//8 alpha mode between the inset alpha range, texels are snapped to the nearest step of the ramp
+	static void encodeAlphaFast(const uint8_t block[64], uint8_t* out)
+	{
+		uint8_t minAlpha = 255;
+		uint8_t maxAlpha = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			minAlpha = std::min(minAlpha, block[i * 4 + 3]);
+			maxAlpha = std::max(maxAlpha, block[i * 4 + 3]);
+		}
+		uint8_t inset = static_cast<uint8_t>((maxAlpha - minAlpha) >> 5);
+		minAlpha += inset;
+		maxAlpha -= inset;
+
+		uint64_t indices = 0;
+		uint32_t range = maxAlpha - minAlpha;
+		if (range > 0)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t alpha = std::clamp(block[i * 4 + 3], minAlpha, maxAlpha) - minAlpha;
+				uint32_t step = (alpha * 14 + range) / (range * 2); //0 is the minimum, 7 the maximum
+				uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+				indices |= index << (i * 3);
+			}
+		}
+
+		out[0] = maxAlpha;
+		out[1] = minAlpha;
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+	}
+
+	static void encodeBlock(Quality quality, bool alpha, const uint8_t block[64], uint8_t* out)
+	{
+		if (quality == Quality::Fast)
+		{
+			if (alpha)
+			{
+				encodeAlphaFast(block, out);
+				out += 8;
+			}
+			encodeColorFast(block, out);
+			return;
+		}
+		stb_compress_dxt_block(out, block, alpha ? 1 : 0, quality == Quality::High ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL);
+	}
+
+	void create()
+	{
+		sQualityCVar = Command::registerVar("eg::Data::TextureQuality", "None", static_cast<double>(Quality::Normal));
+		Command::registerFn("eg::Data::BenchmarkTextureCompression", [](size_t argc, char* argv[]) {
+			uint32_t size = 2048;
+			uint32_t iterations = 3;
+			try
+			{
+				if (argc > 1)
+					size = std::clamp(static_cast<uint32_t>(std::stoul(argv[1])), 4u, 16384u);
+				if (argc > 2)
+					iterations = std::max(static_cast<uint32_t>(std::stoul(argv[2])), 1u);
+			}
+			catch (...)
+			{
+				Logger::gError("Invalid arguments for eg::Data::BenchmarkTextureCompression");
+				return;
+			}
+			benchmark(size, iterations);
+			});
+	}
+
+	Quality getQuality()
+	{
+		if (sQualityCVar == nullptr)
+			return Quality::Normal;
+		return static_cast<Quality>(std::clamp(static_cast<int>(sQualityCVar->value), 0, 2));
+	}
+
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			levels++;
+		}
+		return levels;
+	}
+
+	CompressedImage compress(const uint8_t* rgba, uint32_t width, uint32_t height, Quality quality, uint32_t threadCount)
+	{
+		if (rgba == nullptr || width == 0 || height == 0)
+			throw std::runtime_error("TextureCompressor, empty image");
+
+		CompressedImage result;
+		result.width = width;
+		result.height = height;
+		result.mipLevels = getMipLevelCount(width, height);
+		const bool alpha = !isOpaque(rgba, static_cast<size_t>(width) * height);
+		result.format = alpha ? vk::Format::eBc3UnormBlock : vk::Format::eBc1RgbUnormBlock;
+		const size_t blockSize = alpha ? 16 : 8;
+
+		//Every level is filtered from the one above before any block is encoded
+		std::vector<std::vector<uint8_t>> mips(result.mipLevels - 1);
+		std::vector<Level> levels;
+		levels.reserve(result.mipLevels);
+		levels.push_back({ rgba, width, height, 0 });
+		for (uint32_t i = 1; i < result.mipLevels; i++)
+		{
+			const Level& previous = levels.back();
+			uint32_t levelWidth = std::max(previous.width / 2, 1u);
+			uint32_t levelHeight = std::max(previous.height / 2, 1u);
+			mips[i - 1].resize(static_cast<size_t>(levelWidth) * levelHeight * 4);
+			downsample(previous.pixels, previous.width, previous.height, mips[i - 1].data(), levelWidth, levelHeight);
+			levels.push_back({ mips[i - 1].data(), levelWidth, levelHeight, 0 });
+		}
+
+		//Tiles of every level go to one pool, small levels don't leave threads waiting
+		std::vector<Tile> tiles;
+		size_t dataSize = 0;
+		for (uint32_t i = 0; i < result.mipLevels; i++)
+		{
+			Level& level = levels[i];
+			uint32_t blocksX = (level.width + 3) / 4;
+			uint32_t blocksY = (level.height + 3) / 4;
+			level.offset = dataSize;
+			dataSize += static_cast<size_t>(blocksX) * blocksY * blockSize;
+			for (uint32_t row = 0; row < blocksY; row += ROWS_PER_TILE)
+			{
+				tiles.push_back({ i, row, std::min(ROWS_PER_TILE, blocksY - row) });
+			}
+		}
+		result.data.resize(dataSize);
+
+		uint32_t maxThreads = static_cast<uint32_t>(std::max<size_t>(dataSize / blockSize / MIN_BLOCKS_PER_THREAD, 1));
+		threadCount = threadCount == 0 ? maxThreads : std::min(threadCount, maxThreads);
+		//Shared workers, concurrent loads queue their tiles instead of each starting threads
+		Jobs::parallelFor(tiles.size(), threadCount, [&](size_t i) {
+			const Tile& tile = tiles[i];
+			const Level& level = levels[tile.level];
+			uint32_t blocksX = (level.width + 3) / 4;
+			uint8_t block[64];
+			for (uint32_t by = tile.firstRow; by < tile.firstRow + tile.rowCount; by++)
+			{
+				for (uint32_t bx = 0; bx < blocksX; bx++)
+				{
+					loadBlock(level, bx, by, block);
+					encodeBlock(quality, alpha, block,
+						result.data.data() + level.offset + (static_cast<size_t>(by) * blocksX + bx) * blockSize);
+				}
+			}
+			});
+		return result;
+	}
+
+	vk::Format getImageFormat(const tinygltf::Image& image)
+	{
+		//LoadImageData marks images without alpha as 3 component
+		return image.component == 3 ? vk::Format::eBc1RgbUnormBlock : vk::Format::eBc3UnormBlock;
+	}
+
+	uint32_t getImageMipLevels(const tinygltf::Image& image)
+	{
+		return getMipLevelCount(static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height));
+	}
+
+	void benchmark(uint32_t size, uint32_t iterations)
+	{
+		//Gradients with noise, the opaque copy takes the BC1 path
+		std::vector<uint8_t> translucent(static_cast<size_t>(size) * size * 4);
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint8_t* texel = &translucent[(static_cast<size_t>(y) * size + x) * 4];
+				texel[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(x * 255 / size) + noise(random), 0, 255));
+				texel[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(y * 255 / size) + noise(random), 0, 255));
+				texel[2] = static_cast<uint8_t>(std::clamp(static_cast<int>(((x / 16) ^ (y / 16)) & 1) * 160 + noise(random) + 48, 0, 255));
+				texel[3] = static_cast<uint8_t>((x + y) * 255 / (2 * size));
+			}
+		}
+		std::vector<uint8_t> opaque = translucent;
+		for (size_t i = 3; i < opaque.size(); i += 4)
+		{
+			opaque[i] = 255;
+		}
+
+		using Clock = std::chrono::high_resolution_clock;
+		const double megapixels = static_cast<double>(size) * size / 1e6;
+		auto report = [megapixels, iterations](const std::string& name, Clock::duration duration) {
+			double seconds = std::chrono::duration<double>(duration).count() / iterations;
+			Logger::gInfo("TextureCompressor " + name + ": " + std::to_string(megapixels / seconds) + " MPixels/s, "
+				+ std::to_string(seconds * 1000.0) + " ms");
+			};
+
+		//Previous LoadImageData path: top level only, one block at a time on the calling thread
+		{
+			auto start = Clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				Level level{ translucent.data(), size, size, 0 };
+				uint32_t blocks = (size + 3) / 4;
+				std::vector<uint8_t> compressed(static_cast<size_t>(blocks) * blocks * 16);
+				uint8_t block[64];
+				for (uint32_t by = 0; by < blocks; by++)
+				{
+					for (uint32_t bx = 0; bx < blocks; bx++)
+					{
+						loadBlock(level, bx, by, block);
+						stb_compress_dxt_block(&compressed[(static_cast<size_t>(by) * blocks + bx) * 16], block, 1, STB_DXT_NORMAL);
+					}
+				}
+			}
+			report("baseline, BC3 Normal, no mips, 1 thread", Clock::now() - start);
+		}
+
+		const char* qualityNames[] = { "Fast", "Normal", "High" };
+		for (const auto* source : { &opaque, &translucent })
+		{
+			for (uint32_t quality = 0; quality < 3; quality++)
+			{
+				for (uint32_t threads : { 1u, 0u })
+				{
+					auto start = Clock::now();
+					for (uint32_t i = 0; i < iterations; i++)
+					{
+						compress(source->data(), size, size, static_cast<Quality>(quality), threads);
+					}
+					report(std::string(source == &opaque ? "BC1 " : "BC3 ") + qualityNames[quality] + ", mips, "
+						+ (threads == 1 ? "1 thread" : "all threads"), Clock::now() - start);
+				}
+			}
+		}
+		Logger::gInfo("TextureCompressor: MPixels/s counts top level texels of a " + std::to_string(size) + "x" + std::to_string(size)
+			+ " image, mip levels are included in the time");
+	}
+}
@@ -212,7 +212,9 @@ namespace eg::Debug
 
 		ImGui::Begin("GameObjects");
 		uint32_t i = 0;
+		bool selectedFound = false;
 		for (auto& obj : World::getGameObjects()) {
+			selectedFound |= obj.get() == gSelectedObject;
 			ImGui::PushID(i++);
 			std::string label = std::to_string(i) + " | " + obj->getType();
 			if (ImGui::Selectable(label.c_str(), obj.get() == gSelectedObject)) {
@@ -220,6 +222,9 @@ namespace eg::Debug
 			}
 			ImGui::PopID();
 		}
+		//Selected object may have been streamed out
+		if (!selectedFound)
+			gSelectedObject = nullptr;
 		ImGui::End();
 
 		ImGui::Begin("Inspector");
@@ -274,6 +279,7 @@ namespace eg::Debug
 		
 		ImGui::End();
 		ImGui::Begin("World Debugger");
+		ImGui::Text("Objects: %zu, active: %zu", eg::World::getGameObjects().size(), eg::World::getActiveObjectCount());
 
 
 		// Button to open Load dialog
@@ -323,6 +329,7 @@ namespace eg::Debug
 		{
 			eg::Renderer::waitIdle();
 			eg::Command::execute("eg::Renderer::ReloadAllPipelines");
+			eg::Renderer::PipelineCache::wait();
 		}
 		//Render scale
 		{
@@ -364,6 +371,35 @@ namespace eg::Debug
 		}
 
 
+		ImGui::Separator();
+		//LOD statistics of the last recorded frame
+		if (ImGui::CollapsingHeader("LOD statistics"))
+		{
+			const auto& gBufferStats = eg::Components::LevelOfDetail::getStats(eg::Renderer::RenderStage::SUBPASS0_GBUFFER);
+			const auto& shadowStats = eg::Components::LevelOfDetail::getStats(eg::Renderer::RenderStage::SHADOW);
+			if (ImGui::BeginTable("LodStats", 5))
+			{
+				ImGui::TableSetupColumn("LOD");
+				ImGui::TableSetupColumn("Objects");
+				ImGui::TableSetupColumn("Draws");
+				ImGui::TableSetupColumn("Triangles");
+				ImGui::TableSetupColumn("Shadow triangles");
+				ImGui::TableHeadersRow();
+				for (uint32_t lod = 0; lod < eg::Components::LevelOfDetail::MAX_LOD_COUNT; lod++)
+				{
+					if (gBufferStats.objects[lod] == 0 && shadowStats.objects[lod] == 0)
+						continue;
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%u", lod);
+					ImGui::TableNextColumn(); ImGui::Text("%u", gBufferStats.objects[lod]);
+					ImGui::TableNextColumn(); ImGui::Text("%u", gBufferStats.drawCalls[lod]);
+					ImGui::TableNextColumn(); ImGui::Text("%u", gBufferStats.triangles[lod]);
+					ImGui::TableNextColumn(); ImGui::Text("%u", shadowStats.triangles[lod]);
+				}
+				ImGui::EndTable();
+			}
+		}
+
 		ImGui::Separator();
 		/*
 			glm::vec3 direction = { 1, -1, 0 };
@@ -0,0 +1,171 @@
+#include "Core.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <exception>
+
+#include "Logger.h"
+
+namespace eg::Jobs
+{
+	static std::mutex sMutex;
+	static std::condition_variable sCV;
+	static std::deque<Job> sJobs;
+	static std::vector<std::unique_ptr<std::thread>> sThreads;
+	static bool sRunning = false;
+	static Command::Var* sThreadCountCVar = nullptr;
+
+	//Outlives the call, helpers that start after every index ran still read it
+	struct ParallelFor
+	{
+		std::function<void(size_t)> task;
+		size_t count = 0;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::exception_ptr error; //First one a task threw, rethrown on the calling thread
+
+		void run()
+		{
+			for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+			{
+				try
+				{
+					task(i);
+				}
+				catch (...)
+				{
+					std::lock_guard lk(mutex);
+					if (!error)
+						error = std::current_exception();
+				}
+				if (done.fetch_add(1) + 1 == count)
+				{
+					std::lock_guard lk(mutex);
+					cv.notify_all();
+				}
+			}
+		}
+	};
+
+	static void threadFn()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				sCV.wait(lk, [] {
+					return !sJobs.empty() || !sRunning;
+					});
+				if (!sRunning)
+					break;
+				job = std::move(sJobs.front());
+				sJobs.pop_front();
+			}
+			try
+			{
+				job();
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError("Jobs: " + std::string(e.what()));
+			}
+		}
+	}
+
+	void create()
+	{
+		//0 starts a worker for every core the main thread doesn't use
+		sThreadCountCVar = Command::registerVar("eg::JobThreads", "None", 0.0);
+		uint32_t workerCount = static_cast<uint32_t>(std::max(sThreadCountCVar->value, 0.0));
+		if (workerCount == 0)
+			workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		std::lock_guard lk(sMutex);
+		sRunning = true;
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			sThreads.push_back(std::make_unique<std::thread>(threadFn));
+		}
+		Logger::gInfo("Jobs: " + std::to_string(workerCount) + " worker threads");
+	}
+
+	void destroy()
+	{
+		{
+			std::lock_guard lk(sMutex);
+			sRunning = false;
+			sCV.notify_all();
+		}
+		for (auto& thread : sThreads)
+		{
+			thread->join();
+		}
+		sThreads.clear();
+
+		std::deque<Job> jobs;
+		{
+			std::lock_guard lk(sMutex);
+			jobs.swap(sJobs);
+		}
+		for (auto& job : jobs)
+		{
+			job();
+		}
+	}
+
+	void push(Job&& job)
+	{
+		{
+			std::unique_lock lk(sMutex);
+			if (sRunning)
+			{
+				sJobs.push_back(std::move(job));
+				sCV.notify_one();
+				return;
+			}
+		}
+		job();
+	}
+
+	void parallelFor(size_t count, uint32_t maxThreads, const std::function<void(size_t)>& task)
+	{
+		if (count == 0)
+			return;
+		auto state = std::make_shared<ParallelFor>();
+		state->task = task;
+		state->count = count;
+
+		uint32_t helpers = getWorkerCount();
+		if (maxThreads != 0)
+			helpers = std::min(helpers, maxThreads - 1);
+		helpers = static_cast<uint32_t>(std::min<size_t>(helpers, count - 1));
+		for (uint32_t i = 0; i < helpers; i++)
+		{
+			push([state]() { state->run(); });
+		}
+
+		state->run();
+		std::unique_lock lk(state->mutex);
+		state->cv.wait(lk, [&state] {
+			return state->done == state->count;
+			});
+		if (state->error)
+			std::rethrow_exception(state->error);
+	}
+
+	uint32_t getWorkerCount()
+	{
+		std::lock_guard lk(sMutex);
+		return sRunning ? static_cast<uint32_t>(sThreads.size()) : 0;
+	}
+}
@@ -96,6 +96,7 @@ namespace eg::Physics
 	std::optional< ObjectLayerPairFilterImpl> gObjectVsObjectLayerFilter;
 	std::optional< PhysicsSystem> gPhysicsSystem;
 	BodyInterface* gBodyInterface = nullptr;
+	BodyActivationListener* gBodyActivationListener = nullptr;
 
 
 	const uint cMaxBodies = 65536;
@@ -126,6 +127,7 @@ namespace eg::Physics
 			gObjectVsBroadPhaseLayerFilter.value(),
 			gObjectVsObjectLayerFilter.value());
 
+		gPhysicsSystem->SetBodyActivationListener(gBodyActivationListener);
 		gBodyInterface = &gPhysicsSystem->GetBodyInterface();
 	}
 
@@ -150,6 +152,7 @@ namespace eg::Physics
 			gObjectVsBroadPhaseLayerFilter.value(),
 			gObjectVsObjectLayerFilter.value());
 
+		gPhysicsSystem->SetBodyActivationListener(gBodyActivationListener);
 		gBodyInterface = &gPhysicsSystem->GetBodyInterface();
 	}
 	void destroy()
@@ -165,6 +168,13 @@ namespace eg::Physics
 		Factory::sInstance = nullptr;
 	}
 
+	void setBodyActivationListener(JPH::BodyActivationListener* listener)
+	{
+		gBodyActivationListener = listener;
+		if (gPhysicsSystem)
+			gPhysicsSystem->SetBodyActivationListener(listener);
+	}
+
 	JPH::PhysicsSystem& getPhysicsSystem()
 	{
 		return *gPhysicsSystem;
@@ -2,6 +2,7 @@
 #include <Core.h>
 
 #include <random>
+#include <algorithm>
 
 #include <shaderc/shaderc.hpp>
 
@@ -71,14 +72,32 @@ namespace eg::Renderer::Atmosphere
 		Command::registerFn("eg::Renderer::ReloadAllPipelines",
 		[](size_t, char* []) {
 			destroyAllPipelines();
-			createAmbientLightPipeline(getGlobalDescriptorSet());
+			PipelineCache::build([]() { createAmbientLightPipeline(getGlobalDescriptorSet()); });
 			createDirectionalLightPipeline(getGlobalDescriptorSet());
 		});
 
 
-		createAmbientLightPipeline(getGlobalDescriptorSet());
+		HotReload::registerPipeline("Atmosphere ambient", []() { createAmbientLightPipeline(getGlobalDescriptorSet()); }, []() {
+			return HotReload::Build([pipeline = mAmbientPipeline, layout = mAmbientLayout, descLayout = mAmbientDescLayout, set = mAmbientSet]() {
+				getDevice().destroyPipeline(pipeline);
+				getDevice().destroyPipelineLayout(layout);
+				getDevice().destroyDescriptorSetLayout(descLayout);
+				auto poolLock = lockDescriptorPool();
+				getDevice().freeDescriptorSets(getDescriptorPool(), set);
+				});
+			});
 		createDirectionalShadowPass(shadowMapSize);
-		createDirectionalLightPipeline(getGlobalDescriptorSet());
+		//Built in place, the shadow pipelines of the models are laid out against its set layout
+		HotReload::registerPipeline("Atmosphere directional", []() { createDirectionalLightPipeline(getGlobalDescriptorSet()); }, []() {
+			std::vector<vk::DescriptorSet> sets(std::begin(mDirectionalSet), std::end(mDirectionalSet));
+			return HotReload::Build([pipeline = mDirectionalPipeline, layout = mDirectionalLayout, descLayout = mDirectionalDescLayout, sets]() {
+				getDevice().destroyPipeline(pipeline);
+				getDevice().destroyPipelineLayout(layout);
+				getDevice().destroyDescriptorSetLayout(descLayout);
+				auto poolLock = lockDescriptorPool();
+				getDevice().freeDescriptorSets(getDescriptorPool(), sets);
+				});
+			}, true);
 		
 	}
 	void destroy()
@@ -117,6 +136,7 @@ namespace eg::Renderer::Atmosphere
 
 	void destroyAllPipelines()
 	{
+		auto poolLock = lockDescriptorPool();
 		getDevice().destroyPipeline(mAmbientPipeline);
 		getDevice().destroyPipelineLayout(mAmbientLayout);
 		getDevice().destroyDescriptorSetLayout(mAmbientDescLayout);
@@ -380,6 +400,11 @@ namespace eg::Renderer::Atmosphere
 
 	void createAmbientLightPipeline(const vk::DescriptorSetLayout& globalSetLayout)
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet set;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -393,15 +418,18 @@ namespace eg::Renderer::Atmosphere
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mAmbientDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 
 		vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(mAmbientDescLayout);
-		mAmbientSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		{
+			auto poolLock = lockDescriptorPool();
+			set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 
 		
@@ -419,29 +447,29 @@ namespace eg::Renderer::Atmosphere
 			.setRange(sizeof(AmbientLightUniformBuffer));
 
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mAmbientSet, 0, 0,
+			vk::WriteDescriptorSet(set, 0, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[0]),
-			vk::WriteDescriptorSet(mAmbientSet, 1, 0,
+			vk::WriteDescriptorSet(set, 1, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[1]),
-			vk::WriteDescriptorSet(mAmbientSet, 2, 0,
+			vk::WriteDescriptorSet(set, 2, 0,
 				1,
 				vk::DescriptorType::eInputAttachment,
 				&imageInfos[2]),
 
-			vk::WriteDescriptorSet(mAmbientSet, 3, 0,
+			vk::WriteDescriptorSet(set, 3, 0,
 				1,
 				vk::DescriptorType::eCombinedImageSampler,
 				&imageInfos[3]),
 
-			vk::WriteDescriptorSet(mAmbientSet, 4, 0,
+			vk::WriteDescriptorSet(set, 4, 0,
 				1,
 				vk::DescriptorType::eUniformBuffer, {}, &bufferInfo),
 
-			vk::WriteDescriptorSet(mAmbientSet, 5, 0,
+			vk::WriteDescriptorSet(set, 5, 0,
 				1,
 				vk::DescriptorType::eCombinedImageSampler, &imageInfos[4]),
 
@@ -469,14 +497,14 @@ namespace eg::Renderer::Atmosphere
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			globalSetLayout, // Slot0
-			mAmbientDescLayout //Slot 1
+			descLayout //Slot 1
 		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRangeCount(0)
 			.setPPushConstantRanges(nullptr);
-		mAmbientLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -585,7 +613,7 @@ namespace eg::Renderer::Atmosphere
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mAmbientLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(DefaultRenderPass::getRenderPass())
 			.setSubpass(1)
 			.setBasePipelineHandle(nullptr)
@@ -602,22 +630,32 @@ namespace eg::Renderer::Atmosphere
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create AmbientLight pipeline !");
 		}
-		mAmbientPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mAmbientDescLayout = descLayout;
+		mAmbientSet = set;
+		mAmbientLayout = layout;
+		mAmbientPipeline = pipeline;
 	}
 
 	void createDirectionalLightPipeline(const vk::DescriptorSetLayout& globalSetLayout)
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -633,7 +671,7 @@ namespace eg::Renderer::Atmosphere
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mDirectionalDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 
 		//Allocate descriptor set right here
@@ -642,8 +680,9 @@ namespace eg::Renderer::Atmosphere
 			vk::DescriptorSetAllocateInfo ai{};
 			ai.setDescriptorPool(Renderer::getDescriptorPool())
 				.setDescriptorSetCount(1)
-				.setSetLayouts(mDirectionalDescLayout);
-			mDirectionalSet[i] = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+				.setSetLayouts(descLayout);
+			auto poolLock = lockDescriptorPool();
+			sets[i] = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
 		}
 
 		vk::DescriptorImageInfo imageInfos[] = {
@@ -664,27 +703,27 @@ namespace eg::Renderer::Atmosphere
 
 
 			Renderer::getDevice().updateDescriptorSets({
-				vk::WriteDescriptorSet(mDirectionalSet[i], 0, 0,
+				vk::WriteDescriptorSet(sets[i], 0, 0,
 					1,
 					vk::DescriptorType::eInputAttachment,
 					&imageInfos[0]),
-				vk::WriteDescriptorSet(mDirectionalSet[i], 1, 0,
+				vk::WriteDescriptorSet(sets[i], 1, 0,
 					1,
 					vk::DescriptorType::eInputAttachment,
 					&imageInfos[1]),
-				vk::WriteDescriptorSet(mDirectionalSet[i], 2, 0,
+				vk::WriteDescriptorSet(sets[i], 2, 0,
 					1,
 					vk::DescriptorType::eInputAttachment,
 					&imageInfos[2]),
-				vk::WriteDescriptorSet(mDirectionalSet[i], 3, 0,
+				vk::WriteDescriptorSet(sets[i], 3, 0,
 					1,
 					vk::DescriptorType::eInputAttachment,
 					&imageInfos[3]),
-				vk::WriteDescriptorSet(mDirectionalSet[i], 4, 0,
+				vk::WriteDescriptorSet(sets[i], 4, 0,
 					1,
 					vk::DescriptorType::eCombinedImageSampler,
 					&imageInfos[4]),
-				vk::WriteDescriptorSet(mDirectionalSet[i], 5, 0,
+				vk::WriteDescriptorSet(sets[i], 5, 0,
 					1,
 					vk::DescriptorType::eUniformBuffer,
 					nullptr,
@@ -711,14 +750,14 @@ namespace eg::Renderer::Atmosphere
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			globalSetLayout, // Slot0
-			mDirectionalDescLayout, //Slot 1
+			descLayout, //Slot 1
 		};
 		vk::PipelineLayoutCreateInfo pipelineLayoutCI{};
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRangeCount(0)
 			.setPPushConstantRanges(nullptr);
-		mDirectionalLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -823,7 +862,7 @@ namespace eg::Renderer::Atmosphere
 		dynamicStateCI.setDynamicStates(dynamicStates);
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mDirectionalLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(DefaultRenderPass::getRenderPass())
 			.setSubpass(1)
 			.setBasePipelineHandle(nullptr)
@@ -840,16 +879,21 @@ namespace eg::Renderer::Atmosphere
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create DirectionalLight pipeline !");
 		}
-		mDirectionalPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mDirectionalDescLayout = descLayout;
+		std::copy(std::begin(sets), std::end(sets), std::begin(mDirectionalSet));
+		mDirectionalLayout = layout;
+		mDirectionalPipeline = pipeline;
 	}
 
 	void createDirectionalShadowPass(uint32_t size)
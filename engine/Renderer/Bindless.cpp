@@ -0,0 +1,173 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+
+namespace eg::Renderer::Bindless
+{
+	//Slots freed by removal are handed out again before the array grows
+	struct SlotList
+	{
+		std::vector<uint32_t> free;
+		uint32_t next = 0;
+		uint32_t capacity = 0;
+
+		uint32_t take(const char* name)
+		{
+			if (!free.empty())
+			{
+				uint32_t index = free.back();
+				free.pop_back();
+				return index;
+			}
+			if (next == capacity)
+				throw std::runtime_error(std::string("Bindless: out of ") + name + " slots !");
+			return next++;
+		}
+
+		uint32_t used() const { return next - static_cast<uint32_t>(free.size()); }
+	};
+
+	static constexpr uint32_t MAX_TEXTURES = 16384;
+	static constexpr uint32_t MAX_MATERIALS = 65536;
+
+	static vk::DescriptorPool sPool;
+	static vk::DescriptorSetLayout sLayout;
+	static vk::DescriptorSet sSet;
+	static std::optional<CPUBuffer> sMaterialBuffer;
+	static std::mutex sMutex;
+	static SlotList sTextures;
+	static SlotList sMaterials;
+
+	void create()
+	{
+		//The whole array is counted against the update after bind limits of a single stage
+		auto properties = getPhysicalDevice().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+		const auto& vulkan12Properties = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+		sTextures.capacity = std::min({ MAX_TEXTURES,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages });
+		sMaterials.capacity = MAX_MATERIALS;
+
+		Command::registerFn("eg::Renderer::PrintBindlessStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("Bindless: " + std::to_string(stats.textures) + " / " + std::to_string(stats.textureCapacity) + " textures, "
+				+ std::to_string(stats.materials) + " / " + std::to_string(stats.materialCapacity) + " materials");
+			});
+
+		vk::DescriptorBindingFlags bindingFlags[] =
+		{
+			vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind
+				| vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending, //textures
+			vk::DescriptorBindingFlagBits::eUpdateAfterBind //materials
+		};
+		vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{};
+		bindingFlagsCI.setBindingFlags(bindingFlags);
+
+		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
+		{
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, sTextures.capacity, vk::ShaderStageFlagBits::eFragment, {}),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment, {})
+		};
+		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
+		descLayoutCI.setBindings(descLayoutBindings)
+			.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+			.setPNext(&bindingFlagsCI);
+		sLayout = getDevice().createDescriptorSetLayout(descLayoutCI);
+
+		vk::DescriptorPoolSize poolSizes[] =
+		{
+			vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, sTextures.capacity},
+			vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 1}
+		};
+		vk::DescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.setPoolSizes(poolSizes)
+			.setMaxSets(1)
+			.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+		sPool = getDevice().createDescriptorPool(descriptorPoolCI);
+
+		vk::DescriptorSetAllocateInfo ai{};
+		ai.setDescriptorPool(sPool)
+			.setSetLayouts(sLayout);
+		sSet = getDevice().allocateDescriptorSets(ai).at(0);
+
+		sMaterialBuffer.emplace(nullptr, MAX_MATERIALS * sizeof(Material), vk::BufferUsageFlagBits::eStorageBuffer);
+		vk::DescriptorBufferInfo bufferInfo(sMaterialBuffer->getBuffer(), 0, VK_WHOLE_SIZE);
+		getDevice().updateDescriptorSets({
+			vk::WriteDescriptorSet(sSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfo, nullptr, nullptr)
+			}, {});
+
+		Logger::gInfo("Bindless: " + std::to_string(sTextures.capacity) + " texture slots, " + std::to_string(sMaterials.capacity) + " material slots");
+	}
+
+	void destroy()
+	{
+		getDevice().destroyDescriptorPool(sPool);
+		getDevice().destroyDescriptorSetLayout(sLayout);
+		sMaterialBuffer.reset();
+		sTextures = {};
+		sMaterials = {};
+	}
+
+	uint32_t addTexture(vk::ImageView view, vk::Sampler sampler)
+	{
+		std::lock_guard lock(sMutex);
+		uint32_t index = sTextures.take("texture");
+		vk::DescriptorImageInfo imageInfo(sampler, view, vk::ImageLayout::eShaderReadOnlyOptimal);
+		getDevice().updateDescriptorSets({
+			vk::WriteDescriptorSet(sSet, 0, index, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo, nullptr, nullptr, nullptr)
+			}, {});
+		return index;
+	}
+
+	void removeTexture(uint32_t index)
+	{
+		if (index == INVALID_INDEX)
+			return;
+		//Partially bound, the stale descriptor is never read before the slot is written again
+		std::lock_guard lock(sMutex);
+		sTextures.free.push_back(index);
+	}
+
+	uint32_t addMaterial(const Material& material)
+	{
+		std::lock_guard lock(sMutex);
+		uint32_t index = sMaterials.take("material");
+		std::memcpy(static_cast<Material*>(sMaterialBuffer->getInfo().pMappedData) + index, &material, sizeof(Material));
+		return index;
+	}
+
+	void removeMaterial(uint32_t index)
+	{
+		if (index == INVALID_INDEX)
+			return;
+		std::lock_guard lock(sMutex);
+		sMaterials.free.push_back(index);
+	}
+
+	vk::DescriptorSetLayout getLayout()
+	{
+		return sLayout;
+	}
+
+	vk::DescriptorSet getSet()
+	{
+		return sSet;
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lock(sMutex);
+		Stats stats;
+		stats.textures = sTextures.used();
+		stats.textureCapacity = sTextures.capacity;
+		stats.materials = sMaterials.used();
+		stats.materialCapacity = sMaterials.capacity;
+		return stats;
+	}
+}
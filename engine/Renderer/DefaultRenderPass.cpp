@@ -270,9 +270,9 @@ namespace eg::Renderer::DefaultRenderPass
 			vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}),
 		};
 
-		Command::Var* renderScaleCVar = Command::findVar("eg::Renderer::ScreenRenderScale");
-		Command::Var* widthCVar = Command::findVar("eg::Renderer::ScreenWidth");
-		Command::Var* heightCVar = Command::findVar("eg::Renderer::ScreenHeight");
+		static Command::Var* renderScaleCVar = Command::findVar("eg::Renderer::ScreenRenderScale");
+		static Command::Var* widthCVar = Command::findVar("eg::Renderer::ScreenWidth");
+		static Command::Var* heightCVar = Command::findVar("eg::Renderer::ScreenHeight");
 
 
 		uint32_t scaledWidth = static_cast<uint32_t>(widthCVar->value * renderScaleCVar->value);
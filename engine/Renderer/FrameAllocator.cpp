@@ -0,0 +1,241 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <cstdlib>
+
+//Debug builds count heap allocations made inside a FrameAllocator::CountScope, a steady frame should make none.
+//Only the plain forms are replaced, array and nothrow new go through them and aligned new is left alone
+#ifndef NDEBUG
+static thread_local bool tCountAllocations = false;
+static std::atomic<uint32_t> sHeapAllocations = 0;
+
+void* operator new(size_t size)
+{
+	if (tCountAllocations)
+		sHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* data = std::malloc(size == 0 ? 1 : size))
+		return data;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* data) noexcept
+{
+	std::free(data);
+}
+
+void operator delete(void* data, size_t) noexcept
+{
+	std::free(data);
+}
+#endif
+
+namespace eg::Renderer::FrameAllocator
+{
+	struct Ring
+	{
+		std::optional<CPUBuffer> buffer;
+		std::atomic<vk::DeviceSize> offset = 0;
+	};
+
+	static std::unique_ptr<std::byte[]> sArena;
+	static size_t sArenaCapacity = 0;
+	static std::atomic<size_t> sArenaOffset = 0;
+	//Scratch that didn't fit the arena, freed with it
+	static std::mutex sOverflowMutex;
+	static std::vector<std::unique_ptr<std::byte[]>> sOverflow;
+	static std::atomic<uint32_t> sHeapFallbacks = 0;
+
+	static Ring sRings[MAX_FRAMES_IN_FLIGHT];
+	static vk::DeviceSize sRingCapacity = 0;
+	static vk::DeviceSize sRingAlignment = 256;
+	static std::atomic<uint32_t> sGPUFailures = 0;
+	static uint32_t sCurrentRing = 0;
+
+	static Stats sLastStats;
+	static Command::Var* sArenaSizeCVar = nullptr;
+	static Command::Var* sRingSizeCVar = nullptr;
+
+	//CheckFrameAllocations, frames left to sum and what they allocated
+	static uint32_t sCheckFramesLeft = 0;
+	static uint32_t sCheckFrames = 0;
+	static uint64_t sCheckAllocations = 0;
+	static uint32_t sCheckWorstFrame = 0;
+
+	CountScope::CountScope()
+	{
+#ifndef NDEBUG
+		mPrevious = tCountAllocations;
+		tCountAllocations = true;
+#else
+		mPrevious = false;
+#endif
+	}
+
+	CountScope::~CountScope()
+	{
+#ifndef NDEBUG
+		tCountAllocations = mPrevious;
+#endif
+	}
+
+	static void checkFrame(uint32_t allocations)
+	{
+		if (sCheckFramesLeft == 0)
+			return;
+		//The frame the command ran in is skipped, it was already underway
+		if (sCheckFramesLeft-- > sCheckFrames)
+			return;
+		sCheckAllocations += allocations;
+		sCheckWorstFrame = std::max(sCheckWorstFrame, allocations);
+		if (sCheckFramesLeft != 0)
+			return;
+
+		if (sCheckAllocations == 0)
+		{
+			Logger::gInfo("FrameAllocator: no heap allocations over " + std::to_string(sCheckFrames) + " frames");
+			return;
+		}
+		Logger::gError("FrameAllocator: " + std::to_string(sCheckAllocations) + " heap allocations over " + std::to_string(sCheckFrames)
+			+ " frames, worst frame made " + std::to_string(sCheckWorstFrame));
+	}
+
+	//Bumps offset by an aligned size, returns the aligned start or nothing when it would pass capacity
+	template<typename T>
+	static std::optional<T> bump(std::atomic<T>& offset, T size, T alignment, T capacity)
+	{
+		T current = offset.load();
+		while (true)
+		{
+			T start = (current + alignment - 1) / alignment * alignment;
+			if (start + size > capacity)
+				return std::nullopt;
+			if (offset.compare_exchange_weak(current, start + size))
+				return start;
+		}
+	}
+
+	void create()
+	{
+		sArenaSizeCVar = Command::registerVar("eg::Renderer::FrameScratchMB", "None", 4.0);
+		sRingSizeCVar = Command::registerVar("eg::Renderer::FrameRingMB", "None", 16.0);
+		Command::registerFn("eg::Renderer::PrintFrameAllocatorStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("FrameAllocator: scratch " + std::to_string(stats.cpuUsed / 1024) + " / " + std::to_string(stats.cpuCapacity / 1024)
+				+ " KB, ring " + std::to_string(stats.gpuUsed / 1024) + " / " + std::to_string(stats.gpuCapacity / 1024) + " KB, "
+				+ std::to_string(stats.heapFallbacks) + " heap fallbacks, " + std::to_string(stats.gpuFailures) + " ring failures, "
+				+ std::to_string(stats.heapAllocations) + " heap allocations");
+			});
+		//Fails unless the next frames render without a single operator new, run once the world is streamed in
+		Command::registerFn("eg::Renderer::CheckFrameAllocations", [](size_t argc, char* argv[]) {
+#ifdef NDEBUG
+			Logger::gWarn("eg::Renderer::CheckFrameAllocations needs a debug build");
+#else
+			uint32_t frames = 100;
+			try
+			{
+				if (argc > 1)
+					frames = std::max(static_cast<uint32_t>(std::stoul(argv[1])), 1u);
+			}
+			catch (...)
+			{
+				Logger::gError("Invalid arguments for eg::Renderer::CheckFrameAllocations");
+				return;
+			}
+			sCheckFrames = frames;
+			sCheckFramesLeft = frames + 1;
+			sCheckAllocations = 0;
+			sCheckWorstFrame = 0;
+#endif
+			});
+
+		sArenaCapacity = static_cast<size_t>(std::max(sArenaSizeCVar->value, 1.0)) * 1024 * 1024;
+		sArena = std::make_unique<std::byte[]>(sArenaCapacity);
+
+		//Vertex data shares the ring, its offsets only need the uniform alignment
+		sRingAlignment = std::max<vk::DeviceSize>(getPhysicalDevice().getProperties().limits.minUniformBufferOffsetAlignment, 16);
+		sRingCapacity = static_cast<vk::DeviceSize>(std::max(sRingSizeCVar->value, 1.0)) * 1024 * 1024;
+		for (auto& ring : sRings)
+		{
+			ring.buffer.emplace(nullptr, sRingCapacity,
+				vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+			ring.offset = 0;
+		}
+	}
+
+	void destroy()
+	{
+		for (auto& ring : sRings)
+		{
+			ring.buffer.reset();
+		}
+		sOverflow.clear();
+		sArena.reset();
+	}
+
+	void beginFrame()
+	{
+		sLastStats.cpuUsed = sArenaOffset.load();
+		sLastStats.cpuCapacity = sArenaCapacity;
+		sLastStats.gpuUsed = sRings[sCurrentRing].offset.load();
+		sLastStats.gpuCapacity = sRingCapacity;
+		sLastStats.heapFallbacks = sHeapFallbacks.exchange(0);
+		sLastStats.gpuFailures = sGPUFailures.exchange(0);
+#ifndef NDEBUG
+		sLastStats.heapAllocations = sHeapAllocations.exchange(0);
+#endif
+		checkFrame(sLastStats.heapAllocations);
+
+		sArenaOffset = 0;
+		{
+			std::lock_guard lock(sOverflowMutex);
+			sOverflow.clear();
+		}
+		sCurrentRing = getCurrentFrameIndex();
+		sRings[sCurrentRing].offset = 0;
+	}
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		if (auto offset = bump<size_t>(sArenaOffset, size, alignment, sArenaCapacity))
+			return sArena.get() + *offset;
+
+		//Operator new aligns to max_align_t, which covers everything handed out here
+		sHeapFallbacks++;
+		std::lock_guard lock(sOverflowMutex);
+		sOverflow.push_back(std::make_unique<std::byte[]>(size));
+		return sOverflow.back().get();
+	}
+
+	GPUAllocation allocateGPU(vk::DeviceSize size)
+	{
+		Ring& ring = sRings[sCurrentRing];
+		auto offset = bump<vk::DeviceSize>(ring.offset, size, sRingAlignment, sRingCapacity);
+		if (!offset)
+		{
+			sGPUFailures++;
+			return {};
+		}
+
+		GPUAllocation allocation;
+		allocation.buffer = ring.buffer->getBuffer();
+		allocation.offset = *offset;
+		allocation.data = static_cast<std::byte*>(ring.buffer->getInfo().pMappedData) + *offset;
+		return allocation;
+	}
+
+	vk::Buffer getGPUBuffer(uint32_t frameIndex)
+	{
+		return sRings[frameIndex].buffer->getBuffer();
+	}
+
+	Stats getStats()
+	{
+		return sLastStats;
+	}
+}
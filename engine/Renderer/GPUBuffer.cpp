@@ -5,35 +5,17 @@ namespace eg::Renderer
 	//VertexBuffer constructor
 	GPUBuffer::GPUBuffer(void* data, size_t dataSize, vk::BufferUsageFlags usage)
 	{
-		//Create vertex buffer
-		vma::AllocationInfo info;
-
-		//Create staging
-		auto [stagingBuffer, stagingAllocation] = getAllocator().createBuffer(
-			vk::BufferCreateInfo{
-				{},
-				dataSize,
-				vk::BufferUsageFlagBits::eTransferSrc,
-			},
-			vma::AllocationCreateInfo{
-				vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-				vma::MemoryUsage::eAutoPreferHost,
-			},
-			info
-		);
-
-		if (data)
-		{
-			std::memcpy(info.pMappedData, data, dataSize);
-		}
+		//Shared with the transfer queue when it has its own family, no ownership transfer needed
+		std::vector<uint32_t> queueFamilies = Upload::getSharedQueueFamilies();
+		vk::BufferCreateInfo bufferCI{};
+		bufferCI.setSize(dataSize)
+			.setUsage(usage | vk::BufferUsageFlagBits::eTransferDst)
+			.setSharingMode(queueFamilies.empty() ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent)
+			.setQueueFamilyIndices(queueFamilies);
 
 		//Create vertex buffer
 		auto [buffer, allocation] = getAllocator().createBuffer(
-			vk::BufferCreateInfo{
-				{},
-				dataSize,
-				usage | vk::BufferUsageFlagBits::eTransferDst,
-			},
+			bufferCI,
 			vma::AllocationCreateInfo{
 				{},
 				vma::MemoryUsage::eAutoPreferDevice,
@@ -43,21 +25,24 @@ namespace eg::Renderer
 		this->mBuffer = buffer;
 		this->mAllocation = allocation;
 
-		//Copy staging to vertex buffer
-		immediateSubmit([&](vk::CommandBuffer cmd)
-			{
-				vk::BufferCopy copyRegion{};
-				copyRegion.setSize(dataSize);
-				cmd.copyBuffer(stagingBuffer, buffer, copyRegion);
-			});
-		getAllocator().destroyBuffer(stagingBuffer, stagingAllocation);
-
+		//Copy is batched, it lands before the next frame runs
+		if (data)
+		{
+			mUploadTicket = Upload::copyToBuffer(buffer, 0, data, dataSize);
+		}
 	}
 
 	//VertexBuffer destructor
 	GPUBuffer::~GPUBuffer()
 	{
+		//The copy may still be pending
+		Upload::wait(mUploadTicket);
 		getAllocator().destroyBuffer(this->mBuffer, this->mAllocation);
 	}
 
-}
\ No newline at end of file
+	vk::DeviceSize GPUBuffer::getAllocationSize() const
+	{
+		return mAllocation ? getAllocator().getAllocationInfo(mAllocation).size : 0;
+	}
+
+}
@@ -0,0 +1,215 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <map>
+#include <memory>
+
+namespace eg::Renderer::GeometryPool
+{
+	//First fit over the free ranges of a block, neighbours are merged when a range is released
+	class RangeList
+	{
+	private:
+		std::map<uint32_t, uint32_t> mFree; //Offset, count
+	public:
+		RangeList(uint32_t capacity)
+		{
+			mFree.emplace(0, capacity);
+		}
+
+		std::optional<uint32_t> allocate(uint32_t count)
+		{
+			if (count == 0)
+				return 0;
+			for (auto it = mFree.begin(); it != mFree.end(); ++it)
+			{
+				if (it->second < count)
+					continue;
+				uint32_t offset = it->first;
+				uint32_t remaining = it->second - count;
+				mFree.erase(it);
+				if (remaining > 0)
+					mFree.emplace(offset + count, remaining);
+				return offset;
+			}
+			return std::nullopt;
+		}
+
+		void release(uint32_t offset, uint32_t count)
+		{
+			if (count == 0)
+				return;
+			auto next = mFree.lower_bound(offset);
+			if (next != mFree.begin())
+			{
+				auto prev = std::prev(next);
+				if (prev->first + prev->second == offset)
+				{
+					offset = prev->first;
+					count += prev->second;
+					mFree.erase(prev);
+				}
+			}
+			if (next != mFree.end() && offset + count == next->first)
+			{
+				count += next->second;
+				mFree.erase(next);
+			}
+			mFree.emplace(offset, count);
+		}
+	};
+
+	struct Block
+	{
+		GPUBuffer vertexBuffer;
+		GPUBuffer indexBuffer;
+		RangeList vertices;
+		RangeList indices;
+		uint32_t vertexCapacity;
+		uint32_t indexCapacity;
+	};
+
+	static std::mutex sMutex;
+	//Blocks are only released by destroy, meshes keep the raw buffer handles
+	static std::vector<std::unique_ptr<Block>> sBlocks;
+	static Stats sStats;
+	static Command::Var* sBlockSizeCVar = nullptr;
+
+	static Block& allocate(uint32_t vertexCount, uint32_t indexCount,
+		uint32_t& blockIndex, uint32_t& firstVertex, uint32_t& firstIndex)
+	{
+		std::lock_guard lock(sMutex);
+		for (uint32_t i = 0; i < sBlocks.size(); i++)
+		{
+			Block& block = *sBlocks[i];
+			auto vertexOffset = block.vertices.allocate(vertexCount);
+			if (!vertexOffset)
+				continue;
+			auto indexOffset = block.indices.allocate(indexCount);
+			if (!indexOffset)
+			{
+				block.vertices.release(*vertexOffset, vertexCount);
+				continue;
+			}
+			blockIndex = i;
+			firstVertex = *vertexOffset;
+			firstIndex = *indexOffset;
+			sStats.allocations++;
+			sStats.used += vertexCount * sizeof(Vertex) + indexCount * sizeof(Index);
+			return block;
+		}
+
+		//Every block is full, meshes larger than a block get one of their own size
+		size_t blockSize = static_cast<size_t>(std::max(sBlockSizeCVar ? sBlockSizeCVar->value : 64.0, 1.0)) * 1024 * 1024;
+		uint32_t vertexCapacity = std::max(static_cast<uint32_t>(blockSize / sizeof(Vertex)), vertexCount);
+		uint32_t indexCapacity = std::max(static_cast<uint32_t>(blockSize / sizeof(Index)), indexCount);
+		sBlocks.push_back(std::unique_ptr<Block>(new Block{
+			GPUBuffer(nullptr, vertexCapacity * sizeof(Vertex), vk::BufferUsageFlagBits::eVertexBuffer),
+			GPUBuffer(nullptr, indexCapacity * sizeof(Index), vk::BufferUsageFlagBits::eIndexBuffer),
+			RangeList(vertexCapacity),
+			RangeList(indexCapacity),
+			vertexCapacity,
+			indexCapacity
+			}));
+		Block& block = *sBlocks.back();
+		blockIndex = static_cast<uint32_t>(sBlocks.size() - 1);
+		firstVertex = *block.vertices.allocate(vertexCount);
+		firstIndex = *block.indices.allocate(indexCount);
+
+		sStats.blocks++;
+		sStats.allocations++;
+		sStats.capacity += vertexCapacity * sizeof(Vertex) + indexCapacity * sizeof(Index);
+		sStats.used += vertexCount * sizeof(Vertex) + indexCount * sizeof(Index);
+		Logger::gInfo("GeometryPool: block " + std::to_string(blockIndex) + " created, "
+			+ std::to_string(vertexCapacity) + " vertices, " + std::to_string(indexCapacity) + " indices");
+		return block;
+	}
+
+	static void release(uint32_t blockIndex, uint32_t firstVertex, uint32_t vertexCount, uint32_t firstIndex, uint32_t indexCount)
+	{
+		std::lock_guard lock(sMutex);
+		if (blockIndex >= sBlocks.size())
+			return;
+		sBlocks[blockIndex]->vertices.release(firstVertex, vertexCount);
+		sBlocks[blockIndex]->indices.release(firstIndex, indexCount);
+		sStats.allocations--;
+		sStats.used -= vertexCount * sizeof(Vertex) + indexCount * sizeof(Index);
+	}
+
+	void create()
+	{
+		sBlockSizeCVar = Command::registerVar("eg::Renderer::GeometryBlockMB", "None", 64.0);
+		Command::registerFn("eg::Renderer::PrintGeometryPoolStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("GeometryPool: " + std::to_string(stats.blocks) + " blocks, " + std::to_string(stats.allocations)
+				+ " meshes, " + std::to_string(stats.used / (1024 * 1024)) + " / " + std::to_string(stats.capacity / (1024 * 1024)) + " MB used");
+			});
+	}
+
+	void destroy()
+	{
+		std::lock_guard lock(sMutex);
+		if (sStats.allocations > 0)
+		{
+			Logger::gWarn("GeometryPool: " + std::to_string(sStats.allocations) + " meshes still alive at shutdown");
+		}
+		sBlocks.clear();
+		sStats = {};
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lock(sMutex);
+		return sStats;
+	}
+}
+
+namespace eg::Renderer
+{
+	MeshBuffer::MeshBuffer(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, uint32_t vertexCount,
+		const void* indices, uint32_t indexCount, vk::IndexType indexType)
+	{
+		std::vector<GeometryPool::Vertex> vertices(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			vertices[i] = { positions[i], normals[i], uvs[i] };
+		}
+
+		std::vector<GeometryPool::Index> widenedIndices;
+		const GeometryPool::Index* indexData = static_cast<const GeometryPool::Index*>(indices);
+		if (indexType == vk::IndexType::eUint16)
+		{
+			const uint16_t* shortIndices = static_cast<const uint16_t*>(indices);
+			widenedIndices.assign(shortIndices, shortIndices + indexCount);
+			indexData = widenedIndices.data();
+		}
+
+		GeometryPool::Block& block = GeometryPool::allocate(vertexCount, indexCount, mBlock, mFirstVertex, mFirstIndex);
+		mVertexBuffer = block.vertexBuffer.getBuffer();
+		mIndexBuffer = block.indexBuffer.getBuffer();
+		mVertexCount = vertexCount;
+		mIndexCount = indexCount;
+
+		//Both copies go into the open upload batch, so the later ticket covers the two
+		Upload::Ticket vertexTicket = Upload::copyToBuffer(mVertexBuffer, mFirstVertex * sizeof(GeometryPool::Vertex),
+			vertices.data(), vertices.size() * sizeof(GeometryPool::Vertex));
+		Upload::Ticket indexTicket = Upload::copyToBuffer(mIndexBuffer, mFirstIndex * sizeof(GeometryPool::Index),
+			indexData, static_cast<size_t>(indexCount) * sizeof(GeometryPool::Index));
+		mUploadTicket = std::max(vertexTicket, indexTicket);
+	}
+
+	MeshBuffer::~MeshBuffer()
+	{
+		if (mBlock == std::numeric_limits<uint32_t>::max())
+			return;
+		//The range can't be handed out again while its copy is pending
+		Upload::wait(mUploadTicket);
+		GeometryPool::release(mBlock, mFirstVertex, mVertexCount, mFirstIndex, mIndexCount);
+	}
+
+	vk::DeviceSize MeshBuffer::getAllocationSize() const
+	{
+		return mVertexCount * sizeof(GeometryPool::Vertex) + mIndexCount * sizeof(GeometryPool::Index);
+	}
+}
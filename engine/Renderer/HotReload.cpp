@@ -0,0 +1,359 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <unordered_map>
+#endif
+
+namespace eg::Renderer::HotReload
+{
+	using Defines = std::vector<std::pair<std::string, std::string>>;
+	using Clock = std::chrono::high_resolution_clock;
+
+	//Editors write a file in several steps, changes closer together than this are handled at once
+	static constexpr auto SETTLE_TIME = std::chrono::milliseconds(50);
+	static constexpr int POLL_TIMEOUT_MS = 100;
+
+	struct Shader
+	{
+		std::string path;
+		uint32_t kind;
+		Defines defines;
+	};
+
+	struct Unit
+	{
+		std::string name;
+		Build create;
+		Detach detach;
+		bool inPlace;
+		std::vector<Shader> shaders;
+		std::unordered_set<std::string> files; //Sources and includes
+	};
+
+	static std::string normalize(const std::string& path)
+	{
+		return std::filesystem::path(path).lexically_normal().generic_string();
+	}
+
+#ifdef __linux__
+	class Watcher
+	{
+	private:
+		std::string mDirectory;
+		int mFd = -1;
+	public:
+		Watcher(const std::string& directory) : mDirectory(directory)
+		{
+			mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (mFd < 0)
+				throw std::runtime_error("HotReload: inotify_init1 failed !");
+			//Editors that save through a temporary file rename it over the source
+			if (inotify_add_watch(mFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+			{
+				close(mFd);
+				throw std::runtime_error("HotReload: can't watch " + directory);
+			}
+		}
+		~Watcher()
+		{
+			close(mFd);
+		}
+
+		void poll(int timeoutMs, std::vector<std::string>& changed)
+		{
+			pollfd pollFd{ mFd, POLLIN, 0 };
+			if (::poll(&pollFd, 1, timeoutMs) <= 0)
+				return;
+			alignas(inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(mFd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* event = buffer; event < buffer + length;)
+				{
+					const inotify_event* header = reinterpret_cast<const inotify_event*>(event);
+					if (header->len > 0)
+						changed.push_back(normalize(mDirectory + "/" + header->name));
+					event += sizeof(inotify_event) + header->len;
+				}
+			}
+		}
+	};
+#else
+	//Compares modification times, the directory only holds a few dozen files
+	class Watcher
+	{
+	private:
+		std::string mDirectory;
+		std::unordered_map<std::string, std::filesystem::file_time_type> mWriteTimes;
+
+		void scan(std::vector<std::string>* changed)
+		{
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(mDirectory, error))
+			{
+				if (!entry.is_regular_file(error))
+					continue;
+				auto writeTime = entry.last_write_time(error);
+				if (error)
+					continue;
+				std::string path = normalize(entry.path().string());
+				auto it = mWriteTimes.find(path);
+				if (it == mWriteTimes.end() || it->second != writeTime)
+				{
+					mWriteTimes[path] = writeTime;
+					if (changed)
+						changed->push_back(path);
+				}
+			}
+		}
+	public:
+		Watcher(const std::string& directory) : mDirectory(directory)
+		{
+			if (!std::filesystem::is_directory(directory))
+				throw std::runtime_error("HotReload: can't watch " + directory);
+			scan(nullptr);
+		}
+
+		void poll(int timeoutMs, std::vector<std::string>& changed)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+			scan(&changed);
+		}
+	};
+#endif
+
+	static std::mutex sMutex;
+	static std::vector<std::unique_ptr<Unit>> sUnits;
+	static std::vector<Unit*> sReady; //Compiled, rebuilt by the next update
+	static std::vector<Build> sReplaced; //Objects of rebuilt pipelines, retired by the next update
+	static Stats sStats;
+	static thread_local Unit* tBuilding = nullptr;
+
+	static std::unique_ptr<std::thread> sThread;
+	static std::atomic<bool> sRunning = false;
+	static Command::Var* sEnabledCVar = nullptr;
+
+	//A build that throws keeps the shaders and files recorded by the last one, they are still watched
+	static void build(Unit& unit)
+	{
+		std::vector<Shader> shaders;
+		std::unordered_set<std::string> files;
+		{
+			std::lock_guard lock(sMutex);
+			shaders.swap(unit.shaders);
+			files.swap(unit.files);
+		}
+		tBuilding = &unit;
+		try
+		{
+			unit.create();
+		}
+		catch (...)
+		{
+			tBuilding = nullptr;
+			std::lock_guard lock(sMutex);
+			unit.shaders.swap(shaders);
+			unit.files.swap(files);
+			throw;
+		}
+		tBuilding = nullptr;
+	}
+
+	//Never throws, a bad save must not end the game through PipelineCache::wait
+	static void rebuild(Unit& unit, Build&& replaced)
+	{
+		try
+		{
+			build(unit);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("HotReload: " + unit.name + " keeps its pipelines, " + e.what());
+			std::lock_guard lock(sMutex);
+			sStats.failures++;
+			return;
+		}
+		std::lock_guard lock(sMutex);
+		sReplaced.push_back(std::move(replaced));
+		sStats.reloads++;
+	}
+
+	//Watcher thread, compiles every shader of the affected pipelines before any of them is touched
+	static void recompile(const std::vector<std::string>& changed)
+	{
+		std::vector<std::pair<Unit*, std::vector<Shader>>> affected;
+		{
+			std::lock_guard lock(sMutex);
+			for (const auto& unit : sUnits)
+			{
+				if (std::any_of(changed.begin(), changed.end(), [&](const std::string& path) { return unit->files.count(path) > 0; }))
+					affected.push_back({ unit.get(), unit->shaders });
+			}
+		}
+
+		for (const auto& [unit, shaders] : affected)
+		{
+			auto start = Clock::now();
+			try
+			{
+				for (const auto& shader : shaders)
+				{
+					compileShaderFromFile(shader.path, shader.kind, shader.defines);
+				}
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError("HotReload: " + unit->name + " keeps its pipelines, " + e.what());
+				std::lock_guard lock(sMutex);
+				sStats.failures++;
+				continue;
+			}
+
+			std::lock_guard lock(sMutex);
+			if (std::find(sReady.begin(), sReady.end(), unit) == sReady.end())
+				sReady.push_back(unit);
+			sStats.lastCompileMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+	}
+
+	static void threadFn(std::unique_ptr<Watcher> watcher)
+	{
+		while (sRunning)
+		{
+			std::vector<std::string> changed;
+			watcher->poll(POLL_TIMEOUT_MS, changed);
+			if (changed.empty() || sEnabledCVar->value == 0.0)
+				continue;
+			std::this_thread::sleep_for(SETTLE_TIME);
+			watcher->poll(0, changed);
+
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+			recompile(changed);
+		}
+	}
+
+	void create()
+	{
+		sEnabledCVar = Command::registerVar("eg::Renderer::HotReloadShaders", "None", 1.0);
+		Command::registerFn("eg::Renderer::PrintHotReloadStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("HotReload: " + std::to_string(stats.pipelines) + " pipelines watched, " + std::to_string(stats.reloads)
+				+ " reloads, " + std::to_string(stats.failures) + " failed, last compiled in " + std::to_string(stats.lastCompileMs) + " ms");
+			});
+
+		//Shipping builds without the shader sources simply don't reload
+		std::unique_ptr<Watcher> watcher;
+		try
+		{
+			watcher = std::make_unique<Watcher>(DIRECTORY);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gWarn(e.what());
+			return;
+		}
+		sRunning = true;
+		sThread = std::make_unique<std::thread>(threadFn, std::move(watcher));
+	}
+
+	void destroy()
+	{
+		sRunning = false;
+		if (sThread)
+		{
+			sThread->join();
+			sThread.reset();
+		}
+		//Destroyed with the other retired objects once the device is idle
+		for (auto& destroy : sReplaced)
+		{
+			retire(std::move(destroy));
+		}
+		sReplaced.clear();
+		sReady.clear();
+		sUnits.clear();
+	}
+
+	void registerPipeline(const std::string& name, Build&& create, Detach&& detach, bool inPlace)
+	{
+		Unit* unit;
+		{
+			std::lock_guard lock(sMutex);
+			sUnits.push_back(std::make_unique<Unit>(Unit{ name, std::move(create), std::move(detach), inPlace }));
+			unit = sUnits.back().get();
+			sStats.pipelines++;
+		}
+		if (inPlace)
+			build(*unit);
+		else
+			PipelineCache::build([unit]() { build(*unit); });
+	}
+
+	void recordShader(const std::string& filePath, uint32_t kind, const Defines& defines, const std::vector<std::string>& includes)
+	{
+		if (!tBuilding)
+			return;
+		std::lock_guard lock(sMutex);
+		tBuilding->shaders.push_back({ filePath, kind, defines });
+		tBuilding->files.insert(normalize(filePath));
+		for (const auto& include : includes)
+		{
+			tBuilding->files.insert(normalize(include));
+		}
+	}
+
+	void update()
+	{
+		std::vector<Unit*> ready;
+		std::vector<Build> replaced;
+		{
+			std::lock_guard lock(sMutex);
+			ready.swap(sReady);
+			replaced.swap(sReplaced);
+		}
+		//The new objects were published before the last frame was extracted, nothing recorded since uses these
+		for (auto& destroy : replaced)
+		{
+			retire(std::move(destroy));
+		}
+		if (ready.empty())
+			return;
+
+		//In place pipelines go first, the others may be laid out against what they create
+		std::stable_partition(ready.begin(), ready.end(), [](const Unit* unit) { return unit->inPlace; });
+		for (Unit* unit : ready)
+		{
+			Logger::gInfo("HotReload: rebuilding " + unit->name);
+			Build current = unit->detach();
+			if (unit->inPlace)
+			{
+				rebuild(*unit, std::move(current));
+				continue;
+			}
+			PipelineCache::build([unit, current = std::move(current)]() mutable { rebuild(*unit, std::move(current)); });
+		}
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lock(sMutex);
+		return sStats;
+	}
+}
@@ -3,8 +3,57 @@
 
 namespace eg::Renderer
 {
+	//Bytes of one mip level, block compressed levels are stored as whole 4x4 blocks,
+	//other formats are assumed to be 4 bytes per texel
+	static size_t getLevelSize(vk::Format format, uint32_t width, uint32_t height)
+	{
+		size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+		switch (format)
+		{
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbaUnormBlock:
+			return blocks * 8;
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+			return blocks * 16;
+		default:
+			return static_cast<size_t>(width) * height * 4;
+		}
+	}
+
+	//Mip chains are blitted with a linear filter, block compressed formats never qualify
+	static bool canGenerateMips(vk::Format format)
+	{
+		vk::FormatFeatureFlags features = getPhysicalDevice().getFormatProperties(format).optimalTilingFeatures;
+		return (features & vk::FormatFeatureFlagBits::eBlitSrc)
+			&& (features & vk::FormatFeatureFlagBits::eBlitDst)
+			&& (features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+	}
+
+	static vk::Sampler createSampler(uint32_t mipLevels)
+	{
+		vk::SamplerCreateInfo ci{};
+		ci.setMagFilter(vk::Filter::eLinear)
+			.setMinFilter(vk::Filter::eLinear)
+			.setMipmapMode(vk::SamplerMipmapMode::eLinear)
+			.setAddressModeU(vk::SamplerAddressMode::eRepeat)
+			.setAddressModeV(vk::SamplerAddressMode::eRepeat)
+			.setAddressModeW(vk::SamplerAddressMode::eRepeat)
+			.setMipLodBias(0)
+			.setMinLod(-1)
+			.setMaxLod(static_cast<float>(mipLevels))
+			.setAnisotropyEnable(false)
+			.setMaxAnisotropy(0.0f)
+			.setCompareEnable(false)
+			.setCompareOp(vk::CompareOp::eAlways);
+
+		return getDevice().createSampler(ci);
+	}
+
 	Image2D::Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
-		uint32_t miplevels)
+		uint32_t miplevels) :
+		mMipLevels(miplevels),
+		mFormat(format)
 	{
 		vk::ImageCreateInfo imageCI{};
 		imageCI.setImageType(vk::ImageType::e2D)
@@ -42,17 +91,17 @@ namespace eg::Renderer
 	}
 	Image2D::Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
 		void* data, size_t sizeInBytes) :
+		mMipLevels(1),
 		mFormat(format)
 	{
-		//Calculate mip levels
-		mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))) + 1);
-		if (!data)
-			mMipLevels = 1;
+		//Uploaded images get their full chain blitted down from level 0, when the format can be filtered in a blit
+		if (data && canGenerateMips(format))
+			mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))) + 1);
 
 		vk::ImageCreateInfo imageCI{};
 		imageCI.setImageType(vk::ImageType::e2D)
 			.setExtent({ width, height, 1 })
-			.setMipLevels(1)
+			.setMipLevels(mMipLevels)
 			.setArrayLayers(1)
 			.setFormat(format)
 			.setTiling(vk::ImageTiling::eOptimal)
@@ -72,182 +121,197 @@ namespace eg::Renderer
 			.setViewType(vk::ImageViewType::e2D)
 			.setFormat(format)
 			.setComponents(vk::ComponentMapping{})
-			.setSubresourceRange(vk::ImageSubresourceRange{ aspectFlags, 0, 1, 0, 1 });
+			.setSubresourceRange(vk::ImageSubresourceRange{ aspectFlags, 0, mMipLevels, 0, 1 });
 		this->mImageView = getDevice().createImageView(imageViewCI);
 
 
-		//Create staging
+		//Staged and recorded into the upload batch, done before the next frame runs
 		if (data)
 		{
-			vma::AllocationInfo info;
-			auto [stagingBuffer, stagingAllocation] = getAllocator().createBuffer(
-				vk::BufferCreateInfo{
-					{},
-					sizeInBytes ,
-					vk::BufferUsageFlagBits::eTransferSrc,
-				},
-				vma::AllocationCreateInfo{
-					vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
-					vma::MemoryUsage::eAutoPreferHost,
-				},
-				info
-				);
-
-
-			std::memcpy(info.pMappedData, data, sizeInBytes);
-
-			immediateSubmit([&](vk::CommandBuffer cmd)
+			mUploadTicket = Upload::recordGraphics(data, sizeInBytes, [&](vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset)
 				{
-	
-					//Copy data to image
-
-					cmd.pipelineBarrier(
-						vk::PipelineStageFlagBits::eAllCommands,
-						vk::PipelineStageFlagBits::eAllCommands,
-						vk::DependencyFlagBits::eByRegion
-						, {}, {},
+					auto transition = [&](uint32_t level, uint32_t levelCount,
+						vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage,
+						vk::AccessFlags srcAccess, vk::AccessFlags dstAccess,
+						vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
 						{
-							vk::ImageMemoryBarrier
-							(
-								{},
-								{},
-								vk::ImageLayout::eUndefined,
-								vk::ImageLayout::eTransferDstOptimal,
-								{},
-								{},
-								mImage,
-								vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
-
-							)
-						});
+							cmd.pipelineBarrier(srcStage, dstStage, vk::DependencyFlagBits::eByRegion, {}, {},
+								{
+									vk::ImageMemoryBarrier
+									(
+										srcAccess,
+										dstAccess,
+										oldLayout,
+										newLayout,
+										VK_QUEUE_FAMILY_IGNORED,
+										VK_QUEUE_FAMILY_IGNORED,
+										mImage,
+										vk::ImageSubresourceRange(aspectFlags, level, levelCount, 0, 1)
+									)
+								});
+						};
 
+					//Copy data to image
+					transition(0, mMipLevels, vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+						{}, vk::AccessFlagBits::eTransferWrite,
+						vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
 
 					cmd.copyBufferToImage(stagingBuffer, this->mImage, vk::ImageLayout::eTransferDstOptimal,
-						{ vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+						{ vk::BufferImageCopy(stagingOffset, 0, 0, vk::ImageSubresourceLayers(aspectFlags, 0, 0, 1),
 							{0, 0, 0}, {width, height, 1}) });
 
-					//int32_t mipWidth = width;
-					//int32_t mipHeight = height;
-					//for (uint32_t i = 1; i < mMipLevels; i++)
-					//{
-
-					//	//Transition previous mip level to transfer src
-					//	cmd.pipelineBarrier(
-					//		vk::PipelineStageFlagBits::eAllCommands,
-					//		vk::PipelineStageFlagBits::eAllCommands,
-					//		vk::DependencyFlagBits::eByRegion
-					//		, {}, {},
-					//	{
-					//		vk::ImageMemoryBarrier
-					//		(
-					//			vk::AccessFlagBits::eTransferWrite,
-					//			vk::AccessFlagBits::eTransferRead,
-					//			vk::ImageLayout::eTransferDstOptimal,
-					//			vk::ImageLayout::eTransferSrcOptimal,
-					//			{},
-					//			{},
-					//			mImage,
-					//			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i - 1, 1, 0, 1)
-
-					//		)
-					//	});
-
-					//	//Transition current mip level to transfer dst
-					//	cmd.pipelineBarrier(
-					//		vk::PipelineStageFlagBits::eAllCommands,
-					//		vk::PipelineStageFlagBits::eAllCommands,
-					//		vk::DependencyFlagBits::eByRegion
-					//		, {}, {},
-					//	{
-					//		vk::ImageMemoryBarrier
-					//		(
-					//			{},
-					//			vk::AccessFlagBits::eTransferRead,
-					//			vk::ImageLayout::eUndefined,
-					//			vk::ImageLayout::eTransferDstOptimal,
-					//			{},
-					//			{},
-					//			mImage,
-					//			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i, 1, 0, 1)
-
-					//		)
-					//	});
-
-					//	//Blitz mip level i-1 to i
-					//	cmd.blitImage(mImage, vk::ImageLayout::eTransferSrcOptimal, mImage, vk::ImageLayout::eTransferDstOptimal,
-					//		{
-					//			vk::ImageBlit
-					//			(
-					//				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1, 0, 1),
-					//				{ vk::Offset3D{0, 0, 0}, vk::Offset3D{mipWidth, mipHeight, 1} },
-					//				vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1),
-					//				{ vk::Offset3D{0, 0, 0}, vk::Offset3D{mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1} }
-					//			)
-					//		},
-					//		vk::Filter::eLinear
-					//	);
-
-	
-
-					//	if (mipWidth > 1) mipWidth /= 2;
-					//	if (mipHeight > 1) mipHeight /= 2;
-					//}
-					
-
-				
-					//Transition shader read only except the last mip level
-					cmd.pipelineBarrier(
-						vk::PipelineStageFlagBits::eAllCommands,
-						vk::PipelineStageFlagBits::eAllCommands,
-						vk::DependencyFlagBits::eByRegion
-						, {}, {},
-						{
-							vk::ImageMemoryBarrier
-							(
-								{},
-								{},
-								vk::ImageLayout::eTransferDstOptimal,
-								vk::ImageLayout::eShaderReadOnlyOptimal,
-								{},
-								{},
-								mImage,
-								vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
-
-							)
-						});
-
-					/*cmd.pipelineBarrier(
-							vk::PipelineStageFlagBits::eAllCommands,
-							vk::PipelineStageFlagBits::eAllCommands,
-							vk::DependencyFlagBits::eByRegion
-							, {}, {},
-						{
-							vk::ImageMemoryBarrier
-							(
-								{},
-								{},
-								vk::ImageLayout::eTransferDstOptimal,
-								vk::ImageLayout::eShaderReadOnlyOptimal,
-								{},
-								{},
-								mImage,
-								vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, mMipLevels - 1, 1, 0, 1)
-
-							)
-						});*/
-			});
-			getAllocator().destroyBuffer(stagingBuffer, stagingAllocation);
+					//Every level is blitted from the one above, which is then done and handed to the shaders
+					int32_t mipWidth = static_cast<int32_t>(width);
+					int32_t mipHeight = static_cast<int32_t>(height);
+					for (uint32_t i = 1; i < mMipLevels; i++)
+					{
+						transition(i - 1, 1, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+							vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead,
+							vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal);
+
+						int32_t nextWidth = std::max(mipWidth / 2, 1);
+						int32_t nextHeight = std::max(mipHeight / 2, 1);
+						cmd.blitImage(mImage, vk::ImageLayout::eTransferSrcOptimal, mImage, vk::ImageLayout::eTransferDstOptimal,
+							{
+								vk::ImageBlit
+								(
+									vk::ImageSubresourceLayers(aspectFlags, i - 1, 0, 1),
+									{ vk::Offset3D{0, 0, 0}, vk::Offset3D{mipWidth, mipHeight, 1} },
+									vk::ImageSubresourceLayers(aspectFlags, i, 0, 1),
+									{ vk::Offset3D{0, 0, 0}, vk::Offset3D{nextWidth, nextHeight, 1} }
+								)
+							},
+							vk::Filter::eLinear
+						);
+
+						transition(i - 1, 1, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+							vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead,
+							vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+						mipWidth = nextWidth;
+						mipHeight = nextHeight;
+					}
+
+					//The last level was only ever written
+					transition(mMipLevels - 1, 1, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+						vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+						vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+				});
 		}
 
 	}
 
+	Image2D::Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
+		uint32_t mipLevels, const void* data, size_t sizeInBytes) :
+		mMipLevels(mipLevels),
+		mFormat(format)
+	{
+		//One copy region per level, validated before anything is allocated
+		std::vector<vk::BufferImageCopy> regions;
+		regions.reserve(mipLevels);
+		size_t offset = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			uint32_t levelWidth = std::max(1u, width >> level);
+			uint32_t levelHeight = std::max(1u, height >> level);
+			regions.push_back(vk::BufferImageCopy(offset, 0, 0,
+				vk::ImageSubresourceLayers(aspectFlags, level, 0, 1),
+				{ 0, 0, 0 }, { levelWidth, levelHeight, 1 }));
+			offset += getLevelSize(format, levelWidth, levelHeight);
+		}
+		if (mipLevels == 0 || offset > sizeInBytes)
+			throw std::runtime_error("Image2D, mip chain data is smaller than its " + std::to_string(mipLevels) + " levels");
+
+		vk::ImageCreateInfo imageCI{};
+		imageCI.setImageType(vk::ImageType::e2D)
+			.setExtent({ width, height, 1 })
+			.setMipLevels(mipLevels)
+			.setArrayLayers(1)
+			.setFormat(format)
+			.setTiling(vk::ImageTiling::eOptimal)
+			.setInitialLayout(vk::ImageLayout::eUndefined)
+			.setUsage(usage | vk::ImageUsageFlagBits::eTransferDst)
+			.setSharingMode(vk::SharingMode::eExclusive)
+			.setSamples(vk::SampleCountFlagBits::e1)
+			.setFlags(vk::ImageCreateFlags{});
+		vma::AllocationCreateInfo allocCI{};
+		allocCI.setUsage(vma::MemoryUsage::eAutoPreferDevice);
+		auto [image, allocation] = getAllocator().createImage(imageCI, allocCI);
+		this->mImage = image;
+		this->mAllocation = allocation;
+
+		vk::ImageSubresourceRange subresourceRange(aspectFlags, 0, mipLevels, 0, 1);
+		vk::ImageViewCreateInfo imageViewCI{};
+		imageViewCI.setImage(this->mImage)
+			.setViewType(vk::ImageViewType::e2D)
+			.setFormat(format)
+			.setComponents(vk::ComponentMapping{})
+			.setSubresourceRange(subresourceRange);
+		this->mImageView = getDevice().createImageView(imageViewCI);
+
+		mUploadTicket = Upload::recordGraphics(data, offset, [&](vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset)
+			{
+				cmd.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTopOfPipe,
+					vk::PipelineStageFlagBits::eTransfer,
+					vk::DependencyFlagBits::eByRegion
+					, {}, {},
+					{
+						vk::ImageMemoryBarrier
+						(
+							{},
+							vk::AccessFlagBits::eTransferWrite,
+							vk::ImageLayout::eUndefined,
+							vk::ImageLayout::eTransferDstOptimal,
+							VK_QUEUE_FAMILY_IGNORED,
+							VK_QUEUE_FAMILY_IGNORED,
+							mImage,
+							subresourceRange
+						)
+					});
+
+				//Every level in one copy, nothing is generated on the GPU
+				for (auto& region : regions)
+				{
+					region.bufferOffset += stagingOffset;
+				}
+				cmd.copyBufferToImage(stagingBuffer, this->mImage, vk::ImageLayout::eTransferDstOptimal, regions);
+
+				cmd.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTransfer,
+					vk::PipelineStageFlagBits::eAllCommands,
+					vk::DependencyFlagBits::eByRegion
+					, {}, {},
+					{
+						vk::ImageMemoryBarrier
+						(
+							vk::AccessFlagBits::eTransferWrite,
+							vk::AccessFlagBits::eShaderRead,
+							vk::ImageLayout::eTransferDstOptimal,
+							vk::ImageLayout::eShaderReadOnlyOptimal,
+							VK_QUEUE_FAMILY_IGNORED,
+							VK_QUEUE_FAMILY_IGNORED,
+							mImage,
+							subresourceRange
+						)
+					});
+			});
+	}
+
 	Image2D::~Image2D()
 	{
+		//The upload may still be pending
+		Upload::wait(mUploadTicket);
 		getDevice().destroyImageView(this->mImageView);
 		getAllocator().destroyImage(this->mImage, this->mAllocation);
 
 	}
 
+	vk::DeviceSize Image2D::getAllocationSize() const
+	{
+		return mAllocation ? getAllocator().getAllocationInfo(mAllocation).size : 0;
+	}
+
 	CombinedImageSampler2D::CombinedImageSampler2D(uint32_t width, uint32_t height,
 		vk::Format format,
 		vk::ImageUsageFlags usage,
@@ -258,22 +322,17 @@ namespace eg::Renderer
 
 		//I am having a stroke
 
-		vk::SamplerCreateInfo ci{};
-		ci.setMagFilter(vk::Filter::eLinear)
-			.setMinFilter(vk::Filter::eLinear)
-			.setMipmapMode(vk::SamplerMipmapMode::eLinear)
-			.setAddressModeU(vk::SamplerAddressMode::eRepeat)
-			.setAddressModeV(vk::SamplerAddressMode::eRepeat)
-			.setAddressModeW(vk::SamplerAddressMode::eRepeat)
-			.setMipLodBias(0)
-			.setMinLod(-1)
-			.setMaxLod(static_cast<uint32_t>(mImage.getMipLevels()))
-			.setAnisotropyEnable(false)
-			.setMaxAnisotropy(0.0f)
-			.setCompareEnable(false)
-			.setCompareOp(vk::CompareOp::eAlways);
+		mSampler = createSampler(mImage.getMipLevels());
+	}
 
-		mSampler = getDevice().createSampler(ci);
+	CombinedImageSampler2D::CombinedImageSampler2D(uint32_t width, uint32_t height,
+		vk::Format format,
+		vk::ImageUsageFlags usage,
+		vk::ImageAspectFlags aspectFlags,
+		uint32_t mipLevels, const void* data, size_t sizeInBytes) :
+		mImage(width, height, format, usage, aspectFlags, mipLevels, data, sizeInBytes)
+	{
+		mSampler = createSampler(mImage.getMipLevels());
 	}
 
 	CombinedImageSampler2D::~CombinedImageSampler2D()
@@ -0,0 +1,242 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace eg::Renderer::PipelineCache
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	static vk::PipelineCache sCache;
+
+	static std::mutex sMutex;
+	static std::condition_variable sDoneCV;
+	//Taken by the job threads one per pushed task, or by wait on the main thread, whichever comes first
+	static std::deque<Job> sJobs;
+	static uint32_t sPending = 0; //Built and not finished
+	static bool sRunning = false;
+	static std::exception_ptr sError; //First one a job of the batch threw
+	static uint32_t sBatchJobs = 0;
+	static Clock::time_point sBatchStart;
+	static double sBatchJobMs = 0.0;
+	static Stats sStats;
+
+	//Drivers should reject data another device wrote on their own, not every one of them does
+	static bool isCompatible(const std::vector<char>& data)
+	{
+		VkPipelineCacheHeaderVersionOne header{};
+		if (data.size() < sizeof(header))
+			return false;
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		auto properties = getPhysicalDevice().getProperties();
+		return header.headerSize >= sizeof(header)
+			&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header.vendorID == properties.vendorID
+			&& header.deviceID == properties.deviceID
+			&& std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+	}
+
+	static std::vector<char> load()
+	{
+		std::ifstream file(PATH, std::ios::binary | std::ios::ate);
+		if (!file)
+			return {};
+		std::vector<char> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		if (!file.read(data.data(), data.size()))
+			return {};
+		if (!isCompatible(data))
+		{
+			Logger::gWarn("PipelineCache: " + std::string(PATH) + " was written by another device or driver, starting cold");
+			return {};
+		}
+		return data;
+	}
+
+	static void save()
+	{
+		std::vector<uint8_t> data = getDevice().getPipelineCacheData(sCache);
+		if (data.empty())
+			return;
+
+		//Renamed over the old file once complete, a crash while writing keeps the previous run's data
+		std::string tempPath = std::string(PATH) + ".tmp";
+		std::filesystem::create_directories(std::filesystem::path(PATH).parent_path());
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			if (!file)
+			{
+				Logger::gWarn("PipelineCache: can't write " + tempPath);
+				return;
+			}
+		}
+		std::filesystem::rename(tempPath, PATH);
+	}
+
+	static void runJob(Job& job)
+	{
+		auto start = Clock::now();
+		std::exception_ptr error;
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::lock_guard lk(sMutex);
+		sBatchJobMs += ms;
+		if (error && !sError)
+			sError = error;
+		if (--sPending == 0)
+			sDoneCV.notify_all();
+	}
+
+	//Pushed to the job threads once per build, wait may have run the job already
+	static void runNextJob()
+	{
+		Job job;
+		{
+			std::lock_guard lk(sMutex);
+			if (sJobs.empty())
+				return;
+			job = std::move(sJobs.front());
+			sJobs.pop_front();
+		}
+		runJob(job);
+	}
+
+	void create()
+	{
+		Command::registerFn("eg::Renderer::PrintPipelineCacheStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo(std::string("PipelineCache: ") + (stats.warm ? "warm" : "cold") + " start from "
+				+ std::to_string(stats.loadedBytes / 1024) + " KB, last build ran " + std::to_string(stats.jobs) + " jobs in "
+				+ std::to_string(stats.buildMs) + " ms, " + std::to_string(stats.jobMs) + " ms across threads");
+			});
+		//Registered ahead of every component, their old pipelines aren't destroyed under a build still running
+		Command::registerFn("eg::Renderer::ReloadAllPipelines", [](size_t, char* []) {
+			wait();
+			});
+
+		std::vector<char> data = load();
+		vk::PipelineCacheCreateInfo cacheCI{};
+		cacheCI.setInitialDataSize(data.size())
+			.setPInitialData(data.data());
+		sCache = getDevice().createPipelineCache(cacheCI);
+		sStats.warm = !data.empty();
+		sStats.loadedBytes = data.size();
+
+		{
+			std::lock_guard lk(sMutex);
+			sRunning = true;
+		}
+		Logger::gInfo("PipelineCache: " + std::to_string(data.size() / 1024) + " KB loaded, building on "
+			+ std::to_string(Jobs::getWorkerCount()) + " job threads");
+	}
+
+	void destroy()
+	{
+		try
+		{
+			wait();
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("PipelineCache: " + std::string(e.what()));
+		}
+		{
+			std::lock_guard lk(sMutex);
+			sRunning = false;
+		}
+
+		save();
+		getDevice().destroyPipelineCache(sCache);
+		sCache = nullptr;
+	}
+
+	vk::PipelineCache get()
+	{
+		return sCache;
+	}
+
+	void build(Job&& job)
+	{
+		{
+			std::unique_lock lk(sMutex);
+			if (!sRunning)
+			{
+				lk.unlock();
+				job();
+				return;
+			}
+			if (sBatchJobs++ == 0)
+			{
+				sBatchStart = Clock::now();
+				sBatchJobMs = 0.0;
+			}
+			sJobs.push_back(std::move(job));
+			sPending++;
+		}
+		Jobs::push(runNextJob);
+	}
+
+	void wait()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				if (sJobs.empty())
+				{
+					sDoneCV.wait(lk, [] {
+						return sPending == 0;
+						});
+					break;
+				}
+				job = std::move(sJobs.front());
+				sJobs.pop_front();
+			}
+			runJob(job);
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard lk(sMutex);
+			if (sBatchJobs == 0)
+				return;
+			sStats.jobs = sBatchJobs;
+			sStats.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - sBatchStart).count();
+			sStats.jobMs = sBatchJobMs;
+			sBatchJobs = 0;
+			error = std::exchange(sError, nullptr);
+		}
+		//Stored as soon as a batch lands, what a later crash would have lost is already on disk
+		save();
+		Command::execute("eg::Renderer::PrintPipelineCacheStats");
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lk(sMutex);
+		return sStats;
+	}
+}
@@ -77,9 +77,9 @@ namespace eg::Renderer::Postprocessing
 		Command::registerFn("eg::Renderer::ReloadAllPipelines",
 			[](size_t, char* []) {
 				destroyPipeline();
-				createBloomPipeline();
-				createBloomBlurPipeline();
-				createComposePipeline();
+				PipelineCache::build(createBloomPipeline);
+				PipelineCache::build(createBloomBlurPipeline);
+				PipelineCache::build(createComposePipeline);
 			});
 
 		mWidthCVar = Command::findVar("eg::Renderer::ScreenWidth");
@@ -118,9 +118,35 @@ namespace eg::Renderer::Postprocessing
 		createImages();
 		createRenderPass();
 		createFrameBuffer();
-		createBloomPipeline();
-		createBloomBlurPipeline();
-		createComposePipeline();
+		HotReload::registerPipeline("Postprocessing bloom", createBloomPipeline, []() {
+			return HotReload::Build([pipeline = mBloomPipeline, layout = mBloomLayout, descLayout = mBloomDescLayout, set = mBloomSet]() {
+				getDevice().destroyPipeline(pipeline);
+				getDevice().destroyPipelineLayout(layout);
+				getDevice().destroyDescriptorSetLayout(descLayout);
+				auto poolLock = lockDescriptorPool();
+				getDevice().freeDescriptorSets(getDescriptorPool(), set);
+				});
+			});
+		HotReload::registerPipeline("Postprocessing bloom blur", createBloomBlurPipeline, []() {
+			return HotReload::Build([horizontalPipeline = mBloomBlurHorizontalPipeline, verticalPipeline = mBloomBlurVerticalPipeline, layout = mBloomBlurLayout,
+				descLayout = mBloomBlurDescLayout, horizontalSet = mBloomBlurHorizontalSet, verticalSet = mBloomBlurVerticalSet]() {
+				getDevice().destroyPipeline(horizontalPipeline);
+				getDevice().destroyPipeline(verticalPipeline);
+				getDevice().destroyPipelineLayout(layout);
+				getDevice().destroyDescriptorSetLayout(descLayout);
+				auto poolLock = lockDescriptorPool();
+				getDevice().freeDescriptorSets(getDescriptorPool(), { horizontalSet, verticalSet });
+				});
+			});
+		HotReload::registerPipeline("Postprocessing compose", createComposePipeline, []() {
+			return HotReload::Build([pipeline = mComposePipeline, layout = mComposeLayout, descLayout = mComposeDescLayout, set = mComposeSet]() {
+				getDevice().destroyPipeline(pipeline);
+				getDevice().destroyPipelineLayout(layout);
+				getDevice().destroyDescriptorSetLayout(descLayout);
+				auto poolLock = lockDescriptorPool();
+				getDevice().freeDescriptorSets(getDescriptorPool(), set);
+				});
+			});
 	}
 
 	void createRenderPass()
@@ -339,6 +365,13 @@ namespace eg::Renderer::Postprocessing
 
 	void createBloomBlurPipeline()
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet horizontalSet;
+		vk::DescriptorSet verticalSet;
+		vk::PipelineLayout layout;
+		vk::Pipeline horizontalPipeline;
+		vk::Pipeline verticalPipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -347,27 +380,30 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mBloomBlurDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 		vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(mBloomBlurDescLayout);
-		mBloomBlurHorizontalSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
-		mBloomBlurVerticalSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		{
+			auto poolLock = lockDescriptorPool();
+			horizontalSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			verticalSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 		vk::DescriptorImageInfo imageInfo[1];
 		imageInfo[0] = vk::DescriptorImageInfo(mSampler, mBloomBlurImage->getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal);
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mBloomBlurHorizontalSet, 0, 0,
+			vk::WriteDescriptorSet(horizontalSet, 0, 0,
 				1,
 				vk::DescriptorType::eCombinedImageSampler,
 				imageInfo),
 			}, {});
 		imageInfo[0] = vk::DescriptorImageInfo(mSampler, mBloomImage->getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal);
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mBloomBlurVerticalSet, 0, 0,
+			vk::WriteDescriptorSet(verticalSet, 0, 0,
 				1,
 				vk::DescriptorType::eCombinedImageSampler,
 				imageInfo),
@@ -392,7 +428,7 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			getGlobalDescriptorSet(), // Slot0
-			mBloomBlurDescLayout
+			descLayout
 		};
 
 		// Push constant for blur direction
@@ -405,7 +441,7 @@ namespace eg::Renderer::Postprocessing
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRange);
-		mBloomBlurLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 
 		//Create graphics pipeline
@@ -509,7 +545,7 @@ namespace eg::Renderer::Postprocessing
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mBloomBlurLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(mRenderPass)
 			.setSubpass(2)
 			.setBasePipelineHandle(nullptr)
@@ -524,20 +560,20 @@ namespace eg::Renderer::Postprocessing
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create mBloomBlurHorizontalPipeline pipeline !");
 		}
-		mBloomBlurHorizontalPipeline = pipeLineResult.value;
+		horizontalPipeline = pipeLineResult.value;
 
 		pipelineCI.setSubpass(1);
-		pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create mBloomBlurVerticalPipeline pipeline !");
 		}
-		mBloomBlurVerticalPipeline = pipeLineResult.value;
+		verticalPipeline = pipeLineResult.value;
 
 
 
@@ -545,10 +581,22 @@ namespace eg::Renderer::Postprocessing
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mBloomBlurDescLayout = descLayout;
+		mBloomBlurHorizontalSet = horizontalSet;
+		mBloomBlurVerticalSet = verticalSet;
+		mBloomBlurLayout = layout;
+		mBloomBlurHorizontalPipeline = horizontalPipeline;
+		mBloomBlurVerticalPipeline = verticalPipeline;
 	}
 
 	void createComposePipeline()
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet set;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -560,14 +608,17 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mComposeDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 		vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(mComposeDescLayout);
-		mComposeSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		{
+			auto poolLock = lockDescriptorPool();
+			set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 		vk::DescriptorImageInfo sceneInputInfo{
 			{},  // no sampler
@@ -582,8 +633,8 @@ namespace eg::Renderer::Postprocessing
 		};
 
 		vk::WriteDescriptorSet writes[] = {
-			vk::WriteDescriptorSet(mComposeSet, 0, 0, 1, vk::DescriptorType::eInputAttachment, &sceneInputInfo),
-			vk::WriteDescriptorSet(mComposeSet, 1, 0, 1, vk::DescriptorType::eInputAttachment, &bloomInputInfo),
+			vk::WriteDescriptorSet(set, 0, 0, 1, vk::DescriptorType::eInputAttachment, &sceneInputInfo),
+			vk::WriteDescriptorSet(set, 1, 0, 1, vk::DescriptorType::eInputAttachment, &bloomInputInfo),
 		};
 
 		Renderer::getDevice().updateDescriptorSets(writes, {});
@@ -606,7 +657,7 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			getGlobalDescriptorSet(), // Slot0
-			mComposeDescLayout //Slot 1
+			descLayout //Slot 1
 		};
 
 		//Setup push constant range
@@ -619,7 +670,7 @@ namespace eg::Renderer::Postprocessing
 		pipelineLayoutCI.setFlags(vk::PipelineLayoutCreateFlags{})
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRange);
-		mComposeLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -721,7 +772,7 @@ namespace eg::Renderer::Postprocessing
 		dynamicStateCI.setDynamicStates(dynamicStates);
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mComposeLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(mRenderPass)
 			.setSubpass(3)
 			.setBasePipelineHandle(nullptr)
@@ -736,23 +787,33 @@ namespace eg::Renderer::Postprocessing
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create mComposePipeline pipeline !");
 		}
-		mComposePipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mComposeDescLayout = descLayout;
+		mComposeSet = set;
+		mComposeLayout = layout;
+		mComposePipeline = pipeline;
 	}
 
 	
 	void createBloomPipeline()
 	{
+		vk::DescriptorSetLayout descLayout;
+		vk::DescriptorSet set;
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+
 		//Define shader layout
 		vk::DescriptorSetLayoutBinding descLayoutBindings[] =
 		{
@@ -761,14 +822,17 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayoutCreateInfo descLayoutCI{};
 		descLayoutCI.setBindings(descLayoutBindings);
 
-		mBloomDescLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
+		descLayout = Renderer::getDevice().createDescriptorSetLayout(descLayoutCI);
 
 		//Allocate descriptor set right here
 		vk::DescriptorSetAllocateInfo ai{};
 		ai.setDescriptorPool(Renderer::getDescriptorPool())
 			.setDescriptorSetCount(1)
-			.setSetLayouts(mBloomDescLayout);
-		mBloomSet = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+			.setSetLayouts(descLayout);
+		{
+			auto poolLock = lockDescriptorPool();
+			set = Renderer::getDevice().allocateDescriptorSets(ai).at(0);
+		}
 
 		vk::DescriptorImageInfo imageInfos[] = {
 			vk::DescriptorImageInfo(mSampler, DefaultRenderPass::getDrawImage().getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal),
@@ -776,7 +840,7 @@ namespace eg::Renderer::Postprocessing
 
 
 		Renderer::getDevice().updateDescriptorSets({
-			vk::WriteDescriptorSet(mBloomSet, 0, 0,
+			vk::WriteDescriptorSet(set, 0, 0,
 				1,
 				vk::DescriptorType::eCombinedImageSampler,
 				&imageInfos[0]),
@@ -802,7 +866,7 @@ namespace eg::Renderer::Postprocessing
 		vk::DescriptorSetLayout setLayouts[] =
 		{
 			getGlobalDescriptorSet(), // Slot0
-			mBloomDescLayout //Slot 1
+			descLayout //Slot 1
 		};
 
 		//Setup push constant range
@@ -816,7 +880,7 @@ namespace eg::Renderer::Postprocessing
 			.setSetLayouts(setLayouts)
 			.setPushConstantRanges(pushConstantRange);
 
-		mBloomLayout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
+		layout = Renderer::getDevice().createPipelineLayout(pipelineLayoutCI);
 
 		//Create graphics pipeline
 		vk::PipelineShaderStageCreateInfo shaderStages[] =
@@ -933,7 +997,7 @@ namespace eg::Renderer::Postprocessing
 
 
 		vk::GraphicsPipelineCreateInfo pipelineCI{};
-		pipelineCI.setLayout(mBloomLayout)
+		pipelineCI.setLayout(layout)
 			.setRenderPass(mRenderPass)
 			.setSubpass(0)
 			.setBasePipelineHandle(nullptr)
@@ -948,18 +1012,23 @@ namespace eg::Renderer::Postprocessing
 			.setPColorBlendState(&colorBlendStateCI)
 			.setPDynamicState(&dynamicStateCI);
 
-		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(nullptr, pipelineCI);
+		auto pipeLineResult = Renderer::getDevice().createGraphicsPipeline(Renderer::PipelineCache::get(), pipelineCI);
 		if (pipeLineResult.result != vk::Result::eSuccess)
 		{
 			throw std::runtime_error("Failed to create AmbientLight pipeline !");
 		}
-		mBloomPipeline = pipeLineResult.value;
+		pipeline = pipeLineResult.value;
 
 
 
 		//Destroy shader modules
 		Renderer::getDevice().destroyShaderModule(vertexShaderModule);
 		Renderer::getDevice().destroyShaderModule(fragmentShaderModule);
+
+		mBloomDescLayout = descLayout;
+		mBloomSet = set;
+		mBloomLayout = layout;
+		mBloomPipeline = pipeline;
 	}
 
 	void compose(const vk::CommandBuffer& cmd)
@@ -989,6 +1058,7 @@ namespace eg::Renderer::Postprocessing
 
 	void destroyPipeline()
 	{
+		auto poolLock = lockDescriptorPool();
 		//Destroy bloom pipeline
 
 		getDevice().destroyPipeline(mBloomPipeline);
@@ -0,0 +1,199 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+
+namespace eg::Renderer::Recording
+{
+	struct Context
+	{
+		vk::CommandPool pools[MAX_FRAMES_IN_FLIGHT];
+		//Buffers are kept across frames, resetting the pool resets them too
+		std::vector<vk::CommandBuffer> buffers[MAX_FRAMES_IN_FLIGHT];
+		uint32_t used = 0;
+	};
+
+	static std::mutex sMutex;
+	static std::condition_variable sJobCV;
+	static std::condition_variable sDoneCV;
+	//Consumed from sNextJob and cleared once drained, steady frames reuse its capacity
+	static std::vector<Job> sJobs;
+	static size_t sNextJob = 0;
+	static uint32_t sPending = 0; //Dispatched and not finished
+	static bool sRunning = false;
+	static std::vector<std::unique_ptr<std::thread>> sThreads;
+	//One per worker, the thread calling wait takes the last
+	static std::vector<Context> sContexts;
+	static Command::Var* sThreadCountCVar = nullptr;
+
+	static void runJob(Job& job, uint32_t context)
+	{
+		{
+			FrameAllocator::CountScope countScope;
+			job(context);
+		}
+		std::lock_guard lk(sMutex);
+		if (--sPending == 0)
+			sDoneCV.notify_all();
+	}
+
+	//Under sMutex
+	static bool hasJob()
+	{
+		return sNextJob < sJobs.size();
+	}
+
+	//Under sMutex, the vector is cleared and not shrunk when the last job is taken
+	static Job popJob()
+	{
+		Job job = std::move(sJobs[sNextJob++]);
+		if (sNextJob == sJobs.size())
+		{
+			sJobs.clear();
+			sNextJob = 0;
+		}
+		return job;
+	}
+
+	static void threadFn(uint32_t context)
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				sJobCV.wait(lk, [] {
+					return hasJob() || !sRunning;
+					});
+				if (!sRunning)
+					break;
+				job = popJob();
+			}
+			runJob(job, context);
+		}
+	}
+
+	void create()
+	{
+		//0 starts a worker for every core the main thread doesn't use
+		sThreadCountCVar = Command::registerVar("eg::Renderer::RecordThreads", "None", 0.0);
+		uint32_t workerCount = static_cast<uint32_t>(std::max(sThreadCountCVar->value, 0.0));
+		if (workerCount == 0)
+			workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		sContexts.resize(workerCount + 1);
+		for (auto& context : sContexts)
+		{
+			for (auto& pool : context.pools)
+			{
+				vk::CommandPoolCreateInfo cmdPoolCI{};
+				cmdPoolCI.setQueueFamilyIndex(getGraphicsQueueFamilyIndex())
+					.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+				pool = getDevice().createCommandPool(cmdPoolCI);
+			}
+		}
+
+		sRunning = true;
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			sThreads.push_back(std::make_unique<std::thread>(threadFn, i));
+		}
+		Logger::gInfo("Recording: " + std::to_string(workerCount) + " worker threads");
+	}
+
+	void destroy()
+	{
+		{
+			std::lock_guard lk(sMutex);
+			sRunning = false;
+			sJobs.clear();
+			sNextJob = 0;
+			sJobCV.notify_all();
+		}
+		for (auto& thread : sThreads)
+		{
+			thread->join();
+		}
+		sThreads.clear();
+
+		for (auto& context : sContexts)
+		{
+			for (auto& pool : context.pools)
+			{
+				getDevice().destroyCommandPool(pool);
+			}
+		}
+		sContexts.clear();
+	}
+
+	void beginFrame()
+	{
+		//The frame's fence was waited on, nothing recorded from these pools is pending
+		uint32_t frame = getCurrentFrameIndex();
+		for (auto& context : sContexts)
+		{
+			getDevice().resetCommandPool(context.pools[frame]);
+			context.used = 0;
+		}
+	}
+
+	void dispatch(Job&& job)
+	{
+		std::lock_guard lk(sMutex);
+		sJobs.push_back(std::move(job));
+		sPending++;
+		sJobCV.notify_one();
+	}
+
+	void wait()
+	{
+		uint32_t context = static_cast<uint32_t>(sContexts.size() - 1);
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				if (!hasJob())
+				{
+					sDoneCV.wait(lk, [] {
+						return sPending == 0;
+						});
+					return;
+				}
+				job = popJob();
+			}
+			runJob(job, context);
+		}
+	}
+
+	uint32_t getContextCount()
+	{
+		return static_cast<uint32_t>(sContexts.size());
+	}
+
+	vk::CommandBuffer beginSecondary(uint32_t context, const vk::CommandBufferInheritanceInfo& inheritance)
+	{
+		Context& owner = sContexts.at(context);
+		uint32_t frame = getCurrentFrameIndex();
+		auto& buffers = owner.buffers[frame];
+		if (owner.used == buffers.size())
+		{
+			vk::CommandBufferAllocateInfo cmdAI{};
+			cmdAI.setCommandPool(owner.pools[frame])
+				.setLevel(vk::CommandBufferLevel::eSecondary)
+				.setCommandBufferCount(1);
+			buffers.push_back(getDevice().allocateCommandBuffers(cmdAI).at(0));
+		}
+		vk::CommandBuffer cmd = buffers[owner.used++];
+
+		vk::CommandBufferBeginInfo cmdBeginInfo{};
+		cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+			.setPInheritanceInfo(&inheritance);
+		cmd.begin(cmdBeginInfo);
+		return cmd;
+	}
+}
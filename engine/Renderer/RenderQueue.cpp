@@ -0,0 +1,259 @@
+#include <Renderer.h>
+#include <Components.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+namespace eg::Renderer::RenderQueue
+{
+	//Key fields, from the most significant bit
+	static constexpr uint32_t PIPELINE_BITS = 8;
+	static constexpr uint32_t MATERIAL_BITS = 20;
+	static constexpr uint32_t MESH_BITS = 20;
+	static constexpr uint32_t DEPTH_BITS = 16;
+	static_assert(PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	struct StageQueue
+	{
+		std::vector<Packet> packets;
+		std::vector<SortEntry> entries;
+		std::vector<SortEntry> scratch;
+		std::mutex statsMutex; //Ranges are recorded concurrently
+		Stats stats;
+		Stats lastStats;
+	};
+	//Shadow and G-buffer, the point light subpass records no packets
+	static StageQueue sQueues[2];
+	static Command::Var* sRenderScaleCVar = nullptr;
+	static Command::Var* sWidthCVar = nullptr;
+	static Command::Var* sHeightCVar = nullptr;
+
+	static StageQueue& getQueue(RenderStage stage)
+	{
+		return sQueues[stage == RenderStage::SHADOW ? 0 : 1];
+	}
+
+	//Fibonacci hashing, equal handles always land in the same field value
+	static uint64_t hashHandle(uint64_t handle, uint32_t bits)
+	{
+		if (handle == 0)
+			return 0;
+		return (handle * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+	}
+
+	//LSD radix sort over the key bytes, bytes every key shares are skipped
+	static void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+	{
+		scratch.resize(entries.size());
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			uint32_t offsets[256] = {};
+			for (const auto& entry : entries)
+			{
+				offsets[(entry.key >> shift) & 0xFF]++;
+			}
+			if (offsets[(entries.front().key >> shift) & 0xFF] == entries.size())
+				continue;
+
+			uint32_t sum = 0;
+			for (auto& offset : offsets)
+			{
+				uint32_t count = offset;
+				offset = sum;
+				sum += count;
+			}
+			for (const auto& entry : entries)
+			{
+				scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+			}
+			entries.swap(scratch);
+		}
+	}
+
+	void create()
+	{
+		sRenderScaleCVar = Command::findVar("eg::Renderer::ScreenRenderScale");
+		sWidthCVar = Command::findVar("eg::Renderer::ScreenWidth");
+		sHeightCVar = Command::findVar("eg::Renderer::ScreenHeight");
+		Command::registerFn("eg::Renderer::PrintRenderQueueStats", [](size_t, char* []) {
+			auto print = [](const std::string& name, const Stats& stats)
+				{
+					Logger::gInfo(name + ": " + std::to_string(stats.packets) + " packets, "
+						+ std::to_string(stats.pipelineBinds) + " pipeline binds, "
+						+ std::to_string(stats.descriptorBinds) + " descriptor binds, "
+						+ std::to_string(stats.vertexBufferBinds) + " vertex buffer binds, "
+						+ std::to_string(stats.indexBufferBinds) + " index buffer binds, "
+						+ std::to_string(stats.draws) + " draws");
+				};
+			print("Shadow", getStats(RenderStage::SHADOW));
+			print("GBuffer", getStats(RenderStage::SUBPASS0_GBUFFER));
+			});
+	}
+
+	void destroy()
+	{
+		for (auto& queue : sQueues)
+		{
+			queue.packets = {};
+			queue.entries = {};
+			queue.scratch = {};
+		}
+	}
+
+	uint64_t makeKey(vk::Pipeline pipeline, uint32_t material, vk::Buffer mesh, float depth)
+	{
+		//Front to back over the camera range, opaque draws reject more fragments early
+		float range = getMainCamera().mFar;
+		float normalized = std::clamp(depth / range, 0.0f, 1.0f);
+		uint64_t depthField = static_cast<uint64_t>(normalized * ((1u << DEPTH_BITS) - 1));
+
+		return hashHandle(reinterpret_cast<uint64_t>(static_cast<VkPipeline>(pipeline)), PIPELINE_BITS) << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS)
+			| (static_cast<uint64_t>(material) & ((1u << MATERIAL_BITS) - 1)) << (MESH_BITS + DEPTH_BITS)
+			| hashHandle(reinterpret_cast<uint64_t>(static_cast<VkBuffer>(mesh)), MESH_BITS) << DEPTH_BITS
+			| depthField;
+	}
+
+	void submit(RenderStage stage, const Packet& packet)
+	{
+		StageQueue& queue = getQueue(stage);
+		queue.entries.push_back({ packet.key, static_cast<uint32_t>(queue.packets.size()) });
+		queue.packets.push_back(packet);
+	}
+
+	uint32_t sort(RenderStage stage)
+	{
+		StageQueue& queue = getQueue(stage);
+		if (!queue.entries.empty())
+			radixSort(queue.entries, queue.scratch);
+		return static_cast<uint32_t>(queue.entries.size());
+	}
+
+	void record(vk::CommandBuffer cmd, RenderStage stage, uint32_t first, uint32_t count)
+	{
+		StageQueue& queue = getQueue(stage);
+		Stats stats{};
+		stats.packets = count;
+		if (count == 0)
+			return;
+
+		//Viewport and scissor are dynamic in every packet pipeline, they outlive the pipeline binds
+		if (stage == RenderStage::SHADOW)
+		{
+			uint32_t size = Atmosphere::getShadowMapSize();
+			cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f, static_cast<float>(size), static_cast<float>(size), 0.0f, 1.0f } });
+			cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(size, size)));
+		}
+		else
+		{
+			float scaledWidth = static_cast<float>(sWidthCVar->value * sRenderScaleCVar->value);
+			float scaledHeight = static_cast<float>(sHeightCVar->value * sRenderScaleCVar->value);
+			cmd.setViewport(0, { vk::Viewport{ 0.0f, 0.0f, scaledWidth, scaledHeight, 0.0f, 1.0f } });
+			cmd.setScissor(0, vk::Rect2D({ 0, 0 }, { static_cast<uint32_t>(scaledWidth), static_cast<uint32_t>(scaledHeight) }));
+		}
+
+		vk::Pipeline boundPipeline;
+		vk::PipelineLayout boundLayout;
+		vk::DescriptorSet boundSets[MAX_DESCRIPTOR_SETS];
+		uint32_t boundDynamicOffsets[MAX_DYNAMIC_OFFSETS] = {};
+		uint32_t boundDynamicSet = MAX_DESCRIPTOR_SETS; //Set the bound offsets belong to
+		vk::Buffer boundVertexBuffers[MAX_VERTEX_BUFFERS];
+		vk::Buffer boundIndexBuffer;
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const Packet& packet = queue.packets[queue.entries[i].packet];
+			if (packet.pipeline != boundPipeline)
+			{
+				boundPipeline = packet.pipeline;
+				cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, boundPipeline);
+				stats.pipelineBinds++;
+			}
+			//Sets bound with another layout aren't assumed compatible
+			if (packet.layout != boundLayout)
+			{
+				boundLayout = packet.layout;
+				std::fill(std::begin(boundSets), std::end(boundSets), vk::DescriptorSet{});
+			}
+
+			uint32_t firstSet = 0;
+			while (firstSet < packet.setCount && packet.sets[firstSet] == boundSets[firstSet])
+				firstSet++;
+			//Other offsets into the same last set still need it rebound
+			if (firstSet == packet.setCount && packet.dynamicOffsetCount > 0
+				&& (boundDynamicSet != packet.setCount - 1
+					|| !std::equal(packet.dynamicOffsets, packet.dynamicOffsets + packet.dynamicOffsetCount, boundDynamicOffsets)))
+				firstSet = packet.setCount - 1;
+			if (firstSet < packet.setCount)
+			{
+				cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, packet.layout, firstSet,
+					packet.setCount - firstSet, packet.sets + firstSet, packet.dynamicOffsetCount, packet.dynamicOffsets);
+				std::copy(packet.sets + firstSet, packet.sets + packet.setCount, boundSets + firstSet);
+				std::copy(packet.dynamicOffsets, packet.dynamicOffsets + packet.dynamicOffsetCount, boundDynamicOffsets);
+				boundDynamicSet = packet.dynamicOffsetCount > 0 ? packet.setCount - 1 : MAX_DESCRIPTOR_SETS;
+				stats.descriptorBinds++;
+			}
+
+			uint32_t firstBinding = 0;
+			while (firstBinding < packet.vertexBufferCount && packet.vertexBuffers[firstBinding] == boundVertexBuffers[firstBinding])
+				firstBinding++;
+			if (firstBinding < packet.vertexBufferCount)
+			{
+				vk::DeviceSize offsets[MAX_VERTEX_BUFFERS] = {};
+				cmd.bindVertexBuffers(firstBinding, packet.vertexBufferCount - firstBinding, packet.vertexBuffers + firstBinding, offsets);
+				std::copy(packet.vertexBuffers + firstBinding, packet.vertexBuffers + packet.vertexBufferCount, boundVertexBuffers + firstBinding);
+				stats.vertexBufferBinds++;
+			}
+			if (packet.indexBuffer != boundIndexBuffer)
+			{
+				boundIndexBuffer = packet.indexBuffer;
+				cmd.bindIndexBuffer(boundIndexBuffer, 0, vk::IndexType::eUint32);
+				stats.indexBufferBinds++;
+			}
+
+			if (packet.pushConstantSize > 0)
+			{
+				cmd.pushConstants(packet.layout, packet.pushConstantStages, 0, packet.pushConstantSize, packet.pushConstants);
+			}
+			if (packet.indirectBuffer)
+			{
+				cmd.drawIndexedIndirectCount(packet.indirectBuffer, packet.indirectOffset,
+					packet.countBuffer, packet.countOffset, packet.maxDrawCount, packet.stride);
+			}
+			else
+			{
+				cmd.drawIndexed(packet.indexCount, packet.instanceCount, packet.firstIndex, packet.vertexOffset, packet.firstInstance);
+			}
+			stats.draws++;
+		}
+
+		std::lock_guard lock(queue.statsMutex);
+		queue.stats.packets += stats.packets;
+		queue.stats.pipelineBinds += stats.pipelineBinds;
+		queue.stats.descriptorBinds += stats.descriptorBinds;
+		queue.stats.vertexBufferBinds += stats.vertexBufferBinds;
+		queue.stats.indexBufferBinds += stats.indexBufferBinds;
+		queue.stats.draws += stats.draws;
+	}
+
+	void finish(RenderStage stage)
+	{
+		StageQueue& queue = getQueue(stage);
+		queue.packets.clear();
+		queue.entries.clear();
+		queue.lastStats = queue.stats;
+		queue.stats = {};
+	}
+
+	Stats getStats(RenderStage stage)
+	{
+		return getQueue(stage).lastStats;
+	}
+}
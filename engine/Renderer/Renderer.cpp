@@ -8,7 +8,6 @@
 #include <limits>
 #include <vector>
 #include <optional>
-#include <shaderc/shaderc.hpp>
 #include <glm/glm.hpp>
 #define VMA_IMPLEMENTATION
 #include <vulkan-memory-allocator-hpp/vk_mem_alloc.hpp>
@@ -21,6 +20,12 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <numeric>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <utility>
 
 namespace eg::Renderer
 {
@@ -46,12 +51,11 @@ namespace eg::Renderer
 		vk::CommandBuffer commandBuffer;
 		uint32_t swapchainIndex = 0;
 		float alpha;
+		bool submitted = false; //The fence was reset by begin and will be signalled by this frame's submission
 	};
 	static Components::Camera gDummyCamera;
 	static const Components::Camera* gCamera = &gDummyCamera;
 
-	static shaderc::Compiler gShaderCompiler;
-	static shaderc::CompileOptions gShaderCompilerOptions;
 	static Command::Var* gScreenWidth = nullptr;
 	static Command::Var* gScreenHeight = nullptr;
 	static Command::Var* gScreenRenderScale = nullptr;
@@ -63,10 +67,13 @@ namespace eg::Renderer
 	static uint32_t gImageCount;
 	static vk::PhysicalDevice gPhysicalDevice;
 	static uint32_t gGraphicsQueueFamilyIndex = std::numeric_limits<uint32_t>::max();
+	static uint32_t gTransferQueueFamilyIndex = std::numeric_limits<uint32_t>::max();
 	static vk::Device gDevice;
 	static vma::Allocator gAllocator;
 
 	static vk::Queue gMainQueue;
+	static vk::Queue gTransferQueue;
+	static bool gDrawIndirectCountSupported = false;
 	static vk::PresentModeKHR gPresentMode = vk::PresentModeKHR::eImmediate;
 	static vk::SurfaceFormatKHR gSurfaceFormat = vk::SurfaceFormatKHR{ vk::Format::eR16G16B16A16Sfloat, vk::ColorSpaceKHR::eSrgbNonlinear };
 	static vk::SwapchainKHR gSwapchain;
@@ -102,23 +109,61 @@ namespace eg::Renderer
 	static RenderFn gDebugRenderFn = dummyRenderFn;
 
 	//Multi threading
-	static std::mutex gMainThreadMutex;
-	static std::condition_variable gMainCV;
+	//The main queue is shared with the upload batches, which can be submitted from any thread
+	static std::mutex gQueueMutex;
+	static std::mutex gDescriptorPoolMutex;
 
-	static std::mutex gShadowMutex;
-	static std::condition_variable gShadowCV;
-	static bool gShadowThreadReady = false;
-	static bool gShadowThreadRunning = true;
-	static vk::CommandBuffer gShadowCmdBuffers[MAX_FRAMES_IN_FLIGHT];
+	//Summed over every job of the stage
+	static std::atomic<double> gShadowRecordTimeMs = 0.0;
+	static std::atomic<double> gBufferRecordTimeMs = 0.0;
+	static Command::Var* gRecordChunkCVar = nullptr;
 
-	static std::mutex gBufferMutex;
-	static std::condition_variable gBufferCV;
-	static bool gBufferThreadReady = false;
-	static bool gBufferThreadRunning = true;
-	static vk::CommandBuffer gBufferCmdBuffers[MAX_FRAMES_IN_FLIGHT];
+	//One sorted range of a stage, the recording job captures only a pointer to it
+	struct RecordChunk
+	{
+		RenderStage stage;
+		const vk::CommandBufferInheritanceInfo* inheritance;
+		vk::CommandBuffer* buffer;
+		double* time;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	//Everything submit needs from the main thread, the render thread records from this and the frame's buffers alone
+	struct ExtractedFrame
+	{
+		vk::CommandBufferInheritanceInfo shadowInheritance;
+		vk::CommandBufferInheritanceInfo gBufferInheritance;
+		vk::CommandBufferInheritanceInfo lightInheritance;
+		std::vector<vk::CommandBuffer> shadowBuffers, gBufferBuffers;
+		std::vector<double> shadowTimes, gBufferTimes;
+		std::vector<RecordChunk> shadowChunks, gBufferChunks; //Cleared, their capacity stays across frames
+		vk::CommandBuffer lightBuffer;
+		float delta = 0.0f;
+		bool debug = false;
+	};
+	static ExtractedFrame gExtractedFrame;
+
+	//Pipelined frames, the main thread simulates and extracts frame N+1 while the render thread submits frame N
+	static std::unique_ptr<std::thread> gRenderThread;
+	static std::mutex gRenderThreadMutex;
+	static std::condition_variable gRenderThreadCV;
+	static bool gFrameExtracted = false; //Handed to the render thread and not submitted yet
+	static std::exception_ptr gSubmitError; //Thrown by the render thread, rethrown by the next waitForSubmit
+	static bool gRenderThreadRunning = false;
+	static Command::Var* gPipelineFramesCVar = nullptr;
+	static uint64_t gFrameNumber = 0;
+	static FrameTimes gFrameTimes;
+	static std::optional<std::chrono::high_resolution_clock::time_point> gLastRenderEnd;
+
+	struct RetiredObject
+	{
+		std::function<void()> destroy;
+		size_t framesLeft;
+	};
+	static std::vector<RetiredObject> gRetiredObjects;
 
-	static std::unique_ptr<std::thread> gShadowThread;
-	static std::unique_ptr<std::thread> gBufferThread;
+	static void renderThreadFn();
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL gDebugCallbackFn(
 		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -139,249 +184,72 @@ namespace eg::Renderer
 	}
 
 
-	std::vector<uint32_t> compileShaderFromFile(const std::string& filePath, uint32_t kind,
-		std::vector<std::pair<std::string, std::string>> defines)
+	std::unique_lock<std::mutex> lockDescriptorPool()
 	{
-		Logger::gTrace("Compiling shader: " + filePath);
-
-		class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
-		{
-			shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
-			{
-				std::string msg = std::string(requestingSource);
-				msg += std::to_string(type);
-				msg += static_cast<char>(includeDepth);
-
-				const std::string name = std::string(requestedSource);
-				const std::string contents = ReadFile(name);
-
-				auto container = new std::array<std::string, 2>;
-				(*container)[0] = name;
-				(*container)[1] = contents;
-
-				auto data = new shaderc_include_result;
-
-				data->user_data = container;
-
-				data->source_name = (*container)[0].data();
-				data->source_name_length = (*container)[0].size();
-
-				data->content = (*container)[1].data();
-				data->content_length = (*container)[1].size();
-
-				return data;
-			}
-			void ReleaseInclude(shaderc_include_result* data) override
-			{
-				delete static_cast<std::array<std::string, 2>*>(data->user_data);
-				delete data;
-			}
-			static std::string ReadFile(const std::string& path)
-			{
-				std::string sourceCode;
-				std::ifstream in(path, std::ios::in | std::ios::binary);
-				if (in)
-				{
-					in.seekg(0, std::ios::end);
-					size_t size = in.tellg();
-					if (size > 0)
-					{
-						sourceCode.resize(size);
-						in.seekg(0, std::ios::beg);
-						in.read(&sourceCode[0], size);
-					}
-					else
-					{
-						Logger::gWarn("compileShaderFromFile, file is empty" + path);
-					}
-				}
-				else
-				{
-					Logger::gWarn("compileShaderFromFile, can't open shader file file" + path);
-				}
-				return sourceCode;
-			}
-		};
-
-
-
-		std::ifstream file(filePath);
-		if (!file.is_open())
-		{
-			throw std::runtime_error("Failed to open shader file !");
-		}
-		std::stringstream ss;
-		ss << file.rdbuf();
-		std::string data = ss.str();
-
-		for (const auto& define : defines)
-		{
-			gShaderCompilerOptions.AddMacroDefinition(define.first, define.second);
-		}
-		gShaderCompilerOptions.SetOptimizationLevel(shaderc_optimization_level_performance);
-		gShaderCompilerOptions.SetIncluder(std::make_unique<ShaderIncluder>());
-
-		shaderc::PreprocessedSourceCompilationResult precompileResult 
-			= gShaderCompiler.PreprocessGlsl(data, (shaderc_shader_kind)kind, filePath.c_str(), gShaderCompilerOptions);
-		if (precompileResult.GetCompilationStatus() != shaderc_compilation_status_success)
-		{
-			Logger::gError(precompileResult.GetErrorMessage());
-			throw std::runtime_error("Failed to preprocess shader !");
-		}
-
-		std::string processedData(precompileResult.begin());
-
-		shaderc::SpvCompilationResult module = gShaderCompiler.CompileGlslToSpv(processedData,
-			(shaderc_shader_kind)kind,
-			filePath.c_str(), gShaderCompilerOptions);
-
-		if (module.GetCompilationStatus() != shaderc_compilation_status_success)
-		{
-			Logger::gError(module.GetErrorMessage());
-			throw std::runtime_error("Failed to compile shader !");
-		}
-
-		return { module.cbegin(), module.cend() };
+		return std::unique_lock<std::mutex>(gDescriptorPoolMutex);
 	}
 
-	void immediateSubmit(std::function<void(vk::CommandBuffer cmd)>&& function)
+	std::unique_lock<std::mutex> lockMainQueue()
 	{
-		vk::CommandBufferAllocateInfo cmdAI{};
-		cmdAI.setCommandPool(gCommandPool)
-			.setLevel(vk::CommandBufferLevel::ePrimary)
-			.setCommandBufferCount(1);
-		auto cmdBuffer = gDevice.allocateCommandBuffers(cmdAI)[0];
-		vk::CommandBufferBeginInfo cmdBeginInfo{};
-		cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-		cmdBuffer.begin(cmdBeginInfo);
-		function(cmdBuffer);
-		cmdBuffer.end();
-		vk::SubmitInfo submitInfo{};
-		submitInfo.setCommandBufferCount(1)
-			.setPCommandBuffers(&cmdBuffer);
-		gMainQueue.submit(submitInfo, nullptr);
-		gMainQueue.waitIdle();
-		gDevice.freeCommandBuffers(gCommandPool, cmdBuffer);
+		return std::unique_lock<std::mutex>(gQueueMutex);
 	}
 
-	static void gShadowThreadFn()
+	void retire(std::function<void()>&& destroy)
 	{
-		eg::Logger::gInfo("Shadow thread started !");
-
-		//Allocate command pool and command buffer for gShadow rendering
-		vk::CommandPoolCreateInfo cmdPoolCI{};
-		cmdPoolCI.setQueueFamilyIndex(eg::Renderer::getGraphicsQueueFamilyIndex())
-			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
-		auto cmdPool = gDevice.createCommandPool(cmdPoolCI);
-		vk::CommandBufferAllocateInfo cmdAI{};
-		cmdAI.setCommandPool(cmdPool)
-			.setLevel(vk::CommandBufferLevel::eSecondary)
-			.setCommandBufferCount(MAX_FRAMES_IN_FLIGHT);
-		auto buffers = gDevice.allocateCommandBuffers(cmdAI);
-		for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			gShadowCmdBuffers[i] = buffers[i];
-		}
+		gRetiredObjects.push_back({ std::move(destroy), RETIRE_FRAME_COUNT });
+	}
 
-		while (gShadowThreadRunning)
+	static void destroyRetiredObjects(bool all)
+	{
+		for (auto it = gRetiredObjects.begin(); it != gRetiredObjects.end();)
 		{
-			std::unique_lock lk(gShadowMutex);
-			gShadowCV.wait(lk, [] {
-				return gShadowThreadReady;
-				});
-
-			//Reset commandbuffer
-
-			//Record commands
-			vk::CommandBufferInheritanceInfo cmdInheritanceInfo{};
-			cmdInheritanceInfo.setRenderPass(Atmosphere::getRenderPass())
-				.setSubpass(0)
-				.setFramebuffer(Atmosphere::getFramebuffer());
-
-			auto cmd = gShadowCmdBuffers[gCurrentFrame];
-
-			vk::CommandBufferBeginInfo cmdBeginInfo{};
-			cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse)
-				.setPInheritanceInfo(&cmdInheritanceInfo);
-			cmd.reset(vk::CommandBufferResetFlagBits::eReleaseResources);
-			cmd.begin(cmdBeginInfo);
-			gShadowRenderFn(cmd, gFrameData[gCurrentFrame].alpha);
-			cmd.end();
-
-			//Notify main thread that gShadow commands are ready
+			if (all || --it->framesLeft == 0)
 			{
-				std::lock_guard lk(gMainThreadMutex);
-				gShadowThreadReady = false;
-				gMainCV.notify_one();
+				it->destroy();
+				it = gRetiredObjects.erase(it);
+			}
+			else
+			{
+				it++;
 			}
 		}
-
-		//Delete command buffer and command pool
-		gDevice.destroyCommandPool(cmdPool);
-
-		eg::Logger::gInfo("Shadow thread destroyed !");
 	}
 
-	static void gBufferThreadFn()
+	//Splits the sorted packets of a stage over the recording contexts, the secondaries land in buffers after the gather one
+	static void recordStageChunks(RenderStage stage, const vk::CommandBufferInheritanceInfo& inheritance,
+		std::vector<vk::CommandBuffer>& buffers, std::vector<double>& times, std::vector<RecordChunk>& chunks)
 	{
-		eg::Logger::gInfo("GBuffer thread started !");
-
-		//Allocate command pool and command buffer for gShadow rendering
-		vk::CommandPoolCreateInfo cmdPoolCI{};
-		cmdPoolCI.setQueueFamilyIndex(eg::Renderer::getGraphicsQueueFamilyIndex())
-			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
-		auto cmdPool = gDevice.createCommandPool(cmdPoolCI);
-		vk::CommandBufferAllocateInfo cmdAI{};
-		cmdAI.setCommandPool(cmdPool)
-			.setLevel(vk::CommandBufferLevel::eSecondary)
-			.setCommandBufferCount(MAX_FRAMES_IN_FLIGHT);
-		auto buffers = gDevice.allocateCommandBuffers(cmdAI);
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		chunks.clear();
+		uint32_t packetCount = RenderQueue::sort(stage);
+		if (packetCount == 0)
+			return;
+		//Small chunks cost more in begin and rebinding than they save
+		uint32_t minChunk = static_cast<uint32_t>(std::max(gRecordChunkCVar->value, 1.0));
+		uint32_t chunkSize = std::max(minChunk, (packetCount + Recording::getContextCount() - 1) / Recording::getContextCount());
+		uint32_t chunkCount = (packetCount + chunkSize - 1) / chunkSize;
+
+		size_t firstBuffer = buffers.size();
+		buffers.resize(firstBuffer + chunkCount);
+		times.resize(firstBuffer + chunkCount);
+		//Filled before any job runs, a single pointer fits the job's small buffer and doesn't allocate
+		for (uint32_t i = 0; i < chunkCount; i++)
 		{
-			gBufferCmdBuffers[i] = buffers[i];
+			uint32_t first = i * chunkSize;
+			chunks.push_back({ stage, &inheritance, &buffers[firstBuffer + i], &times[firstBuffer + i], first, std::min(chunkSize, packetCount - first) });
 		}
-
-
-		while (gBufferThreadRunning)
+		for (const RecordChunk& chunk : chunks)
 		{
-			std::unique_lock lk(gBufferMutex);
-			gBufferCV.wait(lk, [] {
-				return gBufferThreadReady;
+			Recording::dispatch([chunk = &chunk](uint32_t context) {
+				auto recordStart = std::chrono::high_resolution_clock::now();
+				vk::CommandBuffer cmd = Recording::beginSecondary(context, *chunk->inheritance);
+				RenderQueue::record(cmd, chunk->stage, chunk->first, chunk->count);
+				cmd.end();
+				*chunk->buffer = cmd;
+				*chunk->time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
 				});
-
-			//Reset commandbuffer
-
-			//Record commands
-			vk::CommandBufferInheritanceInfo cmdInheritanceInfo{};
-			cmdInheritanceInfo.setRenderPass(eg::Renderer::DefaultRenderPass::getRenderPass())
-				.setSubpass(0)
-				.setFramebuffer(eg::Renderer::DefaultRenderPass::getFramebuffer());
-
-			auto cmd = gBufferCmdBuffers[gCurrentFrame];
-
-			vk::CommandBufferBeginInfo cmdBeginInfo{};
-			cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse)
-				.setPInheritanceInfo(&cmdInheritanceInfo);
-			cmd.reset(vk::CommandBufferResetFlagBits::eReleaseResources);
-			cmd.begin(cmdBeginInfo);
-			gBufferRenderFn(cmd, gFrameData[gCurrentFrame].alpha);
-			cmd.end();
-
-			//Notify main thread that gShadow commands are ready
-			{
-				std::lock_guard lk(gMainThreadMutex);
-				gBufferThreadReady = false;
-				gMainCV.notify_one();
-			}
 		}
-
-		//Delete command buffer and command pool
-		gDevice.destroyCommandPool(cmdPool);
-
-		eg::Logger::gInfo("GBuffer thread destroyed !");
 	}
 
-
 	static void createSwapchain(uint32_t width, uint32_t height)
 	{
 		//Create swapchain
@@ -432,13 +300,28 @@ namespace eg::Renderer
 
 	}
 
+	//The extracted frame and everything it references stay untouched until this returns
+	static void waitForSubmit()
+	{
+		std::unique_lock lk(gRenderThreadMutex);
+		gRenderThreadCV.wait(lk, [] {
+			return !gFrameExtracted;
+			});
+		if (gSubmitError)
+			std::rethrow_exception(std::exchange(gSubmitError, nullptr));
+	}
+
 	void waitIdle()
 	{
+		waitForSubmit();
+		std::lock_guard queueLock(gQueueMutex);
 		gDevice.waitIdle();
 	}
 
 	void create(uint32_t width, uint32_t height, uint32_t shadowMapRes)
 	{
+		ShaderCache::create();
+
 		//Create cvar for draw extent
 		gScreenWidth = Command::registerVar("eg::Renderer::ScreenWidth", "None", static_cast<double>(width));
 		gScreenHeight = Command::registerVar("eg::Renderer::ScreenHeight", "None", static_cast<double>(height));
@@ -452,7 +335,7 @@ namespace eg::Renderer
 			}
 			try
 			{
-				gDevice.waitIdle();
+				waitIdle();
 
 				//Extract width and height
 				int screenWidth = std::stoi(argv[1]);
@@ -466,7 +349,7 @@ namespace eg::Renderer
 				changedHeight = static_cast<uint32_t>(framebufferHeight);
 
 
-				gDevice.waitIdle();
+				waitIdle();
 				gScreenWidth->value = static_cast<double>(framebufferWidth);
 				gScreenHeight->value = static_cast<double>(framebufferHeight);
 
@@ -484,6 +367,7 @@ namespace eg::Renderer
 
 				//Rebuild all pipelines
 				eg::Command::execute("eg::Renderer::ReloadAllPipelines");
+				PipelineCache::wait();
 			} 
 			catch (const std::exception& e)
 			{
@@ -598,6 +482,22 @@ namespace eg::Renderer
 		{
 			throw std::runtime_error("Failed to find suitable queue family !");
 		}
+		//Prefer a dedicated transfer family for uploads, then one without graphics, else share the main queue
+		gTransferQueueFamilyIndex = gGraphicsQueueFamilyIndex;
+		for (uint32_t i = 0; i < queueFamilies.size(); i++)
+		{
+			auto flags = queueFamilies[i].queueFlags;
+			if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics) && !(flags & vk::QueueFlagBits::eCompute))
+			{
+				gTransferQueueFamilyIndex = i;
+				break;
+			}
+			if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics)
+				&& gTransferQueueFamilyIndex == gGraphicsQueueFamilyIndex)
+			{
+				gTransferQueueFamilyIndex = i;
+			}
+		}
 
 		//Create logical device
 		const float queuePriorities[] = { 1.0f };
@@ -611,12 +511,42 @@ namespace eg::Renderer
 				queuePriorities
 			}
 		};
+		if (gTransferQueueFamilyIndex != gGraphicsQueueFamilyIndex)
+		{
+			queueCIs.push_back(vk::DeviceQueueCreateInfo{ {}, gTransferQueueFamilyIndex, 1, queuePriorities });
+		}
+
+		//Upload batches complete on timeline semaphores
+		vk::PhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.timelineSemaphore = true;
+
+		//GPU culled draws are submitted with drawIndexedIndirectCount, optional
+		auto supportedFeatures = gPhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		gDrawIndirectCountSupported = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount
+			&& supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect;
+		vulkan12Features.drawIndirectCount = gDrawIndirectCountSupported;
+
+		//Model materials and textures are indexed from one bindless set, required
+		const auto& supported12 = supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>();
+		if (!supported12.runtimeDescriptorArray || !supported12.descriptorBindingPartiallyBound
+			|| !supported12.descriptorBindingSampledImageUpdateAfterBind || !supported12.descriptorBindingStorageBufferUpdateAfterBind
+			|| !supported12.descriptorBindingUpdateUnusedWhilePending)
+		{
+			throw std::runtime_error("Physical device doesn't support descriptor indexing !");
+		}
+		vulkan12Features.runtimeDescriptorArray = true;
+		vulkan12Features.descriptorBindingPartiallyBound = true;
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+		vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = true;
+		vulkan12Features.descriptorBindingUpdateUnusedWhilePending = true;
 
 		vk::PhysicalDeviceSynchronization2Features sync2Features{};
 		sync2Features.synchronization2 = true;
+		sync2Features.pNext = &vulkan12Features;
 
 		vk::PhysicalDeviceFeatures2 features2{};
 		features2.features.geometryShader = true;
+		features2.features.multiDrawIndirect = gDrawIndirectCountSupported;
 		features2.pNext = &sync2Features;
 
 
@@ -636,6 +566,7 @@ namespace eg::Renderer
 
 		//Get main queue
 		gMainQueue = gDevice.getQueue(gGraphicsQueueFamilyIndex, 0);
+		gTransferQueue = gTransferQueueFamilyIndex == gGraphicsQueueFamilyIndex ? gMainQueue : gDevice.getQueue(gTransferQueueFamilyIndex, 0);
 
 		//Create allocator
 		vma::AllocatorCreateInfo allocatorCI{};
@@ -655,6 +586,15 @@ namespace eg::Renderer
 			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
 		gCommandPool = gDevice.createCommandPool(commandPoolCI);
 
+		//Create upload ring
+		Upload::create();
+		GeometryPool::create();
+		RenderQueue::create();
+		FrameAllocator::create();
+		Bindless::create();
+		PipelineCache::create();
+		HotReload::create();
+
 
 		//Create frame data
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -680,7 +620,9 @@ namespace eg::Renderer
 		vk::DescriptorPoolSize poolSizes[] =
 		{
 			vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, 4096},
-			vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 4096}
+			vk::DescriptorPoolSize{vk::DescriptorType::eUniformBufferDynamic, 64},
+			vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 4096},
+			vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 1024}
 		};
 		vk::DescriptorPoolCreateInfo descriptorPoolCI{};
 		descriptorPoolCI
@@ -755,9 +697,20 @@ namespace eg::Renderer
 		//ImGui_ImplVulkan_Init(&init_info);
 
 
-		//Launch threads
-		gShadowThread = std::make_unique<std::thread>(gShadowThreadFn);
-		gBufferThread = std::make_unique<std::thread>(gBufferThreadFn);
+		//Packets under this many aren't split further between recording threads
+		gRecordChunkCVar = Command::registerVar("eg::Renderer::RecordChunkSize", "None", 64.0);
+		Recording::create();
+
+		//0 submits every frame on the main thread right after extracting it
+		gPipelineFramesCVar = Command::registerVar("eg::Renderer::PipelineFrames", "None", 1.0);
+		Command::registerFn("eg::Renderer::PrintFrameTimes", [](size_t, char* []) {
+			FrameTimes times = getFrameTimes();
+			Logger::gInfo(std::string(times.pipelined ? "Pipelined" : "Serial") + " frame: simulation " + std::to_string(times.simulationMs)
+				+ " ms, extract " + std::to_string(times.extractMs) + " ms, submit " + std::to_string(times.submitMs)
+				+ " ms, stalled " + std::to_string(times.stallMs) + " ms");
+			});
+		gRenderThreadRunning = true;
+		gRenderThread = std::make_unique<std::thread>(renderThreadFn);
 
 		
 	}
@@ -778,7 +731,9 @@ namespace eg::Renderer
 	}
 
 
-	void render(float alpha, float delta)
+	//Everything that reads live simulation state, on the main thread. Packets copy their transforms and animators
+	//snapshot their bones into the frame's buffers, the light subpass reads the world directly so it is recorded here too
+	static void extractFrame(float alpha, float delta)
 	{	
 		auto cmd = begin();
 		auto& frameData = gFrameData[gCurrentFrame];
@@ -787,46 +742,89 @@ namespace eg::Renderer
 		Data::DebugRenderer::updateVertexBuffers();
 		Data::ParticleRenderer::updateBuffers();
 
-		//Give tasks for gBuffer and shadow threads
-		{
-			std::lock_guard lk(gShadowMutex);
-			gShadowThreadReady = true;
-			gShadowCV.notify_one();
-		}
-
-		{
-			std::lock_guard lk(gBufferMutex);
-			gBufferThreadReady = true;
-			gBufferCV.notify_one();
-		}
-
-
-		//Wait for the shadow thread and gBuffer thread to be ready
-		{
-			std::unique_lock lk(gMainThreadMutex);
-			gMainCV.wait(lk, [] {
-				return !gBufferThreadReady && !gShadowThreadReady;
-				});
-		}
-
+		ExtractedFrame& frame = gExtractedFrame;
+		frame.delta = delta;
+		frame.debug = Debug::enabled();
+		frame.shadowInheritance.setRenderPass(Atmosphere::getRenderPass())
+			.setSubpass(0)
+			.setFramebuffer(Atmosphere::getFramebuffer());
+		frame.gBufferInheritance.setRenderPass(DefaultRenderPass::getRenderPass())
+			.setSubpass(0)
+			.setFramebuffer(DefaultRenderPass::getFramebuffer());
+		frame.lightInheritance.setRenderPass(DefaultRenderPass::getRenderPass())
+			.setSubpass(1)
+			.setFramebuffer(DefaultRenderPass::getFramebuffer());
+
+		//Gather, the render functions submit their packets, anything they record directly goes first
+		Recording::beginFrame();
+		frame.shadowBuffers.assign(1, vk::CommandBuffer{});
+		frame.gBufferBuffers.assign(1, vk::CommandBuffer{});
+		frame.shadowTimes.assign(1, 0.0);
+		frame.gBufferTimes.assign(1, 0.0);
+		Recording::dispatch([&frame, alpha](uint32_t context) {
+			auto recordStart = std::chrono::high_resolution_clock::now();
+			vk::CommandBuffer stageCmd = Recording::beginSecondary(context, frame.shadowInheritance);
+			gShadowRenderFn(stageCmd, alpha);
+			Components::StaticModel::flushInstances(RenderStage::SHADOW);
+			stageCmd.end();
+			frame.shadowBuffers[0] = stageCmd;
+			frame.shadowTimes[0] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+			});
+		Recording::dispatch([&frame, alpha](uint32_t context) {
+			auto recordStart = std::chrono::high_resolution_clock::now();
+			vk::CommandBuffer stageCmd = Recording::beginSecondary(context, frame.gBufferInheritance);
+			gBufferRenderFn(stageCmd, alpha);
+			Components::StaticModel::flushInstances(RenderStage::SUBPASS0_GBUFFER);
+			stageCmd.end();
+			frame.gBufferBuffers[0] = stageCmd;
+			frame.gBufferTimes[0] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+			});
+
+		//Light state doesn't depend on what the stages gather
 		Atmosphere::generateCSMMatrices(gCamera->mFov, gCamera->buildView());
 		Atmosphere::updateDirectionalLight();
 		Atmosphere::updateAmbientLight();
+		//The main thread's context is free until it waits
+		frame.lightBuffer = Recording::beginSecondary(Recording::getContextCount() - 1, frame.lightInheritance);
+		Atmosphere::renderAmbientLight(frame.lightBuffer);
+		Atmosphere::renderDirectionalLight(frame.lightBuffer);
+		Data::LightRenderer::beginPointLight(frame.lightBuffer);
+		//Data::SkyRenderer::render(cmd, Data::SkyRenderer::SkySettings{});
+		gLightRenderFn(frame.lightBuffer, alpha);
+		Data::ParticleRenderer::render(frame.lightBuffer);
+		frame.lightBuffer.end();
+		Recording::wait();
+		Components::LevelOfDetail::endFrame();
+
+		//Fills the indirect draws both stages gathered, before their passes begin
+		Components::StaticModel::cullInstances(cmd);
+	}
+
+	//Records the sorted packets and the passes from the extracted frame, on the render thread when frames are pipelined.
+	//Recording::wait runs jobs on the calling thread's context, so the main thread never waits while this runs
+	static void submitFrame()
+	{
+		ExtractedFrame& frame = gExtractedFrame;
+		auto& frameData = gFrameData[gCurrentFrame];
+		vk::CommandBuffer cmd = frameData.commandBuffer;
+
+		//Record, sorted packets in chunks over every context
+		recordStageChunks(RenderStage::SHADOW, frame.shadowInheritance, frame.shadowBuffers, frame.shadowTimes, frame.shadowChunks);
+		recordStageChunks(RenderStage::SUBPASS0_GBUFFER, frame.gBufferInheritance, frame.gBufferBuffers, frame.gBufferTimes, frame.gBufferChunks);
+		Recording::wait();
+		RenderQueue::finish(RenderStage::SHADOW);
+		RenderQueue::finish(RenderStage::SUBPASS0_GBUFFER);
+		gShadowRecordTimeMs = std::accumulate(frame.shadowTimes.begin(), frame.shadowTimes.end(), 0.0);
+		gBufferRecordTimeMs = std::accumulate(frame.gBufferTimes.begin(), frame.gBufferTimes.end(), 0.0);
 
 		Atmosphere::beginDirectionalShadowPass(cmd);
-		cmd.executeCommands(gShadowCmdBuffers[gCurrentFrame]);
+		cmd.executeCommands(frame.shadowBuffers);
 		cmd.endRenderPass();
 
 		DefaultRenderPass::begin(cmd); // subpass 0
-		cmd.executeCommands(gBufferCmdBuffers[gCurrentFrame]);
-		cmd.nextSubpass(vk::SubpassContents::eInline); //Subpass 1
-		Atmosphere::renderAmbientLight(cmd);
-		Atmosphere::renderDirectionalLight(cmd);
-		Data::LightRenderer::beginPointLight(cmd);
-		//Data::SkyRenderer::render(cmd, Data::SkyRenderer::SkySettings{});
-		gLightRenderFn(cmd, frameData.alpha);
-		Data::ParticleRenderer::render(cmd);
-		
+		cmd.executeCommands(frame.gBufferBuffers);
+		cmd.nextSubpass(vk::SubpassContents::eSecondaryCommandBuffers); //Subpass 1
+		cmd.executeCommands(frame.lightBuffer);
 
 		cmd.endRenderPass();
 
@@ -844,9 +842,10 @@ namespace eg::Renderer
 		/*ImGui::Render();
 		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);*/
 		cmd.endRenderPass();
-		Postprocessing::processLuminance(cmd, delta);
+		Postprocessing::processLuminance(cmd, frame.delta);
 
-		Debug::render(cmd);
+		if (frame.debug)
+			Debug::render(cmd);
 
 		//Copy the post processing image to the swapchain image
 		{
@@ -870,7 +869,7 @@ namespace eg::Renderer
 				.setDstOffset({ 0, 0, 0 })
 				.setExtent({ static_cast<uint32_t>(gScreenWidth->value), static_cast<uint32_t>(gScreenHeight->value), 1 });
 
-			cmd.copyImage(Debug::enabled() ? Debug::getImage().getImage() : Postprocessing::getFinalDrawImage().getImage(),
+			cmd.copyImage(frame.debug ? Debug::getImage().getImage() : Postprocessing::getFinalDrawImage().getImage(),
 				vk::ImageLayout::eTransferSrcOptimal,
 				gSwapchainImages[frameData.swapchainIndex], vk::ImageLayout::eTransferDstOptimal, { blitRegion });
 
@@ -897,24 +896,142 @@ namespace eg::Renderer
 		Renderer::end();
 	}
 
-	void destory()
+	//A frame that threw before its submission still owns a reset fence, a recording command buffer and the acquire semaphore.
+	//An empty submission waits on the semaphore and signals the fence, so the slot can be reused and waitIdle returns
+	static void abandonFrame()
+	{
+		auto& frameData = gFrameData[gCurrentFrame];
+		if (!frameData.submitted)
+		{
+			frameData.commandBuffer.reset();
+			vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+			vk::SubmitInfo submitInfo{};
+			submitInfo.setWaitSemaphores(frameData.presentSemaphore)
+				.setWaitDstStageMask(waitStage);
+			std::lock_guard queueLock(gQueueMutex);
+			gMainQueue.submit(submitInfo, frameData.renderFence);
+			frameData.submitted = true;
+		}
+		gCurrentFrame = (gCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	}
+
+	static void renderThreadFn()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock lk(gRenderThreadMutex);
+				gRenderThreadCV.wait(lk, [] {
+					return gFrameExtracted || !gRenderThreadRunning;
+					});
+				if (!gRenderThreadRunning)
+					break;
+			}
+
+			auto submitStart = std::chrono::high_resolution_clock::now();
+			std::exception_ptr error;
+			try
+			{
+				FrameAllocator::CountScope countScope;
+				submitFrame();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+				try
+				{
+					abandonFrame();
+				}
+				catch (const std::exception& e)
+				{
+					Logger::gError("Failed to abandon frame: " + std::string(e.what()));
+				}
+			}
+
+			std::lock_guard lk(gRenderThreadMutex);
+			if (error && !gSubmitError)
+				gSubmitError = error;
+			gFrameTimes.submitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - submitStart).count();
+			gFrameExtracted = false;
+			gRenderThreadCV.notify_all();
+		}
+	}
+
+	void render(float alpha, float delta)
 	{
-		//Stop threads
-		gBufferThreadRunning = false;
+		using Clock = std::chrono::high_resolution_clock;
+		FrameAllocator::CountScope countScope;
+		auto renderStart = Clock::now();
+		waitForSubmit();
+		//Nothing is recording, pipelines can be swapped. The ones a reload queued are bound from here on
+		destroyRetiredObjects(false);
+		HotReload::update();
+		PipelineCache::wait();
+		auto extractStart = Clock::now();
+		extractFrame(alpha, delta);
+		auto extractEnd = Clock::now();
+
+		//The debugger edits live objects and draws ImGui on the main thread, frames stay serial while it is open
+		bool pipelined = gPipelineFramesCVar->value != 0.0 && !gExtractedFrame.debug;
 		{
-			std::lock_guard lk(gBufferMutex);
-			gBufferThreadReady = true;
-			gBufferCV.notify_one();
+			std::lock_guard lk(gRenderThreadMutex);
+			gFrameTimes.simulationMs = gLastRenderEnd ? std::chrono::duration<double, std::milli>(renderStart - *gLastRenderEnd).count() : 0.0;
+			gFrameTimes.stallMs = std::chrono::duration<double, std::milli>(extractStart - renderStart).count();
+			gFrameTimes.extractMs = std::chrono::duration<double, std::milli>(extractEnd - extractStart).count();
+			gFrameTimes.pipelined = pipelined;
+			if (pipelined)
+			{
+				gFrameExtracted = true;
+				gRenderThreadCV.notify_all();
+			}
 		}
-		gBufferThread->join();
 
-		gShadowThreadRunning = false;
+		if (!pipelined)
+		{
+			try
+			{
+				submitFrame();
+			}
+			catch (...)
+			{
+				abandonFrame();
+				throw;
+			}
+			std::lock_guard lk(gRenderThreadMutex);
+			gFrameTimes.submitMs = std::chrono::duration<double, std::milli>(Clock::now() - extractEnd).count();
+		}
+		gLastRenderEnd = Clock::now();
+	}
+
+	void destory()
+	{
+		//Stop threads, a frame that failed on the render thread was abandoned already
+		try
+		{
+			waitForSubmit();
+		}
+		catch (const std::exception& e)
 		{
-			std::lock_guard lk(gShadowMutex);
-			gShadowThreadReady = true;
-			gShadowCV.notify_one();
+			Logger::gError("Failed to submit frame: " + std::string(e.what()));
 		}
-		gShadowThread->join();
+		{
+			std::lock_guard lk(gRenderThreadMutex);
+			gRenderThreadRunning = false;
+			gRenderThreadCV.notify_all();
+		}
+		if (gRenderThread)
+		{
+			gRenderThread->join();
+			gRenderThread.reset();
+		}
+		Recording::destroy();
+		HotReload::destroy();
+		PipelineCache::destroy();
+		{
+			std::lock_guard queueLock(gQueueMutex);
+			gDevice.waitIdle();
+		}
+		destroyRetiredObjects(true);
 
 		Atmosphere::destroy();
 		Postprocessing::destroy();
@@ -924,7 +1041,11 @@ namespace eg::Renderer
 		gDefaultWhiteImage.reset();
 		gDefaultCheckerboardImage.reset();
 
-		
+		RenderQueue::destroy();
+		FrameAllocator::destroy();
+		Bindless::destroy();
+		GeometryPool::destroy();
+		Upload::destroy();
 		gAllocator.destroy();
 		gDevice.destroyDescriptorPool(gDescriptorPool);
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -970,6 +1091,9 @@ namespace eg::Renderer
 		}
 
 		gDevice.resetFences(frameData.renderFence);
+		frameData.submitted = false;
+		gFrameNumber++;
+		FrameAllocator::beginFrame();
 		frameData.swapchainIndex = gDevice.acquireNextImageKHR(gSwapchain, 1000000000, frameData.presentSemaphore, nullptr).value;
 
 		//draw imgui
@@ -1005,16 +1129,26 @@ namespace eg::Renderer
 		cmd.end();
 
 
-		vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+		//Everything uploaded before this frame has to land first
+		uint64_t uploadValue = 0;
+		vk::Semaphore uploadSemaphore = Upload::flushFrame(uploadValue);
+
+		vk::Semaphore waitSemaphores[] = { frameData.presentSemaphore, uploadSemaphore };
+		vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eAllCommands };
+		uint64_t waitValues[] = { 0, uploadValue };
+		vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.setWaitSemaphoreValues(waitValues);
 		vk::SubmitInfo submitInfo{};
-		submitInfo.setWaitSemaphoreCount(1)
-			.setPWaitSemaphores(&frameData.presentSemaphore)
-			.setPWaitDstStageMask(waitStages)
+		submitInfo.setWaitSemaphores(waitSemaphores)
+			.setWaitDstStageMask(waitStages)
+			.setPNext(&timelineInfo)
 			.setCommandBufferCount(1)
 			.setPCommandBuffers(&frameData.commandBuffer)
 			.setSignalSemaphoreCount(1)
 			.setPSignalSemaphores(&frameData.renderSemaphore);
+		std::unique_lock queueLock(gQueueMutex);
 		gMainQueue.submit(submitInfo, frameData.renderFence);
+		frameData.submitted = true;
 		vk::PresentInfoKHR presentInfo{};
 		presentInfo.setWaitSemaphoreCount(1)
 			.setPWaitSemaphores(&frameData.renderSemaphore)
@@ -1030,6 +1164,7 @@ namespace eg::Renderer
 		{
 			Logger::gWarn("Failed to present image: " + std::string(e.what()));
 		}
+		queueLock.unlock();
 		
 		gCurrentFrame = (gCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
@@ -1038,6 +1173,11 @@ namespace eg::Renderer
 	{
 		return gCurrentFrame;
 	}
+
+	uint64_t getFrameNumber()
+	{
+		return gFrameNumber;
+	}
 	vk::Instance getInstance()
 	{
 		return gInstance;
@@ -1045,6 +1185,8 @@ namespace eg::Renderer
 	vk::PhysicalDevice getPhysicalDevice() { return gPhysicalDevice;  }
 	vk::Queue getMainQueue() { return gMainQueue; }
 	uint32_t getMainQueueFamilyIndex() { return gGraphicsQueueFamilyIndex; }
+	vk::Queue getTransferQueue() { return gTransferQueue; }
+	uint32_t getTransferQueueFamilyIndex() { return gTransferQueueFamilyIndex; }
 	vk::DescriptorPool getDescriptorPool() { return gDescriptorPool; }
 	vk::SurfaceCapabilitiesKHR getSurfaceCapabilities() { return gSurfaceCapabilities; }
 	uint32_t getImageCount() { return static_cast<uint32_t>(gSwapchainImages.size()); }
@@ -1082,6 +1224,27 @@ namespace eg::Renderer
 		return gGraphicsQueueFamilyIndex;
 	}
 
+	bool isDrawIndirectCountSupported()
+	{
+		return gDrawIndirectCountSupported;
+	}
+
+	double getShadowRecordTimeMs()
+	{
+		return gShadowRecordTimeMs;
+	}
+
+	double getGBufferRecordTimeMs()
+	{
+		return gBufferRecordTimeMs;
+	}
+
+	FrameTimes getFrameTimes()
+	{
+		std::lock_guard lk(gRenderThreadMutex);
+		return gFrameTimes;
+	}
+
 	void setShadowRenderFunction(RenderFn&& renderFn)
 	{
 		gShadowRenderFn = std::move(renderFn);
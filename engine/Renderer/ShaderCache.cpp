@@ -0,0 +1,354 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <shaderc/shaderc.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+//Set by the build from the installed shaderc and glslang, a compiler update produces different SPIR-V from the same source
+#ifndef EG_SHADER_COMPILER_ID
+#define EG_SHADER_COMPILER_ID "unknown"
+#endif
+
+namespace eg::Renderer::ShaderCache
+{
+	//On disk layout: EntryHeader | Dependency[dependencyCount] | SPIR-V words
+	//A dependency is the content hash of an include, its path length and its path
+	static constexpr char MAGIC[4] = { 'E', 'G', 'S', 'C' };
+
+	struct EntryHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t dependencyCount;
+		uint32_t codeSize; //In words
+	};
+	static_assert(sizeof(EntryHeader) == 24);
+
+	struct Dependency
+	{
+		std::string path;
+		uint64_t hash;
+	};
+
+	using Defines = std::vector<std::pair<std::string, std::string>>;
+	using Clock = std::chrono::high_resolution_clock;
+
+	//Compiling concurrently with one compiler is fine, each call brings its own options
+	static shaderc::Compiler sCompiler;
+	static Command::Var* sEnabledCVar = nullptr;
+	static std::mutex sStatsMutex;
+	static Stats sStats;
+
+	//FNV-1a, chained so a key covers every part in order
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		constexpr uint64_t PRIME = 1099511628211ull;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * PRIME;
+		}
+		return hash;
+	}
+
+	//Length first, so neighbouring strings can't trade characters
+	static uint64_t hashString(const std::string& string, uint64_t hash = 14695981039346656037ull)
+	{
+		uint64_t size = string.size();
+		hash = hashBytes(&size, sizeof(size), hash);
+		return hashBytes(string.data(), string.size(), hash);
+	}
+
+	static bool readFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		if (!in)
+			return false;
+		std::stringstream ss;
+		ss << in.rdbuf();
+		contents = ss.str();
+		return true;
+	}
+
+	//Everything that changes the output except includes, which are checked against the entry.
+	//shaderc_get_spv_version only reports the SPIR-V version it targets, the compiler build is keyed on its own
+	static uint64_t makeKey(const std::string& filePath, const std::string& source, uint32_t kind, Defines defines)
+	{
+		uint32_t spvVersion = 0, spvRevision = 0;
+		shaderc_get_spv_version(&spvVersion, &spvRevision);
+		uint32_t fields[] = { VERSION, spvVersion, spvRevision, kind, static_cast<uint32_t>(shaderc_optimization_level_performance) };
+		uint64_t hash = hashBytes(fields, sizeof(fields));
+		hash = hashString(EG_SHADER_COMPILER_ID, hash);
+		hash = hashString(filePath, hash);
+		hash = hashString(source, hash);
+		//The order defines are passed in doesn't change the output
+		std::sort(defines.begin(), defines.end());
+		for (const auto& [name, value] : defines)
+		{
+			hash = hashString(name, hash);
+			hash = hashString(value, hash);
+		}
+		return hash;
+	}
+
+	static std::string getEntryPath(const std::string& filePath, uint64_t key)
+	{
+		char hashString[17];
+		std::snprintf(hashString, sizeof(hashString), "%016llx", static_cast<unsigned long long>(key));
+		return (std::filesystem::path(DIRECTORY)
+			/ (std::filesystem::path(filePath).stem().string() + "-" + hashString + EXTENSION)).string();
+	}
+
+	static bool load(const std::string& entryPath, uint64_t key, std::vector<uint32_t>& code, std::vector<std::string>& includes)
+	{
+		std::ifstream file(entryPath, std::ios::binary);
+		if (!file)
+			return false;
+		EntryHeader header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+			|| std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.key != key)
+			return false;
+
+		for (uint32_t i = 0; i < header.dependencyCount; i++)
+		{
+			uint64_t hash = 0;
+			uint32_t pathLength = 0;
+			if (!file.read(reinterpret_cast<char*>(&hash), sizeof(hash)) || !file.read(reinterpret_cast<char*>(&pathLength), sizeof(pathLength)))
+				return false;
+			std::string path(pathLength, '\0');
+			if (!file.read(&path[0], pathLength))
+				return false;
+			//An edited include makes the entry stale, it is overwritten by the recompile
+			std::string contents;
+			if (!readFile(path, contents) || hashString(contents) != hash)
+				return false;
+			includes.push_back(path);
+		}
+
+		code.resize(header.codeSize);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t)));
+	}
+
+	static void store(const std::string& entryPath, uint64_t key, const std::vector<Dependency>& dependencies, const std::vector<uint32_t>& code)
+	{
+		EntryHeader header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.key = key;
+		header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		header.codeSize = static_cast<uint32_t>(code.size());
+
+		//Written next to the entry and renamed over it, concurrent compiles of one variant never see a partial file
+		std::filesystem::create_directories(std::filesystem::path(entryPath).parent_path());
+		std::ostringstream tempPath;
+		tempPath << entryPath << ".tmp" << std::hash<std::thread::id>{}(std::this_thread::get_id());
+		{
+			std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+			if (!file)
+				throw std::runtime_error("Can't write shader cache entry: " + tempPath.str());
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (const auto& dependency : dependencies)
+			{
+				uint32_t pathLength = static_cast<uint32_t>(dependency.path.size());
+				file.write(reinterpret_cast<const char*>(&dependency.hash), sizeof(dependency.hash));
+				file.write(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+				file.write(dependency.path.data(), pathLength);
+			}
+			file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+			if (!file)
+				throw std::runtime_error("Can't write shader cache entry: " + tempPath.str());
+		}
+		std::filesystem::rename(tempPath.str(), entryPath);
+	}
+
+	//Resolves includes from the working directory and keeps every file it reads as a dependency of the entry
+	class Includer : public shaderc::CompileOptions::IncluderInterface
+	{
+	private:
+		std::vector<Dependency>& mDependencies;
+	public:
+		Includer(std::vector<Dependency>& dependencies) : mDependencies(dependencies) {}
+
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+		{
+			auto container = new std::array<std::string, 2>;
+			(*container)[0] = requestedSource;
+			if (!readFile((*container)[0], (*container)[1]))
+				Logger::gWarn("compileShaderFromFile, can't open shader file " + (*container)[0]);
+			mDependencies.push_back({ (*container)[0], hashString((*container)[1]) });
+
+			auto data = new shaderc_include_result;
+			data->user_data = container;
+			data->source_name = (*container)[0].data();
+			data->source_name_length = (*container)[0].size();
+			data->content = (*container)[1].data();
+			data->content_length = (*container)[1].size();
+			return data;
+		}
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<std::array<std::string, 2>*>(data->user_data);
+			delete data;
+		}
+	};
+
+	static std::vector<uint32_t> compile(const std::string& filePath, const std::string& source, uint32_t kind,
+		const Defines& defines, std::vector<Dependency>& dependencies)
+	{
+		Logger::gTrace("Compiling shader: " + filePath);
+		shaderc::CompileOptions options;
+		for (const auto& define : defines)
+		{
+			options.AddMacroDefinition(define.first, define.second);
+		}
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+		options.SetIncluder(std::make_unique<Includer>(dependencies));
+
+		shaderc::SpvCompilationResult module = sCompiler.CompileGlslToSpv(source, static_cast<shaderc_shader_kind>(kind),
+			filePath.c_str(), options);
+		if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			Logger::gError(module.GetErrorMessage());
+			throw std::runtime_error("Failed to compile shader !");
+		}
+		return { module.cbegin(), module.cend() };
+	}
+
+	void create()
+	{
+		sEnabledCVar = Command::registerVar("eg::Renderer::ShaderCacheEnabled", "None", 1.0);
+		Command::registerFn("eg::Renderer::PrintShaderCacheStats", [](size_t, char* []) {
+			Stats stats = getStats();
+			Logger::gInfo("ShaderCache: " + std::to_string(stats.hits) + " hits, " + std::to_string(stats.misses) + " misses, "
+				+ std::to_string(stats.loadMs) + " ms loading, " + std::to_string(stats.compileMs) + " ms in shaderc");
+			});
+		Command::registerFn("eg::Renderer::PrecompileShaders", [](size_t argc, char* argv[]) {
+			precompile(argc > 1 ? argv[1] : "shaders/variants.json");
+			});
+	}
+
+	bool isEnabled()
+	{
+		return sEnabledCVar != nullptr && sEnabledCVar->value != 0.0;
+	}
+
+	bool precompile(const std::string& manifestPath)
+	{
+		static const std::unordered_map<std::string, uint32_t> kinds =
+		{
+			{ "vertex", shaderc_glsl_vertex_shader },
+			{ "geometry", shaderc_glsl_geometry_shader },
+			{ "fragment", shaderc_glsl_fragment_shader },
+			{ "compute", shaderc_glsl_compute_shader }
+		};
+
+		std::ifstream file(manifestPath);
+		if (!file)
+			throw std::runtime_error("Can't open shader manifest: " + manifestPath);
+		nlohmann::json manifest = nlohmann::json::parse(file);
+
+		auto start = Clock::now();
+		Stats before = getStats();
+		uint32_t upToDate = 0;
+		for (const auto& variant : manifest.at("variants"))
+		{
+			try
+			{
+				Defines defines;
+				if (variant.contains("defines"))
+				{
+					for (const auto& [name, value] : variant["defines"].items())
+					{
+						defines.emplace_back(name, value.get<std::string>());
+					}
+				}
+				compileShaderFromFile(variant.at("file").get<std::string>(), kinds.at(variant.at("kind").get<std::string>()), defines);
+				upToDate++;
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError("Can't precompile " + variant.dump() + ": " + e.what());
+			}
+		}
+		Stats after = getStats();
+		Logger::gInfo("ShaderCache: " + std::to_string(upToDate) + "/" + std::to_string(manifest.at("variants").size())
+			+ " variants up to date, " + std::to_string(after.misses - before.misses) + " compiled, in "
+			+ std::to_string(std::chrono::duration<double, std::milli>(Clock::now() - start).count()) + " ms");
+		return upToDate == manifest.at("variants").size();
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard lock(sStatsMutex);
+		return sStats;
+	}
+}
+
+namespace eg::Renderer
+{
+	std::vector<uint32_t> compileShaderFromFile(const std::string& filePath, uint32_t kind,
+		std::vector<std::pair<std::string, std::string>> defines)
+	{
+		using namespace ShaderCache;
+		auto start = Clock::now();
+		std::string source;
+		if (!readFile(filePath, source))
+		{
+			throw std::runtime_error("Failed to open shader file ! " + filePath);
+		}
+
+		uint64_t key = makeKey(filePath, source, kind, defines);
+		std::string entryPath = getEntryPath(filePath, key);
+		std::vector<uint32_t> code;
+		std::vector<std::string> includes;
+		if (isEnabled() && load(entryPath, key, code, includes))
+		{
+			HotReload::recordShader(filePath, kind, defines, includes);
+			std::lock_guard lock(sStatsMutex);
+			sStats.hits++;
+			sStats.loadMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			return code;
+		}
+
+		auto compileStart = Clock::now();
+		std::vector<Dependency> dependencies;
+		code = compile(filePath, source, kind, defines, dependencies);
+		auto end = Clock::now();
+		includes.clear();
+		for (const auto& dependency : dependencies)
+		{
+			includes.push_back(dependency.path);
+		}
+		HotReload::recordShader(filePath, kind, defines, includes);
+		if (isEnabled())
+		{
+			try
+			{
+				store(entryPath, key, dependencies, code);
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gWarn(e.what());
+			}
+		}
+
+		std::lock_guard lock(sStatsMutex);
+		sStats.misses++;
+		sStats.loadMs += std::chrono::duration<double, std::milli>(compileStart - start).count();
+		sStats.compileMs += std::chrono::duration<double, std::milli>(end - compileStart).count();
+		return code;
+	}
+}
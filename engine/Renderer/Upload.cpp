@@ -0,0 +1,491 @@
+#include <Renderer.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <chrono>
+#include <deque>
+
+namespace eg::Renderer::Upload
+{
+	//Uploads recorded between two flushes, submitted together
+	struct Batch
+	{
+		Ticket id = 0;
+		vk::CommandPool transferPool;
+		vk::CommandPool graphicsPool;
+		vk::CommandBuffer transferCmd;
+		vk::CommandBuffer graphicsCmd;
+		bool transferUsed = false;
+		bool graphicsUsed = false;
+		size_t ringBytes = 0; //Staging taken from the ring including wrap padding, released once the batch completes
+		size_t ringEnd = 0;
+		std::vector<std::pair<vk::Buffer, vma::Allocation>> dedicated; //Staging for uploads larger than the ring
+	};
+
+	struct Staging
+	{
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		void* mapped;
+	};
+
+	static std::mutex sMutex;
+	static vk::Queue sTransferQueue;
+	static uint32_t sTransferFamily = 0;
+	static bool sTransferIsMain = true;
+	static vk::Semaphore sTransferTimeline;
+	static vk::Semaphore sGraphicsTimeline;
+	static uint64_t sTransferSignaled = 0; //Last value submitted for the transfer timeline
+
+	static vk::Buffer sRingBuffer;
+	static vma::Allocation sRingAllocation;
+	static uint8_t* sRingMapped = nullptr;
+	static size_t sRingCapacity = 0;
+	static size_t sRingHead = 0;
+	static size_t sRingTail = 0;
+	static size_t sRingUsed = 0;
+	static vk::DeviceSize sAlignment = 16;
+
+	static Batch sOpen;
+	static std::deque<Batch> sInFlight;
+	static std::vector<Batch> sFreeBatches;
+	static Ticket sNextId = 1;
+	static Ticket sCompletedId = 0;
+
+	static Stats sFrameStats;
+	static Stats sLastFrameStats;
+	static Stats sTotalStats;
+	static Command::Var* sLogStatsCVar = nullptr;
+
+	using Clock = std::chrono::high_resolution_clock;
+
+	static void addStall(Clock::time_point start)
+	{
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		sFrameStats.stallMs += ms;
+		sTotalStats.stallMs += ms;
+	}
+
+	static Batch createBatch()
+	{
+		vk::Device device = getDevice();
+		Batch batch{};
+		vk::CommandPoolCreateInfo poolCI{};
+		poolCI.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+		vk::CommandBufferAllocateInfo cmdAI{};
+		cmdAI.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(1);
+
+		poolCI.setQueueFamilyIndex(sTransferFamily);
+		batch.transferPool = device.createCommandPool(poolCI);
+		cmdAI.setCommandPool(batch.transferPool);
+		batch.transferCmd = device.allocateCommandBuffers(cmdAI)[0];
+
+		poolCI.setQueueFamilyIndex(getGraphicsQueueFamilyIndex());
+		batch.graphicsPool = device.createCommandPool(poolCI);
+		cmdAI.setCommandPool(batch.graphicsPool);
+		batch.graphicsCmd = device.allocateCommandBuffers(cmdAI)[0];
+		return batch;
+	}
+
+	static void destroyBatch(Batch& batch)
+	{
+		vk::Device device = getDevice();
+		for (auto& [buffer, allocation] : batch.dedicated)
+		{
+			getAllocator().destroyBuffer(buffer, allocation);
+		}
+		batch.dedicated.clear();
+		device.destroyCommandPool(batch.transferPool);
+		device.destroyCommandPool(batch.graphicsPool);
+	}
+
+	static void openBatch()
+	{
+		if (sFreeBatches.empty())
+		{
+			sOpen = createBatch();
+		}
+		else
+		{
+			sOpen = std::move(sFreeBatches.back());
+			sFreeBatches.pop_back();
+		}
+		sOpen.id = sNextId;
+	}
+
+	//Completed batches give their staging back in submission order
+	static void retireCompleted()
+	{
+		if (sInFlight.empty())
+			return;
+		vk::Device device = getDevice();
+		uint64_t transferValue = device.getSemaphoreCounterValue(sTransferTimeline);
+		uint64_t graphicsValue = device.getSemaphoreCounterValue(sGraphicsTimeline);
+		while (!sInFlight.empty())
+		{
+			Batch& batch = sInFlight.front();
+			if ((batch.transferUsed && transferValue < batch.id) || (batch.graphicsUsed && graphicsValue < batch.id))
+				break;
+
+			sRingUsed -= batch.ringBytes;
+			sRingTail = batch.ringEnd;
+			for (auto& [buffer, allocation] : batch.dedicated)
+			{
+				getAllocator().destroyBuffer(buffer, allocation);
+			}
+			batch.dedicated.clear();
+			device.resetCommandPool(batch.transferPool);
+			device.resetCommandPool(batch.graphicsPool);
+			batch.transferUsed = false;
+			batch.graphicsUsed = false;
+			batch.ringBytes = 0;
+			sCompletedId = batch.id;
+			sFreeBatches.push_back(std::move(batch));
+			sInFlight.pop_front();
+		}
+		if (sRingUsed == 0)
+		{
+			sRingHead = 0;
+			sRingTail = 0;
+		}
+	}
+
+	static void submitOpen()
+	{
+		if (!sOpen.transferUsed && !sOpen.graphicsUsed)
+			return;
+
+		if (sOpen.transferUsed)
+		{
+			sOpen.transferCmd.end();
+			vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.setSignalSemaphoreValues(sOpen.id);
+			vk::SubmitInfo submitInfo{};
+			submitInfo.setCommandBuffers(sOpen.transferCmd)
+				.setSignalSemaphores(sTransferTimeline)
+				.setPNext(&timelineInfo);
+			auto queueLock = sTransferIsMain ? lockMainQueue() : std::unique_lock<std::mutex>();
+			sTransferQueue.submit(submitInfo, nullptr);
+			sTransferSignaled = sOpen.id;
+			sFrameStats.submits++;
+			sTotalStats.submits++;
+		}
+		if (sOpen.graphicsUsed)
+		{
+			//Same queue as the frames, every later frame runs after it
+			sOpen.graphicsCmd.end();
+			vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.setSignalSemaphoreValues(sOpen.id);
+			vk::SubmitInfo submitInfo{};
+			submitInfo.setCommandBuffers(sOpen.graphicsCmd)
+				.setSignalSemaphores(sGraphicsTimeline)
+				.setPNext(&timelineInfo);
+			auto queueLock = lockMainQueue();
+			getMainQueue().submit(submitInfo, nullptr);
+			sFrameStats.submits++;
+			sTotalStats.submits++;
+		}
+
+		sOpen.ringEnd = sRingHead;
+		sInFlight.push_back(std::move(sOpen));
+		sNextId++;
+		openBatch();
+	}
+
+	//Blocks on the oldest batch in flight, the lock is released while waiting
+	static void waitOldest(std::unique_lock<std::mutex>& lock)
+	{
+		if (sInFlight.empty())
+			return;
+		const Batch& batch = sInFlight.front();
+		std::vector<vk::Semaphore> semaphores;
+		std::vector<uint64_t> values;
+		if (batch.transferUsed)
+		{
+			semaphores.push_back(sTransferTimeline);
+			values.push_back(batch.id);
+		}
+		if (batch.graphicsUsed)
+		{
+			semaphores.push_back(sGraphicsTimeline);
+			values.push_back(batch.id);
+		}
+
+		auto start = Clock::now();
+		lock.unlock();
+		vk::SemaphoreWaitInfo waitInfo{};
+		waitInfo.setSemaphores(semaphores)
+			.setValues(values);
+		vk::Result result = getDevice().waitSemaphores(waitInfo, UINT64_MAX);
+		lock.lock();
+		addStall(start);
+		if (result != vk::Result::eSuccess)
+			throw std::runtime_error("Upload, failed to wait for a batch");
+		retireCompleted();
+	}
+
+	static std::optional<size_t> tryAllocateRing(size_t size)
+	{
+		if (sRingUsed >= sRingCapacity)
+			return std::nullopt;
+		if (sRingHead >= sRingTail)
+		{
+			//Free space is [head, capacity) then [0, tail)
+			if (sRingHead + size <= sRingCapacity)
+			{
+				size_t offset = sRingHead;
+				sRingHead += size;
+				sRingUsed += size;
+				sOpen.ringBytes += size;
+				return offset;
+			}
+			if (size <= sRingTail)
+			{
+				size_t padding = sRingCapacity - sRingHead;
+				sRingHead = size;
+				sRingUsed += padding + size;
+				sOpen.ringBytes += padding + size;
+				return 0;
+			}
+			return std::nullopt;
+		}
+		if (sRingHead + size <= sRingTail)
+		{
+			size_t offset = sRingHead;
+			sRingHead += size;
+			sRingUsed += size;
+			sOpen.ringBytes += size;
+			return offset;
+		}
+		return std::nullopt;
+	}
+
+	static Staging allocateStaging(std::unique_lock<std::mutex>& lock, size_t size)
+	{
+		size_t alignedSize = (size + sAlignment - 1) / sAlignment * sAlignment;
+		if (alignedSize > sRingCapacity / 2)
+		{
+			vma::AllocationInfo info;
+			auto [buffer, allocation] = getAllocator().createBuffer(
+				vk::BufferCreateInfo{
+					{},
+					size,
+					vk::BufferUsageFlagBits::eTransferSrc,
+				},
+				vma::AllocationCreateInfo{
+					vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+					vma::MemoryUsage::eAutoPreferHost,
+				},
+				info
+				);
+			sOpen.dedicated.emplace_back(buffer, allocation);
+			return { buffer, 0, info.pMappedData };
+		}
+
+		while (true)
+		{
+			retireCompleted();
+			if (auto offset = tryAllocateRing(alignedSize))
+				return { sRingBuffer, *offset, sRingMapped + *offset };
+
+			//Ring is full, what is recorded goes out now and the oldest batch frees its space
+			submitOpen();
+			waitOldest(lock);
+		}
+	}
+
+	static vk::CommandBuffer beginTransfer()
+	{
+		if (!sOpen.transferUsed)
+		{
+			sOpen.transferCmd.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+			sOpen.transferUsed = true;
+		}
+		return sOpen.transferCmd;
+	}
+
+	static vk::CommandBuffer beginGraphics()
+	{
+		if (!sOpen.graphicsUsed)
+		{
+			sOpen.graphicsCmd.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+			sOpen.graphicsUsed = true;
+		}
+		return sOpen.graphicsCmd;
+	}
+
+	static void countCopy(size_t size)
+	{
+		sFrameStats.copies++;
+		sFrameStats.bytes += size;
+		sTotalStats.copies++;
+		sTotalStats.bytes += size;
+	}
+
+	void create()
+	{
+		vk::Device device = getDevice();
+		sTransferQueue = getTransferQueue();
+		sTransferFamily = getTransferQueueFamilyIndex();
+		sTransferIsMain = sTransferFamily == getGraphicsQueueFamilyIndex();
+
+		vk::SemaphoreTypeCreateInfo timelineCI{};
+		timelineCI.setSemaphoreType(vk::SemaphoreType::eTimeline)
+			.setInitialValue(0);
+		vk::SemaphoreCreateInfo semaphoreCI{};
+		semaphoreCI.setPNext(&timelineCI);
+		sTransferTimeline = device.createSemaphore(semaphoreCI);
+		sGraphicsTimeline = device.createSemaphore(semaphoreCI);
+
+		//Copies into block compressed images need offsets aligned to the block and to the device's preference
+		sAlignment = std::max<vk::DeviceSize>(16, getPhysicalDevice().getProperties().limits.optimalBufferCopyOffsetAlignment);
+
+		Command::Var* ringSizeCVar = Command::registerVar("eg::Renderer::UploadRingMB", "None", 64.0);
+		sRingCapacity = static_cast<size_t>(std::max(ringSizeCVar->value, 1.0)) * 1024 * 1024;
+		vma::AllocationInfo info;
+		auto [buffer, allocation] = getAllocator().createBuffer(
+			vk::BufferCreateInfo{
+				{},
+				sRingCapacity,
+				vk::BufferUsageFlagBits::eTransferSrc,
+			},
+			vma::AllocationCreateInfo{
+				vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+				vma::MemoryUsage::eAutoPreferHost,
+			},
+			info
+			);
+		sRingBuffer = buffer;
+		sRingAllocation = allocation;
+		sRingMapped = static_cast<uint8_t*>(info.pMappedData);
+		sRingHead = sRingTail = sRingUsed = 0;
+
+		sNextId = 1;
+		sCompletedId = 0;
+		sTransferSignaled = 0;
+		openBatch();
+
+		sLogStatsCVar = Command::registerVar("eg::Renderer::LogUploadStats", "None", 0.0);
+		Command::registerFn("eg::Renderer::PrintUploadStats", [](size_t, char* []) {
+			Stats frame = getFrameStats();
+			Stats total = getTotalStats();
+			Logger::gInfo("Upload last frame: " + std::to_string(frame.submits) + " submits, " + std::to_string(frame.copies)
+				+ " copies, " + std::to_string(frame.bytes / 1024) + " KB, stalled " + std::to_string(frame.stallMs) + " ms");
+			Logger::gInfo("Upload total: " + std::to_string(total.submits) + " submits, " + std::to_string(total.copies)
+				+ " copies, " + std::to_string(total.bytes / (1024 * 1024)) + " MB, stalled " + std::to_string(total.stallMs) + " ms");
+			});
+		Logger::gInfo(std::string("Upload: ") + (sTransferIsMain ? "sharing the main queue" : "dedicated transfer queue")
+			+ ", " + std::to_string(sRingCapacity / (1024 * 1024)) + " MB staging ring");
+	}
+
+	void destroy()
+	{
+		std::unique_lock lock(sMutex);
+		submitOpen();
+		lock.unlock();
+		waitIdle();
+		lock.lock();
+		retireCompleted();
+
+		destroyBatch(sOpen);
+		for (auto& batch : sFreeBatches)
+		{
+			destroyBatch(batch);
+		}
+		sFreeBatches.clear();
+		getAllocator().destroyBuffer(sRingBuffer, sRingAllocation);
+		getDevice().destroySemaphore(sTransferTimeline);
+		getDevice().destroySemaphore(sGraphicsTimeline);
+		sRingMapped = nullptr;
+		//Resources outliving the renderer don't wait on anything
+		sCompletedId = UINT64_MAX;
+	}
+
+	Ticket copyToBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, size_t size)
+	{
+		if (size == 0)
+			return 0;
+		std::unique_lock lock(sMutex);
+		Staging staging = allocateStaging(lock, size);
+		std::memcpy(staging.mapped, data, size);
+		beginTransfer().copyBuffer(staging.buffer, dst, vk::BufferCopy(staging.offset, dstOffset, size));
+		countCopy(size);
+		return sOpen.id;
+	}
+
+	Ticket recordGraphics(const void* data, size_t size, const GraphicsRecordFn& record)
+	{
+		std::unique_lock lock(sMutex);
+		Staging staging = allocateStaging(lock, size);
+		std::memcpy(staging.mapped, data, size);
+		record(beginGraphics(), staging.buffer, staging.offset);
+		countCopy(size);
+		return sOpen.id;
+	}
+
+	void flush()
+	{
+		std::lock_guard lock(sMutex);
+		submitOpen();
+	}
+
+	bool isComplete(Ticket ticket)
+	{
+		std::lock_guard lock(sMutex);
+		if (ticket <= sCompletedId)
+			return true;
+		retireCompleted();
+		return ticket <= sCompletedId;
+	}
+
+	void wait(Ticket ticket)
+	{
+		std::unique_lock lock(sMutex);
+		if (ticket <= sCompletedId)
+			return;
+		if (ticket == sOpen.id)
+			submitOpen();
+		while (ticket > sCompletedId && !sInFlight.empty())
+		{
+			waitOldest(lock);
+		}
+	}
+
+	vk::Semaphore flushFrame(uint64_t& waitValue)
+	{
+		std::lock_guard lock(sMutex);
+		submitOpen();
+		retireCompleted();
+
+		sLastFrameStats = sFrameStats;
+		sFrameStats = {};
+		if (sLogStatsCVar->value != 0.0 && sLastFrameStats.copies > 0)
+		{
+			Logger::gInfo("Upload: " + std::to_string(sLastFrameStats.submits) + " submits, " + std::to_string(sLastFrameStats.copies)
+				+ " copies, " + std::to_string(sLastFrameStats.bytes / 1024) + " KB, stalled " + std::to_string(sLastFrameStats.stallMs) + " ms");
+		}
+
+		waitValue = sTransferSignaled;
+		return sTransferTimeline;
+	}
+
+	std::vector<uint32_t> getSharedQueueFamilies()
+	{
+		if (sTransferIsMain)
+			return {};
+		return { getGraphicsQueueFamilyIndex(), sTransferFamily };
+	}
+
+	Stats getFrameStats()
+	{
+		std::lock_guard lock(sMutex);
+		return sLastFrameStats;
+	}
+
+	Stats getTotalStats()
+	{
+		std::lock_guard lock(sMutex);
+		return sTotalStats;
+	}
+}
@@ -13,13 +13,8 @@ namespace eg::World
 {
 	DynamicWorldObject::~DynamicWorldObject()
 	{
-		const JPH::BodyLockInterface& lockInterface = Physics::getPhysicsSystem().GetBodyLockInterface();
-		JPH::BodyLockRead lockRead(lockInterface, mBody.mBodyID);
-		bool valid = lockRead.Succeeded();
-		lockRead.ReleaseLock();
-		if (!valid) return; // Body already removed or invalid
-		eg::Physics::getBodyInterface()->RemoveBody(mBody.mBodyID);
-		eg::Physics::getBodyInterface()->DestroyBody(mBody.mBodyID);
+		getTransformHierarchy().destroy(mNode);
+		mBody.destroy();
 	}
 	void DynamicWorldObject::fromJson(const nlohmann::json& json)
 	{
@@ -28,7 +23,7 @@ namespace eg::World
 			json["body"]["position"].at(1).get<float>(),
 			json["body"]["position"].at(2).get<float>() };
 
-		mModel = eg::Components::ModelCache::loadStaticModel(modelPath);
+		mModel = eg::Components::ModelCache::loadStaticModelAsync(modelPath);
 
 		//Create rigid body
 		{
@@ -55,9 +50,27 @@ namespace eg::World
 
 		}
 	}
+	bool DynamicWorldObject::onPoolAcquire(const nlohmann::json& json)
+	{
+		glm::vec3 position = { json["body"]["position"].at(0).get<float>(),
+			json["body"]["position"].at(1).get<float>(),
+			json["body"]["position"].at(2).get<float>() };
+
+		//Shape is the same for every instance, only the model and placement change
+		mModel = eg::Components::ModelCache::loadStaticModelAsync(json["model"]["path"].get<std::string>());
+		mBody.unpark(position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		return true;
+	}
 	void DynamicWorldObject::update(float delta, float alpha)
 	{
 
+	}
+	void DynamicWorldObject::updateTransform(float alpha)
+	{
+		TransformHierarchy& hierarchy = getTransformHierarchy();
+		if (mNode == TransformHierarchy::INVALID_HANDLE)
+			mNode = hierarchy.create();
+		hierarchy.setLocal(mNode, mBody.getBodyMatrix(alpha));
 	}
 	void DynamicWorldObject::fixedUpdate(float delta)
 	{
@@ -65,18 +78,26 @@ namespace eg::World
 	}
 	void DynamicWorldObject::render(vk::CommandBuffer cmd, float alpha, Renderer::RenderStage stage)
 	{
-		glm::mat4x4 mat = mBody.getBodyMatrix(alpha);
+		if (mNode == TransformHierarchy::INVALID_HANDLE)
+			return;
+		const glm::mat4x4& mat = getTransformHierarchy().getWorld(mNode);
+		//Placeholder until the model has finished loading
+		Components::StaticModel* model = mModel.get().get();
+		if (!model)
+			model = Components::ModelCache::getPlaceholder().get();
+		if (!model)
+			return;
 
 		switch (stage)
 		{
 		case Renderer::RenderStage::SHADOW:
 		{
-			mModel->renderShadow(cmd, mat);
+			model->renderShadow(cmd, mat);
 			break;
 		}
 		case Renderer::RenderStage::SUBPASS0_GBUFFER:
 		{
-			mModel->render(cmd,  mat);
+			model->render(cmd,  mat);
 			break;
 		}
 
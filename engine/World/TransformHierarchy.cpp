@@ -0,0 +1,376 @@
+#include <World.h>
+#include <Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace eg::World
+{
+	TransformHierarchy::Handle TransformHierarchy::create(Handle parent, const glm::mat4x4& local)
+	{
+		if (parent != INVALID_HANDLE && !isValid(parent))
+		{
+			Logger::gWarn("TransformHierarchy::create, invalid parent handle !");
+			parent = INVALID_HANDLE;
+		}
+
+		Handle handle;
+		if (!mFreeHandles.empty())
+		{
+			handle = mFreeHandles.back();
+			mFreeHandles.pop_back();
+		}
+		else
+		{
+			handle = static_cast<Handle>(mHandleToIndex.size());
+			mHandleToIndex.push_back(INVALID_INDEX);
+			mFirstChild.push_back(INVALID_HANDLE);
+			mNextSibling.push_back(INVALID_HANDLE);
+			mPrevSibling.push_back(INVALID_HANDLE);
+		}
+
+		//Appending keeps the depth ordering valid, the parent already lives at a lower index
+		uint32_t index = static_cast<uint32_t>(mHandles.size());
+		mParents.push_back(parent == INVALID_HANDLE ? INVALID_INDEX : mHandleToIndex[parent]);
+		mDirty.push_back(0);
+		mLocals.push_back(local);
+		mWorlds.push_back(local);
+		mHandles.push_back(handle);
+		mHandleToIndex[handle] = index;
+		link(handle, parent);
+
+		markDirty(index);
+		return handle;
+	}
+
+	void TransformHierarchy::destroy(Handle handle)
+	{
+		if (!isValid(handle))
+			return;
+		uint32_t index = mHandleToIndex[handle];
+		Handle parent = getParent(handle);
+		unlink(handle, parent);
+
+		//Children are re-attached to the grandparent, their world transform stays the same
+		for (Handle child = mFirstChild[handle]; child != INVALID_HANDLE;)
+		{
+			Handle next = mNextSibling[child];
+			uint32_t i = mHandleToIndex[child];
+			mParents[i] = mParents[index];
+			mLocals[i] = mLocals[index] * mLocals[i];
+			mNextSibling[child] = INVALID_HANDLE;
+			mPrevSibling[child] = INVALID_HANDLE;
+			link(child, parent);
+			markDirty(i);
+			child = next;
+		}
+		mFirstChild[handle] = INVALID_HANDLE;
+
+		//Leave a tombstone, the slot is compacted away on the next update
+		mHandles[index] = INVALID_HANDLE;
+		mParents[index] = INVALID_INDEX;
+		mDirty[index] = 0;
+		mHandleToIndex[handle] = INVALID_INDEX;
+		mFreeHandles.push_back(handle);
+		mNeedsRebuild = true;
+	}
+
+	void TransformHierarchy::clear()
+	{
+		mParents.clear();
+		mDirty.clear();
+		mLocals.clear();
+		mWorlds.clear();
+		mHandles.clear();
+		mHandleToIndex.clear();
+		mFreeHandles.clear();
+		mFirstChild.clear();
+		mNextSibling.clear();
+		mPrevSibling.clear();
+		mFirstDirty = INVALID_INDEX;
+		mLastUpdatedCount = 0;
+		mNeedsRebuild = false;
+	}
+
+	void TransformHierarchy::reserve(size_t count)
+	{
+		mParents.reserve(count);
+		mDirty.reserve(count);
+		mLocals.reserve(count);
+		mWorlds.reserve(count);
+		mHandles.reserve(count);
+		mHandleToIndex.reserve(count);
+		mFirstChild.reserve(count);
+		mNextSibling.reserve(count);
+		mPrevSibling.reserve(count);
+	}
+
+	void TransformHierarchy::setParent(Handle handle, Handle parent)
+	{
+		if (!isValid(handle) || (parent != INVALID_HANDLE && !isValid(parent)))
+		{
+			Logger::gWarn("TransformHierarchy::setParent, invalid handle !");
+			return;
+		}
+		uint32_t index = mHandleToIndex[handle];
+		uint32_t parentIndex = parent == INVALID_HANDLE ? INVALID_INDEX : mHandleToIndex[parent];
+
+		//Reject cycles
+		for (uint32_t p = parentIndex; p != INVALID_INDEX; p = mParents[p])
+		{
+			if (p == index)
+			{
+				Logger::gWarn("TransformHierarchy::setParent, parent is a descendant of the node !");
+				return;
+			}
+		}
+
+		unlink(handle, getParent(handle));
+		link(handle, parent);
+		mParents[index] = parentIndex;
+		if (parentIndex != INVALID_INDEX && parentIndex > index)
+			mNeedsRebuild = true;
+		markDirty(index);
+	}
+
+	void TransformHierarchy::setLocal(Handle handle, const glm::mat4x4& local)
+	{
+		if (!isValid(handle))
+			return;
+		uint32_t index = mHandleToIndex[handle];
+		mLocals[index] = local;
+		markDirty(index);
+	}
+
+	TransformHierarchy::Handle TransformHierarchy::getParent(Handle handle) const
+	{
+		if (!isValid(handle))
+			return INVALID_HANDLE;
+		uint32_t parentIndex = mParents[mHandleToIndex[handle]];
+		return parentIndex == INVALID_INDEX ? INVALID_HANDLE : mHandles[parentIndex];
+	}
+
+	bool TransformHierarchy::isValid(Handle handle) const
+	{
+		//Objects that never got a node may be destroyed off the main thread, don't touch the tables for them
+		if (handle == INVALID_HANDLE)
+			return false;
+		return handle < mHandleToIndex.size() && mHandleToIndex[handle] != INVALID_INDEX;
+	}
+
+	void TransformHierarchy::update()
+	{
+		if (mNeedsRebuild)
+			rebuild();
+
+		mLastUpdatedCount = 0;
+		if (mFirstDirty == INVALID_INDEX)
+			return;
+
+		//Parents precede children, so a dirty flag reaches the whole subtree in a single pass
+		const uint32_t count = static_cast<uint32_t>(mHandles.size());
+		for (uint32_t i = mFirstDirty; i < count; i++)
+		{
+			uint32_t parent = mParents[i];
+			if (parent != INVALID_INDEX && mDirty[parent])
+				mDirty[i] = 1;
+			if (!mDirty[i])
+				continue;
+
+			mWorlds[i] = parent == INVALID_INDEX ? mLocals[i] : mWorlds[parent] * mLocals[i];
+			mLastUpdatedCount++;
+		}
+
+		std::fill(mDirty.begin() + mFirstDirty, mDirty.end(), static_cast<uint8_t>(0));
+		mFirstDirty = INVALID_INDEX;
+	}
+
+	void TransformHierarchy::markDirty(uint32_t index)
+	{
+		mDirty[index] = 1;
+		mFirstDirty = std::min(mFirstDirty, index);
+	}
+
+	void TransformHierarchy::link(Handle handle, Handle parent)
+	{
+		if (parent == INVALID_HANDLE)
+			return;
+		Handle first = mFirstChild[parent];
+		mNextSibling[handle] = first;
+		mPrevSibling[handle] = INVALID_HANDLE;
+		if (first != INVALID_HANDLE)
+			mPrevSibling[first] = handle;
+		mFirstChild[parent] = handle;
+	}
+
+	void TransformHierarchy::unlink(Handle handle, Handle parent)
+	{
+		Handle prev = mPrevSibling[handle];
+		Handle next = mNextSibling[handle];
+		if (prev != INVALID_HANDLE)
+			mNextSibling[prev] = next;
+		else if (parent != INVALID_HANDLE)
+			mFirstChild[parent] = next;
+		if (next != INVALID_HANDLE)
+			mPrevSibling[next] = prev;
+		mNextSibling[handle] = INVALID_HANDLE;
+		mPrevSibling[handle] = INVALID_HANDLE;
+	}
+
+	void TransformHierarchy::rebuild()
+	{
+		const uint32_t count = static_cast<uint32_t>(mHandles.size());
+
+		//Compute depth of every live node
+		std::vector<uint32_t> depths(count, INVALID_INDEX);
+		std::vector<uint32_t> chain;
+		uint32_t maxDepth = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (mHandles[i] == INVALID_HANDLE || depths[i] != INVALID_INDEX)
+				continue;
+
+			chain.clear();
+			uint32_t node = i;
+			while (node != INVALID_INDEX && depths[node] == INVALID_INDEX)
+			{
+				chain.push_back(node);
+				node = mParents[node];
+			}
+			uint32_t depth = node == INVALID_INDEX ? 0 : depths[node] + 1;
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			{
+				depths[*it] = depth++;
+			}
+			maxDepth = std::max(maxDepth, depth);
+		}
+
+		//Stable counting sort by depth, tombstones are dropped
+		std::vector<uint32_t> offsets(maxDepth + 1, 0);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (mHandles[i] != INVALID_HANDLE)
+				offsets[depths[i]]++;
+		}
+		uint32_t liveCount = 0;
+		for (auto& offset : offsets)
+		{
+			uint32_t n = offset;
+			offset = liveCount;
+			liveCount += n;
+		}
+
+		std::vector<uint32_t> remap(count, INVALID_INDEX);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (mHandles[i] != INVALID_HANDLE)
+				remap[i] = offsets[depths[i]]++;
+		}
+
+		std::vector<uint32_t> parents(liveCount);
+		std::vector<uint8_t> dirty(liveCount);
+		std::vector<glm::mat4x4> locals(liveCount);
+		std::vector<glm::mat4x4> worlds(liveCount);
+		std::vector<Handle> handles(liveCount);
+		mFirstDirty = INVALID_INDEX;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t dst = remap[i];
+			if (dst == INVALID_INDEX)
+				continue;
+			parents[dst] = mParents[i] == INVALID_INDEX ? INVALID_INDEX : remap[mParents[i]];
+			dirty[dst] = mDirty[i];
+			locals[dst] = mLocals[i];
+			worlds[dst] = mWorlds[i];
+			handles[dst] = mHandles[i];
+			mHandleToIndex[mHandles[i]] = dst;
+			if (mDirty[i])
+				mFirstDirty = std::min(mFirstDirty, dst);
+		}
+
+		mParents = std::move(parents);
+		mDirty = std::move(dirty);
+		mLocals = std::move(locals);
+		mWorlds = std::move(worlds);
+		mHandles = std::move(handles);
+		mNeedsRebuild = false;
+	}
+
+	void benchmarkTransformHierarchy(uint32_t nodeCount)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		static constexpr uint32_t ITERATIONS = 10;
+
+		enum class Shape { Deep, Wide, Tree };
+		const std::pair<Shape, const char*> shapes[] =
+		{
+			{ Shape::Deep, "deep" },
+			{ Shape::Wide, "wide" },
+			{ Shape::Tree, "tree(4)" },
+		};
+
+		const glm::mat4x4 offset = glm::translate(glm::mat4x4(1.0f), glm::vec3(0.0f, 0.01f, 0.0f));
+		for (const auto& [shape, name] : shapes)
+		{
+			TransformHierarchy hierarchy;
+			std::vector<TransformHierarchy::Handle> handles;
+			handles.reserve(nodeCount);
+			hierarchy.reserve(nodeCount);
+
+			auto start = Clock::now();
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				TransformHierarchy::Handle parent = TransformHierarchy::INVALID_HANDLE;
+				if (i > 0)
+				{
+					switch (shape)
+					{
+					case Shape::Deep: parent = handles[i - 1]; break;
+					case Shape::Wide: parent = handles[0]; break;
+					case Shape::Tree: parent = handles[(i - 1) / 4]; break;
+					}
+				}
+				handles.push_back(hierarchy.create(parent, offset));
+			}
+			hierarchy.update();
+			double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			//Whole hierarchy dirty through its root
+			start = Clock::now();
+			for (uint32_t it = 0; it < ITERATIONS; it++)
+			{
+				hierarchy.setLocal(handles[0], offset);
+				hierarchy.update();
+			}
+			double rootMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ITERATIONS;
+
+			//1% of the nodes dirty, spread over the last depth levels
+			uint32_t sparseCount = std::max(1u, nodeCount / 100);
+			start = Clock::now();
+			for (uint32_t it = 0; it < ITERATIONS; it++)
+			{
+				for (uint32_t i = 0; i < sparseCount; i++)
+				{
+					hierarchy.setLocal(handles[nodeCount - 1 - i * 97 % nodeCount], offset);
+				}
+				hierarchy.update();
+			}
+			double sparseMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ITERATIONS;
+			uint32_t sparseUpdated = hierarchy.getLastUpdatedCount();
+
+			//Nothing dirty
+			start = Clock::now();
+			for (uint32_t it = 0; it < ITERATIONS; it++)
+			{
+				hierarchy.update();
+			}
+			double cleanMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / ITERATIONS;
+
+			Logger::gInfo("TransformHierarchy benchmark [" + std::string(name) + ", " + std::to_string(nodeCount) + " nodes]: build "
+				+ std::to_string(buildMs) + " ms, root dirty " + std::to_string(rootMs) + " ms, 1% dirty "
+				+ std::to_string(sparseMs) + " ms (" + std::to_string(sparseUpdated) + " recomputed), clean "
+				+ std::to_string(cleanMs) + " ms");
+		}
+	}
+}
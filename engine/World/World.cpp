@@ -1,39 +1,275 @@
 #include <World.h>
 #include <Physics.h>
+#include <Core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace eg::World
 {
 	static std::string sWorldName = "Default";
 	static std::vector<std::unique_ptr<IGameObject>> sGameObjects;
 	static std::vector<JsonToIGameObjectDispatcher> sJsonToIGameObjectDispatchers;
+	static TransformHierarchy sTransformHierarchy;
+
+	//Removed objects may still be referenced by frames in flight
+	struct RetiredGameObject
+	{
+		std::unique_ptr<IGameObject> object;
+		size_t framesLeft;
+	};
+	static std::vector<RetiredGameObject> sRetiredGameObjects;
+	static std::vector<IObjectPool*> sObjectPools;
+
+	//Per phase iteration lists, only rebuilt when membership changes
+	static std::vector<IGameObject*> sUpdateList;
+	static std::vector<IGameObject*> sPrePhysicsList;
+	static std::vector<IGameObject*> sFixedUpdateList;
+	static size_t sActiveObjectCount = 0;
+	static bool sUpdateListsDirty = true;
+	static std::unordered_map<uint32_t, IGameObject*> sBodyToGameObject;
+	static std::unordered_set<const IGameObject*> sSleepingGameObjects;
+	static std::unordered_map<const IGameObject*, uint64_t> sSaveIds;
+	static uint64_t sNextSaveId = 0;
+
+	//Activation changes reported by Jolt, applied on the main thread
+	struct ActivationEvent
+	{
+		JPH::BodyID body;
+		bool active;
+	};
+	static std::mutex sActivationMutex;
+	static std::vector<ActivationEvent> sActivationEvents;
+	static std::vector<ActivationEvent> sActivationEventsScratch;
+	//Last activation state of each object this tick, sorted by object. Cleared, its capacity stays across ticks
+	static std::vector<std::pair<IGameObject*, bool>> sFinalStatesScratch;
+
+	class WorldBodyActivationListener final : public JPH::BodyActivationListener
+	{
+	public:
+		virtual void OnBodyActivated(const JPH::BodyID& inBodyID, JPH::uint64 inBodyUserData) override
+		{
+			std::lock_guard lk(sActivationMutex);
+			sActivationEvents.push_back({ inBodyID, true });
+		}
+
+		virtual void OnBodyDeactivated(const JPH::BodyID& inBodyID, JPH::uint64 inBodyUserData) override
+		{
+			std::lock_guard lk(sActivationMutex);
+			sActivationEvents.push_back({ inBodyID, false });
+		}
+	};
+	static WorldBodyActivationListener sActivationListener;
+
+	static void rebuildUpdateLists()
+	{
+		sUpdateList.clear();
+		sPrePhysicsList.clear();
+		sFixedUpdateList.clear();
+		sActiveObjectCount = 0;
+		for (const auto& obj : sGameObjects)
+		{
+			uint32_t phases = obj->getUpdatePhases();
+			if (phases & IGameObject::PHASE_UPDATE)
+				sUpdateList.push_back(obj.get());
+			if (sSleepingGameObjects.find(obj.get()) != sSleepingGameObjects.end())
+				continue;
+			if (phases & IGameObject::PHASE_PRE_PHYSICS)
+				sPrePhysicsList.push_back(obj.get());
+			if (phases & IGameObject::PHASE_FIXED_UPDATE)
+				sFixedUpdateList.push_back(obj.get());
+			if (phases & (IGameObject::PHASE_PRE_PHYSICS | IGameObject::PHASE_FIXED_UPDATE))
+				sActiveObjectCount++;
+		}
+		sUpdateListsDirty = false;
+	}
+
+	IObjectPool::IObjectPool(const std::string& type) :
+		mType(type)
+	{
+		sObjectPools.push_back(this);
+	}
+
+	IObjectPool::~IObjectPool()
+	{
+		sObjectPools.erase(std::remove(sObjectPools.begin(), sObjectPools.end(), this), sObjectPools.end());
+	}
 
 	void create()
 	{
-		
+		Physics::setBodyActivationListener(&sActivationListener);
+		Streaming::create();
+		Journal::create();
+		Command::registerFn("eg::World::BenchmarkTransformHierarchy", [](size_t argc, char* argv[]) {
+			uint32_t nodeCount = 100000;
+			if (argc > 1)
+			{
+				try
+				{
+					nodeCount = static_cast<uint32_t>(std::stoul(argv[1]));
+				}
+				catch (const std::exception&)
+				{
+					Logger::gWarn("eg::World::BenchmarkTransformHierarchy <nodeCount>");
+					return;
+				}
+			}
+			benchmarkTransformHierarchy(nodeCount);
+			});
+		Command::registerFn("eg::World::ConvertToBinary", [](size_t argc, char* argv[]) {
+			if (argc < 3)
+			{
+				Logger::gError("Usage: eg::World::ConvertToBinary <input.json> <output.egw>");
+				return;
+			}
+			try
+			{
+				Binary::convertJsonToBinary(argv[1], argv[2]);
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError(e.what());
+			}
+			});
+		Command::registerFn("eg::World::ConvertToJson", [](size_t argc, char* argv[]) {
+			if (argc < 3)
+			{
+				Logger::gError("Usage: eg::World::ConvertToJson <input.egw> <output.json>");
+				return;
+			}
+			try
+			{
+				Binary::convertBinaryToJson(argv[1], argv[2]);
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError(e.what());
+			}
+			});
+		Command::registerFn("eg::World::BenchmarkBinary", [](size_t argc, char* argv[]) {
+			uint32_t objectCount = 100000;
+			if (argc > 1)
+			{
+				try
+				{
+					objectCount = static_cast<uint32_t>(std::stoul(argv[1]));
+				}
+				catch (...)
+				{
+					Logger::gError("Invalid object count for eg::World::BenchmarkBinary");
+					return;
+				}
+			}
+			Binary::benchmark(objectCount);
+			});
 	}
 	void destroy()
 	{
+		Journal::end();
+		Streaming::destroy();
 		sGameObjects.clear();
 		cleanup();
+		Journal::destroy();
+		Physics::setBodyActivationListener(nullptr);
 	}
 
 	void cleanup()
 	{
+		//The journal belongs to the world being unloaded
+		Journal::end();
 		Renderer::waitIdle();
 		Components::ParticleEmitter::clearAtlasTextures();
-		Components::ModelCache::clearCache();
+		Streaming::reset();
 		sGameObjects.clear();
+		sRetiredGameObjects.clear();
+		//Assets shared with the next world stay resident within the budget
+		Components::ModelCache::trim();
+		sUpdateList.clear();
+		sPrePhysicsList.clear();
+		sFixedUpdateList.clear();
+		sActiveObjectCount = 0;
+		sUpdateListsDirty = true;
+		sBodyToGameObject.clear();
+		sSleepingGameObjects.clear();
+		sSaveIds.clear();
+		sNextSaveId = 0;
+		{
+			std::lock_guard lk(sActivationMutex);
+			sActivationEvents.clear();
+		}
+		//Parked bodies must go before the physics system is reset
+		for (IObjectPool* pool : sObjectPools)
+			pool->clear();
+		sTransformHierarchy.clear();
 		Physics::reset();
 	}
 
 	void addGameObject(std::unique_ptr<IGameObject> gameobject)
 	{
+		JPH::BodyID body = gameobject->getSleepBody();
+		if (!body.IsInvalid())
+		{
+			sBodyToGameObject[body.GetIndexAndSequenceNumber()] = gameobject.get();
+			if (!Physics::getBodyInterface()->IsActive(body))
+				sSleepingGameObjects.insert(gameobject.get());
+		}
+		sSaveIds[gameobject.get()] = sNextSaveId++;
+		//Sleeping and static objects keep this transform until their body moves again
+		gameobject->updateTransform(1.0f);
+		Journal::onObjectAdded(gameobject.get());
 		sGameObjects.push_back(std::move(gameobject));
+		sUpdateListsDirty = true;
 	}
 
 	void removeGameObject(const IGameObject* gameObject)
 	{
-		//TODO: Implement
+		retireGameObject(detachGameObject(gameObject));
+	}
+
+	std::unique_ptr<IGameObject> detachGameObject(const IGameObject* gameObject)
+	{
+		auto it = std::find_if(sGameObjects.begin(), sGameObjects.end(),
+			[gameObject](const std::unique_ptr<IGameObject>& obj) { return obj.get() == gameObject; });
+		if (it == sGameObjects.end())
+			return nullptr;
+
+		std::unique_ptr<IGameObject> owned = std::move(*it);
+		sGameObjects.erase(it);
+
+		JPH::BodyID body = owned->getSleepBody();
+		if (!body.IsInvalid())
+			sBodyToGameObject.erase(body.GetIndexAndSequenceNumber());
+		sSleepingGameObjects.erase(owned.get());
+		sUpdateListsDirty = true;
+
+		auto saveId = sSaveIds.find(owned.get());
+		if (saveId != sSaveIds.end())
+		{
+			Journal::onObjectDetached(owned.get(), saveId->second);
+			sSaveIds.erase(saveId);
+		}
+		return owned;
+	}
+
+	void retireGameObject(std::unique_ptr<IGameObject> gameObject)
+	{
+		if (!gameObject)
+			return;
+		gameObject->onRetire();
+		sRetiredGameObjects.push_back({ std::move(gameObject), Renderer::RETIRE_FRAME_COUNT });
+	}
+
+	IObjectPool* findObjectPool(const std::string& type)
+	{
+		for (IObjectPool* pool : sObjectPools)
+		{
+			if (pool->getType() == type)
+				return pool;
+		}
+		return nullptr;
 	}
 
 	std::vector<std::unique_ptr<IGameObject>>& getGameObjects()
@@ -41,19 +277,146 @@ namespace eg::World
 		return sGameObjects;
 	}
 
+	bool findGameObjectPosition(const nlohmann::json& json, glm::vec3& position)
+	{
+		if (!json.is_object())
+			return false;
+
+		auto it = json.find("position");
+		if (it != json.end() && it->is_array() && it->size() >= 3 && it->at(0).is_number())
+		{
+			position = { it->at(0).get<float>(), it->at(1).get<float>(), it->at(2).get<float>() };
+			return true;
+		}
+		for (const auto& [key, value] : json.items())
+		{
+			if (value.is_object() && findGameObjectPosition(value, position))
+				return true;
+		}
+		return false;
+	}
+
+	size_t getActiveObjectCount()
+	{
+		return sActiveObjectCount;
+	}
+
+	bool isGameObjectSleeping(const IGameObject* gameObject)
+	{
+		return sSleepingGameObjects.find(gameObject) != sSleepingGameObjects.end();
+	}
+
+	uint64_t getSaveId(const IGameObject* gameObject)
+	{
+		auto it = sSaveIds.find(gameObject);
+		return it == sSaveIds.end() ? std::numeric_limits<uint64_t>::max() : it->second;
+	}
+
+	void setSaveId(const IGameObject* gameObject, uint64_t saveId)
+	{
+		sSaveIds[gameObject] = saveId;
+		sNextSaveId = std::max(sNextSaveId, saveId + 1);
+	}
+
+	uint64_t allocateSaveId()
+	{
+		return sNextSaveId++;
+	}
+
+	TransformHierarchy& getTransformHierarchy()
+	{
+		return sTransformHierarchy;
+	}
+
+	const std::string& getWorldName()
+	{
+		return sWorldName;
+	}
+
+	void setWorldName(const std::string& name)
+	{
+		sWorldName = name;
+	}
+
 	void update(float delta, float alpha)
 	{
-		for (auto& obj : sGameObjects)
+		if (sUpdateListsDirty)
+			rebuildUpdateLists();
+		for (IGameObject* obj : sUpdateList)
 			obj->update(delta, alpha);
+
+		//Release objects once every frame that could reference them has completed
+		for (auto it = sRetiredGameObjects.begin(); it != sRetiredGameObjects.end();)
+		{
+			if (--it->framesLeft == 0)
+				it = sRetiredGameObjects.erase(it);
+			else
+				++it;
+		}
+		Components::ModelCache::update();
+
+		//Only awake bodies move, resolve world matrices before render
+		for (IGameObject* obj : sPrePhysicsList)
+			obj->updateTransform(alpha);
+		sTransformHierarchy.update();
+
+		//Every object has finished its update, a consistent point to snapshot changes
+		Journal::update(delta);
 	}
 	void prePhysicsUpdate(float delta)
 	{
-		for (auto& obj : sGameObjects)
+		{
+			std::lock_guard lk(sActivationMutex);
+			sActivationEventsScratch.swap(sActivationEvents);
+		}
+
+		//Only the last event of a body counts, wake ups are applied right away
+		auto& finalStates = sFinalStatesScratch;
+		for (const auto& event : sActivationEventsScratch)
+		{
+			auto it = sBodyToGameObject.find(event.body.GetIndexAndSequenceNumber());
+			if (it == sBodyToGameObject.end())
+				continue;
+			auto state = std::lower_bound(finalStates.begin(), finalStates.end(), it->second,
+				[](const std::pair<IGameObject*, bool>& entry, IGameObject* obj) { return entry.first < obj; });
+			if (state != finalStates.end() && state->first == it->second)
+				state->second = event.active;
+			else
+				finalStates.insert(state, { it->second, event.active });
+		}
+		sActivationEventsScratch.clear();
+		for (const auto& [obj, active] : finalStates)
+		{
+			if (active && sSleepingGameObjects.erase(obj) != 0)
+				sUpdateListsDirty = true;
+		}
+
+		if (sUpdateListsDirty)
+			rebuildUpdateLists();
+		for (IGameObject* obj : sPrePhysicsList)
 			obj->prePhysicsUpdate(delta);
+
+		//Objects that fell asleep got one more pass to snapshot their final state
+		for (const auto& [obj, active] : finalStates)
+		{
+			if (active)
+				continue;
+			//The object may have been removed by the pass above
+			auto it = sBodyToGameObject.find(obj->getSleepBody().GetIndexAndSequenceNumber());
+			if (it != sBodyToGameObject.end() && it->second == obj && sSleepingGameObjects.insert(obj).second)
+			{
+				//Sleeping objects are skipped by autosave, save where the body came to rest
+				Journal::markDirty(obj);
+				sUpdateListsDirty = true;
+			}
+		}
+		finalStates.clear();
 	}
 	void fixedUpdate(float delta)
 	{
-		for (auto& obj : sGameObjects)
+		if (sUpdateListsDirty)
+			rebuildUpdateLists();
+		for (IGameObject* obj : sFixedUpdateList)
 			obj->fixedUpdate(delta);
 	}
 	void render(vk::CommandBuffer cmd, float alpha, Renderer::RenderStage stage)
@@ -73,6 +436,20 @@ namespace eg::World
 			objJson["type"] = std::string(gameObject->getType()); // Ensure type is included
 			gameObjectsJson.push_back(objJson);
 		}
+		//Objects living in cells that are currently streamed out
+		Streaming::appendNonResidentObjects(gameObjectsJson);
+		if (Binary::isBinaryWorld(filename))
+		{
+			try
+			{
+				Binary::write(filename, sWorldName, gameObjectsJson);
+			}
+			catch (const std::exception& e)
+			{
+				eg::Logger::gError(e.what());
+			}
+			return;
+		}
 		mainJson["gameObjects"] = gameObjectsJson;
 		std::ofstream file(filename);
 		if (file.is_open())
@@ -85,50 +462,203 @@ namespace eg::World
 			eg::Logger::gError("Failed to open file for saving game objects: " + filename);
 		}
 	}
+	//A world object between the load phases, errors are logged in file order once every phase has run
+	struct PendingGameObject
+	{
+		nlohmann::json json;
+		std::string type;
+		std::unique_ptr<IGameObject> object;
+		LoadContext context;
+		bool prepared = false;
+		std::string error;
+	};
+
+	void LoadContext::addBody(JPH::BodyID body, JPH::EActivation activation)
+	{
+		if (activation == JPH::EActivation::Activate)
+			mActivatedBodies.push_back(body);
+		else
+			mDeactivatedBodies.push_back(body);
+	}
+
+	void LoadContext::append(LoadContext& other)
+	{
+		mActivatedBodies.insert(mActivatedBodies.end(), other.mActivatedBodies.begin(), other.mActivatedBodies.end());
+		mDeactivatedBodies.insert(mDeactivatedBodies.end(), other.mDeactivatedBodies.begin(), other.mDeactivatedBodies.end());
+		other.mActivatedBodies.clear();
+		other.mDeactivatedBodies.clear();
+	}
+
+	void LoadContext::flush()
+	{
+		JPH::BodyInterface* bodyInterface = Physics::getBodyInterface();
+		auto addBodies = [bodyInterface](std::vector<JPH::BodyID>& bodies, JPH::EActivation activation) {
+			if (bodies.empty())
+				return;
+			int count = static_cast<int>(bodies.size());
+			JPH::BodyInterface::AddState state = bodyInterface->AddBodiesPrepare(bodies.data(), count);
+			bodyInterface->AddBodiesFinalize(bodies.data(), count, state, activation);
+			bodies.clear();
+			};
+		addBodies(mActivatedBodies, JPH::EActivation::Activate);
+		addBodies(mDeactivatedBodies, JPH::EActivation::DontActivate);
+	}
+
 	void load(const std::string& filename, JsonToIGameObjectDispatcher dispatcher)
 	{
+		using Clock = std::chrono::high_resolution_clock;
+		auto elapsedMs = [](Clock::time_point from, Clock::time_point to) {
+			return std::to_string(std::chrono::duration<double, std::milli>(to - from).count());
+			};
+
 		cleanup();
-		//Load json file
-		std::ifstream file(filename);
-		if (!file.is_open())
+		Journal::recover(filename);
+		std::vector<PendingGameObject> pending;
+		auto parseStart = Clock::now();
+		if (Binary::isBinaryWorld(filename))
 		{
-			throw std::runtime_error("Failed to open file for loading game objects: " + filename);
+			//Object bodies are decoded straight from the mapped file, independently of each other
+			Binary::Reader reader(filename);
+			sWorldName = std::string(reader.getWorldName());
+			pending.resize(reader.getObjectCount());
+			Jobs::parallelFor(pending.size(), 0, [&](size_t i) {
+				try
+				{
+					Binary::ObjectView view = reader.getObject(static_cast<uint32_t>(i));
+					pending[i].type = std::string(view.type);
+					pending[i].json = view.decode();
+				}
+				catch (const std::exception& e)
+				{
+					pending[i].error = "Failed to decode game object " + std::to_string(i) + ": " + e.what();
+				}
+				});
 		}
-
-		nlohmann::json mainJson;
-		file >> mainJson;
-		file.close();
-		if (!mainJson.contains("gameObjects") || !mainJson["gameObjects"].is_array())
+		else
 		{
-			throw std::runtime_error("Invalid game object data in file: " + filename);
+			//Load json file
+			std::ifstream file(filename);
+			if (!file.is_open())
+			{
+				throw std::runtime_error("Failed to open file for loading game objects: " + filename);
+			}
+
+			nlohmann::json mainJson;
+			file >> mainJson;
+			file.close();
+			if (!mainJson.contains("gameObjects") || !mainJson["gameObjects"].is_array())
+			{
+				throw std::runtime_error("Invalid game object data in file: " + filename);
+			}
+			sWorldName = mainJson.at("worldName").get<std::string>();
+			nlohmann::json& gameObjectsJson = mainJson["gameObjects"];
+			pending.reserve(gameObjectsJson.size());
+			for (auto& objJson : gameObjectsJson)
+			{
+				PendingGameObject& object = pending.emplace_back();
+				if (!objJson.contains("type") || !objJson["type"].is_string())
+				{
+					object.error = "Game object type is missing or invalid in JSON: " + objJson.dump();
+					continue;
+				}
+				object.type = objJson["type"].get<std::string>();
+				object.json = std::move(objJson);
+			}
 		}
-		sWorldName = mainJson.at("worldName").get<std::string>();
-		for (const auto& objJson : mainJson["gameObjects"])
+
+		//Dispatchers may touch renderer state (the player sets the camera), keep them on the main thread
+		auto dispatchStart = Clock::now();
+		for (auto& object : pending)
 		{
-			if (!objJson.contains("type") || !objJson["type"].is_string())
-			{
-				eg::Logger::gError("Game object type is missing or invalid in JSON: " + objJson.dump());
+			if (!object.error.empty())
 				continue;
+			try
+			{
+				object.object = dispatcher(object.json, object.type);
+				if (!object.object)
+					object.error = "Unknown game object type: " + object.type;
 			}
-			std::string type = objJson["type"];
-			std::unique_ptr<IGameObject> gameObject = nullptr;
+			catch (const std::exception& e)
+			{
+				object.error = e.what();
+			}
+		}
+
+		//File I/O, asset decoding, collision shapes and body creation
+		auto prepareStart = Clock::now();
+		uint32_t threadCount = Jobs::getWorkerCount() + 1;
+		Jobs::parallelFor(pending.size(), 0, [&pending](size_t i) {
+			PendingGameObject& object = pending[i];
+			if (!object.object)
+				return;
 			try
 			{
-				gameObject = dispatcher(objJson, type);
-				gameObject->fromJson(objJson);
+				object.prepared = object.object->prepareLoad(object.json, object.context);
 			}
 			catch (const nlohmann::detail::exception& e)
 			{
-				std::string errorMsg = "JSON parsing error for game object type '" + type + "': " + e.what();
-				eg::Logger::gError(errorMsg);
-				continue; // Skip this object if an error occurs
+				object.error = "JSON parsing error for game object type '" + object.type + "': " + e.what();
 			}
 			catch (const std::exception& e)
 			{
-				eg::Logger::gError(e.what());
-				continue; // Skip this object if an error occurs
+				object.error = e.what();
+			}
+			});
+
+		//GPU uploads, objects without a prepare step are loaded the old way
+		auto finalizeStart = Clock::now();
+		for (auto& object : pending)
+		{
+			if (!object.object || !object.error.empty())
+				continue;
+			try
+			{
+				if (object.prepared)
+					object.object->finishLoad();
+				else
+					object.object->fromJson(object.json);
+			}
+			catch (const nlohmann::detail::exception& e)
+			{
+				object.error = "JSON parsing error for game object type '" + object.type + "': " + e.what();
+			}
+			catch (const std::exception& e)
+			{
+				object.error = e.what();
 			}
-			addGameObject(std::move(gameObject));
 		}
+
+		//Bodies of failed objects are added too, the object destructor removes them again
+		auto bodiesStart = Clock::now();
+		LoadContext bodies;
+		for (auto& object : pending)
+			bodies.append(object.context);
+		size_t bodyCount = bodies.getBodyCount();
+		bodies.flush();
+		if (bodyCount > 0)
+			Physics::getPhysicsSystem().OptimizeBroadPhase();
+
+		auto addStart = Clock::now();
+		size_t loadedCount = 0;
+		for (auto& object : pending)
+		{
+			if (!object.error.empty())
+			{
+				eg::Logger::gError(object.error);
+				continue;
+			}
+			addGameObject(std::move(object.object));
+			loadedCount++;
+		}
+		pending.clear();
+		auto end = Clock::now();
+
+		eg::Logger::gInfo("World load '" + filename + "': " + std::to_string(loadedCount) + " objects, "
+			+ std::to_string(bodyCount) + " batched bodies, parse " + elapsedMs(parseStart, dispatchStart)
+			+ " ms, dispatch " + elapsedMs(dispatchStart, prepareStart)
+			+ " ms, prepare " + elapsedMs(prepareStart, finalizeStart) + " ms (" + std::to_string(threadCount) + " threads)"
+			+ ", finalize " + elapsedMs(finalizeStart, bodiesStart)
+			+ " ms, bodies " + elapsedMs(bodiesStart, addStart)
+			+ " ms, total " + elapsedMs(parseStart, end) + " ms");
 	}
 }
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include <World.h>
+#include <Data.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace eg::World::Binary
+{
+	//On disk layout, little endian:
+	//FileHeader | strings | TypeEntry[typeCount] | ObjectEntry[objectCount] | msgpack object data
+	static constexpr char MAGIC[4] = { 'E', 'G', 'W', 'B' };
+	static constexpr uint64_t ALIGNMENT = 8;
+
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t objectCount;
+		uint32_t typeCount;
+		uint64_t stringsOffset;
+		uint64_t stringsSize;
+		uint64_t typesOffset;
+		uint64_t objectsOffset;
+		uint64_t dataOffset;
+		uint64_t dataSize;
+		uint32_t worldNameOffset;
+		uint32_t worldNameSize;
+	};
+	static_assert(sizeof(FileHeader) == 72);
+
+	struct TypeEntry
+	{
+		uint32_t nameOffset;
+		uint32_t nameSize;
+	};
+	static_assert(sizeof(TypeEntry) == 8);
+
+	struct ObjectEntry
+	{
+		static constexpr uint32_t FLAG_HAS_POSITION = 1 << 0;
+
+		uint32_t typeIndex;
+		uint32_t flags;
+		float position[3];
+		uint32_t dataSize;
+		uint64_t dataOffset;
+	};
+	static_assert(sizeof(ObjectEntry) == 32);
+
+	static uint64_t alignUp(uint64_t value)
+	{
+		return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	//Reader
+	Reader::Reader(const std::string& filename) :
+		mFile(std::make_unique<Data::MappedFile>(filename))
+	{
+		const uint8_t* base = mFile->getData();
+		const uint64_t fileSize = mFile->getSize();
+		auto inBounds = [fileSize](uint64_t offset, uint64_t size) {
+			return offset <= fileSize && size <= fileSize - offset;
+			};
+
+		if (!inBounds(0, sizeof(FileHeader)))
+			throw std::runtime_error("Binary world is too small: " + filename);
+		FileHeader header;
+		std::memcpy(&header, base, sizeof(header));
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+			throw std::runtime_error("Not a binary world file: " + filename);
+		if (header.version != VERSION)
+			throw std::runtime_error("Unsupported binary world version " + std::to_string(header.version) + ": " + filename);
+
+		if (!inBounds(header.stringsOffset, header.stringsSize)
+			|| !inBounds(header.typesOffset, static_cast<uint64_t>(header.typeCount) * sizeof(TypeEntry))
+			|| !inBounds(header.objectsOffset, static_cast<uint64_t>(header.objectCount) * sizeof(ObjectEntry))
+			|| !inBounds(header.dataOffset, header.dataSize)
+			|| static_cast<uint64_t>(header.worldNameOffset) + header.worldNameSize > header.stringsSize)
+			throw std::runtime_error("Corrupted binary world: " + filename);
+
+		mStrings = base + header.stringsOffset;
+		mTypes = base + header.typesOffset;
+		mObjects = base + header.objectsOffset;
+		mData = base + header.dataOffset;
+		mStringsSize = header.stringsSize;
+		mDataSize = header.dataSize;
+		mObjectCount = header.objectCount;
+		mTypeCount = header.typeCount;
+		mWorldName = std::string_view(reinterpret_cast<const char*>(mStrings) + header.worldNameOffset, header.worldNameSize);
+	}
+
+	Reader::~Reader() = default;
+
+	ObjectView Reader::getObject(uint32_t index) const
+	{
+		if (index >= mObjectCount)
+			throw std::out_of_range("Binary world object index out of range");
+
+		ObjectEntry entry;
+		std::memcpy(&entry, mObjects + static_cast<size_t>(index) * sizeof(ObjectEntry), sizeof(entry));
+		if (entry.typeIndex >= mTypeCount || entry.dataOffset + entry.dataSize > mDataSize)
+			throw std::runtime_error("Corrupted binary world object " + std::to_string(index));
+
+		TypeEntry type;
+		std::memcpy(&type, mTypes + static_cast<size_t>(entry.typeIndex) * sizeof(TypeEntry), sizeof(type));
+		if (static_cast<uint64_t>(type.nameOffset) + type.nameSize > mStringsSize)
+			throw std::runtime_error("Corrupted binary world type " + std::to_string(entry.typeIndex));
+
+		ObjectView view;
+		view.type = std::string_view(reinterpret_cast<const char*>(mStrings) + type.nameOffset, type.nameSize);
+		view.data = mData + entry.dataOffset;
+		view.size = entry.dataSize;
+		view.hasPosition = (entry.flags & ObjectEntry::FLAG_HAS_POSITION) != 0;
+		view.position = { entry.position[0], entry.position[1], entry.position[2] };
+		return view;
+	}
+
+	bool isBinaryWorld(const std::string& filename)
+	{
+		return std::filesystem::path(filename).extension() == EXTENSION;
+	}
+
+	void write(const std::string& filename, const std::string& worldName, const nlohmann::json& gameObjectsJson)
+	{
+		std::string strings = worldName;
+		std::vector<TypeEntry> types;
+		std::unordered_map<std::string, uint32_t> typeIndices;
+		std::vector<ObjectEntry> objects;
+		std::vector<uint8_t> data;
+		objects.reserve(gameObjectsJson.size());
+
+		for (const auto& objJson : gameObjectsJson)
+		{
+			if (!objJson.contains("type") || !objJson["type"].is_string())
+			{
+				Logger::gWarn("Binary world: skipping game object without a type");
+				continue;
+			}
+			const std::string& type = objJson["type"].get_ref<const std::string&>();
+			auto [it, inserted] = typeIndices.try_emplace(type, static_cast<uint32_t>(types.size()));
+			if (inserted)
+			{
+				types.push_back({ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(type.size()) });
+				strings += type;
+			}
+
+			ObjectEntry entry{};
+			entry.typeIndex = it->second;
+			glm::vec3 position;
+			if (findGameObjectPosition(objJson, position))
+			{
+				entry.flags |= ObjectEntry::FLAG_HAS_POSITION;
+				entry.position[0] = position.x;
+				entry.position[1] = position.y;
+				entry.position[2] = position.z;
+			}
+
+			data.resize(alignUp(data.size()));
+			entry.dataOffset = data.size();
+			nlohmann::json::to_msgpack(objJson, data);
+			entry.dataSize = static_cast<uint32_t>(data.size() - entry.dataOffset);
+			objects.push_back(entry);
+		}
+
+		FileHeader header{};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.objectCount = static_cast<uint32_t>(objects.size());
+		header.typeCount = static_cast<uint32_t>(types.size());
+		header.stringsOffset = sizeof(FileHeader);
+		header.stringsSize = strings.size();
+		header.typesOffset = alignUp(header.stringsOffset + header.stringsSize);
+		header.objectsOffset = alignUp(header.typesOffset + types.size() * sizeof(TypeEntry));
+		header.dataOffset = alignUp(header.objectsOffset + objects.size() * sizeof(ObjectEntry));
+		header.dataSize = data.size();
+		header.worldNameOffset = 0;
+		header.worldNameSize = static_cast<uint32_t>(worldName.size());
+
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open file for saving binary world: " + filename);
+
+		auto pad = [&file](uint64_t offset) {
+			static const char zeros[ALIGNMENT] = {};
+			uint64_t current = static_cast<uint64_t>(file.tellp());
+			file.write(zeros, static_cast<std::streamsize>(offset - current));
+			};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+		pad(header.typesOffset);
+		file.write(reinterpret_cast<const char*>(types.data()), static_cast<std::streamsize>(types.size() * sizeof(TypeEntry)));
+		pad(header.objectsOffset);
+		file.write(reinterpret_cast<const char*>(objects.data()), static_cast<std::streamsize>(objects.size() * sizeof(ObjectEntry)));
+		pad(header.dataOffset);
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!file)
+			throw std::runtime_error("Failed to write binary world: " + filename);
+	}
+
+	void convertJsonToBinary(const std::string& jsonFile, const std::string& binaryFile)
+	{
+		std::ifstream file(jsonFile);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open json world: " + jsonFile);
+		nlohmann::json mainJson = nlohmann::json::parse(file);
+
+		write(binaryFile, mainJson.value("worldName", std::string("Default")),
+			mainJson.value("gameObjects", nlohmann::json::array()));
+		Logger::gInfo("Converted " + jsonFile + " to " + binaryFile);
+	}
+
+	void convertBinaryToJson(const std::string& binaryFile, const std::string& jsonFile)
+	{
+		Reader reader(binaryFile);
+		nlohmann::json mainJson;
+		mainJson["worldName"] = std::string(reader.getWorldName());
+		nlohmann::json gameObjectsJson = nlohmann::json::array();
+		for (uint32_t i = 0; i < reader.getObjectCount(); i++)
+		{
+			gameObjectsJson.push_back(reader.getObject(i).decode());
+		}
+		mainJson["gameObjects"] = std::move(gameObjectsJson);
+
+		std::ofstream file(jsonFile);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open file for saving json world: " + jsonFile);
+		file << mainJson.dump(4);
+		Logger::gInfo("Converted " + binaryFile + " to " + jsonFile);
+	}
+
+	void benchmark(uint32_t objectCount)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		const std::string jsonFile = "benchmark_world.json";
+		const std::string binaryFile = std::string("benchmark_world") + EXTENSION;
+
+		//Objects shaped like the sandbox map objects
+		{
+			nlohmann::json mainJson;
+			mainJson["worldName"] = "Benchmark";
+			nlohmann::json gameObjectsJson = nlohmann::json::array();
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				float x = static_cast<float>(i % 1000) * 2.0f;
+				float z = static_cast<float>(i / 1000) * 2.0f;
+				gameObjectsJson.push_back({
+					{ "type", "MapPhysicsObject" },
+					{ "model", { { "model_path", "models/cube.glb" } } },
+					{ "rigidBody", {
+						{ "position", { x, 1.0f, z } },
+						{ "rotation", { 0.0f, 0.0f, 0.0f, 1.0f } },
+						{ "mass", 10.0f },
+						{ "friction", 0.2f },
+						{ "restitution", 0.9f } } },
+					{ "particleEmitter", nullptr }
+					});
+			}
+			mainJson["gameObjects"] = std::move(gameObjectsJson);
+			std::ofstream file(jsonFile);
+			file << mainJson.dump(4);
+		}
+		convertJsonToBinary(jsonFile, binaryFile);
+
+		//Both paths end with the per-object json that fromJson reads, plus the position lookup
+		glm::vec3 checksum(0.0f);
+		auto start = Clock::now();
+		{
+			std::ifstream file(jsonFile);
+			nlohmann::json mainJson = nlohmann::json::parse(file);
+			for (const auto& objJson : mainJson["gameObjects"])
+			{
+				const auto& position = objJson["rigidBody"]["position"];
+				checksum.x += position.at(0).get<float>();
+			}
+		}
+		double jsonMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		{
+			Reader reader(binaryFile);
+			for (uint32_t i = 0; i < reader.getObjectCount(); i++)
+			{
+				nlohmann::json objJson = reader.getObject(i).decode();
+				const auto& position = objJson["rigidBody"]["position"];
+				checksum.y += position.at(0).get<float>();
+			}
+		}
+		double binaryMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		//What the streaming index needs: type and position, no decoding
+		start = Clock::now();
+		{
+			Reader reader(binaryFile);
+			for (uint32_t i = 0; i < reader.getObjectCount(); i++)
+			{
+				ObjectView view = reader.getObject(i);
+				checksum.z += view.position.x;
+			}
+		}
+		double indexMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		uintmax_t jsonSize = std::filesystem::file_size(jsonFile);
+		uintmax_t binarySize = std::filesystem::file_size(binaryFile);
+		std::filesystem::remove(jsonFile);
+		std::filesystem::remove(binaryFile);
+
+		if (checksum.x != checksum.y || checksum.x != checksum.z)
+			Logger::gWarn("Binary world benchmark: checksum mismatch between json and binary loads !");
+		Logger::gInfo("Binary world benchmark [" + std::to_string(objectCount) + " objects]: json "
+			+ std::to_string(jsonMs) + " ms (" + std::to_string(jsonSize / 1024) + " KiB), binary "
+			+ std::to_string(binaryMs) + " ms (" + std::to_string(binarySize / 1024) + " KiB), binary index only "
+			+ std::to_string(indexMs) + " ms");
+	}
+}
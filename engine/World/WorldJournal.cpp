@@ -0,0 +1,480 @@
+#include <World.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace eg::World::Journal
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Job
+	{
+		enum class Type
+		{
+			Begin,
+			Changes,
+			Compact,
+			End
+		} type;
+		std::string filename;
+		std::string worldName;
+		std::vector<nlohmann::json> objects;
+		std::vector<uint64_t> removed;
+	};
+
+	//Shared with the writer thread
+	static std::mutex sMutex;
+	static std::condition_variable sCV;
+	static std::condition_variable sIdleCV;
+	static std::deque<Job> sJobs;
+	static bool sWriterBusy = false;
+	static bool sThreadRunning = false;
+	static std::unique_ptr<std::thread> sThread;
+
+	//Writer thread only, the world as it is on disk once the journal is replayed
+	static std::map<uint64_t, nlohmann::json> sImage;
+	static std::string sImageFilename;
+	static std::string sImageWorldName;
+	static std::ofstream sJournalFile;
+	static uint32_t sBatchCount = 0;
+
+	//Main thread only
+	static bool sActive = false;
+	static std::string sPendingBeginFilename;
+	static std::unordered_set<const IGameObject*> sDirtyObjects;
+	static std::unordered_set<const IGameObject*> sStreamedOutObjects;
+	static std::vector<nlohmann::json> sPendingObjects;
+	static std::vector<uint64_t> sPendingRemovals;
+	static float sTimeSinceAutosave = 0.0f;
+
+	static Command::Var* sAutosaveIntervalCVar = nullptr;
+	static Command::Var* sCompactBatchesCVar = nullptr;
+
+	static nlohmann::json snapshotObject(const IGameObject* gameObject)
+	{
+		nlohmann::json objJson = gameObject->toJson();
+		objJson["type"] = std::string(gameObject->getType());
+		objJson["saveId"] = getSaveId(gameObject);
+		return objJson;
+	}
+
+	static void readWorldFile(const std::string& filename, std::string& worldName, std::vector<nlohmann::json>& objects)
+	{
+		if (Binary::isBinaryWorld(filename))
+		{
+			Binary::Reader reader(filename);
+			worldName = std::string(reader.getWorldName());
+			objects.reserve(reader.getObjectCount());
+			for (uint32_t i = 0; i < reader.getObjectCount(); i++)
+				objects.push_back(reader.getObject(i).decode());
+			return;
+		}
+
+		std::ifstream file(filename);
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open world file: " + filename);
+		nlohmann::json mainJson = nlohmann::json::parse(file);
+		worldName = mainJson.value("worldName", std::string("Default"));
+		for (auto& objJson : mainJson.value("gameObjects", nlohmann::json::array()))
+			objects.push_back(std::move(objJson));
+	}
+
+	//Written next to the base file and moved over it, a crash never leaves a half written base behind
+	static void writeWorldFile(const std::string& filename, const std::string& worldName, nlohmann::json gameObjectsJson)
+	{
+		std::string tempFilename = filename + ".tmp";
+		if (Binary::isBinaryWorld(filename))
+		{
+			Binary::write(tempFilename, worldName, gameObjectsJson);
+		}
+		else
+		{
+			nlohmann::json mainJson;
+			mainJson["worldName"] = worldName;
+			mainJson["gameObjects"] = std::move(gameObjectsJson);
+			std::ofstream file(tempFilename, std::ios::trunc);
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open file for saving game objects: " + tempFilename);
+			file << mainJson.dump(4);
+			if (!file)
+				throw std::runtime_error("Failed to write world file: " + tempFilename);
+		}
+		std::filesystem::rename(tempFilename, filename);
+	}
+
+	static void applyChanges(std::map<uint64_t, nlohmann::json>& image, const nlohmann::json& batch)
+	{
+		for (const auto& objJson : batch["objects"])
+			image[objJson["saveId"].get<uint64_t>()] = objJson;
+		for (const auto& saveId : batch["removed"])
+			image.erase(saveId.get<uint64_t>());
+	}
+
+	static void compactImage()
+	{
+		auto start = Clock::now();
+		nlohmann::json gameObjectsJson = nlohmann::json::array();
+		for (const auto& [saveId, objJson] : sImage)
+			gameObjectsJson.push_back(objJson);
+		writeWorldFile(sImageFilename, sImageWorldName, std::move(gameObjectsJson));
+
+		//Only dropped once the base holds every change, replaying it again would be harmless
+		sJournalFile.close();
+		sJournalFile.open(sImageFilename + EXTENSION, std::ios::trunc);
+		sBatchCount = 0;
+
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Logger::gInfo("World journal: compacted " + std::to_string(sImage.size()) + " objects into "
+			+ sImageFilename + " in " + std::to_string(ms) + " ms");
+	}
+
+	static void processJob(Job& job)
+	{
+		switch (job.type)
+		{
+		case Job::Type::Begin:
+			sImage.clear();
+			for (auto& objJson : job.objects)
+			{
+				uint64_t saveId = objJson["saveId"].get<uint64_t>();
+				sImage[saveId] = std::move(objJson);
+			}
+			sImageFilename = job.filename;
+			sImageWorldName = job.worldName;
+			compactImage();
+			break;
+		case Job::Type::Changes:
+		{
+			nlohmann::json batch;
+			batch["worldName"] = job.worldName;
+			batch["objects"] = std::move(job.objects);
+			batch["removed"] = std::move(job.removed);
+			sJournalFile << batch.dump() << '\n';
+			sJournalFile.flush();
+
+			sImageWorldName = job.worldName;
+			applyChanges(sImage, batch);
+			if (++sBatchCount >= static_cast<uint32_t>(sCompactBatchesCVar->value))
+				compactImage();
+			break;
+		}
+		case Job::Type::Compact:
+			if (sBatchCount > 0)
+				compactImage();
+			break;
+		case Job::Type::End:
+			if (sBatchCount > 0)
+				compactImage();
+			sJournalFile.close();
+			std::filesystem::remove(sImageFilename + EXTENSION);
+			sImage.clear();
+			sImageFilename.clear();
+			break;
+		}
+	}
+
+	static void threadFn()
+	{
+		eg::Logger::gInfo("World journal thread started !");
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				sCV.wait(lk, [] {
+					return !sJobs.empty() || !sThreadRunning;
+					});
+				if (sJobs.empty() && !sThreadRunning)
+					break;
+				job = std::move(sJobs.front());
+				sJobs.pop_front();
+				sWriterBusy = true;
+			}
+
+			try
+			{
+				processJob(job);
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError(std::string("World journal: ") + e.what());
+			}
+
+			{
+				std::lock_guard lk(sMutex);
+				sWriterBusy = false;
+			}
+			sIdleCV.notify_all();
+		}
+		eg::Logger::gInfo("World journal thread destroyed !");
+	}
+
+	static void pushJob(Job job)
+	{
+		std::lock_guard lk(sMutex);
+		sJobs.push_back(std::move(job));
+		sCV.notify_one();
+	}
+
+	static void beginNow(const std::string& filename)
+	{
+		auto start = Clock::now();
+		Job job{ Job::Type::Begin, filename, getWorldName() };
+		job.objects.reserve(getGameObjects().size());
+		for (const auto& gameObject : getGameObjects())
+			job.objects.push_back(snapshotObject(gameObject.get()));
+
+		nlohmann::json nonResidentObjects = nlohmann::json::array();
+		Streaming::stampNonResidentObjects(nonResidentObjects);
+		for (auto& objJson : nonResidentObjects)
+			job.objects.push_back(std::move(objJson));
+		size_t objectCount = job.objects.size();
+		pushJob(std::move(job));
+
+		sActive = true;
+		sDirtyObjects.clear();
+		sStreamedOutObjects.clear();
+		sPendingObjects.clear();
+		sPendingRemovals.clear();
+		sTimeSinceAutosave = 0.0f;
+
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Logger::gInfo("World journal: started on " + filename + ", " + std::to_string(objectCount)
+			+ " objects snapshotted in " + std::to_string(ms) + " ms");
+	}
+
+	void create()
+	{
+		sAutosaveIntervalCVar = Command::registerVar("eg::World::AutosaveInterval", "None", 10.0);
+		//Journal batches written before the writer folds them back into the base file
+		sCompactBatchesCVar = Command::registerVar("eg::World::JournalCompactBatches", "None", 32.0);
+
+		Command::registerFn("eg::World::BeginJournal", [](size_t argc, char* argv[]) {
+			if (argc < 2)
+			{
+				Logger::gError("Usage: eg::World::BeginJournal <world file>");
+				return;
+			}
+			begin(argv[1]);
+			});
+		Command::registerFn("eg::World::EndJournal", [](size_t, char* []) {
+			end();
+			});
+		Command::registerFn("eg::World::Autosave", [](size_t, char* []) {
+			autosave();
+			});
+		Command::registerFn("eg::World::CompactJournal", [](size_t, char* []) {
+			compact();
+			});
+
+		sThreadRunning = true;
+		sThread = std::make_unique<std::thread>(threadFn);
+	}
+
+	void destroy()
+	{
+		end();
+		{
+			std::lock_guard lk(sMutex);
+			sThreadRunning = false;
+			sCV.notify_one();
+		}
+		if (sThread)
+		{
+			sThread->join();
+			sThread.reset();
+		}
+	}
+
+	void begin(const std::string& filename)
+	{
+		end();
+		//Objects of cells being indexed or parsed can't be given an id yet
+		if (Streaming::isBusy())
+		{
+			sPendingBeginFilename = filename;
+			Logger::gInfo("World journal: waiting for world streaming before starting on " + filename);
+			return;
+		}
+		beginNow(filename);
+	}
+
+	void end()
+	{
+		sPendingBeginFilename.clear();
+		if (!sActive)
+			return;
+
+		autosave();
+		pushJob(Job{ Job::Type::End });
+		sActive = false;
+		sDirtyObjects.clear();
+		sStreamedOutObjects.clear();
+
+		std::unique_lock lk(sMutex);
+		sIdleCV.wait(lk, [] {
+			return sJobs.empty() && !sWriterBusy;
+			});
+	}
+
+	bool isActive()
+	{
+		return sActive;
+	}
+
+	void markDirty(const IGameObject* gameObject)
+	{
+		if (sActive)
+			sDirtyObjects.insert(gameObject);
+	}
+
+	void update(float delta)
+	{
+		if (!sPendingBeginFilename.empty() && !Streaming::isBusy())
+		{
+			std::string filename = std::move(sPendingBeginFilename);
+			sPendingBeginFilename.clear();
+			beginNow(filename);
+		}
+		if (!sActive || sAutosaveIntervalCVar->value <= 0.0)
+			return;
+
+		sTimeSinceAutosave += delta;
+		if (sTimeSinceAutosave >= static_cast<float>(sAutosaveIntervalCVar->value))
+			autosave();
+	}
+
+	void autosave()
+	{
+		if (!sActive)
+		{
+			Logger::gWarn("World journal: autosave requested without an active journal");
+			return;
+		}
+		sTimeSinceAutosave = 0.0f;
+
+		auto start = Clock::now();
+		Job job{ Job::Type::Changes, {}, getWorldName() };
+		job.objects = std::move(sPendingObjects);
+		job.removed = std::move(sPendingRemovals);
+		sPendingObjects.clear();
+		sPendingRemovals.clear();
+
+		//Static objects only when marked, sleeping bodies were marked when they fell asleep,
+		//objects without a body to watch may change every frame
+		size_t streamedOutCount = job.objects.size();
+		for (const auto& gameObject : getGameObjects())
+		{
+			const IGameObject* object = gameObject.get();
+			bool changed = sDirtyObjects.find(object) != sDirtyObjects.end();
+			if (!changed && object->getUpdatePhases() != IGameObject::PHASE_NONE)
+				changed = object->getSleepBody().IsInvalid() || !isGameObjectSleeping(object);
+			if (changed)
+				job.objects.push_back(snapshotObject(object));
+		}
+		sDirtyObjects.clear();
+
+		if (job.objects.empty() && job.removed.empty())
+			return;
+		size_t changedCount = job.objects.size() - streamedOutCount;
+		size_t removedCount = job.removed.size();
+		pushJob(std::move(job));
+
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Logger::gTrace("World journal: autosave snapshotted " + std::to_string(changedCount) + " changed, "
+			+ std::to_string(streamedOutCount) + " streamed out, " + std::to_string(removedCount)
+			+ " removed objects in " + std::to_string(ms) + " ms");
+	}
+
+	void compact()
+	{
+		if (!sActive)
+			return;
+		pushJob(Job{ Job::Type::Compact });
+	}
+
+	void recover(const std::string& filename)
+	{
+		std::string journalFilename = filename + EXTENSION;
+		std::error_code ec;
+		if (!std::filesystem::exists(journalFilename, ec) || std::filesystem::file_size(journalFilename, ec) == 0)
+			return;
+
+		try
+		{
+			std::string worldName;
+			std::vector<nlohmann::json> objects;
+			readWorldFile(filename, worldName, objects);
+
+			std::map<uint64_t, nlohmann::json> image;
+			nlohmann::json unjournaledObjects = nlohmann::json::array();
+			for (auto& objJson : objects)
+			{
+				if (objJson.contains("saveId"))
+				{
+					uint64_t saveId = objJson["saveId"].get<uint64_t>();
+					image[saveId] = std::move(objJson);
+				}
+				else
+					unjournaledObjects.push_back(std::move(objJson));
+			}
+
+			//A batch cut short by the crash is the last line, everything before it is complete
+			std::ifstream journalFile(journalFilename);
+			std::string line;
+			size_t batchCount = 0;
+			while (std::getline(journalFile, line))
+			{
+				nlohmann::json batch = nlohmann::json::parse(line, nullptr, false);
+				if (batch.is_discarded())
+					break;
+				worldName = batch.value("worldName", worldName);
+				applyChanges(image, batch);
+				batchCount++;
+			}
+			journalFile.close();
+
+			for (auto& [saveId, objJson] : image)
+				unjournaledObjects.push_back(std::move(objJson));
+			writeWorldFile(filename, worldName, std::move(unjournaledObjects));
+			std::filesystem::remove(journalFilename);
+			Logger::gInfo("World journal: recovered " + std::to_string(batchCount) + " batches into " + filename);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("World journal: failed to recover " + journalFilename + ": " + e.what());
+		}
+	}
+
+	void onObjectAdded(const IGameObject* gameObject)
+	{
+		markDirty(gameObject);
+	}
+
+	void onObjectDetached(const IGameObject* gameObject, uint64_t saveId)
+	{
+		if (!sActive)
+			return;
+		sDirtyObjects.erase(gameObject);
+		if (sStreamedOutObjects.erase(gameObject) != 0)
+			return;
+		sPendingRemovals.push_back(saveId);
+	}
+
+	void onObjectStreamedOut(const IGameObject* gameObject, const nlohmann::json& objJson)
+	{
+		if (!sActive)
+			return;
+		sStreamedOutObjects.insert(gameObject);
+		sPendingObjects.push_back(objJson);
+	}
+}
@@ -0,0 +1,839 @@
+#include <World.h>
+#include <Core.h>
+#include <Logger.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+namespace eg::World::Streaming
+{
+	using CellKey = int64_t;
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct PendingObject
+	{
+		nlohmann::json json;
+		std::string type;
+		std::unique_ptr<IGameObject> object; //Null for objects a pool spawns
+		IGameObject* spawned = nullptr;
+		IObjectPool* pool = nullptr; //Holds a reservation on one of its free objects until finalized
+		bool prepared = false;
+		std::string error;
+	};
+
+	//A cell's objects between dispatch and finalization. prepareLoad runs on the streaming thread,
+	//finishLoad on the main thread within the budget, and the bodies are added in one batch once every object is done
+	struct PendingCell
+	{
+		CellKey key;
+		std::vector<PendingObject> objects;
+		LoadContext context;
+		size_t finalized = 0;
+	};
+
+	struct Cell
+	{
+		enum class State
+		{
+			NonResident,
+			Requested,
+			Parsed,
+			Preparing,
+			Prepared,
+			Resident
+		};
+		State state = State::NonResident;
+		//Msgpack encoded objects, owned by the cell while it is not resident
+		std::vector<std::vector<uint8_t>> serializedObjects;
+		//Decoded by the streaming thread, kept until the prepared objects take over so saves still see them
+		std::vector<nlohmann::json> parsedObjects;
+		std::shared_ptr<PendingCell> prepared;
+		//Live instances, main thread only
+		std::vector<IGameObject*> objects;
+	};
+
+	struct Job
+	{
+		enum class Type
+		{
+			Index,
+			Parse,
+			Prepare
+		} type;
+		std::string filename;
+		CellKey key;
+		uint64_t generation;
+		std::shared_ptr<PendingCell> cell;
+	};
+
+	static std::unordered_set<std::string> sStreamableTypes;
+	static JsonToIGameObjectDispatcher sDispatcher;
+
+	//Shared with the streaming thread
+	static std::mutex sMutex;
+	static std::condition_variable sCV;
+	static std::deque<Job> sJobs;
+	static std::unordered_map<CellKey, Cell> sCells;
+	static std::deque<nlohmann::json> sResidentObjects;
+	static std::string sWorldName;
+	static bool sWorldNameReady = false;
+	static bool sIndexed = false;
+	static bool sIndexing = false;
+	static uint64_t sGeneration = 0;
+	static bool sThreadRunning = false;
+	static std::unique_ptr<std::thread> sThread;
+
+	//Main thread only
+	static std::deque<std::shared_ptr<PendingCell>> sFinalizeQueue;
+	//Free pooled objects promised to dispatched cells, a pool can't hand out more than it has free
+	static std::unordered_map<IObjectPool*, size_t> sPoolReservations;
+
+	static Command::Var* sCellSizeCVar = nullptr;
+	static Command::Var* sStreamInRadiusCVar = nullptr;
+	static Command::Var* sStreamOutRadiusCVar = nullptr;
+	static Command::Var* sBudgetCVar = nullptr;
+
+	static CellKey makeKey(int32_t x, int32_t z)
+	{
+		return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(z);
+	}
+
+	static void splitKey(CellKey key, int32_t& x, int32_t& z)
+	{
+		x = static_cast<int32_t>(key >> 32);
+		z = static_cast<int32_t>(key & 0xFFFFFFFF);
+	}
+
+	static CellKey cellKeyFromPosition(const glm::vec3& position)
+	{
+		float cellSize = static_cast<float>(sCellSizeCVar->value);
+		return makeKey(static_cast<int32_t>(std::floor(position.x / cellSize)),
+			static_cast<int32_t>(std::floor(position.z / cellSize)));
+	}
+
+	//Returns true if the object was bucketed into a cell, false if it must stay resident
+	static bool bucketObject(const nlohmann::json& objJson, uint64_t generation)
+	{
+		if (!objJson.contains("type") || !objJson["type"].is_string())
+			return false;
+		if (sStreamableTypes.find(objJson["type"].get<std::string>()) == sStreamableTypes.end())
+			return false;
+
+		glm::vec3 position;
+		if (!findGameObjectPosition(objJson, position))
+			return false;
+
+		CellKey key = cellKeyFromPosition(position);
+		std::vector<uint8_t> serialized = nlohmann::json::to_msgpack(objJson);
+
+		std::lock_guard lk(sMutex);
+		if (generation == sGeneration)
+			sCells[key].serializedObjects.push_back(std::move(serialized));
+		return true;
+	}
+
+	//Binary worlds already store type, position and msgpack bodies, cells take the bytes as they are
+	static void indexBinaryWorldFile(const std::string& filename, uint64_t generation)
+	{
+		auto start = Clock::now();
+		size_t objectCount = 0;
+		size_t cellCount = 0;
+		std::string worldName;
+		std::unordered_map<CellKey, std::vector<std::vector<uint8_t>>> cellObjects;
+		std::vector<nlohmann::json> residentObjects;
+		try
+		{
+			Binary::Reader reader(filename);
+			objectCount = reader.getObjectCount();
+			worldName = std::string(reader.getWorldName());
+			for (uint32_t i = 0; i < reader.getObjectCount(); i++)
+			{
+				Binary::ObjectView view = reader.getObject(i);
+				if (view.hasPosition && sStreamableTypes.find(std::string(view.type)) != sStreamableTypes.end())
+					cellObjects[cellKeyFromPosition(view.position)].emplace_back(view.data, view.data + view.size);
+				else
+					residentObjects.push_back(view.decode());
+			}
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("Failed to index world file " + filename + ": " + e.what());
+			return;
+		}
+
+		{
+			std::lock_guard lk(sMutex);
+			if (generation != sGeneration)
+				return;
+			sWorldName = worldName;
+			sWorldNameReady = true;
+			for (auto& [key, objects] : cellObjects)
+			{
+				auto& serializedObjects = sCells[key].serializedObjects;
+				for (auto& object : objects)
+					serializedObjects.push_back(std::move(object));
+			}
+			for (auto& objJson : residentObjects)
+				sResidentObjects.push_back(std::move(objJson));
+			sIndexed = true;
+			cellCount = sCells.size();
+		}
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Logger::gInfo("World streaming: indexed " + std::to_string(objectCount) + " objects into "
+			+ std::to_string(cellCount) + " cells in " + std::to_string(ms) + " ms");
+	}
+
+	static void indexWorldFile(const std::string& filename, uint64_t generation)
+	{
+		if (Binary::isBinaryWorld(filename))
+		{
+			indexBinaryWorldFile(filename, generation);
+			return;
+		}
+
+		auto start = Clock::now();
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			Logger::gError("Failed to open file for streaming game objects: " + filename);
+			return;
+		}
+
+		//Objects are handed out as soon as they are parsed and discarded, the full DOM is never built
+		size_t objectCount = 0;
+		std::string lastKey;
+		auto callback = [&](int depth, nlohmann::json::parse_event_t event, nlohmann::json& parsed) -> bool
+			{
+				if (depth == 1 && event == nlohmann::json::parse_event_t::key)
+				{
+					lastKey = parsed.get<std::string>();
+					return true;
+				}
+				if (depth == 1 && event == nlohmann::json::parse_event_t::value && lastKey == "worldName" && parsed.is_string())
+				{
+					std::lock_guard lk(sMutex);
+					if (generation == sGeneration)
+					{
+						sWorldName = parsed.get<std::string>();
+						sWorldNameReady = true;
+					}
+					return false;
+				}
+				if (depth == 2 && event == nlohmann::json::parse_event_t::object_end && lastKey == "gameObjects")
+				{
+					objectCount++;
+					if (!bucketObject(parsed, generation))
+					{
+						std::lock_guard lk(sMutex);
+						if (generation == sGeneration)
+							sResidentObjects.push_back(std::move(parsed));
+					}
+					return false;
+				}
+				return true;
+			};
+
+		try
+		{
+			//The callback drops every object once bucketed, the DOM that is left is thrown away on purpose
+			(void)nlohmann::json::parse(file, callback);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::gError("Failed to index world file " + filename + ": " + e.what());
+		}
+
+		size_t cellCount = 0;
+		{
+			std::lock_guard lk(sMutex);
+			if (generation != sGeneration)
+				return;
+			sIndexed = true;
+			cellCount = sCells.size();
+		}
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Logger::gInfo("World streaming: indexed " + std::to_string(objectCount) + " objects into "
+			+ std::to_string(cellCount) + " cells in " + std::to_string(ms) + " ms");
+	}
+
+	static void parseCell(CellKey key, uint64_t generation)
+	{
+		std::vector<std::vector<uint8_t>> serialized;
+		{
+			std::lock_guard lk(sMutex);
+			if (generation != sGeneration)
+				return;
+			serialized = std::move(sCells[key].serializedObjects);
+			sCells[key].serializedObjects.clear();
+		}
+
+		std::vector<nlohmann::json> parsed;
+		parsed.reserve(serialized.size());
+		for (const auto& data : serialized)
+		{
+			try
+			{
+				parsed.push_back(nlohmann::json::from_msgpack(data));
+			}
+			catch (const std::exception& e)
+			{
+				Logger::gError(std::string("World streaming: failed to decode object: ") + e.what());
+			}
+		}
+
+		std::lock_guard lk(sMutex);
+		if (generation != sGeneration)
+			return;
+		Cell& cell = sCells[key];
+		cell.parsedObjects = std::move(parsed);
+		cell.state = Cell::State::Parsed;
+	}
+
+	//File I/O, asset decoding, collision shapes and body creation for a whole cell
+	static void prepareCell(const std::shared_ptr<PendingCell>& cell, uint64_t generation)
+	{
+		for (auto& object : cell->objects)
+		{
+			if (!object.object || !object.error.empty())
+				continue;
+			try
+			{
+				object.prepared = object.object->prepareLoad(object.json, cell->context);
+			}
+			catch (const nlohmann::detail::exception& e)
+			{
+				object.error = "JSON parsing error for game object type '" + object.type + "': " + e.what();
+			}
+			catch (const std::exception& e)
+			{
+				object.error = e.what();
+			}
+		}
+
+		std::lock_guard lk(sMutex);
+		if (generation != sGeneration)
+			return;
+		Cell& target = sCells[cell->key];
+		target.prepared = cell;
+		target.state = Cell::State::Prepared;
+	}
+
+	static void threadFn()
+	{
+		eg::Logger::gInfo("World streaming thread started !");
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock lk(sMutex);
+				sCV.wait(lk, [] {
+					return !sJobs.empty() || !sThreadRunning;
+					});
+				if (!sThreadRunning)
+					break;
+				job = std::move(sJobs.front());
+				sJobs.pop_front();
+			}
+
+			switch (job.type)
+			{
+			case Job::Type::Index:
+			{
+				indexWorldFile(job.filename, job.generation);
+				std::lock_guard lk(sMutex);
+				if (job.generation == sGeneration)
+					sIndexing = false;
+				break;
+			}
+			case Job::Type::Parse:
+				parseCell(job.key, job.generation);
+				break;
+			case Job::Type::Prepare:
+				prepareCell(job.cell, job.generation);
+				break;
+			}
+		}
+		eg::Logger::gInfo("World streaming thread destroyed !");
+	}
+
+	static IGameObject* instantiate(const nlohmann::json& objJson)
+	{
+		if (!objJson.contains("type") || !objJson["type"].is_string())
+		{
+			eg::Logger::gError("Game object type is missing or invalid in JSON: " + objJson.dump());
+			return nullptr;
+		}
+		std::string type = objJson["type"];
+		try
+		{
+			IGameObject* ptr = nullptr;
+			if (IObjectPool* pool = findObjectPool(type))
+			{
+				ptr = pool->spawnObject(objJson);
+			}
+			else
+			{
+				std::unique_ptr<IGameObject> gameObject = sDispatcher(objJson, type);
+				gameObject->fromJson(objJson);
+				ptr = gameObject.get();
+				addGameObject(std::move(gameObject));
+			}
+
+			//Objects streaming back in keep the id they were journaled under
+			if (Journal::isActive() && objJson.contains("saveId"))
+				setSaveId(ptr, objJson["saveId"].get<uint64_t>());
+			return ptr;
+		}
+		catch (const nlohmann::detail::exception& e)
+		{
+			eg::Logger::gError("JSON parsing error for game object type '" + type + "': " + e.what());
+		}
+		catch (const std::exception& e)
+		{
+			eg::Logger::gError(e.what());
+		}
+		return nullptr;
+	}
+
+	static void releasePoolReservation(PendingObject& object)
+	{
+		auto it = sPoolReservations.find(object.pool);
+		if (it != sPoolReservations.end() && it->second > 0)
+			it->second--;
+		object.pool = nullptr;
+	}
+
+	//Main thread, dispatchers may touch renderer state. Pooled types are spawned at finalization instead
+	static std::shared_ptr<PendingCell> dispatchCell(CellKey key, std::vector<nlohmann::json>&& objects)
+	{
+		auto cell = std::make_shared<PendingCell>();
+		cell->key = key;
+		cell->objects.resize(objects.size());
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			PendingObject& object = cell->objects[i];
+			object.json = std::move(objects[i]);
+			if (!object.json.contains("type") || !object.json["type"].is_string())
+			{
+				object.error = "Game object type is missing or invalid in JSON: " + object.json.dump();
+				continue;
+			}
+			object.type = object.json["type"].get<std::string>();
+			//Objects past the pool's free count take the dispatcher and prepare path like any other
+			IObjectPool* pool = findObjectPool(object.type);
+			if (pool && pool->getFreeCount() > sPoolReservations[pool])
+			{
+				sPoolReservations[pool]++;
+				object.pool = pool;
+				continue;
+			}
+			try
+			{
+				object.object = sDispatcher(object.json, object.type);
+				if (!object.object)
+					object.error = "Unknown game object type: " + object.type;
+			}
+			catch (const std::exception& e)
+			{
+				object.error = e.what();
+			}
+		}
+		return cell;
+	}
+
+	//GPU uploads, objects without a prepare step are loaded the old way
+	static void finalizeObject(PendingCell& cell, PendingObject& object)
+	{
+		if (!object.error.empty())
+			return;
+		try
+		{
+			if (object.pool)
+			{
+				releasePoolReservation(object);
+				//Parked bodies are already in the physics system, the object joins the world right away
+				object.spawned = instantiate(object.json);
+				if (object.spawned)
+				{
+					std::lock_guard lk(sMutex);
+					sCells[cell.key].objects.push_back(object.spawned);
+				}
+			}
+			else if (object.prepared)
+			{
+				object.object->finishLoad();
+			}
+			else if (object.object)
+			{
+				object.object->fromJson(object.json);
+			}
+		}
+		catch (const nlohmann::detail::exception& e)
+		{
+			object.error = "JSON parsing error for game object type '" + object.type + "': " + e.what();
+		}
+		catch (const std::exception& e)
+		{
+			object.error = e.what();
+		}
+	}
+
+	//Every object of the cell is finalized, its bodies go in with a single batch
+	static void addCell(PendingCell& cell)
+	{
+		cell.context.flush();
+
+		std::vector<IGameObject*> added;
+		for (auto& object : cell.objects)
+		{
+			if (!object.error.empty())
+			{
+				eg::Logger::gError(object.error);
+				//Its body was part of the batch, retiring removes it again
+				retireGameObject(std::move(object.object));
+				continue;
+			}
+			if (!object.object)
+				continue;
+
+			IGameObject* ptr = object.object.get();
+			addGameObject(std::move(object.object));
+			//Objects streaming back in keep the id they were journaled under
+			if (Journal::isActive() && object.json.contains("saveId"))
+				setSaveId(ptr, object.json["saveId"].get<uint64_t>());
+			added.push_back(ptr);
+		}
+
+		std::lock_guard lk(sMutex);
+		auto& objects = sCells[cell.key].objects;
+		objects.insert(objects.end(), added.begin(), added.end());
+	}
+
+	static void serializeBack(nlohmann::json objJson)
+	{
+		glm::vec3 position;
+		CellKey key = findGameObjectPosition(objJson, position) ? cellKeyFromPosition(position) : makeKey(0, 0);
+		std::vector<uint8_t> serialized = nlohmann::json::to_msgpack(objJson);
+
+		std::lock_guard lk(sMutex);
+		sCells[key].serializedObjects.push_back(std::move(serialized));
+	}
+
+	static void unloadCell(CellKey key)
+	{
+		std::vector<IGameObject*> objects;
+		{
+			std::lock_guard lk(sMutex);
+			Cell& cell = sCells[key];
+			objects = std::move(cell.objects);
+			cell.objects.clear();
+			cell.state = Cell::State::NonResident;
+		}
+
+		//Objects may have moved, they are re-bucketed with their current state
+		for (IGameObject* object : objects)
+		{
+			nlohmann::json objJson = object->toJson();
+			objJson["type"] = std::string(object->getType());
+			if (Journal::isActive())
+			{
+				objJson["saveId"] = getSaveId(object);
+				Journal::onObjectStreamedOut(object, objJson);
+			}
+			if (IObjectPool* pool = findObjectPool(object->getType()))
+				pool->despawnObject(object);
+			else
+				removeGameObject(object);
+			serializeBack(std::move(objJson));
+		}
+
+		//Objects that were still waiting for finalization, spawned ones already left with the cell
+		for (auto it = sFinalizeQueue.begin(); it != sFinalizeQueue.end();)
+		{
+			if ((*it)->key != key)
+			{
+				++it;
+				continue;
+			}
+			for (auto& object : (*it)->objects)
+			{
+				if (object.spawned)
+					continue;
+				if (object.pool)
+					releasePoolReservation(object);
+				serializeBack(std::move(object.json));
+				retireGameObject(std::move(object.object));
+			}
+			it = sFinalizeQueue.erase(it);
+		}
+	}
+
+	void create()
+	{
+		sCellSizeCVar = Command::registerVar("eg::World::Streaming::CellSize", "None", 64.0);
+		sStreamInRadiusCVar = Command::registerVar("eg::World::Streaming::StreamInRadius", "None", 2.0);
+		sStreamOutRadiusCVar = Command::registerVar("eg::World::Streaming::StreamOutRadius", "None", 3.0);
+		sBudgetCVar = Command::registerVar("eg::World::Streaming::BudgetMs", "None", 2.0);
+
+		sThreadRunning = true;
+		sThread = std::make_unique<std::thread>(threadFn);
+	}
+
+	void destroy()
+	{
+		{
+			std::lock_guard lk(sMutex);
+			sThreadRunning = false;
+			sCV.notify_one();
+		}
+		if (sThread)
+		{
+			sThread->join();
+			sThread.reset();
+		}
+		reset();
+	}
+
+	void reset()
+	{
+		std::lock_guard lk(sMutex);
+		sGeneration++;
+		sJobs.clear();
+		sCells.clear();
+		sResidentObjects.clear();
+		sWorldNameReady = false;
+		sIndexed = false;
+		sIndexing = false;
+		sFinalizeQueue.clear();
+		sPoolReservations.clear();
+	}
+
+	void registerStreamableType(const std::string& type)
+	{
+		sStreamableTypes.insert(type);
+	}
+
+	void load(const std::string& filename, JsonToIGameObjectDispatcher dispatcher)
+	{
+		World::cleanup();
+		Journal::recover(filename);
+		sDispatcher = std::move(dispatcher);
+
+		std::lock_guard lk(sMutex);
+		sIndexing = true;
+		sJobs.push_back(Job{ Job::Type::Index, filename, 0, sGeneration });
+		sCV.notify_one();
+	}
+
+	void update(const glm::vec3& focus)
+	{
+		auto start = Clock::now();
+		const double budgetMs = sBudgetCVar->value;
+		const int32_t streamInRadius = static_cast<int32_t>(sStreamInRadiusCVar->value);
+		const int32_t streamOutRadius = std::max(streamInRadius, static_cast<int32_t>(sStreamOutRadiusCVar->value));
+
+		int32_t focusX, focusZ;
+		splitKey(cellKeyFromPosition(focus), focusX, focusZ);
+
+		std::deque<nlohmann::json> residentObjects;
+		std::vector<CellKey> cellsToUnload;
+		std::vector<std::pair<CellKey, std::vector<nlohmann::json>>> cellsToDispatch;
+		{
+			std::lock_guard lk(sMutex);
+			if (sWorldNameReady)
+			{
+				World::setWorldName(sWorldName);
+				sWorldNameReady = false;
+			}
+			residentObjects = std::move(sResidentObjects);
+			sResidentObjects.clear();
+
+			//Cells are only requested once the whole file is indexed, so resident objects (maps, players) come first
+			if (sIndexed)
+			{
+				for (auto& [key, cell] : sCells)
+				{
+					int32_t x, z;
+					splitKey(key, x, z);
+					int32_t distance = std::max(std::abs(x - focusX), std::abs(z - focusZ));
+
+					switch (cell.state)
+					{
+					case Cell::State::NonResident:
+						if (distance <= streamInRadius && !cell.serializedObjects.empty())
+						{
+							cell.state = Cell::State::Requested;
+							sJobs.push_back(Job{ Job::Type::Parse, {}, key, sGeneration });
+							sCV.notify_one();
+						}
+						break;
+					case Cell::State::Parsed:
+						cellsToDispatch.emplace_back(key, cell.parsedObjects);
+						cell.state = Cell::State::Preparing;
+						break;
+					case Cell::State::Prepared:
+						sFinalizeQueue.push_back(std::move(cell.prepared));
+						cell.prepared.reset();
+						cell.parsedObjects.clear();
+						cell.state = Cell::State::Resident;
+						break;
+					case Cell::State::Resident:
+						if (distance > streamOutRadius)
+						{
+							cellsToUnload.push_back(key);
+						}
+						else if (!cell.serializedObjects.empty())
+						{
+							//Objects moved in from a cell that streamed out
+							cell.state = Cell::State::Requested;
+							sJobs.push_back(Job{ Job::Type::Parse, {}, key, sGeneration });
+							sCV.notify_one();
+						}
+						break;
+					default:
+						break;
+					}
+				}
+			}
+		}
+
+		//Resident objects are not budgeted, the world is not playable without them
+		for (const auto& objJson : residentObjects)
+		{
+			instantiate(objJson);
+		}
+
+		for (CellKey key : cellsToUnload)
+		{
+			unloadCell(key);
+		}
+
+		for (auto& [key, objects] : cellsToDispatch)
+		{
+			std::shared_ptr<PendingCell> cell = dispatchCell(key, std::move(objects));
+			std::lock_guard lk(sMutex);
+			sJobs.push_back(Job{ Job::Type::Prepare, {}, key, sGeneration, std::move(cell) });
+			sCV.notify_one();
+		}
+
+		//Amortize GPU uploads over frames, the prepare step already ran on the streaming thread
+		uint32_t finalized = 0;
+		while (!sFinalizeQueue.empty())
+		{
+			PendingCell& cell = *sFinalizeQueue.front();
+			while (cell.finalized < cell.objects.size())
+			{
+				double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				if (finalized > 0 && elapsedMs > budgetMs)
+					return;
+				finalizeObject(cell, cell.objects[cell.finalized++]);
+				finalized++;
+			}
+			addCell(cell);
+			sFinalizeQueue.pop_front();
+		}
+	}
+
+	void appendNonResidentObjects(nlohmann::json& gameObjectsJson)
+	{
+		for (const auto& cell : sFinalizeQueue)
+		{
+			for (const auto& object : cell->objects)
+			{
+				if (!object.spawned)
+					gameObjectsJson.push_back(object.json);
+			}
+		}
+
+		std::lock_guard lk(sMutex);
+		for (const auto& objJson : sResidentObjects)
+		{
+			gameObjectsJson.push_back(objJson);
+		}
+		for (const auto& [key, cell] : sCells)
+		{
+			for (const auto& data : cell.serializedObjects)
+			{
+				gameObjectsJson.push_back(nlohmann::json::from_msgpack(data));
+			}
+			for (const auto& objJson : cell.parsedObjects)
+			{
+				gameObjectsJson.push_back(objJson);
+			}
+		}
+	}
+
+	void stampNonResidentObjects(nlohmann::json& gameObjectsJson)
+	{
+		auto stamp = [&gameObjectsJson](nlohmann::json& objJson) {
+			objJson["saveId"] = allocateSaveId();
+			gameObjectsJson.push_back(objJson);
+			};
+
+		for (auto& cell : sFinalizeQueue)
+		{
+			for (auto& object : cell->objects)
+			{
+				if (!object.spawned)
+					stamp(object.json);
+			}
+		}
+
+		std::lock_guard lk(sMutex);
+		for (auto& objJson : sResidentObjects)
+		{
+			stamp(objJson);
+		}
+		for (auto& [key, cell] : sCells)
+		{
+			for (auto& data : cell.serializedObjects)
+			{
+				nlohmann::json objJson = nlohmann::json::from_msgpack(data);
+				stamp(objJson);
+				data = nlohmann::json::to_msgpack(objJson);
+			}
+			for (auto& objJson : cell.parsedObjects)
+			{
+				stamp(objJson);
+			}
+		}
+	}
+
+	bool isBusy()
+	{
+		std::lock_guard lk(sMutex);
+		if (sIndexing)
+			return true;
+		for (const auto& [key, cell] : sCells)
+		{
+			if (cell.state != Cell::State::NonResident && cell.state != Cell::State::Resident)
+				return true;
+		}
+		return false;
+	}
+
+	size_t getResidentCellCount()
+	{
+		std::lock_guard lk(sMutex);
+		size_t count = 0;
+		for (const auto& [key, cell] : sCells)
+		{
+			if (cell.state == Cell::State::Resident)
+				count++;
+		}
+		return count;
+	}
+
+	size_t getCellCount()
+	{
+		std::lock_guard lk(sMutex);
+		return sCells.size();
+	}
+}
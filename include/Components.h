@@ -1,6 +1,10 @@
 #pragma once
 
 #include <optional>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <limits>
 #include <glm/vec3.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/mat4x4.hpp>
@@ -11,6 +15,7 @@
 #include <Jolt/Physics/Body/BodyID.h>
 
 #include <Renderer.h>
+#include <RenderStages.h>
 #include <Core.h>
 
 
@@ -33,6 +38,12 @@ namespace eg::Components
 		void updatePrevState();
 		glm::mat4x4 getBodyMatrix(float alpha) const;
 
+		//Pooling, the body stays in the physics system but is deactivated and moved out of the way
+		void park();
+		void unpark(const glm::vec3& position, const glm::quat& rotation);
+		//Removes the body from the physics system if it is still there, safe to call more than once
+		void destroy();
+
 		nlohmann::json toJson() const;
 	};
 
@@ -107,6 +118,8 @@ namespace eg::Components
 		bool isSphereInFrustum(const glm::vec3& center, float radius) const;
 		// Update the frustum planes based on the camera's view and projection matrices
 		void updateFrustumPlanes(vk::Extent2D extent);
+		// Plane as (normal, d), inside when dot(normal, p) + d >= 0
+		glm::vec4 getPlane(size_t index) const { return glm::vec4(mFrustumPlanes[index].normal, mFrustumPlanes[index].d); }
 	private:
 		FrustumPlane extractPlane(float a, float b, float c, float d);
 	private:
@@ -183,50 +196,69 @@ namespace eg::Components
 			glm::mat4x4 model;
 		};
 
+		struct InstanceStats
+		{
+			uint32_t instances = 0;
+			uint32_t drawCalls = 0;
+		};
+
 		static void create();
 		static void destroy();
+		//Draws every instance render and renderShadow queued for the stage, called when the stage's recording ends
+		static void flushInstances(Renderer::RenderStage stage);
+		//Culls the instances flushed this frame on the GPU and writes their indirect draws, outside any render pass
+		static void cullInstances(vk::CommandBuffer cmd);
+		static InstanceStats getInstanceStats(Renderer::RenderStage stage);
 	private:
 		static void createStaticModelPipeline();
 		static void createStaticModelShadowPipeline();
+		static void createCullPipeline();
+		static void destroyPipelines();
+		//Pipeline, layout and per pass descriptor sets of the stage
+		static Renderer::RenderQueue::Packet stagePacket(uint32_t stageIndex);
+		static void drawInstances(uint32_t stageIndex);
+		static void drawInstancesIndirect(uint32_t stageIndex);
 	private:
 		static vk::Pipeline sPipeline;
 		static vk::PipelineLayout sPipelineLayout;
-		static vk::DescriptorSetLayout sDescriptorLayout;
 
 		static vk::Pipeline sShadowPipeline;
 		static vk::PipelineLayout sShadowPipelineLayout;
 
+		static vk::Pipeline sCullPipeline;
+		static vk::PipelineLayout sCullPipelineLayout;
+		static vk::DescriptorSetLayout sCullDescriptorLayout;
+
 		static Command::Var* sRenderScaleCVar;
 		static Command::Var* sWidthCVar;
 		static Command::Var* sHeightCVar;
+		static Command::Var* sInstancingCVar;
+		static Command::Var* sGpuCullingCVar;
 
 	//Per instance field
 
 	protected:
 		struct RawMesh
 		{
-			Renderer::GPUBuffer positionBuffer;
-			Renderer::GPUBuffer normalBuffer;
-			Renderer::GPUBuffer uvBuffer;
-			Renderer::GPUBuffer indexBuffer;
+			Renderer::MeshBuffer geometry;
 			uint32_t materialIndex = 0;
-			uint32_t vertexCount = 0;
+			uint32_t lod = 0;
+			uint32_t lodCount = 1;
 		};
 
 		struct Material
 		{
-			struct UniformBuffer
-			{
-				float albedoColor[3] = {};
-				uint32_t has_albedo = 0;
-				uint32_t has_normal = 0;
-				uint32_t has_mr = 0;
-			};
-			std::shared_ptr<Renderer::CPUBuffer> mUniformBuffer;
 			std::shared_ptr<Renderer::CombinedImageSampler2D> mAlbedo;
 			std::shared_ptr<Renderer::CombinedImageSampler2D> mNormal;
 			std::shared_ptr<Renderer::CombinedImageSampler2D> mMr;
-			vk::DescriptorSet mSet;
+			//Slots in the bindless set, draws push mIndex
+			uint32_t mIndex = Renderer::Bindless::INVALID_INDEX;
+			uint32_t mTextures[3] = { Renderer::Bindless::INVALID_INDEX, Renderer::Bindless::INVALID_INDEX, Renderer::Bindless::INVALID_INDEX };
+		};
+
+		struct MaterialPushConstant
+		{
+			uint32_t materialIndex;
 		};
 
 		std::vector<RawMesh> mRawMeshes;
@@ -234,24 +266,53 @@ namespace eg::Components
 		std::vector<Material> mMaterials;
 
 		std::string mFilePath;
+
+		//Local space bounds, used for LOD selection
+		glm::vec3 mBoundsMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 mBoundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		uint32_t mLodCount = 1;
 	protected:
 		StaticModel() = default;
 
 		void extractRawMeshes(const tinygltf::Model& model);
 		void extractMaterials(const tinygltf::Model& model);
+		//Bindless slots for a material whose images are already set
+		void createMaterial(Material& material, const glm::vec3& albedoColor);
+		//Frees every material's bindless slots
+		void releaseMaterials();
+		void expandBounds(const std::vector<glm::vec3>& positions);
+		//Uploads a MeshCache file, defined next to the cooker
+		void loadCooked(const std::string& cookedPath);
+		//Meshes of one LOD level, instanceCount transforms from firstInstance of the instance buffer
+		void drawMeshes(uint32_t stageIndex, uint32_t lod, uint32_t firstInstance, uint32_t instanceCount,
+			vk::Buffer instanceBuffer, float depth) const;
 	public:
+		//Per glTF mesh: the mesh followed by its coarser levels, empty for meshes that are a coarser level themselves
+		static std::vector<std::vector<int32_t>> extractLodChains(const tinygltf::Model& model);
+
 		StaticModel(const std::string& filePath);
 		StaticModel(const std::string& filePath, const tinygltf::Model& model);
+		//From a file returned by MeshCache::getCookedPath
+		StaticModel(const std::string& filePath, const std::string& cookedPath);
 		virtual ~StaticModel();
 
+		//Queue an instance, objects sharing the model are drawn together by flushInstances
 		void render(vk::CommandBuffer cmd,
-			glm::mat4x4 worldTransform);
+			glm::mat4x4 worldTransform, uint32_t lod = 0);
 		void renderShadow(vk::CommandBuffer cmd,
-			glm::mat4x4 worldTransform);
+			glm::mat4x4 worldTransform, uint32_t lod = 0);
 
 		const std::vector<RawMesh>& getRawMeshes() const { return mRawMeshes; }
 		const std::vector<Material>& getMaterials() const { return mMaterials; }
 
+		//Bytes held on the GPU and in host memory, charged against the ModelCache budget
+		virtual size_t getGpuMemorySize() const;
+		virtual size_t getCpuMemorySize() const;
+
+		uint32_t getLodCount() const { return mLodCount; }
+		glm::vec3 getBoundingCenter() const { return (mBoundsMin + mBoundsMax) * 0.5f; }
+		float getBoundingRadius() const;
+
 		nlohmann::json toJson() const
 		{
 			return { {"model_path", mFilePath} };
@@ -262,6 +323,48 @@ namespace eg::Components
 	};
 
 
+	//Picks a LOD level from the projected screen size of a model's bounding sphere.
+	//The shadow stage keeps its own level and uses a coarser bias
+	class LevelOfDetail
+	{
+	//Static field
+	public:
+		static constexpr uint32_t MAX_LOD_COUNT = 8;
+
+		struct Stats
+		{
+			uint32_t objects[MAX_LOD_COUNT] = {};
+			uint32_t drawCalls[MAX_LOD_COUNT] = {};
+			uint32_t triangles[MAX_LOD_COUNT] = {};
+		};
+
+		static void create();
+		//Publishes the counters of the frame that was just recorded
+		static void endFrame();
+		static void recordSubmit(Renderer::RenderStage stage, uint32_t lod, uint32_t drawCalls, uint32_t triangles, uint32_t objects = 1);
+		static const Stats& getStats(Renderer::RenderStage stage);
+	private:
+		static Command::Var* sScreenSizeCVar;
+		static Command::Var* sHysteresisCVar;
+		static Command::Var* sShadowBiasCVar;
+		static Command::Var* sForceLodCVar;
+
+		static std::atomic<uint32_t> sObjects[2][MAX_LOD_COUNT];
+		static std::atomic<uint32_t> sDrawCalls[2][MAX_LOD_COUNT];
+		static std::atomic<uint32_t> sTriangles[2][MAX_LOD_COUNT];
+		static Stats sLastStats[2];
+
+	//Per instance field
+	private:
+		uint32_t mLods[2] = {};
+	public:
+		LevelOfDetail() = default;
+		~LevelOfDetail() = default;
+
+		uint32_t select(Renderer::RenderStage stage, const glm::mat4x4& worldTransform, const StaticModel& model);
+		uint32_t getLod(Renderer::RenderStage stage) const;
+	};
+
 	class Animation
 	{
 	private:
@@ -304,6 +407,7 @@ namespace eg::Components
 		inline const std::string& getName() const { return mName; }
 		inline const std::vector<Channel>& getChannels() const { return mChannels; }
 		inline float getDuration() const { return mDuration; }
+		size_t getMemorySize() const;
 	};
 
 	class AnimatedModel : public StaticModel
@@ -319,8 +423,9 @@ namespace eg::Components
 	private:
 		static vk::Pipeline sPipeline;
 		static vk::PipelineLayout sPipelineLayout;
-		static vk::DescriptorSetLayout sMaterialLayout;
 		static vk::DescriptorSetLayout sBoneLayout;
+		//One per frame ring, every animator's bones are picked with a dynamic offset
+		static vk::DescriptorSet sBoneSets[Renderer::MAX_FRAMES_IN_FLIGHT];
 		 
 		static vk::Pipeline sShadowPipeline;
 		static vk::PipelineLayout sShadowPipelineLayout;
@@ -361,6 +466,7 @@ namespace eg::Components
 
 		int mRootNodeIndex = -1;
 		std::vector<AnimatedRawMesh> mAnimatedRawMeshes;
+		std::vector<std::vector<int32_t>> mLodChains;
 		std::vector<Node> mNodes;
 		std::vector<Skin> mSkins;
 
@@ -370,16 +476,20 @@ namespace eg::Components
 
 		AnimatedModel() = delete;
 		AnimatedModel(const std::string& filePath);
+		AnimatedModel(const std::string& filePath, const tinygltf::Model& model);
 		virtual ~AnimatedModel();
 
 		void render(vk::CommandBuffer cmd,
 			const Animator& animator,
-			glm::mat4x4 worldTransform);
+			glm::mat4x4 worldTransform, uint32_t lod = 0);
 		void renderShadow(vk::CommandBuffer cmd,
 			const Animator& animator,
-			glm::mat4x4 worldTransform);
+			glm::mat4x4 worldTransform, uint32_t lod = 0);
 
 
+		size_t getGpuMemorySize() const override;
+		size_t getCpuMemorySize() const override;
+
 		inline const std::vector<AnimatedRawMesh>& getAnimatedRawMehses() const { return mAnimatedRawMeshes; }
 		inline const std::vector<Skin>& getSkins() const { return mSkins; }
 		inline const int getRootNodeIndex() const { return mRootNodeIndex; }
@@ -413,20 +523,20 @@ namespace eg::Components
 		std::shared_ptr<Animation> mCurrentAnimation;
 		BoneMatrices mBoneMatrices;
 		AnimationNodeVec mAnimationNodes;
-		vk::DescriptorSet mDescriptorSet;
-		Renderer::CPUBuffer mUniformBuffer;
 		AnimationMap mAnimationMap;
 		float mCurrentTime = 0.0f;
 		float mTimeScale = 1.0f;
 	public:
 		Animator(const std::vector<std::shared_ptr<Animation>>& animations, const AnimatedModel& model);
-		virtual ~Animator();
+		virtual ~Animator() = default;
 
 		void update(float deltaTime);
 
 
 		void setAnimation(const std::string& animationName);
-		inline vk::DescriptorSet getDescriptorSet() const { return mDescriptorSet; }
+		//Copies the bone matrices into the frame ring, the offset goes with AnimatedModel's bone set.
+		//Empty when the ring is full
+		std::optional<uint32_t> snapshotBones() const;
 		inline const AnimationNodeVec& getAnimationNodes() const { return mAnimationNodes; }
 
 		std::shared_ptr<AnimationNode> getAnimationNodeByName(const std::string& name);
@@ -468,17 +578,94 @@ namespace eg::Components
 		virtual void processCurrentAnimation(float delta) override;
 	};
 
+	//Asset that may still be loading. Copies share the load, get() is safe from the render threads
+	template<typename T>
+	class AssetHandle
+	{
+	private:
+		std::string mPath;
+		std::shared_future<std::shared_ptr<T>> mFuture;
+	public:
+		AssetHandle() = default;
+		AssetHandle(const std::string& path, std::shared_future<std::shared_ptr<T>> future) :
+			mPath(path), mFuture(std::move(future)) {}
+
+		bool isReady() const
+		{
+			return mFuture.valid() && mFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+		//Null while loading and when the load failed
+		const std::shared_ptr<T>& get() const
+		{
+			static const std::shared_ptr<T> sNull;
+			return isReady() ? mFuture.get() : sNull;
+		}
+		const std::string& getPath() const { return mPath; }
+	};
+
 	namespace ModelCache
 	{
+		static constexpr const char* PLACEHOLDER_PATH = "models/box.glb";
+
+		void create();
+		void destroy();
+
+		//Return at once, the file is read and decoded on a job thread and its GPU resources are created on the
+		//transfer thread. Requests for a path already in flight share its load, synchronous loads of it wait for it
+		AssetHandle<StaticModel> loadStaticModelAsync(const std::string& filePath);
+		AssetHandle<AnimatedModel> loadAnimatedModelAsync(const std::string& filePath);
+		AssetHandle<Animation> loadAnimationAsync(const std::string& animPath);
+		//Drawn in place of static models that are still loading, null if it can't be loaded
+		const std::shared_ptr<StaticModel>& getPlaceholder();
+		uint32_t getLoadingCount();
+
 		std::shared_ptr<StaticModel> loadStaticModel(const std::string& filePath);
 		std::shared_ptr<StaticModel> loadStaticModelFromJson(const nlohmann::json& json);
 		std::shared_ptr<AnimatedModel> loadAnimatedModel(const std::string& filePath);
 		std::shared_ptr<AnimatedModel> loadAnimatedModelFromJson(const nlohmann::json& json);
 
 		std::shared_ptr<Animation> loadAnimation(const std::string& animPath);
+
+		//Resident assets are charged their GPU and host bytes against eg::Components::ModelCacheBudgetMB.
+		//Over budget, assets nothing outside the cache references are evicted least recently used first
+		struct Stats
+		{
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t gpuBytes = 0;
+			size_t cpuBytes = 0;
+			uint32_t residentCount = 0;
+		};
+		//Per frame, evicted assets are released once no frame in flight can draw them
+		void update();
+		//Evicts down to the budget and releases at once, the GPU must be idle
+		void trim();
+		Stats getStats();
+		//Drops every cached asset, the GPU must be idle
 		void clearCache();
 	}
 
+	//Cooked static models (.egm): vertex streams in binding order, 16 bit indices where they fit and BC3 textures
+	//with their mip chains. Files are named after a hash of the source contents, an edited source is cooked again
+	namespace MeshCache
+	{
+		static constexpr uint32_t VERSION = 2;
+		static constexpr const char* EXTENSION = ".egm";
+		static constexpr const char* DIRECTORY = "cache";
+
+		void create();
+		bool isEnabled();
+
+		//Path of an up to date cooked file for the source, cooked first if needed. Empty if the source can't be cooked
+		std::string getCookedPath(const std::string& sourcePath);
+		void cook(const std::string& sourcePath, const std::string& cookedPath);
+		void cookDirectory(const std::string& directory);
+
+		//glTF against cooked load time for every .glb in the directory
+		void benchmark(const std::string& directory, uint32_t iterations);
+	}
+
 
 	struct ParticleInstance {
 		glm::vec4 positionSize; // xyz = position, w = size
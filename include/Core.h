@@ -29,6 +29,23 @@ namespace eg
 
 		void execute(const std::string& commandLine);
 	};
+
+	//Shared worker threads for CPU work outside the frame: texture compression, pipeline builds.
+	//Jobs pushed before create or after destroy run on the calling thread
+	namespace Jobs
+	{
+		using Job = std::function<void()>;
+
+		void create();
+		//Runs the jobs still queued on the calling thread, then joins the workers
+		void destroy();
+
+		void push(Job&& job);
+		//Runs task(i) for every index, on up to maxThreads threads (0 for all of them). The calling thread takes part
+		//and returns once every index ran, so callers running on a worker themselves can't deadlock
+		void parallelFor(size_t count, uint32_t maxThreads, const std::function<void(size_t)>& task);
+		uint32_t getWorkerCount();
+	}
 }
 
 
@@ -17,6 +17,63 @@
 
 namespace eg::Data
 {
+	//Read only view of a whole file mapped into memory
+	class MappedFile
+	{
+	private:
+		const uint8_t* mData = nullptr;
+		size_t mSize = 0;
+#ifdef _WIN32
+		void* mFileHandle = nullptr;
+		void* mMappingHandle = nullptr;
+#else
+		int mFileDescriptor = -1;
+#endif
+	public:
+		MappedFile(const std::string& filePath);
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		const uint8_t* getData() const { return mData; }
+		size_t getSize() const { return mSize; }
+	};
+
+	//Block compression of RGBA8 textures, blocks are split across every idle core
+	namespace TextureCompressor
+	{
+		enum class Quality : uint32_t
+		{
+			Fast = 0, //SIMD range fit
+			Normal = 1, //stb_dxt
+			High = 2 //stb_dxt with endpoint refinement
+		};
+
+		struct CompressedImage
+		{
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+			vk::Format format = vk::Format::eBc3UnormBlock;
+			std::vector<uint8_t> data; //Levels packed one after another starting with the largest
+		};
+
+		void create();
+		Quality getQuality();
+		uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+		//Full box filtered mip chain, BC1 when every texel is opaque and BC3 otherwise.
+		//Tiles run on the shared job workers, threadCount 0 lets every worker take part
+		CompressedImage compress(const uint8_t* rgba, uint32_t width, uint32_t height, Quality quality, uint32_t threadCount = 0);
+
+		//Images decoded by LoadImageData hold the whole compressed chain
+		vk::Format getImageFormat(const tinygltf::Image& image);
+		uint32_t getImageMipLevels(const tinygltf::Image& image);
+
+		//Source MPixels/s of every quality mode on a generated size x size image
+		void benchmark(uint32_t size, uint32_t iterations);
+	}
+
 	bool LoadImageData(tinygltf::Image* image, const int image_idx, std::string* err,
 		std::string* warn, int req_width, int req_height,
 		const unsigned char* bytes, int size, void* user_data);
@@ -3,6 +3,7 @@
 #include <Jolt/Jolt.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/Physics/Body/BodyID.h>
+#include <Jolt/Physics/Body/BodyActivationListener.h>
 
 
 namespace eg::Physics
@@ -29,6 +30,8 @@ namespace eg::Physics
 	void render();
 	void destroy();
 	void reset();
+	//Kept across reset(), callbacks come from the physics job threads
+	void setBodyActivationListener(JPH::BodyActivationListener* listener);
 
 	JPH::PhysicsSystem& getPhysicsSystem();
 	JPH::BodyInterface* getBodyInterface();
@@ -3,12 +3,19 @@
 #include <MyVulkan.h>
 #include <vulkan-memory-allocator-hpp/vk_mem_alloc.hpp>
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <functional>
 #include <optional>
+#include <mutex>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <cstddef>
 
 #include <Logger.h>
+#include <RenderStages.h>
 
 namespace eg::Components
 {
@@ -20,6 +27,8 @@ namespace eg::Components
 namespace eg::Renderer
 {
 	static constexpr size_t MAX_FRAMES_IN_FLIGHT = 3;
+	//Recording trails the simulation by a frame, so anything a frame gathered has to outlive one more
+	static constexpr size_t RETIRE_FRAME_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
 	static constexpr uint8_t SKY_STENCIL_VALUE = 0x00;
 	static constexpr uint8_t MESH_STENCIL_VALUE = 0x01;
 
@@ -27,9 +36,138 @@ namespace eg::Renderer
 	using RenderFn = std::function<void(vk::CommandBuffer cmd, float alpha)>;
 
 	//Global functions
+	//Looked up in the ShaderCache first, shaderc only runs on a miss. Safe to call from any thread
 	std::vector<uint32_t> compileShaderFromFile(const std::string& filePath, uint32_t kind, 
 		std::vector<std::pair<std::string, std::string>> defines = {});
-	void immediateSubmit(std::function<void(vk::CommandBuffer cmd)>&& function);
+
+	//SPIR-V of every compiled shader variant, named after a hash of its source, defines, kind and compiler version.
+	//Entries record the includes they were built from and are compiled again once one of them changes
+	namespace ShaderCache
+	{
+		static constexpr uint32_t VERSION = 2;
+		static constexpr const char* EXTENSION = ".spv";
+		static constexpr const char* DIRECTORY = "cache/shaders";
+
+		struct Stats
+		{
+			uint32_t hits = 0;
+			uint32_t misses = 0;
+			double loadMs = 0.0; //Reading sources and checking entries
+			double compileMs = 0.0; //Spent in shaderc, 0 on a warm cache
+		};
+
+		void create();
+		bool isEnabled();
+		//Compiles every variant of a manifest (shaders/variants.json) that isn't cached, false if one failed
+		bool precompile(const std::string& manifestPath);
+		Stats getStats();
+	}
+	//One driver pipeline cache shared by every pipeline, kept in cache/pipeline_cache.bin between runs. Data another
+	//device or driver wrote is dropped on load. Pipelines are built by jobs on the shared job threads, everything a job
+	//creates is only used once the main thread waited for it
+	namespace PipelineCache
+	{
+		static constexpr const char* PATH = "cache/pipeline_cache.bin";
+
+		using Job = std::function<void()>;
+
+		struct Stats
+		{
+			bool warm = false; //Started from the file on disk
+			size_t loadedBytes = 0;
+			uint32_t jobs = 0; //Of the last batch waited on
+			double buildMs = 0.0; //From its first job to the end of the wait
+			double jobMs = 0.0; //Summed over every thread
+		};
+
+		void create();
+		//Waits for the running builds and stores the cache
+		void destroy();
+		vk::PipelineCache get();
+		//Runs the job on the calling thread before create and after destroy
+		void build(Job&& job);
+		//Main thread only. Runs queued jobs until every one finished, stores the cache and rethrows the first
+		//exception a job threw
+		void wait();
+		Stats getStats();
+	}
+
+	//Watches the shader directory, inotify on Linux and modification times elsewhere. A pipeline registered here
+	//records the sources and includes it compiles, a change to one of them recompiles it on the watcher thread.
+	//Only once every shader compiled is the pipeline built again, and only once that succeeded are the old objects retired
+	namespace HotReload
+	{
+		static constexpr const char* DIRECTORY = "shaders";
+
+		using Build = std::function<void()>;
+		//Captures the objects the pipeline owns right now, the returned function destroys them
+		using Detach = std::function<Build()>;
+
+		struct Stats
+		{
+			uint32_t pipelines = 0; //Registered
+			uint32_t reloads = 0;
+			uint32_t failures = 0; //Changes that didn't compile or build, the old pipeline was kept
+			double lastCompileMs = 0.0; //From the change being seen to its shaders compiling
+		};
+
+		void create();
+		void destroy();
+		//create is built by a PipelineCache job, or on the calling thread when inPlace. It builds into locals and
+		//publishes them once everything was created, a create that throws leaves the running objects alone.
+		//detach runs on the main thread right before a rebuild, what it returns goes to Renderer::retire once it succeeded
+		void registerPipeline(const std::string& name, Build&& create, Detach&& detach, bool inPlace = false);
+		//Called by compileShaderFromFile, records the shader for the pipeline the calling thread is building
+		void recordShader(const std::string& filePath, uint32_t kind, const std::vector<std::pair<std::string, std::string>>& defines,
+			const std::vector<std::string>& includes);
+		//Main thread, once per frame while the render thread is idle. Retires what the last rebuilds replaced and
+		//rebuilds the pipelines that recompiled, a rebuild that fails is logged and the old pipeline kept
+		void update();
+		Stats getStats();
+	}
+	//Held around every descriptor set allocation and free that can run off the main thread
+	std::unique_lock<std::mutex> lockDescriptorPool();
+	//Held around every submission to the main queue
+	std::unique_lock<std::mutex> lockMainQueue();
+	//Destroys objects frames still in flight may use once RETIRE_FRAME_COUNT frames passed. Main thread only
+	void retire(std::function<void()>&& destroy);
+
+	//Uploads from any thread are staged in a persistent ring and recorded into one batch, submitted once per frame
+	//or when the ring runs out. Buffer copies go to a dedicated transfer queue when the device has one,
+	//image work stays on the main queue. Frames wait for every batch flushed before them
+	namespace Upload
+	{
+		using Ticket = uint64_t; //Batch an upload was recorded in, 0 is always complete
+		using GraphicsRecordFn = std::function<void(vk::CommandBuffer cmd, vk::Buffer staging, vk::DeviceSize offset)>;
+
+		struct Stats
+		{
+			uint32_t submits = 0;
+			uint32_t copies = 0;
+			uint64_t bytes = 0;
+			double stallMs = 0.0; //Waiting for staging space or for a batch to complete
+		};
+
+		void create();
+		void destroy();
+
+		//dst needs transfer dst usage, and concurrent sharing with getSharedQueueFamilies()
+		Ticket copyToBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, size_t size);
+		//data is staged, record gets the main queue command buffer and where the data lies
+		Ticket recordGraphics(const void* data, size_t size, const GraphicsRecordFn& record);
+
+		void flush();
+		bool isComplete(Ticket ticket);
+		//Flushes the ticket's batch if it is still open
+		void wait(Ticket ticket);
+
+		//Called by end, returns the timeline semaphore and value the frame has to wait on
+		vk::Semaphore flushFrame(uint64_t& waitValue);
+		//Queue families a buffer written by the transfer queue is shared with, empty when there is only the main queue
+		std::vector<uint32_t> getSharedQueueFamilies();
+		Stats getFrameStats();
+		Stats getTotalStats();
+	}
 
 
 	void create(uint32_t width, uint32_t height, uint32_t shadowMapRes);
@@ -47,6 +185,8 @@ namespace eg::Renderer
 	vk::PhysicalDevice getPhysicalDevice();
 	vk::Queue getMainQueue();
 	uint32_t getMainQueueFamilyIndex();
+	vk::Queue getTransferQueue();
+	uint32_t getTransferQueueFamilyIndex();
 	vk::DescriptorPool getDescriptorPool();
 	vk::SurfaceCapabilitiesKHR getSurfaceCapabilities();
 	uint32_t getImageCount();
@@ -56,10 +196,27 @@ namespace eg::Renderer
 	vk::DescriptorSet getCurrentFrameGUBODescSet();
 	vk::DescriptorSetLayout getGlobalDescriptorSet();
 	uint32_t getCurrentFrameIndex();
+	//Frames begun since create, the first is 1
+	uint64_t getFrameNumber();
 
 	const class CombinedImageSampler2D& getDefaultWhiteImage();
 	const class CombinedImageSampler2D& getDefaultCheckerboardImage();
 	const uint32_t getGraphicsQueueFamilyIndex();
+	bool isDrawIndirectCountSupported();
+	//CPU time the last frame spent gathering and recording each stage, summed over its recording jobs
+	double getShadowRecordTimeMs();
+	double getGBufferRecordTimeMs();
+
+	//Where the last frame went, the simulation of a frame overlaps the recording of the one before it
+	struct FrameTimes
+	{
+		double simulationMs = 0.0; //Between two render calls
+		double extractMs = 0.0; //Main thread, gathering packets and snapshotting the state they read
+		double submitMs = 0.0; //Render thread, recording the passes, submitting and presenting
+		double stallMs = 0.0; //Main thread waiting for the previous frame's submit
+		bool pipelined = false;
+	};
+	FrameTimes getFrameTimes();
 
 	void setShadowRenderFunction(RenderFn&& renderFn);
 	void setGBufferRenderFunction(RenderFn&& renderFn);
@@ -73,6 +230,7 @@ namespace eg::Renderer
 	private:
 		vk::Buffer mBuffer;
 		vma::Allocation mAllocation;
+		Upload::Ticket mUploadTicket = 0;
 	public:
 		GPUBuffer(void* data, size_t dataSize, vk::BufferUsageFlags usage);
 		~GPUBuffer();
@@ -85,6 +243,7 @@ namespace eg::Renderer
 		{
 			this->mBuffer = other.mBuffer;
 			this->mAllocation = other.mAllocation;
+			this->mUploadTicket = other.mUploadTicket;
 			other.mBuffer = nullptr;
 			other.mAllocation = nullptr;
 		}
@@ -93,12 +252,14 @@ namespace eg::Renderer
 		{
 			this->mBuffer = other.mBuffer;
 			this->mAllocation = other.mAllocation;
+			this->mUploadTicket = other.mUploadTicket;
 			other.mBuffer = nullptr;
 			other.mAllocation = nullptr;
 		};
 
 
 		vk::Buffer getBuffer() const { return mBuffer; }
+		vk::DeviceSize getAllocationSize() const;
 	};
 
 	class CPUBuffer
@@ -137,9 +298,271 @@ namespace eg::Renderer
 		};
 
 		vk::Buffer getBuffer() const { return mBuffer; }
+		vk::DeviceSize getAllocationSize() const { return mInfo.size; }
 	};
 
 
+	//Static mesh geometry lives in a few large device local blocks, each mesh takes a range of one block.
+	//Meshes in the same block share one vertex and one index binding
+	namespace GeometryPool
+	{
+		struct Vertex
+		{
+			glm::vec3 position;
+			glm::vec3 normal;
+			glm::vec2 uv;
+		};
+		using Index = uint32_t;
+
+		struct Stats
+		{
+			uint32_t blocks = 0;
+			uint32_t allocations = 0;
+			vk::DeviceSize capacity = 0; //Vertex and index bytes of every block
+			vk::DeviceSize used = 0;
+		};
+
+		void create();
+		void destroy();
+		Stats getStats();
+	}
+
+	//Vertices and indices of one mesh, suballocated from the geometry pool
+	class MeshBuffer
+	{
+	private:
+		vk::Buffer mVertexBuffer;
+		vk::Buffer mIndexBuffer;
+		uint32_t mBlock = std::numeric_limits<uint32_t>::max();
+		uint32_t mFirstVertex = 0;
+		uint32_t mVertexCount = 0;
+		uint32_t mFirstIndex = 0;
+		uint32_t mIndexCount = 0;
+		Upload::Ticket mUploadTicket = 0;
+	public:
+		//Attribute streams are interleaved, 16 bit indices are widened
+		MeshBuffer(const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* uvs, uint32_t vertexCount,
+			const void* indices, uint32_t indexCount, vk::IndexType indexType);
+		~MeshBuffer();
+
+		MeshBuffer(const MeshBuffer&) = delete;
+		MeshBuffer operator=(const MeshBuffer&) = delete;
+
+		MeshBuffer(MeshBuffer&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MeshBuffer& operator=(MeshBuffer&& other) noexcept
+		{
+			std::swap(this->mVertexBuffer, other.mVertexBuffer);
+			std::swap(this->mIndexBuffer, other.mIndexBuffer);
+			std::swap(this->mBlock, other.mBlock);
+			std::swap(this->mFirstVertex, other.mFirstVertex);
+			std::swap(this->mVertexCount, other.mVertexCount);
+			std::swap(this->mFirstIndex, other.mFirstIndex);
+			std::swap(this->mIndexCount, other.mIndexCount);
+			std::swap(this->mUploadTicket, other.mUploadTicket);
+			return *this;
+		}
+
+		//Draws with firstIndex and vertexOffset from the getters, the index type is always eUint32
+		vk::Buffer getVertexBuffer() const { return mVertexBuffer; }
+		vk::Buffer getIndexBuffer() const { return mIndexBuffer; }
+		uint32_t getFirstVertex() const { return mFirstVertex; }
+		uint32_t getVertexCount() const { return mVertexCount; }
+		uint32_t getFirstIndex() const { return mFirstIndex; }
+		uint32_t getIndexCount() const { return mIndexCount; }
+		vk::DeviceSize getAllocationSize() const;
+	};
+
+	//Transient data that only lives for a frame, bumped from preallocated memory and reset wholesale in begin.
+	//CPU scratch comes from one arena, dynamic uniforms and vertices from a host visible ring per frame in flight,
+	//whose reset waits for the frame's fence. Both can be allocated from any gather thread
+	namespace FrameAllocator
+	{
+		struct Stats
+		{
+			size_t cpuUsed = 0;
+			size_t cpuCapacity = 0;
+			vk::DeviceSize gpuUsed = 0;
+			vk::DeviceSize gpuCapacity = 0;
+			uint32_t heapFallbacks = 0; //Scratch that didn't fit the arena, 0 in a steady frame
+			uint32_t gpuFailures = 0; //Ring allocations that didn't fit, their draws were dropped
+			uint32_t heapAllocations = 0; //Every operator new inside a CountScope, debug builds only
+		};
+
+		//Debug builds count the operator new calls a thread makes while one of these is alive,
+		//the renderer opens one around its frame work on every thread that takes part
+		class CountScope
+		{
+		private:
+			bool mPrevious;
+		public:
+			CountScope();
+			~CountScope();
+			CountScope(const CountScope&) = delete;
+			CountScope& operator=(const CountScope&) = delete;
+		};
+
+		struct GPUAllocation
+		{
+			vk::Buffer buffer;
+			vk::DeviceSize offset = 0;
+			void* data = nullptr;
+
+			explicit operator bool() const { return data != nullptr; }
+		};
+
+		void create();
+		void destroy();
+		//Called by begin once the frame's fence was waited on
+		void beginFrame();
+
+		//Valid until the next begin, never keep scratch across frames
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		//Default constructed and never destroyed
+		template<typename T>
+		T* allocateArray(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>);
+			T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+			std::uninitialized_default_construct_n(data, count);
+			return data;
+		}
+
+		//Aligned for dynamic uniform offsets, empty when the ring is full
+		GPUAllocation allocateGPU(vk::DeviceSize size);
+		//For descriptor sets that pick their data with a dynamic offset, one per frame in flight
+		vk::Buffer getGPUBuffer(uint32_t frameIndex);
+		//Of the last frame that finished extracting
+		Stats getStats();
+	}
+
+	//Textures and materials of every model live in one update after bind descriptor set, bound once per pass.
+	//Draws pick their material by index, the material holds the indices of its textures
+	namespace Bindless
+	{
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		//Matches the Material struct of the model fragment shaders
+		struct Material
+		{
+			float albedoColor[3] = { 1.0f, 1.0f, 1.0f };
+			uint32_t albedo = INVALID_INDEX; //Texture indices, INVALID_INDEX when the material has none
+			uint32_t normal = INVALID_INDEX;
+			uint32_t mr = INVALID_INDEX;
+			uint32_t pad[2] = {};
+		};
+		static_assert(sizeof(Material) == 32);
+
+		struct Stats
+		{
+			uint32_t textures = 0;
+			uint32_t textureCapacity = 0;
+			uint32_t materials = 0;
+			uint32_t materialCapacity = 0;
+		};
+
+		void create();
+		void destroy();
+
+		//Slots can be added from any thread, remove them once no frame in flight reads them
+		uint32_t addTexture(vk::ImageView view, vk::Sampler sampler);
+		void removeTexture(uint32_t index);
+		uint32_t addMaterial(const Material& material);
+		void removeMaterial(uint32_t index);
+
+		vk::DescriptorSetLayout getLayout();
+		vk::DescriptorSet getSet();
+		Stats getStats();
+	}
+
+	//Draws submitted while a stage gathers are sorted by key, then recorded in ranges
+	//with every pipeline, descriptor set, vertex and index buffer bind equal to the bound one skipped.
+	//A stage is submitted to from one thread at a time, its sorted ranges can be recorded from many
+	namespace RenderQueue
+	{
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+		static constexpr uint32_t MAX_VERTEX_BUFFERS = 6;
+		static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+		static constexpr uint32_t MAX_DYNAMIC_OFFSETS = 4;
+
+		struct Packet
+		{
+			uint64_t key = 0;
+			vk::Pipeline pipeline;
+			vk::PipelineLayout layout;
+			vk::DescriptorSet sets[MAX_DESCRIPTOR_SETS]; //Bound from set 0
+			uint32_t setCount = 0;
+			uint32_t dynamicOffsets[MAX_DYNAMIC_OFFSETS]; //Only the last set may have dynamic bindings
+			uint32_t dynamicOffsetCount = 0;
+			vk::Buffer vertexBuffers[MAX_VERTEX_BUFFERS]; //Bound from binding 0 at offset 0
+			uint32_t vertexBufferCount = 0;
+			vk::Buffer indexBuffer; //Always eUint32
+			vk::ShaderStageFlags pushConstantStages;
+			uint32_t pushConstantSize = 0;
+			uint8_t pushConstants[MAX_PUSH_CONSTANT_SIZE];
+
+			uint32_t indexCount = 0;
+			uint32_t instanceCount = 1;
+			uint32_t firstIndex = 0;
+			int32_t vertexOffset = 0;
+			uint32_t firstInstance = 0;
+			//drawIndexedIndirectCount instead of drawIndexed when set
+			vk::Buffer indirectBuffer;
+			vk::DeviceSize indirectOffset = 0;
+			vk::Buffer countBuffer;
+			vk::DeviceSize countOffset = 0;
+			uint32_t maxDrawCount = 0;
+			uint32_t stride = 0;
+		};
+
+		struct Stats
+		{
+			uint32_t packets = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t descriptorBinds = 0;
+			uint32_t vertexBufferBinds = 0;
+			uint32_t indexBufferBinds = 0;
+			uint32_t draws = 0;
+		};
+
+		void create();
+		void destroy();
+
+		//Pipeline in the top bits, then bindless material index, mesh and front to back depth, handles are hashed into their fields
+		uint64_t makeKey(vk::Pipeline pipeline, uint32_t material, vk::Buffer mesh, float depth);
+		void submit(RenderStage stage, const Packet& packet);
+		//Sorts the stage's packets once submitting is done, returns how many there are
+		uint32_t sort(RenderStage stage);
+		//Records count sorted packets from first, every range starts with nothing bound
+		void record(vk::CommandBuffer cmd, RenderStage stage, uint32_t first, uint32_t count);
+		//Drops the stage's packets once every range is recorded
+		void finish(RenderStage stage);
+		Stats getStats(RenderStage stage);
+	}
+
+	//Worker threads recording secondary command buffers, each worker and the waiting thread own one command pool
+	//per frame in flight. The pools of a frame are reset by beginFrame, after its fence was waited on
+	namespace Recording
+	{
+		using Job = std::function<void(uint32_t context)>;
+
+		void create();
+		void destroy();
+
+		void beginFrame();
+		void dispatch(Job&& job);
+		//Runs queued jobs on the calling thread until every dispatched job has finished. The last context belongs
+		//to whichever thread waits, the main thread while extracting and the render thread while submitting, never both
+		void wait();
+		//Worker threads plus the waiting thread, context indices run below this
+		uint32_t getContextCount();
+		vk::CommandBuffer beginSecondary(uint32_t context, const vk::CommandBufferInheritanceInfo& inheritance);
+	}
+
+
 	class Image2D
 	{
 	private:
@@ -148,11 +571,16 @@ namespace eg::Renderer
 		vma::Allocation mAllocation;
 		vk::ImageView mImageView;
 		vk::Format mFormat;
+		Upload::Ticket mUploadTicket = 0;
 	public:
 		Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
 			uint32_t miplevels);
+		//With data, level 0 is uploaded and the rest of the chain is blitted on the GPU if the format allows it
 		Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
 			void* data = nullptr, size_t sizeInBytes = 0);
+		//Prebuilt mip chain, levels packed one after another starting with the largest
+		Image2D(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspectFlags,
+			uint32_t mipLevels, const void* data, size_t sizeInBytes);
 		~Image2D();
 
 
@@ -161,8 +589,11 @@ namespace eg::Renderer
 		Image2D(Image2D&& other) noexcept
 		{
 			this->mImage = other.mImage;
+			this->mMipLevels = other.mMipLevels;
 			this->mAllocation = other.mAllocation;
 			this->mImageView = other.mImageView;
+			this->mFormat = other.mFormat;
+			this->mUploadTicket = other.mUploadTicket;
 
 			other.mImage = nullptr;
 			other.mAllocation = nullptr;
@@ -171,8 +602,11 @@ namespace eg::Renderer
 		Image2D& operator=(Image2D&& other) noexcept
 		{
 			this->mImage = other.mImage;
+			this->mMipLevels = other.mMipLevels;
 			this->mAllocation = other.mAllocation;
 			this->mImageView = other.mImageView;
+			this->mFormat = other.mFormat;
+			this->mUploadTicket = other.mUploadTicket;
 
 			other.mImage = nullptr;
 			other.mAllocation = nullptr;
@@ -186,6 +620,7 @@ namespace eg::Renderer
 		vk::Image getImage() const { return mImage; }
 		vk::ImageView getImageView() const { return mImageView; }
 		vk::Format getFormat() const { return mFormat; }
+		vk::DeviceSize getAllocationSize() const;
 	};
 
 
@@ -200,6 +635,11 @@ namespace eg::Renderer
 			vk::ImageUsageFlags usage,
 			vk::ImageAspectFlags aspectFlags,
 			void* data = nullptr, size_t sizeInBytes = 0);
+		CombinedImageSampler2D(uint32_t width, uint32_t height,
+			vk::Format format,
+			vk::ImageUsageFlags usage,
+			vk::ImageAspectFlags aspectFlags,
+			uint32_t mipLevels, const void* data, size_t sizeInBytes);
 		~CombinedImageSampler2D();
 
 		CombinedImageSampler2D(const CombinedImageSampler2D&) = delete;
@@ -3,17 +3,52 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <string_view>
 #include <nlohmann/json.hpp>
+#include <glm/mat4x4.hpp>
 
 #include <MyVulkan.h>
 #include <RenderStages.h>
 #include <Components.h>
+#include <Jolt/Physics/EActivation.h>
+
+namespace eg::Data
+{
+	class MappedFile;
+}
 
 namespace eg::World
 {
+	//Bodies created with BodyInterface::CreateBody during a load, added to the physics system in one batch
+	class LoadContext
+	{
+	private:
+		std::vector<JPH::BodyID> mActivatedBodies;
+		std::vector<JPH::BodyID> mDeactivatedBodies;
+	public:
+		void addBody(JPH::BodyID body, JPH::EActivation activation);
+		void append(LoadContext& other);
+		//AddBodiesPrepare/AddBodiesFinalize for every pending body, main thread only
+		void flush();
+		size_t getBodyCount() const { return mActivatedBodies.size() + mDeactivatedBodies.size(); }
+	};
+
 	class IGameObject
 	{
 	public:
+		//Phases an object takes part in, objects outside a phase are never iterated for it
+		enum UpdatePhase : uint32_t
+		{
+			PHASE_NONE = 0,
+			PHASE_UPDATE = 1 << 0,
+			PHASE_PRE_PHYSICS = 1 << 1,
+			PHASE_FIXED_UPDATE = 1 << 2,
+			PHASE_ALL = PHASE_UPDATE | PHASE_PRE_PHYSICS | PHASE_FIXED_UPDATE,
+		};
+
 		IGameObject() = default;
 		virtual ~IGameObject() = default;
 
@@ -26,13 +61,93 @@ namespace eg::World
 		virtual const char* getType() const = 0;
 
 		virtual void onInspector() = 0;
+
+		//Object pool hooks. onPoolRelease parks the object's resources (physics body, GPU buffers) instead of freeing them,
+		//onPoolAcquire re-initializes a parked object in place and returns false if it can't be reused for that json
+		virtual void onPoolRelease() {}
+		virtual bool onPoolAcquire(const nlohmann::json& json) { return false; }
+		//Called when the object leaves the world for good. Physics bodies go right away so they stop colliding,
+		//GPU resources stay alive in the destructor until the frames in flight are done with them
+		virtual void onRetire() {}
+
+		//Writes the object's transform hierarchy nodes, called once when added to the world and then every frame
+		//while the object is awake in pre physics, before the world matrices are resolved
+		virtual void updateTransform(float alpha) {}
+
+		//Read when the object is added to the world
+		virtual uint32_t getUpdatePhases() const { return PHASE_ALL; }
+		//Pre physics and fixed update are skipped while this body sleeps
+		virtual JPH::BodyID getSleepBody() const { return JPH::BodyID(); }
+
+		//Two phase loading. prepareLoad runs on a loader thread: parsing, file I/O, asset decoding, shape building
+		//and body creation (handed to the context, not added). finishLoad runs on the main thread for GPU uploads.
+		//Objects that return false are loaded with fromJson on the main thread instead
+		virtual bool prepareLoad(const nlohmann::json& json, LoadContext& context) { return false; }
+		virtual void finishLoad() {}
+	};
+
+	//Parent/child transforms stored as SoA arrays sorted by depth (a parent always precedes its children),
+	//world matrices are recomputed in one linear pass, only for dirty subtrees
+	class TransformHierarchy
+	{
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = std::numeric_limits<uint32_t>::max();
+	private:
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		//Dense arrays, indexed by slot
+		std::vector<uint32_t> mParents;
+		std::vector<uint8_t> mDirty;
+		std::vector<glm::mat4x4> mLocals;
+		std::vector<glm::mat4x4> mWorlds;
+		std::vector<Handle> mHandles;
+
+		//Sparse handle -> slot table
+		std::vector<uint32_t> mHandleToIndex;
+		std::vector<Handle> mFreeHandles;
+
+		//Child lists, indexed by handle so rebuilding the slots leaves them alone
+		std::vector<Handle> mFirstChild;
+		std::vector<Handle> mNextSibling;
+		std::vector<Handle> mPrevSibling;
+
+		uint32_t mFirstDirty = INVALID_INDEX;
+		uint32_t mLastUpdatedCount = 0;
+		bool mNeedsRebuild = false;
+	public:
+		TransformHierarchy() = default;
+		~TransformHierarchy() = default;
+
+		Handle create(Handle parent = INVALID_HANDLE, const glm::mat4x4& local = glm::mat4x4(1.0f));
+		void destroy(Handle handle);
+		void clear();
+		void reserve(size_t count);
+
+		void setParent(Handle handle, Handle parent);
+		void setLocal(Handle handle, const glm::mat4x4& local);
+		Handle getParent(Handle handle) const;
+		const glm::mat4x4& getLocal(Handle handle) const { return mLocals[mHandleToIndex[handle]]; }
+		const glm::mat4x4& getWorld(Handle handle) const { return mWorlds[mHandleToIndex[handle]]; }
+		bool isValid(Handle handle) const;
+
+		void update();
+
+		size_t size() const { return mHandles.size(); }
+		uint32_t getLastUpdatedCount() const { return mLastUpdatedCount; }
+	private:
+		void markDirty(uint32_t index);
+		void link(Handle handle, Handle parent);
+		void unlink(Handle handle, Handle parent);
+		void rebuild();
 	};
 
 	class DynamicWorldObject final : public IGameObject
 	{
 	private:
-		std::shared_ptr<Components::StaticModel> mModel = nullptr;
+		Components::AssetHandle<Components::StaticModel> mModel;
 		eg::Components::RigidBody mBody;
+		TransformHierarchy::Handle mNode = TransformHierarchy::INVALID_HANDLE;
 	public:
 		DynamicWorldObject() = default;
 		virtual ~DynamicWorldObject();
@@ -45,9 +160,14 @@ namespace eg::World
 		virtual void fromJson(const nlohmann::json& json) final;
 		virtual const char* getType() const final { return "DynamicWorldObject"; }
 		virtual void onInspector() final {};
+		virtual void onPoolRelease() final { mBody.park(); }
+		virtual void onRetire() final { mBody.destroy(); }
+		virtual void updateTransform(float alpha) final;
+		virtual bool onPoolAcquire(const nlohmann::json& json) final;
+		virtual uint32_t getUpdatePhases() const final { return PHASE_PRE_PHYSICS; }
+		virtual JPH::BodyID getSleepBody() const final { return mBody.mBodyID; }
 	};
 
-
 	//Json load dispatcher function pointer
 	using JsonToIGameObjectDispatcher = std::function<std::unique_ptr<IGameObject>(const nlohmann::json&, const std::string&)>;
 
@@ -69,11 +189,41 @@ namespace eg::World
 		}
 	};
 
+	//Type erased part of ObjectPool, pools register themselves so the world can spawn pooled types by name
+	//and drop parked objects before physics is reset
+	class IObjectPool
+	{
+	private:
+		std::string mType;
+	protected:
+		size_t mCreatedCount = 0;
+		size_t mReusedCount = 0;
+	public:
+		IObjectPool(const std::string& type);
+		IObjectPool(const IObjectPool&) = delete;
+		IObjectPool& operator=(const IObjectPool&) = delete;
+		virtual ~IObjectPool();
+
+		virtual IGameObject* spawnObject(const nlohmann::json& json) = 0;
+		virtual void despawnObject(IGameObject* object) = 0;
+		virtual void clear() = 0;
+		virtual size_t getFreeCount() const = 0;
+
+		const std::string& getType() const { return mType; }
+		size_t getCreatedCount() const { return mCreatedCount; }
+		size_t getReusedCount() const { return mReusedCount; }
+	};
+
 	void create();
 	void destroy();
 	void cleanup();
 	void addGameObject(std::unique_ptr<IGameObject> gameobject);
 	void removeGameObject(const IGameObject* gameObject);
+	//Takes ownership back from the world without destroying the object
+	std::unique_ptr<IGameObject> detachGameObject(const IGameObject* gameObject);
+	//Destroys the object once the frames in flight that may reference it have completed
+	void retireGameObject(std::unique_ptr<IGameObject> gameObject);
+	IObjectPool* findObjectPool(const std::string& type);
 
 	void update(float delta, float alpha);
 	void prePhysicsUpdate(float delta);
@@ -83,6 +233,185 @@ namespace eg::World
 	void save(const std::string& filename);
 	void load(const std::string& filename, JsonToIGameObjectDispatcher dispatcher);
 	std::vector<std::unique_ptr<IGameObject>>& getGameObjects();
+	//Objects iterated by the last fixed tick, sleeping and static objects excluded
+	size_t getActiveObjectCount();
+	TransformHierarchy& getTransformHierarchy();
+	const std::string& getWorldName();
+	void setWorldName(const std::string& name);
+
+	//Pre physics and fixed update are skipped for sleeping objects
+	bool isGameObjectSleeping(const IGameObject* gameObject);
+	//Identifies a live object in the save journal, assigned when the object is added to the world
+	uint64_t getSaveId(const IGameObject* gameObject);
+	void setSaveId(const IGameObject* gameObject, uint64_t saveId);
+	uint64_t allocateSaveId();
+
+	void benchmarkTransformHierarchy(uint32_t nodeCount);
+	//Looks for the first "position" array, game objects nest it in different components
+	bool findGameObjectPosition(const nlohmann::json& json, glm::vec3& position);
+
+	//Despawned objects are parked instead of destroyed, spawning reuses them through onPoolAcquire
+	template<typename T>
+	class ObjectPool final : public IObjectPool
+	{
+		static_assert(std::is_base_of_v<IGameObject, T>, "T must be a game object");
+	private:
+		std::vector<std::unique_ptr<T>> mFree;
+	public:
+		ObjectPool(const std::string& type) : IObjectPool(type) {}
+		~ObjectPool() { clear(); }
+
+		T* spawn(const nlohmann::json& json)
+		{
+			std::unique_ptr<T> object;
+			while (!mFree.empty() && !object)
+			{
+				object = std::move(mFree.back());
+				mFree.pop_back();
+				if (!object->onPoolAcquire(json))
+				{
+					retireGameObject(std::move(object));
+					object = nullptr;
+				}
+				else
+				{
+					mReusedCount++;
+				}
+			}
+			if (!object)
+			{
+				object = std::make_unique<T>();
+				object->fromJson(json);
+				mCreatedCount++;
+			}
+			T* ptr = object.get();
+			addGameObject(std::move(object));
+			return ptr;
+		}
+
+		void despawn(T* object)
+		{
+			std::unique_ptr<IGameObject> owned = detachGameObject(object);
+			if (!owned)
+				return;
+			owned->onPoolRelease();
+			mFree.push_back(std::unique_ptr<T>(static_cast<T*>(owned.release())));
+		}
+
+		//Creates count parked objects up front
+		void prewarm(size_t count, const nlohmann::json& json)
+		{
+			std::vector<T*> objects;
+			objects.reserve(count);
+			for (size_t i = 0; i < count; i++)
+				objects.push_back(spawn(json));
+			for (T* object : objects)
+				despawn(object);
+		}
+
+		virtual IGameObject* spawnObject(const nlohmann::json& json) override { return spawn(json); }
+		virtual void despawnObject(IGameObject* object) override { despawn(static_cast<T*>(object)); }
+		virtual void clear() override { mFree.clear(); }
+		virtual size_t getFreeCount() const override { return mFree.size(); }
+	};
+
+	//World partition: objects of streamable types are bucketed into spatial cells
+	//that stream in and out around a focus point, other objects are always resident
+	namespace Streaming
+	{
+		void create();
+		void destroy();
+		void reset();
+
+		void registerStreamableType(const std::string& type);
+		void load(const std::string& filename, JsonToIGameObjectDispatcher dispatcher);
+		void update(const glm::vec3& focus);
+
+		void appendNonResidentObjects(nlohmann::json& gameObjectsJson);
+		//Gives every non resident object a fresh save id and appends it, used when a journal starts
+		void stampNonResidentObjects(nlohmann::json& gameObjectsJson);
+		//Index, parse or prepare jobs in flight, their objects can't be stamped yet
+		bool isBusy();
+		size_t getResidentCellCount();
+		size_t getCellCount();
+	}
+
+	//Incremental save. The base file is written once when the journal starts, after that only changed objects are
+	//snapshotted (on the main thread, between frames) and appended to <base>.journal by a writer thread that keeps
+	//its own copy of the world and periodically compacts it back into the base file
+	namespace Journal
+	{
+		static constexpr const char* EXTENSION = ".journal";
+
+		void create();
+		void destroy();
+
+		void begin(const std::string& filename);
+		//Saves the last changes and waits for the writer thread
+		void end();
+		bool isActive();
+
+		//For changes the journal can't see, objects with an awake body or per frame updates are always saved
+		void markDirty(const IGameObject* gameObject);
+		void update(float delta);
+		void autosave();
+		void compact();
+		//Folds a journal left behind by a crash into its base file
+		void recover(const std::string& filename);
+
+		void onObjectAdded(const IGameObject* gameObject);
+		void onObjectDetached(const IGameObject* gameObject, uint64_t saveId);
+		//The object leaves the world but not the save, objJson is its final state
+		void onObjectStreamedOut(const IGameObject* gameObject, const nlohmann::json& objJson);
+	}
+
+	//Versioned binary world (.egw): flat offset based tables that are read in place from a mapped file,
+	//each object body is msgpack and only decoded when the object is instantiated
+	namespace Binary
+	{
+		static constexpr uint32_t VERSION = 1;
+		static constexpr const char* EXTENSION = ".egw";
+
+		struct ObjectView
+		{
+			std::string_view type;
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+			bool hasPosition = false;
+			glm::vec3 position = glm::vec3(0.0f);
+
+			nlohmann::json decode() const { return nlohmann::json::from_msgpack(data, data + size); }
+		};
+
+		class Reader
+		{
+		private:
+			std::unique_ptr<Data::MappedFile> mFile;
+			const uint8_t* mStrings = nullptr;
+			const uint8_t* mTypes = nullptr;
+			const uint8_t* mObjects = nullptr;
+			const uint8_t* mData = nullptr;
+			uint64_t mStringsSize = 0;
+			uint64_t mDataSize = 0;
+			uint32_t mObjectCount = 0;
+			uint32_t mTypeCount = 0;
+			std::string_view mWorldName;
+		public:
+			Reader(const std::string& filename);
+			~Reader();
+
+			uint32_t getObjectCount() const { return mObjectCount; }
+			std::string_view getWorldName() const { return mWorldName; }
+			ObjectView getObject(uint32_t index) const;
+		};
+
+		bool isBinaryWorld(const std::string& filename);
+		void write(const std::string& filename, const std::string& worldName, const nlohmann::json& gameObjectsJson);
+
+		void convertJsonToBinary(const std::string& jsonFile, const std::string& binaryFile);
+		void convertBinaryToJson(const std::string& binaryFile, const std::string& jsonFile);
+		void benchmark(uint32_t objectCount);
+	}
 
 
 }
\ No newline at end of file